@@ -0,0 +1,1218 @@
+#include "../include/serialization.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "json.hh"
+
+#ifdef SERIALIZATION_TOOLS
+#include "block.abc.h"
+#endif
+
+
+using namespace ObjectModel;
+using json = nlohmann::json;
+
+
+// counts every heap allocation so benchmarks can report allocs per iteration
+static std::atomic<size_t> allocations{0};
+
+// every form of new takes its memory from malloc, or aligned_alloc when an
+// alignment is asked for, and every form of delete hands it to free
+static void* allocate(size_t n, size_t alignment = 0)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	n = n ? n : 1;
+	if (alignment == 0)
+	{
+		return std::malloc(n);
+	}
+	return std::aligned_alloc(alignment, (n + alignment - 1) / alignment * alignment);
+}
+
+static void* allocateOrThrow(size_t n, size_t alignment = 0)
+{
+	if (void* p = allocate(n, alignment))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t n) { return allocateOrThrow(n); }
+void* operator new[](size_t n) { return allocateOrThrow(n); }
+void* operator new(size_t n, std::align_val_t a) { return allocateOrThrow(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a) { return allocateOrThrow(n, (size_t)a); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return allocate(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return allocate(n); }
+void* operator new(size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate(n, (size_t)a); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+
+namespace
+{
+	// the legacy pack/unpack iterate with an int16_t, keep every message below 32k
+	constexpr int maxArrayBytes = 16 * 1024;
+
+	struct AllocationCounter
+	{
+		size_t start = allocations.load();
+
+		void report(benchmark::State& state)
+		{
+			state.counters["allocs/iter"] = benchmark::Counter(
+				(double)(allocations.load() - start), benchmark::Counter::kAvgIterations);
+		}
+	};
+
+	template<typename T>
+	std::vector<T> samples(int n)
+	{
+		std::vector<T> result(n);
+		for (int i = 0; i < n; i++)
+		{
+			result[i] = (T)(i * 37 % 101);
+		}
+		return result;
+	}
+
+	std::vector<uint8_t> packed(Root& root)
+	{
+		int16_t it = 0;
+		std::vector<uint8_t> buffer(root.getSize());
+		root.pack(buffer, it);
+		return buffer;
+	}
+
+	Object makeWide(int fields)
+	{
+		Object obj("wide");
+		for (int i = 0; i < fields; i++)
+		{
+			std::unique_ptr<Primitive> p = Primitive::create("field" + std::to_string(i), Type::I32, i);
+			obj.addEntity(p.get());
+		}
+		return obj;
+	}
+
+	Object makeDeep(int depth)
+	{
+		std::unique_ptr<Primitive> leaf = Primitive::create("leaf", Type::I64, (int64_t)depth);
+		Object obj("level");
+		obj.addEntity(leaf.get());
+
+		for (int i = 1; i < depth; i++)
+		{
+			Object parent("level");
+			parent.addEntity(leaf.get());
+			parent.addEntity(&obj);
+			obj = parent;
+		}
+		return obj;
+	}
+
+	// same fields as Block::serialize in the Blockchain project
+	struct BlockRecord
+	{
+		int32_t difficulty;
+		int32_t counter;
+		std::string minedTime;
+		std::string prevHash;
+		std::string hash;
+		std::string nonce;
+		std::vector<int8_t> data;
+	};
+
+	BlockRecord makeRecord(int i)
+	{
+		return BlockRecord
+		{
+			4, i, "2023-01-0" + std::to_string(i % 9 + 1) + " | 12:00:00",
+			std::string(64, 'a' + i % 26), std::string(64, 'b' + i % 25), std::to_string(i * 7919),
+			samples<int8_t>(256)
+		};
+	}
+
+	Object blockObject(const BlockRecord& r)
+	{
+		Object object("data");
+		std::unique_ptr<Primitive> difficulty = Primitive::create("difficulty", Type::I32, r.difficulty);
+		std::unique_ptr<Primitive> counter = Primitive::create("counter", Type::I32, r.counter);
+		std::unique_ptr<Array> minedTime = Array::createString("minedTime", Type::I8, r.minedTime);
+		std::unique_ptr<Array> prevHash = Array::createString("prevHash", Type::I8, r.prevHash);
+		std::unique_ptr<Array> hash = Array::createString("hash", Type::I8, r.hash);
+		std::unique_ptr<Array> nonce = Array::createString("nonce", Type::I8, r.nonce);
+		std::unique_ptr<Array> tx = Array::createArray("data", Type::I8, r.data);
+
+		object.addEntity(difficulty.get());
+		object.addEntity(counter.get());
+		object.addEntity(minedTime.get());
+		object.addEntity(prevHash.get());
+		object.addEntity(hash.get());
+		object.addEntity(nonce.get());
+		object.addEntity(tx.get());
+		return object;
+	}
+
+	json blockJson(const BlockRecord& r)
+	{
+		json j;
+		j["difficulty"] = r.difficulty;
+		j["counter"] = r.counter;
+		j["minedTime"] = r.minedTime;
+		j["prevHash"] = r.prevHash;
+		j["hash"] = r.hash;
+		j["nonce"] = r.nonce;
+		j["data"] = r.data;
+		return j;
+	}
+}
+
+
+template<typename T, Type type>
+static void BM_PackPrimitive(benchmark::State& state)
+{
+	std::unique_ptr<Primitive> p = Primitive::create("value", type, (T)42);
+	std::vector<uint8_t> buffer(p->getSize());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		p->pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.SetBytesProcessed(state.iterations() * p->getSize());
+}
+
+template<typename T, Type type>
+static void BM_UnpackPrimitive(benchmark::State& state)
+{
+	std::unique_ptr<Primitive> p = Primitive::create("value", type, (T)42);
+	std::vector<uint8_t> buffer = packed(*p);
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Primitive result = Primitive::unpack(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+#define PRIMITIVE_BENCHMARKS(T, type) \
+	BENCHMARK_TEMPLATE(BM_PackPrimitive, T, type); \
+	BENCHMARK_TEMPLATE(BM_UnpackPrimitive, T, type);
+
+PRIMITIVE_BENCHMARKS(int8_t, Type::I8)
+PRIMITIVE_BENCHMARKS(int16_t, Type::I16)
+PRIMITIVE_BENCHMARKS(int32_t, Type::I32)
+PRIMITIVE_BENCHMARKS(int64_t, Type::I64)
+PRIMITIVE_BENCHMARKS(float, Type::FLOAT)
+PRIMITIVE_BENCHMARKS(double, Type::DOUBLE)
+PRIMITIVE_BENCHMARKS(bool, Type::BOOL)
+PRIMITIVE_BENCHMARKS(uint8_t, Type::U8)
+PRIMITIVE_BENCHMARKS(uint16_t, Type::U16)
+PRIMITIVE_BENCHMARKS(uint32_t, Type::U32)
+PRIMITIVE_BENCHMARKS(uint64_t, Type::U64)
+
+
+template<typename T, Type type>
+static void BM_PackArray(benchmark::State& state)
+{
+	std::unique_ptr<Array> arr = Array::createArray("values", type, samples<T>((int)state.range(0)));
+	std::vector<uint8_t> buffer(arr->getSize());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		arr->pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.SetBytesProcessed(state.iterations() * arr->getSize());
+}
+
+template<typename T, Type type>
+static void BM_UnpackArray(benchmark::State& state)
+{
+	std::unique_ptr<Array> arr = Array::createArray("values", type, samples<T>((int)state.range(0)));
+	std::vector<uint8_t> buffer = packed(*arr);
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Array result = Array::unpack(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+#define ARRAY_BENCHMARKS(T, type) \
+	BENCHMARK_TEMPLATE(BM_PackArray, T, type)->RangeMultiplier(8)->Range(16, maxArrayBytes / sizeof(T)); \
+	BENCHMARK_TEMPLATE(BM_UnpackArray, T, type)->RangeMultiplier(8)->Range(16, maxArrayBytes / sizeof(T));
+
+ARRAY_BENCHMARKS(int8_t, Type::I8)
+ARRAY_BENCHMARKS(int16_t, Type::I16)
+ARRAY_BENCHMARKS(int32_t, Type::I32)
+ARRAY_BENCHMARKS(int64_t, Type::I64)
+ARRAY_BENCHMARKS(float, Type::FLOAT)
+ARRAY_BENCHMARKS(double, Type::DOUBLE)
+ARRAY_BENCHMARKS(bool, Type::BOOL)
+ARRAY_BENCHMARKS(uint8_t, Type::U8)
+ARRAY_BENCHMARKS(uint16_t, Type::U16)
+ARRAY_BENCHMARKS(uint32_t, Type::U32)
+ARRAY_BENCHMARKS(uint64_t, Type::U64)
+
+
+// to a native value: unpack and getData before, a TypedPrimitive now
+template<typename T>
+static void BM_ReadPrimitive(benchmark::State& state)
+{
+	std::unique_ptr<Primitive> p = Primitive::create("value", (T)42);
+	std::vector<uint8_t> buffer = packed(*p);
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Primitive result = Primitive::unpack(buffer, it);
+		T value = Core::load<T>(result.getData().data());
+		benchmark::DoNotOptimize(value);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+template<typename T>
+static void BM_ReadTypedPrimitive(benchmark::State& state)
+{
+	std::unique_ptr<Primitive> p = Primitive::create("value", (T)42);
+	std::vector<uint8_t> buffer = packed(*p);
+	TypedPrimitive<T> result;
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		TypedPrimitive<T>::unpack(buffer, it, result);
+		T value = result.get();
+		benchmark::DoNotOptimize(value);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_ReadPrimitive, int32_t);
+BENCHMARK_TEMPLATE(BM_ReadTypedPrimitive, int32_t);
+BENCHMARK_TEMPLATE(BM_ReadPrimitive, double);
+BENCHMARK_TEMPLATE(BM_ReadTypedPrimitive, double);
+
+template<typename T>
+static void BM_ReadArray(benchmark::State& state)
+{
+	std::unique_ptr<Array> arr = Array::createArray("values", samples<T>((int)state.range(0)));
+	std::vector<uint8_t> buffer = packed(*arr);
+	std::vector<T> values(arr->getCount());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Array result = Array::unpack(buffer, it);
+		result.get(values.data());
+		benchmark::DoNotOptimize(values.data());
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+template<typename T>
+static void BM_ReadTypedArray(benchmark::State& state)
+{
+	std::unique_ptr<Array> arr = Array::createArray("values", samples<T>((int)state.range(0)));
+	std::vector<uint8_t> buffer = packed(*arr);
+	TypedArray<T> result;
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		TypedArray<T>::unpack(buffer, it, result);
+		benchmark::DoNotOptimize(result.get().data());
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+BENCHMARK_TEMPLATE(BM_ReadArray, int32_t)->RangeMultiplier(8)->Range(16, maxArrayBytes / sizeof(int32_t));
+BENCHMARK_TEMPLATE(BM_ReadTypedArray, int32_t)->RangeMultiplier(8)->Range(16, maxArrayBytes / sizeof(int32_t));
+BENCHMARK_TEMPLATE(BM_ReadArray, double)->RangeMultiplier(8)->Range(16, maxArrayBytes / sizeof(double));
+BENCHMARK_TEMPLATE(BM_ReadTypedArray, double)->RangeMultiplier(8)->Range(16, maxArrayBytes / sizeof(double));
+
+
+// a feature vector with range(0) non zero values per thousand: the scan
+// createArray does to pick the layout, and expanding it back
+static std::vector<float> features(int perThousand)
+{
+	std::vector<float> values(maxArrayBytes / sizeof(float));
+	for (size_t i = 0; i < values.size(); i += 1000 / perThousand)
+	{
+		values[i] = (float)i;
+	}
+	return values;
+}
+
+static void BM_SparseCreate(benchmark::State& state)
+{
+	std::vector<float> values = features((int)state.range(0));
+	for (auto _ : state)
+	{
+		std::unique_ptr<Array> arr = Array::createArray("features", Type::FLOAT, values);
+		benchmark::DoNotOptimize(arr);
+	}
+	state.SetBytesProcessed(state.iterations() * values.size() * sizeof(float));
+}
+BENCHMARK(BM_SparseCreate)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_SparseExpand(benchmark::State& state)
+{
+	std::unique_ptr<Array> arr = Array::createArray("features", Type::FLOAT, features((int)state.range(0)));
+	std::vector<float> out(arr->getCount());
+	Object obj("sample");
+	obj.addEntity(arr.get());
+	std::vector<uint8_t> buffer = packed(obj);
+
+	for (auto _ : state)
+	{
+		size_t offset = 0;
+		std::string_view name;
+		ArrayView view;
+		View::enterObject(buffer.data(), buffer.size(), offset, name);
+		offset += 2 * sizeof(int16_t);
+		ArrayView::read(buffer.data(), buffer.size(), offset, view);
+		view.copyTo<float>(out.data());
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetBytesProcessed(state.iterations() * out.size() * sizeof(float));
+	state.counters["packed"] = (double)buffer.size();
+}
+BENCHMARK(BM_SparseExpand)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+
+static void BM_PackBitArray(benchmark::State& state)
+{
+	std::vector<int> values = samples<int>((int)state.range(0));
+	std::unique_ptr<bool[]> bits(new bool[values.size()]);
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		bits[i] = values[i] & 1;
+	}
+
+	for (auto _ : state)
+	{
+		std::unique_ptr<Array> arr = Array::createBitArray("bits", bits.get(), (int32_t)values.size());
+		benchmark::DoNotOptimize(arr->getPtrData()->data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PackBitArray)->Range(64, maxArrayBytes * 8);
+
+static void BM_UnpackBitArray(benchmark::State& state)
+{
+	std::vector<bool> values(state.range(0));
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		values[i] = i % 3 == 0;
+	}
+	std::unique_ptr<Array> arr = Array::createBitArray("bits", values);
+	std::unique_ptr<bool[]> out(new bool[values.size()]);
+
+	for (auto _ : state)
+	{
+		arr->getBits(out.get());
+		benchmark::DoNotOptimize(out.get());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UnpackBitArray)->Range(64, maxArrayBytes * 8);
+
+template<Type type>
+static void BM_HalfArray(benchmark::State& state)
+{
+	std::vector<float> values = samples<float>((int)state.range(0));
+	std::vector<float> out(values.size());
+
+	for (auto _ : state)
+	{
+		std::unique_ptr<Array> arr = Array::createHalfArray("halves", type, values);
+		arr->getFloats(out.data());
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_HalfArray, Type::F16)->Range(64, maxArrayBytes / 2);
+BENCHMARK_TEMPLATE(BM_HalfArray, Type::BF16)->Range(64, maxArrayBytes / 2);
+
+
+static void BM_PackString(benchmark::State& state)
+{
+	std::unique_ptr<Array> str = Array::createString("text", Type::I8, std::string(state.range(0), 'x'));
+	std::vector<uint8_t> buffer(str->getSize());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		str->pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.SetBytesProcessed(state.iterations() * str->getSize());
+}
+BENCHMARK(BM_PackString)->Range(8, maxArrayBytes);
+
+static void BM_UnpackString(benchmark::State& state)
+{
+	std::unique_ptr<Array> str = Array::createString("text", Type::I8, std::string(state.range(0), 'x'));
+	std::vector<uint8_t> buffer = packed(*str);
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Array result = Array::unpackS(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_UnpackString)->Range(8, maxArrayBytes);
+
+
+static void BM_PackWideObject(benchmark::State& state)
+{
+	Object obj = makeWide((int)state.range(0));
+	std::vector<uint8_t> buffer(obj.getSize());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		obj.pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.SetBytesProcessed(state.iterations() * obj.getSize());
+}
+BENCHMARK(BM_PackWideObject)->RangeMultiplier(4)->Range(4, 1024);
+
+static void BM_UnpackWideObject(benchmark::State& state)
+{
+	Object obj = makeWide((int)state.range(0));
+	std::vector<uint8_t> buffer = packed(obj);
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Object result = Object::unpack(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_UnpackWideObject)->RangeMultiplier(4)->Range(4, 1024);
+
+static void BM_PackDeepObject(benchmark::State& state)
+{
+	Object obj = makeDeep((int)state.range(0));
+	std::vector<uint8_t> buffer(obj.getSize());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		obj.pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.SetBytesProcessed(state.iterations() * obj.getSize());
+}
+BENCHMARK(BM_PackDeepObject)->RangeMultiplier(4)->Range(2, 128);
+
+static void BM_UnpackDeepObject(benchmark::State& state)
+{
+	Object obj = makeDeep((int)state.range(0));
+	std::vector<uint8_t> buffer = packed(obj);
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Object result = Object::unpack(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_UnpackDeepObject)->RangeMultiplier(4)->Range(2, 128);
+
+static void BM_StackDecodeWideObject(benchmark::State& state)
+{
+	Object obj = makeWide((int)state.range(0));
+	std::vector<uint8_t> buffer = packed(obj);
+	StackDecoder decoder;
+
+	for (auto _ : state)
+	{
+		Object result("");
+		size_t offset = 0;
+		benchmark::DoNotOptimize(decoder.decode(buffer, offset, result));
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_StackDecodeWideObject)->RangeMultiplier(4)->Range(4, 1024);
+
+static void BM_StackDecodeDeepObject(benchmark::State& state)
+{
+	Object obj = makeDeep((int)state.range(0));
+	std::vector<uint8_t> buffer = packed(obj);
+	StackDecoder decoder;
+
+	for (auto _ : state)
+	{
+		Object result("");
+		size_t offset = 0;
+		benchmark::DoNotOptimize(decoder.decode(buffer, offset, result));
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_StackDecodeDeepObject)->RangeMultiplier(4)->Range(2, 128);
+
+// lookup by name on packed bytes: a linear scan of an object's primitives
+// against the table of a map with the same keys
+static void BM_ObjectScanGet(benchmark::State& state)
+{
+	int fields = (int)state.range(0);
+	Object obj("keys");
+	for (int i = 0; i < fields; i++)
+	{
+		std::unique_ptr<Primitive> p = Primitive::create("key" + std::to_string(i), Type::I32, i);
+		obj.addEntity(p.get());
+	}
+	Encoder encoder;
+	Core::Slice bytes = encoder.encode(obj);
+	std::vector<std::string> keys;
+	for (int i = 0; i < fields; i += std::max(1, fields / 64))
+	{
+		keys.push_back("key" + std::to_string(i));
+	}
+
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		const std::string& key = keys[next++ % keys.size()];
+		size_t offset = 0;
+		std::string_view name;
+		View::enterObject(bytes.data, bytes.length, offset, name);
+		int16_t n = Core::load<int16_t>(bytes.data + offset);
+		offset += sizeof n;
+		int32_t value = 0;
+		for (int16_t i = 0; i < n; i++)
+		{
+			size_t it = offset;
+			uint8_t wrapper;
+			View::readHeader(bytes.data, bytes.length, it, wrapper, name);
+			if (name == key)
+			{
+				value = Core::load<int32_t>(bytes.data + it + 1);
+				break;
+			}
+			View::skipPrimitive(bytes.data, bytes.length, offset);
+		}
+		benchmark::DoNotOptimize(value);
+	}
+}
+BENCHMARK(BM_ObjectScanGet)->RangeMultiplier(8)->Range(8, 4096);
+
+static void BM_MapViewGet(benchmark::State& state)
+{
+	int fields = (int)state.range(0);
+	Map map("keys");
+	for (int i = 0; i < fields; i++)
+	{
+		std::unique_ptr<Primitive> p = Primitive::create("key" + std::to_string(i), Type::I32, i);
+		map.addEntity(p.get());
+	}
+	Encoder encoder;
+	Core::Slice bytes = encoder.encode(map);
+	std::vector<std::string> keys;
+	for (int i = 0; i < fields; i += std::max(1, fields / 64))
+	{
+		keys.push_back("key" + std::to_string(i));
+	}
+
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		const std::string& key = keys[next++ % keys.size()];
+		size_t offset = 0;
+		MapView view;
+		MapView::read(bytes.data, bytes.length, offset, view);
+		int32_t value = 0;
+		view.get(key, Type::I32, value);
+		benchmark::DoNotOptimize(value);
+	}
+}
+BENCHMARK(BM_MapViewGet)->RangeMultiplier(8)->Range(8, 4096);
+
+// View::findField on the same object packed plain and sorted, the
+// second argument is 1 for the sorted layout
+static void BM_ObjectFindField(benchmark::State& state)
+{
+	int fields = (int)state.range(0);
+	Object obj("keys");
+	obj.setSorted(state.range(1) != 0);
+	for (int i = 0; i < fields; i++)
+	{
+		std::unique_ptr<Primitive> p = Primitive::create("key" + std::to_string(i), Type::I32, i);
+		obj.addEntity(p.get());
+	}
+	Encoder encoder;
+	Core::Slice bytes = encoder.encode(obj);
+	std::vector<std::string> keys;
+	for (int i = 0; i < fields; i += std::max(1, fields / 64))
+	{
+		keys.push_back("key" + std::to_string(i));
+	}
+
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		const std::string& key = keys[next++ % keys.size()];
+		size_t field = 0;
+		int32_t value = 0;
+		if (View::findField(bytes.data, bytes.length, 0, key, field))
+		{
+			value = Core::load<int32_t>(bytes.data + field + 3 + key.size() + 1);
+		}
+		benchmark::DoNotOptimize(value);
+	}
+}
+BENCHMARK(BM_ObjectFindField)->ArgsProduct({ { 8, 64, 512, 4096 }, { 0, 1 } });
+
+
+static void BM_BlockPack(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer(obj.getSize());
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		obj.pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * obj.getSize());
+}
+BENCHMARK(BM_BlockPack);
+
+static void BM_BlockUnpack(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = packed(obj);
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Object result = Object::unpack(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockUnpack);
+
+static void BM_BlockEncoderDecoder(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> wire(obj.getSize());
+	Encoder encoder;
+	Decoder decoder;
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		Core::Slice slice = encoder.encode(obj);
+		wire.assign(slice.data, slice.data + slice.length);
+		int16_t it = 0;
+		benchmark::DoNotOptimize(&decoder.decode(wire, it));
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * obj.getSize());
+}
+BENCHMARK(BM_BlockEncoderDecoder);
+
+static void BM_BlockStackDecoder(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = packed(obj);
+	StackDecoder decoder;
+	Object result("");
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		size_t offset = 0;
+		benchmark::DoNotOptimize(decoder.decode(buffer, offset, result));
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockStackDecoder);
+
+// untrusted input: one validation pass, then StackDecoder without checks;
+// compare with BM_BlockStackDecoder, which checks as it goes
+static void BM_BlockValidate(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = packed(obj);
+	Validator validator;
+
+	for (auto _ : state)
+	{
+		size_t offset = 0;
+		Trusted trusted;
+		benchmark::DoNotOptimize(validator.validate(buffer, offset, trusted));
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockValidate);
+
+static void BM_BlockTrustedDecode(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = packed(obj);
+	size_t offset = 0;
+	Trusted trusted;
+	Validator().validate(buffer, offset, trusted);
+	StackDecoder decoder;
+	Object result("");
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(decoder.decode(trusted, result));
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockTrustedDecode);
+
+static void BM_WideValidate(benchmark::State& state)
+{
+	Object obj = makeWide((int)state.range(0));
+	std::vector<uint8_t> buffer = packed(obj);
+	Validator validator;
+
+	for (auto _ : state)
+	{
+		size_t offset = 0;
+		Trusted trusted;
+		benchmark::DoNotOptimize(validator.validate(buffer, offset, trusted));
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_WideValidate)->RangeMultiplier(4)->Range(4, 1024);
+
+// decodes over one result like BM_BlockStackDecoder, not a fresh tree
+static void BM_WideDecode(benchmark::State& state)
+{
+	Object obj = makeWide((int)state.range(0));
+	std::vector<uint8_t> buffer = packed(obj);
+	bool trustedPath = state.range(1) != 0;
+	size_t offset = 0;
+	Trusted trusted;
+	Validator().validate(buffer, offset, trusted);
+	StackDecoder decoder;
+	Object result("");
+
+	for (auto _ : state)
+	{
+		if (trustedPath)
+		{
+			benchmark::DoNotOptimize(decoder.decode(trusted, result));
+		}
+		else
+		{
+			offset = 0;
+			benchmark::DoNotOptimize(decoder.decode(buffer, offset, result));
+		}
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_WideDecode)->ArgsProduct({ { 16, 1024 }, { 0, 1 } });
+
+// every thread packs and decodes its own block with its own scratch, so
+// throughput should grow with the thread count up to the core count
+static void BM_ThreadedRoundTrip(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(state.thread_index()));
+	Object result("");
+
+	for (auto _ : state)
+	{
+		Core::Slice slice = Encoder::local().encode(obj);
+		size_t offset = 0;
+		benchmark::DoNotOptimize(StackDecoder::local().decode(slice.data, slice.length, offset, result));
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.SetBytesProcessed(state.iterations() * obj.getSize());
+}
+BENCHMARK(BM_ThreadedRoundTrip)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_BlockEntityPack(benchmark::State& state)
+{
+	Entity entity;
+	Entity::from(blockObject(makeRecord(7)), entity);
+	std::vector<uint8_t> buffer(entity.getSize());
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		entity.pack(buffer, it);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockEntityPack);
+
+static void BM_BlockEntityUnpack(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = packed(obj);
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		Entity result = Entity::unpack(buffer, it);
+		benchmark::DoNotOptimize(result);
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockEntityUnpack);
+
+// a sustained message rate: every iteration unpacks one message and drops
+// the oldest of the last 256 still alive, Arg is 0 for a primitive packet
+// and 1 for a block object
+static void BM_MessageChurn(benchmark::State& state)
+{
+	std::unique_ptr<Primitive> value = Primitive::create("value", Type::I64, (int64_t)7);
+	Object block = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = state.range(0) == 0 ? packed(*value) : packed(block);
+	std::vector<std::unique_ptr<Root>> live(256);
+	AllocationCounter counter;
+
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		if (state.range(0) == 0)
+		{
+			live[next++ % live.size()] = std::make_unique<Primitive>(Primitive::unpack(buffer, it));
+		}
+		else
+		{
+			live[next++ % live.size()] = std::make_unique<Object>(Object::unpack(buffer, it));
+		}
+	}
+	counter.report(state);
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageChurn)->Arg(0)->Arg(1);
+
+static void BM_MessageChurnPooled(benchmark::State& state)
+{
+	std::unique_ptr<Primitive> value = Primitive::create("value", Type::I64, (int64_t)7);
+	Object block = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = state.range(0) == 0 ? packed(*value) : packed(block);
+	std::vector<Pooled<Primitive>> primitives(256);
+	std::vector<Pooled<Object>> objects(256);
+	EntityPool& pool = EntityPool::local();
+	AllocationCounter counter;
+
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		int16_t it = 0;
+		if (state.range(0) == 0)
+		{
+			primitives[next++ % primitives.size()] = pool.unpackPrimitive(buffer, it);
+		}
+		else
+		{
+			objects[next++ % objects.size()] = pool.unpackObject(buffer, it);
+		}
+	}
+	counter.report(state);
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageChurnPooled)->Arg(0)->Arg(1);
+
+#ifndef _WIN32
+namespace
+{
+	// objects with their own names, retriveNsave writes name.abc to the cwd
+	struct PersistSet
+	{
+		std::vector<std::unique_ptr<Object>> roots;
+		std::vector<std::unique_ptr<Array>> payloads;
+		std::string dir;
+		std::string previous;
+
+		explicit PersistSet(size_t count)
+		{
+			char path[] = "/tmp/persistbenchXXXXXX";
+			dir = mkdtemp(path) ? path : "/tmp";
+			char* cwd = getcwd(nullptr, 0);
+			previous = cwd ? cwd : ".";
+			std::free(cwd);
+			benchmark::DoNotOptimize(chdir(dir.c_str()));
+
+			std::vector<int8_t> bytes(1024, 7);
+			for (size_t i = 0; i < count; i++)
+			{
+				roots.push_back(std::make_unique<Object>("obj" + std::to_string(i)));
+				payloads.push_back(Array::createArray("data", Type::I8, bytes));
+				roots.back()->addEntity(payloads.back().get());
+			}
+		}
+
+		~PersistSet()
+		{
+			for (const std::unique_ptr<Object>& root : roots)
+			{
+				remove((root->getName() + ".abc").c_str());
+			}
+			benchmark::DoNotOptimize(chdir(previous.c_str()));
+			rmdir(dir.c_str());
+		}
+	};
+}
+
+static void BM_PersistSync(benchmark::State& state)
+{
+	PersistSet set(256);
+
+	for (auto _ : state)
+	{
+		for (const std::unique_ptr<Object>& root : set.roots)
+		{
+			Core::Util::retriveNsave(root.get());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * set.roots.size());
+}
+BENCHMARK(BM_PersistSync)->UseRealTime();
+
+// one wait per 256 objects, Arg is 1 for io_uring and 0 for the threads
+static void BM_Persister(benchmark::State& state)
+{
+	PersistSet set(256);
+	PersistOptions options;
+	options.uring = state.range(0) != 0;
+	Persister persister(options);
+	state.SetLabel(persister.usesUring() ? "io_uring" : "threads");
+
+	for (auto _ : state)
+	{
+		for (const std::unique_ptr<Object>& root : set.roots)
+		{
+			persister.save(*root, root->getName() + ".abc", nullptr);
+		}
+		persister.wait();
+	}
+	state.SetItemsProcessed(state.iterations() * set.roots.size());
+}
+BENCHMARK(BM_Persister)->Arg(1)->Arg(0)->UseRealTime();
+
+namespace
+{
+	// fraction of the file's pages in the page cache
+	double residentShare(const std::string& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		off_t length = fd < 0 ? 0 : lseek(fd, 0, SEEK_END);
+		void* map = length > 0 ? mmap(nullptr, (size_t)length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+		double share = 0;
+		if (map != MAP_FAILED)
+		{
+			size_t page = (size_t)sysconf(_SC_PAGESIZE);
+			std::vector<unsigned char> pages(((size_t)length + page - 1) / page);
+			if (mincore(map, (size_t)length, pages.data()) == 0)
+			{
+				size_t resident = 0;
+				for (unsigned char p : pages)
+				{
+					resident += p & 1;
+				}
+				share = (double)resident / (double)pages.size();
+			}
+			munmap(map, (size_t)length);
+		}
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return share;
+	}
+}
+
+// 256MB of block records per iteration: Arg 0 plain buffered writes,
+// 1 buffered with drop behind, 2 O_DIRECT. cached is the share of the
+// archive left in the page cache afterwards.
+static void BM_ArchiveWrite(benchmark::State& state)
+{
+	char dir[] = "/tmp/archivebenchXXXXXX";
+	std::string path = std::string(mkdtemp(dir) ? dir : "/tmp") + "/bench.abc";
+	Object obj = blockObject(makeRecord(7));
+	const size_t target = 256u << 20;
+
+	ArchiveOptions options;
+	options.direct = state.range(0) == 2;
+	options.dropBehind = state.range(0) == 1;
+
+	uint64_t bytes = 0;
+	double cached = 0;
+	bool direct = false;
+	for (auto _ : state)
+	{
+		ArchiveWriter writer(options);
+		writer.open(path);
+		while (writer.size() < target)
+		{
+			writer.append(obj);
+		}
+		writer.close();
+		bytes += writer.size();
+		direct = writer.isDirect();
+
+		state.PauseTiming();
+		cached = residentShare(path);
+		state.ResumeTiming();
+	}
+	state.SetBytesProcessed((int64_t)bytes);
+	state.counters["cached"] = cached;
+	state.counters["direct"] = direct;
+	remove(path.c_str());
+	rmdir(dir);
+}
+BENCHMARK(BM_ArchiveWrite)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+
+#ifdef SERIALIZATION_TOOLS
+namespace
+{
+	::Block blockStruct(const BlockRecord& r)
+	{
+		return ::Block{ r.difficulty, r.counter, r.minedTime, r.prevHash, r.hash, r.nonce, r.data };
+	}
+}
+
+static void BM_BlockGeneratedPack(benchmark::State& state)
+{
+	::Block block = blockStruct(makeRecord(7));
+	std::vector<uint8_t> buffer(block.getSize("data"));
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(block.pack(buffer.data(), "data"));
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockGeneratedPack);
+
+static void BM_BlockGeneratedUnpack(benchmark::State& state)
+{
+	Object obj = blockObject(makeRecord(7));
+	std::vector<uint8_t> buffer = packed(obj);
+	::Block result;
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		size_t offset = 0;
+		benchmark::DoNotOptimize(result.unpack(buffer, offset));
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_BlockGeneratedUnpack);
+#endif
+
+static void BM_BlockJsonDump(benchmark::State& state)
+{
+	json j = blockJson(makeRecord(7));
+	size_t bytes = 0;
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		std::string text = j.dump();
+		bytes += text.size();
+		benchmark::DoNotOptimize(text.data());
+	}
+	counter.report(state);
+	state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_BlockJsonDump);
+
+static void BM_BlockJsonParse(benchmark::State& state)
+{
+	std::string text = blockJson(makeRecord(7)).dump();
+	AllocationCounter counter;
+
+	for (auto _ : state)
+	{
+		json j = json::parse(text);
+		benchmark::DoNotOptimize(j);
+	}
+	counter.report(state);
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_BlockJsonParse);
+
+static void BM_BlockMsgpackDump(benchmark::State& state)
+{
+	json j = blockJson(makeRecord(7));
+	size_t bytes = 0;
+
+	for (auto _ : state)
+	{
+		std::vector<uint8_t> out = json::to_msgpack(j);
+		bytes += out.size();
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_BlockMsgpackDump);
+
+static void BM_BlockMsgpackParse(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes = json::to_msgpack(blockJson(makeRecord(7)));
+
+	for (auto _ : state)
+	{
+		json j = json::from_msgpack(bytes);
+		benchmark::DoNotOptimize(j);
+	}
+	state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_BlockMsgpackParse);
+
+
+BENCHMARK_MAIN();
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Regression gate for serialization_bench.
+
+Compares two Google Benchmark JSON reports and exits non-zero when a
+benchmark present in both got slower than the threshold allows.
+
+    compare.py baseline.json current.json [--threshold 15]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        report = json.load(f)
+
+    times = {}
+    for b in report.get("benchmarks", []):
+        # with repetitions only the aggregates carry a stable number
+        if b.get("run_type") == "aggregate" and b.get("aggregate_name") != "median":
+            continue
+        name = b.get("run_name", b["name"])
+        times[name] = b["cpu_time"]
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=15.0,
+                        help="allowed slowdown in percent")
+    args = parser.parse_args()
+
+    try:
+        baseline = load(args.baseline)
+    except FileNotFoundError:
+        print("no baseline at %s, build serialization_bench_baseline first" % args.baseline)
+        return 1
+
+    current = load(args.current)
+
+    regressions = []
+    for name, before in sorted(baseline.items()):
+        after = current.get(name)
+        if after is None or before <= 0:
+            continue
+
+        change = (after - before) / before * 100.0
+        marker = ""
+        if change > args.threshold:
+            regressions.append(name)
+            marker = "  <-- regression"
+        print("%-60s %12.1f %12.1f %+7.1f%%%s" % (name, before, after, change, marker))
+
+    missing = sorted(set(baseline) - set(current))
+    for name in missing:
+        print("%-60s missing from the current run" % name)
+
+    if regressions:
+        print("\n%d benchmark(s) slower than %.0f%% over the baseline" % (len(regressions), args.threshold))
+        return 1
+
+    print("\nno regressions over %.0f%%" % args.threshold)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
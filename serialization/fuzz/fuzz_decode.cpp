@@ -0,0 +1,52 @@
+#include "../include/serialization.h"
+#include <algorithm>
+#include <cstdlib>
+
+
+using namespace ObjectModel;
+
+
+// anything Validator passes has to decode through the checked path to the
+// same offset, and the unchecked path has to build the same tree
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	DecodeLimits limits;
+	limits.maxDepth = 32;
+	limits.maxSize = 1 << 20;
+	static Validator validator(limits);
+	static StackDecoder checked(limits);
+	static StackDecoder unchecked(limits);
+	// kept across inputs so the reuse of nodes is fuzzed too
+	static Object fromChecked("");
+	static Object fromTrusted("");
+
+	size_t validated = 0;
+	Trusted trusted;
+	DecodeStatus status = validator.validate(data, size, validated, trusted);
+
+	size_t decoded = 0;
+	DecodeStatus checkedStatus = checked.decode(data, size, decoded, fromChecked);
+	if (status != DecodeStatus::OK)
+	{
+		return 0;
+	}
+
+	if (checkedStatus != DecodeStatus::OK || decoded != validated || trusted.size() != validated)
+	{
+		std::abort();
+	}
+
+	if (unchecked.decode(trusted, fromTrusted) != DecodeStatus::OK)
+	{
+		std::abort();
+	}
+
+	Core::Slice a = Encoder::local().encode(fromChecked);
+	std::vector<uint8_t> first(a.data, a.data + a.length);
+	Core::Slice b = Encoder::local().encode(fromTrusted);
+	if (first.size() != b.length || !std::equal(first.begin(), first.end(), b.data))
+	{
+		std::abort();
+	}
+	return 0;
+}
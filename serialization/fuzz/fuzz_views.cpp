@@ -0,0 +1,50 @@
+#include "../include/serialization.h"
+
+
+using namespace ObjectModel;
+
+
+// the readers that work on raw bytes without a validation pass
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	const char* keys[] = { "", "a", "value", "p0" };
+
+	size_t offset = 0;
+	View::skipObject(data, size, offset);
+
+	for (const char* key : keys)
+	{
+		size_t field;
+		if (View::findField(data, size, 0, key, field))
+		{
+			View::findField(data, size, field, key, field);
+		}
+	}
+
+	offset = 0;
+	MapView map;
+	if (MapView::read(data, size, offset, map))
+	{
+		for (const char* key : keys)
+		{
+			int32_t value;
+			map.get(key, Type::I32, value);
+			ArrayView array;
+			map.get(key, array);
+		}
+		map.forEach([](std::string_view, Wrapper, size_t) {});
+	}
+
+	// every array in the buffer, dense or sparse, read out in full
+	offset = 0;
+	ArrayView view;
+	while (ArrayView::read(data, size, offset, view))
+	{
+		if (view.getType() == Type::I32 && view.getWrapper() == Wrapper::ARRAY && view.getCount() <= 4096)
+		{
+			std::vector<int32_t> values((size_t)view.getCount());
+			view.copyTo(values.data());
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,22 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+
+// without libFuzzer: every argument is an input file, run once each
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::ifstream in(argv[i], std::ios::binary);
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+		std::printf("%s: %zu bytes\n", argv[i], bytes.size());
+	}
+	return 0;
+}
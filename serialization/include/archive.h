@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core.h"
+#include "decoder.h"
+#include "object.h"
+
+
+// bulk files of packed roots back to back, for archives far bigger than
+// the page cache. Writing one through plain write() leaves every page
+// cached and pushes out whatever was hot; ArchiveWriter goes around the
+// cache with O_DIRECT instead, ArchiveReader reads through it with
+// readahead hints and lets go of what it has decoded.
+#ifndef _WIN32
+namespace ObjectModel
+{
+	struct ArchiveOptions
+	{
+		// bytes per buffer, rounded up to whole pages; the writer keeps two
+		size_t bufferSize = 4 * 1024 * 1024;
+		// O_DIRECT, the writer falls back to the page cache where the
+		// file system refuses it
+		bool direct = true;
+		// written pages are flushed and dropped from the cache when the
+		// writer isn't direct, consumed ones when reading
+		bool dropBehind = true;
+		// bytes the reader asks the kernel to fetch ahead of it
+		size_t readahead = 8 * 1024 * 1024;
+		// fdatasync before close
+		bool sync = false;
+	};
+
+
+	// packs into page aligned buffers of a whole number of pages and writes
+	// each one from a thread of its own while the next is filled, so
+	// packing and io overlap. The tail is padded to a page and the file cut
+	// back to its real length on close.
+	class ArchiveWriter
+	{
+	private:
+		ArchiveOptions options;
+		int fd = -1;
+		std::atomic<bool> direct{ false };
+		size_t alignment = 0;
+		size_t capacity = 0;
+		uint8_t* buffers[2] = { nullptr, nullptr };
+		int current = 0;
+		size_t used = 0;
+		// file offset of the current buffer, bytes appended so far
+		uint64_t offset = 0;
+		uint64_t length = 0;
+		Encoder encoder;
+
+		// the buffer handed to the io thread
+		std::thread io;
+		std::mutex lock;
+		std::condition_variable changed;
+		bool pending = false;
+		bool stopping = false;
+		uint8_t* pendingData = nullptr;
+		size_t pendingLength = 0;
+		uint64_t pendingOffset = 0;
+		int error = 0;
+	public:
+		explicit ArchiveWriter(ArchiveOptions options = ArchiveOptions());
+		// closes
+		~ArchiveWriter();
+
+		ArchiveWriter(const ArchiveWriter&) = delete;
+		ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+	public:
+		// truncates path, false if it can't be created
+		bool open(const std::string& path);
+
+		// false once anything failed, the file is unusable from then on
+		bool append(Root& root);
+		// bytes that are already packed
+		bool append(const uint8_t* bytes, size_t length);
+
+		// writes the tail and closes, false if any write failed
+		bool close();
+
+		// false after a fallback to the page cache
+		inline bool isDirect() const { return direct.load(std::memory_order_relaxed); }
+		inline uint64_t size() const { return length; }
+		// 0 or the errno of the first failure
+		int getError();
+	private:
+		// hands the current buffer to the io thread once it is idle
+		bool submit(size_t bytes);
+		// until the io thread is idle, false if it failed
+		bool drain();
+		void run();
+		int write(const uint8_t* data, size_t bytes, uint64_t at);
+	};
+
+
+	// hands out the roots of an archive one at a time, decoding over the
+	// same object. The kernel is kept readahead bytes ahead of the decoder.
+	class ArchiveReader
+	{
+	private:
+		ArchiveOptions options;
+		int fd = -1;
+		std::vector<uint8_t> buffer;
+		size_t begin = 0;
+		size_t end = 0;
+		// file offset of end, and how far readahead has been asked for
+		uint64_t position = 0;
+		uint64_t hinted = 0;
+		uint64_t dropped = 0;
+		bool eof = false;
+		int error = 0;
+		StackDecoder decoder;
+		DecodeStatus status = DecodeStatus::OK;
+	public:
+		explicit ArchiveReader(ArchiveOptions options = ArchiveOptions(), DecodeLimits limits = DecodeLimits());
+		~ArchiveReader();
+
+		ArchiveReader(const ArchiveReader&) = delete;
+		ArchiveReader& operator=(const ArchiveReader&) = delete;
+	public:
+		bool open(const std::string& path);
+		void close();
+
+		// false at the end of the file or on an error; a clean end has
+		// getStatus OK and getError 0
+		bool next(Object& into);
+
+		inline DecodeStatus getStatus() const { return status; }
+		// 0 or the errno of a failed read
+		inline int getError() const { return error; }
+		// bytes decoded so far
+		inline uint64_t consumed() const { return position - (end - begin); }
+	private:
+		// reads more, growing the buffer when an object doesn't fit; false
+		// when the read fails
+		bool fill();
+		void hint();
+	};
+}
+#endif
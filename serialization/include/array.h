@@ -2,15 +2,20 @@
 #include "root.h"
 #include <memory>
 #include "core.h"
+#include "kernels.h"
+#include "gather.h"
+#include "sparse.h"
 
 namespace ObjectModel
 {
 	class Array : public Root
 	{
+		friend class StackDecoder;
+		friend class EntityPool;
 	private:
 		uint8_t type = 0;
-		static int32_t count;
-		std::vector<uint8_t>* data = nullptr;
+		int32_t count = 0;
+		std::shared_ptr<std::vector<uint8_t>> data;
 	public:
 		Array();
 	public:
@@ -22,15 +27,26 @@ namespace ObjectModel
 			arr->wrapper = static_cast<uint8_t>(Wrapper::ARRAY);
 			arr->type = static_cast<uint8_t>(type);
 			arr->count = (int32_t)value.size();
-			arr->data = new std::vector<uint8_t>(sizeof(T) * arr->count);
+			arr->data = std::make_shared<std::vector<uint8_t>>(sizeof(T) * arr->count);
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, arr->data->size());
 			arr->size += (int32_t)(value.size()) * sizeof(T);
 			int16_t iterator = 0;
 			Core::encode<T>(*arr->data, iterator, value);
+			arr->sparsify();
 
 			return arr;
 		}
 
 
+		// the type follows from T
+		template<typename T>
+		static std::unique_ptr<Array> createArray(std::string name, std::vector<T> value)
+		{
+			return createArray<T>(name, TypeTraits<T>::type, std::move(value));
+		}
+
+
 		template<typename T>
 		static std::unique_ptr<Array> createString(std::string name, Type type, T value)
 		{
@@ -39,7 +55,9 @@ namespace ObjectModel
 			str->wrapper = static_cast<uint8_t>(Wrapper::STRING); 
 			str->type = static_cast<uint8_t>(type);
 			str->count = (int32_t)value.size();
-			str->data = new std::vector<uint8_t>(value.size());
+			str->data = std::make_shared<std::vector<uint8_t>>(value.size());
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, str->data->size());
 			str->size += (int32_t)value.size();
 			int16_t iterator = 0;
 			Core::encode<T>(*str->data, iterator, value);
@@ -47,8 +65,65 @@ namespace ObjectModel
 
 			return str;
 		}
+		// bytes are already in wire order, count elements of type
+		static std::unique_ptr<Array> createFromBytes(std::string name, Wrapper wrapper, Type type, int32_t count, std::vector<uint8_t> bytes);
+
+		// one bit per value instead of one byte
+		static std::unique_ptr<Array> createBitArray(std::string name, const bool* value, int32_t count);
+		static std::unique_ptr<Array> createBitArray(std::string name, const std::vector<bool>& value);
+
+		// type is F16 or BF16, the floats are narrowed on the way in
+		static std::unique_ptr<Array> createHalfArray(std::string name, Type type, const std::vector<float>& value);
+
+		inline Type getType() const { return static_cast<Type>(type & TYPE_MASK); }
+		inline bool isSparse() const { return ObjectModel::isSparse(type); }
+		// elements, the dense length of a sparse array too
+		inline int32_t getCount() const { return count; }
+		// the payload as packed, see SPARSE for the sparse layout
+		std::vector<uint8_t>* getPtrData() { return data.get(); }
+		const std::vector<uint8_t>* getPtrData() const { return data.get(); }
+
+		// switch to the sparse layout when that is smaller, createArray
+		// does it for every array; densify goes back
+		void sparsify();
+		void densify();
+		// count elements in wire order, expanded when sparse
+		void getBytes(uint8_t* out) const;
+
+		// expand BIT and F16/BF16 payloads back to native values
+		void getBits(bool* out) const;
+		void getFloats(float* out) const;
+		// count native values, expanded when sparse; false when the
+		// elements aren't stored as T
+		template<typename T>
+		bool get(T* out) const
+		{
+			if (getWrapper() != Wrapper::ARRAY || getType() != TypeTraits<T>::type)
+			{
+				return false;
+			}
+
+			if (isSparse())
+			{
+				Sparse::expand<T>(data->data(), count, out);
+				return true;
+			}
+
+			for (int32_t i = 0; i < count; i++)
+			{
+				out[i] = Core::load<T>(data->data() + (size_t)i * sizeof(T));
+			}
+			return true;
+		}
+
 		void pack(std::vector<uint8_t>&, int16_t&);
+		// the payload is referenced in place when it's big enough
+		void pack(Core::GatherList&);
 		static Array unpack(std::vector<uint8_t>& buffer, int16_t&);
 		static Array unpackS(std::vector<uint8_t>& buffer, int16_t&);
+		// arrays and strings alike, reusing the buffers of into
+		static void unpack(const std::vector<uint8_t>& buffer, int16_t&, Array& into);
+	protected:
+		uint32_t computeHash() const override;
 	};
 }
\ No newline at end of file
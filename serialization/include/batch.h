@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include "object.h"
+#include "view.h"
+
+
+namespace ObjectModel
+{
+	// struct of arrays for rows that share one schema: every primitive field
+	// becomes one typed Array column, every string field one String holding
+	// the concatenated bytes plus a U32 "<field>.offsets" column of rows + 1
+	// entries. The batch itself is a plain Object with a "rows" primitive,
+	// so it packs and unpacks like any other.
+	class Batch
+	{
+	public:
+		// nullptr when the rows disagree on names/types or nest arrays or objects
+		static std::unique_ptr<Object> create(std::string name, const std::vector<Object>& rows);
+
+		// number of rows in a packed batch, -1 when the buffer isn't one
+		static int32_t rows(const uint8_t* buffer, size_t length);
+
+		// finds one column in a packed batch, only the entity headers of
+		// the columns in front of it are touched
+		static bool column(const uint8_t* buffer, size_t length, std::string_view name, ArrayView& out);
+
+		// scans decode blocks of a column into native order on the stack,
+		// the inner loops stay branch free so they vectorize
+		template<typename T>
+		static T sum(const ArrayView& column)
+		{
+			T block[blockSize];
+			T result = 0;
+
+			for (int32_t first = 0; first < column.getCount(); first += blockSize)
+			{
+				int32_t n = std::min(blockSize, column.getCount() - first);
+				column.copyTo<T>(block, first, n);
+				for (int32_t i = 0; i < n; i++)
+				{
+					result += block[i];
+				}
+			}
+
+			return result;
+		}
+
+		// appends the indexes of the rows matching predicate to selection
+		template<typename T, typename Predicate>
+		static void select(const ArrayView& column, Predicate predicate, std::vector<int32_t>& selection)
+		{
+			T block[blockSize];
+			uint8_t hits[blockSize];
+
+			for (int32_t first = 0; first < column.getCount(); first += blockSize)
+			{
+				int32_t n = std::min(blockSize, column.getCount() - first);
+				column.copyTo<T>(block, first, n);
+				for (int32_t i = 0; i < n; i++)
+				{
+					hits[i] = predicate(block[i]) ? 1 : 0;
+				}
+
+				for (int32_t i = 0; i < n; i++)
+				{
+					if (hits[i])
+					{
+						selection.push_back(first + i);
+					}
+				}
+			}
+		}
+	private:
+		static constexpr int32_t blockSize = 256;
+	};
+}
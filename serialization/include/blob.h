@@ -0,0 +1,140 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core.h"
+#include "array.h"
+#include "object.h"
+#include "view.h"
+
+
+// payloads too big to keep inline live outside the packed tree. The entity
+// is a U8 array flagged EXTERNAL whose bytes are a reference, so anything
+// that doesn't know about blobs still reads it as a plain array:
+//   offset(8) length(8) crc32c(4) path(count - 20)
+// An empty path is the blob section of the container the entity came
+// from, a relative one is resolved against the container's directory;
+// absolute paths and .. components are refused there.
+#ifndef _WIN32
+namespace ObjectModel
+{
+	struct BlobRef
+	{
+		std::string path;
+		uint64_t offset = 0;
+		uint64_t length = 0;
+		uint32_t crc = 0;
+	};
+
+
+	namespace Blob
+	{
+		constexpr size_t fixedSize = 2 * sizeof(uint64_t) + sizeof(uint32_t);
+
+		std::unique_ptr<Array> create(std::string name, const BlobRef& ref);
+
+		// appends bytes to the file at path and returns the entity pointing
+		// at them, nullptr if the file can't be written
+		std::unique_ptr<Array> append(std::string name, const std::string& path, const uint8_t* bytes, size_t length);
+
+		inline bool is(const Root& root) { return (root.wrapper & static_cast<uint8_t>(Flag::EXTERNAL)) != 0; }
+
+		// false when the entity isn't a well formed blob
+		bool read(const Array& entity, BlobRef& ref);
+		bool read(const ArrayView& entity, BlobRef& ref);
+	}
+
+
+	// the bytes of one blob, mapped on the first data() call and unmapped
+	// with the span. Only the pages the blob covers are mapped.
+	class BlobSpan
+	{
+	private:
+		int fd = -1;
+		uint64_t offset = 0;
+		uint64_t length = 0;
+		uint32_t crc = 0;
+		void* mapping = nullptr;
+		size_t mappedLength = 0;
+		const uint8_t* bytes = nullptr;
+	public:
+		BlobSpan() = default;
+		// takes the fd, which must cover [offset, offset + length)
+		BlobSpan(int fd, uint64_t offset, uint64_t length, uint32_t crc)
+			:
+			fd(fd),
+			offset(offset),
+			length(length),
+			crc(crc) {}
+		~BlobSpan();
+
+		BlobSpan(BlobSpan&& other) noexcept;
+		BlobSpan& operator=(BlobSpan&& other) noexcept;
+		BlobSpan(const BlobSpan&) = delete;
+		BlobSpan& operator=(const BlobSpan&) = delete;
+	public:
+		// false for a span that failed to open
+		inline bool isValid() const { return fd >= 0; }
+		inline bool isMapped() const { return mapping != nullptr; }
+		inline uint64_t size() const { return length; }
+
+		// nullptr if the mapping fails; an empty blob maps nothing and
+		// returns a non null pointer
+		const uint8_t* data();
+
+		// maps the blob and checks it against the crc in the reference
+		bool verify();
+	private:
+		void release();
+	};
+
+
+	// resolves blob entities to side files. With a dir only relative paths
+	// without .. components are opened, against dir, so a reference read
+	// from an untrusted file can't reach anything else
+	BlobSpan openBlob(const BlobRef& ref, const std::string& dir = "");
+
+
+	// a root followed by its blobs in one file: the packed root, zeros up
+	// to the next page and then the blobs back to back. The entities added
+	// here have an empty path and offsets relative to the blob section.
+	class BlobSection
+	{
+	private:
+		struct Pending
+		{
+			const uint8_t* bytes;
+			size_t length;
+		};
+
+		std::vector<Pending> blobs;
+		uint64_t size = 0;
+	public:
+		// bytes aren't copied and have to stay valid until save
+		std::unique_ptr<Array> add(std::string name, const uint8_t* bytes, size_t length);
+
+		// root has to hold the entities add returned, false on an io error
+		bool save(const std::string& path, Root& root);
+		void clear();
+	};
+
+
+	// a file written by BlobSection::save, or any packed object followed
+	// by nothing. The root is decoded on open, blobs are mapped on demand.
+	class Container
+	{
+	private:
+		std::string path;
+		std::string dir;
+		uint64_t base = 0;
+	public:
+		// false if the file can't be read or the object doesn't decode
+		bool open(const std::string& path, Object& into);
+
+		// an invalid span if entity isn't a blob or its file can't be opened
+		BlobSpan blob(const Array& entity) const;
+		BlobSpan blob(const BlobRef& ref) const;
+	};
+}
+#endif
@@ -1,5 +1,7 @@
 #pragma once
 #include <bitset>
+#include <cstring>
+#include <type_traits>
 #include <fstream>
 #include <vector>
 #include "root.h"
@@ -13,9 +15,14 @@ namespace Core
 		void save(const char*, std::vector<uint8_t>& vector);
 		std::vector<uint8_t> load(const char*);
 		void retriveNsave(ObjectModel::Root* r);
+		bool equals(ObjectModel::Root* a, ObjectModel::Root* b);
 
 	}
 
+	// crc32c (Castagnoli), sse4.2 crc32 instruction when the cpu has it;
+	// pass the previous result as crc to chain several ranges
+	uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0);
+
 	// 0 1 2 3
 	// 0x00 0x00 0x01 0xd3
 	template<typename T>
@@ -52,7 +59,7 @@ namespace Core
 	}
 
 	template<typename T>
-	void encode(std::vector<uint8_t>& buffer, int16_t& iterator, std::vector<T> value)
+	void encode(std::vector<uint8_t>& buffer, int16_t& iterator, const std::vector<T>& value)
 	{
 		for (unsigned i = 0; i < value.size(); i++)
 		{
@@ -61,6 +68,70 @@ namespace Core
 	}
 
 
+	// same big endian layout, straight to and from raw memory;
+	// the caller has already checked the bounds
+	template<typename T>
+	inline void store(uint8_t* p, T value)
+	{
+		for (unsigned i = 0; i < sizeof(T); i++)
+		{
+			p[i] = (uint8_t)(value >> ((sizeof(T) - 1 - i) * 8));
+		}
+	}
+
+	template<>
+	inline void store<float>(uint8_t* p, float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof bits);
+		store<uint32_t>(p, bits);
+	}
+
+	template<>
+	inline void store<double>(uint8_t* p, double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof bits);
+		store<uint64_t>(p, bits);
+	}
+
+	template<typename T>
+	inline T load(const uint8_t* p)
+	{
+		typedef typename std::make_unsigned<T>::type U;
+		U result = 0;
+		for (unsigned i = 0; i < sizeof(T); i++)
+		{
+			result = (U)((result << 8) | p[i]);
+		}
+		return (T)result;
+	}
+
+	template<>
+	inline bool load<bool>(const uint8_t* p)
+	{
+		return p[0] != 0;
+	}
+
+	template<>
+	inline float load<float>(const uint8_t* p)
+	{
+		uint32_t bits = load<uint32_t>(p);
+		float value;
+		std::memcpy(&value, &bits, sizeof value);
+		return value;
+	}
+
+	template<>
+	inline double load<double>(const uint8_t* p)
+	{
+		uint64_t bits = load<uint64_t>(p);
+		double value;
+		std::memcpy(&value, &bits, sizeof value);
+		return value;
+	}
+
+
 	//deserialize
 
 
@@ -95,13 +166,11 @@ namespace Core
 	}
 
 
-	template<typename ...>
-	void decode(const std::vector<uint8_t>& buffer, int16_t& it, std::vector<uint8_t>& dest)
+	// raw bytes, as many as dest holds
+	inline void decode(const std::vector<uint8_t>& buffer, int16_t& it, std::vector<uint8_t>& dest)
 	{
-		for (unsigned i = 0; i < dest.size(); i++)
-		{
-			dest[i] = buffer[it++];
-		}
+		std::memcpy(dest.data(), buffer.data() + it, dest.size());
+		it += (int16_t)dest.size();
 	}
 
 
@@ -0,0 +1,124 @@
+#pragma once
+#include "object.h"
+#include "gather.h"
+
+
+namespace ObjectModel
+{
+	class Trusted;
+
+	// children a decoded tree shrank by, kept around for the next decode
+	struct NodePool
+	{
+		std::vector<Primitive> primitives;
+		std::vector<Array> arrays;
+		std::vector<Object> objects;
+	};
+
+
+	// packs into one scratch buffer that is reused across calls, once it has
+	// grown to the largest message encoding allocates nothing
+	class Encoder
+	{
+	private:
+		Core::GatherList list;
+	public:
+		Encoder()
+			:
+			list(SIZE_MAX) {}
+	public:
+		// valid until the next encode
+		Core::Slice encode(Root& root);
+
+		// the calling thread's own encoder, for callers without one to keep;
+		// encoders aren't shared, so threads never contend on scratch
+		static Encoder& local();
+	};
+
+
+	// unpacks over the tree of the previous call, so steady state decoding
+	// reuses every node, name and payload buffer. The returned object and
+	// anything pointing into it are only valid until the next decode.
+	class Decoder
+	{
+	private:
+		Object root;
+		NodePool pool;
+	public:
+		Decoder()
+			:
+			root("") {}
+	public:
+		Object& decode(const std::vector<uint8_t>& buffer, int16_t& it);
+
+		// per thread like Encoder::local, the object it returns belongs to
+		// the calling thread
+		static Decoder& local();
+	};
+
+
+	enum class DecodeStatus
+	{
+		OK,
+		// the buffer ends inside an entity
+		TRUNCATED,
+		// negative counts or lengths, unknown types, a wrapper in the wrong section
+		MALFORMED,
+		TOO_DEEP,
+		// the object runs past DecodeLimits::maxSize
+		TOO_LARGE
+	};
+
+
+	struct DecodeLimits
+	{
+		// objects on the path from the root, the root itself included
+		size_t maxDepth = 64;
+		// bytes the whole object may span
+		size_t maxSize = INT32_MAX;
+	};
+
+
+	// Object::unpack without the recursion: nested objects go on an explicit
+	// stack, so depth costs heap and not call frames. Lengths are checked per
+	// entity, once for the header and once for payload and trailer, never per
+	// field. Decodes over into and reuses its nodes and payloads like Decoder,
+	// on failure into is left half decoded.
+	class StackDecoder
+	{
+	private:
+		struct Frame
+		{
+			Object* object;
+			int8_t section;
+			int16_t index;
+			int16_t count;
+		};
+
+		std::vector<Frame> stack;
+		DecodeLimits limits;
+	public:
+		StackDecoder(DecodeLimits limits = DecodeLimits())
+			:
+			limits(limits) {}
+	public:
+		// offset is moved past the object only when OK is returned
+		DecodeStatus decode(const uint8_t* buffer, size_t length, size_t& offset, Object& into);
+		DecodeStatus decode(const std::vector<uint8_t>& buffer, size_t& offset, Object& into)
+		{
+			return decode(buffer.data(), buffer.size(), offset, into);
+		}
+
+		// the same decode without a single check, for bytes Validator has
+		// passed; MALFORMED only for an empty token
+		DecodeStatus decode(const Trusted& trusted, Object& into);
+
+		inline const DecodeLimits& getLimits() const { return limits; }
+
+		// per thread like Encoder::local, with the default limits
+		static StackDecoder& local();
+	private:
+		template<bool checked>
+		DecodeStatus run(const uint8_t* buffer, size_t length, size_t& offset, Object& into);
+	};
+}
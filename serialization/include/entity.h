@@ -0,0 +1,108 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include "core.h"
+
+
+namespace ObjectModel
+{
+	struct Entity;
+
+	// payloads are kept in wire order, exactly as Primitive/Array store them
+	struct PrimitiveValue
+	{
+		Type type;
+		std::vector<uint8_t> data;
+	};
+
+	struct ArrayValue
+	{
+		Type type;
+		int32_t count;
+		std::vector<uint8_t> data;
+		// Flag::EXTERNAL, data is a blob reference, see blob.h
+		bool external = false;
+	};
+
+	struct StringValue
+	{
+		std::string text;
+	};
+
+	struct ObjectValue
+	{
+		// insertion order, pack groups them into the wire sections
+		std::vector<Entity> children;
+	};
+
+
+	// value semantic counterpart of Root/Primitive/Array/Object: a closed
+	// variant in Wrapper order, no vtable, no RTTI and no size patched on
+	// the side, the size is worked out while packing. Same wire format.
+	struct Entity
+	{
+		std::string name;
+		std::variant<PrimitiveValue, ArrayValue, StringValue, ObjectValue> value;
+		bool hashed = false;
+
+		template<typename T>
+		static Entity primitive(std::string name, Type type, T value)
+		{
+			PrimitiveValue p{ type, std::vector<uint8_t>(sizeof(T)) };
+			int16_t it = 0;
+			Core::encode<T>(p.data, it, value);
+			return Entity{ std::move(name), std::move(p) };
+		}
+
+		template<typename T>
+		static Entity array(std::string name, Type type, const std::vector<T>& values)
+		{
+			ArrayValue arr{ type, (int32_t)values.size(), std::vector<uint8_t>(values.size() * sizeof(T)), false };
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				Core::store<T>(arr.data.data() + i * sizeof(T), values[i]);
+			}
+			return Entity{ std::move(name), std::move(arr) };
+		}
+
+		static Entity string(std::string name, std::string text)
+		{
+			return Entity{ std::move(name), StringValue{ std::move(text) } };
+		}
+
+		static Entity object(std::string name)
+		{
+			return Entity{ std::move(name), ObjectValue{} };
+		}
+
+		// from the class hierarchy, dispatching on the wrapper byte; a map
+		// comes back as an object of its values in insertion order. False
+		// for a wrapper entities can't hold, out is left as it was
+		static bool from(const Root& root, Entity& out);
+
+		inline Wrapper getWrapper() const { return static_cast<Wrapper>(value.index() + 1); }
+
+		// bytes pack will write, walks the subtree
+		int32_t getSize() const;
+
+		uint32_t getHash() const;
+
+		// appends to an object, returns the new child
+		Entity& add(Entity child);
+
+		// direct children of an object, nullptr when missing
+		Entity* find(std::string_view childName);
+		const Entity* find(std::string_view childName) const;
+
+		template<typename T>
+		T as() const
+		{
+			return Core::load<T>(std::get<PrimitiveValue>(value).data.data());
+		}
+
+		void pack(std::vector<uint8_t>& buffer, int16_t& it) const;
+		static Entity unpack(const std::vector<uint8_t>& buffer, int16_t& it);
+	};
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+
+namespace Core
+{
+	struct Slice
+	{
+		const uint8_t* data;
+		size_t length;
+	};
+
+	// pack target for scatter/gather writes: headers and small payloads are
+	// copied into one scratch buffer, payloads of at least threshold bytes
+	// are referenced where they live. Referenced memory has to stay alive
+	// until the slices are written.
+	class GatherList
+	{
+	private:
+		struct Segment
+		{
+			const uint8_t* external;
+			size_t offset;
+			size_t length;
+		};
+
+		size_t threshold;
+		size_t size = 0;
+		std::vector<uint8_t> scratch;
+		std::vector<Segment> segments;
+		std::vector<Slice> slices;
+	public:
+		explicit GatherList(size_t threshold = 256)
+			:
+			threshold(threshold) {}
+	public:
+		// n bytes of scratch to write into, valid until the next reserve
+		uint8_t* reserve(size_t n);
+		void reference(const uint8_t* data, size_t length);
+
+		// resolves the scratch offsets, call once everything is packed
+		const std::vector<Slice>& finish();
+		void clear();
+
+		inline size_t getSize() const { return size; }
+		inline size_t getScratchSize() const { return scratch.size(); }
+	};
+
+	namespace Util
+	{
+#ifndef _WIN32
+		// writes every slice, retrying partial writes, false on error
+		bool writev(int fd, GatherList& list);
+
+		// one datagram or stream write, false on error or a short send
+		bool sendmsg(int fd, const struct sockaddr* to, socklen_t toLength, GatherList& list);
+#endif
+	}
+}
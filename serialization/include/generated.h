@@ -0,0 +1,412 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core.h"
+#include "view.h"
+
+
+// what the code abcgen emits is built from: whole entities written straight
+// to memory and read back with the View functions, no Root in between
+namespace ObjectModel
+{
+	namespace Generated
+	{
+		// nested objects a generated unpack follows, like DecodeLimits::maxDepth
+		constexpr size_t maxDepth = 64;
+
+		constexpr size_t headerSize(std::string_view name) { return sizeof(uint8_t) + sizeof(int16_t) + name.size(); }
+		constexpr size_t trailerSize = sizeof(int32_t);
+
+		constexpr int32_t primitiveSize(std::string_view name, Type type)
+		{
+			return (int32_t)(headerSize(name) + sizeof(uint8_t) + getTypeSize(type) + trailerSize);
+		}
+
+		// entity sizes are int32 on the wire and section counts int16; past
+		// either getSize is -1 and pack returns nullptr, like abcjson refuses
+		// a list or payload it can't write
+		constexpr int64_t tooLarge = (int64_t)INT32_MAX + 1;
+
+		constexpr int64_t arraySize(std::string_view name, size_t bytes)
+		{
+			return bytes >= (size_t)tooLarge ? tooLarge : (int64_t)(headerSize(name) + sizeof(uint8_t) + sizeof(int32_t) + bytes + trailerSize);
+		}
+
+		// sums the sizes of children up to tooLarge, a nested -1 is too large
+		constexpr int64_t add(int64_t children, int64_t size)
+		{
+			return size < 0 || size >= tooLarge - children ? tooLarge : children + size;
+		}
+
+		// children is the size of everything in the four sections, -1 when
+		// the object doesn't fit its size field
+		constexpr int32_t objectSize(std::string_view name, int64_t children)
+		{
+			int64_t size = (int64_t)(headerSize(name) + 4 * sizeof(int16_t) + trailerSize) + children;
+			return size > INT32_MAX ? -1 : (int32_t)size;
+		}
+
+
+		// list elements are named by their index, the way abcjson writes lists
+		class Index
+		{
+		private:
+			char text[12];
+			size_t length;
+		public:
+			explicit Index(size_t i)
+				:
+				length(std::to_chars(text, text + sizeof text, i).ptr - text) {}
+
+			inline operator std::string_view() const { return std::string_view(text, length); }
+		};
+
+
+		// writing: a nullptr p is a field that didn't fit further up, it is
+		// passed on so pack returns nullptr
+
+		inline uint8_t* header(uint8_t* p, Wrapper wrapper, std::string_view name)
+		{
+			if (p == nullptr)
+			{
+				return nullptr;
+			}
+
+			*p++ = static_cast<uint8_t>(wrapper);
+			Core::store<int16_t>(p, (int16_t)name.size());
+			p += sizeof(int16_t);
+			std::copy(name.begin(), name.end(), p);
+			return p + name.size();
+		}
+
+		inline uint8_t* count(uint8_t* p, int16_t n)
+		{
+			if (p == nullptr)
+			{
+				return nullptr;
+			}
+
+			Core::store<int16_t>(p, n);
+			return p + sizeof n;
+		}
+
+		// the size field counts the whole entity from start on, itself included
+		inline uint8_t* trailer(uint8_t* p, const uint8_t* start)
+		{
+			if (p == nullptr || p + trailerSize - start > INT32_MAX)
+			{
+				return nullptr;
+			}
+
+			Core::store<int32_t>(p, (int32_t)(p + trailerSize - start));
+			return p + trailerSize;
+		}
+
+		template<typename T>
+		uint8_t* primitive(uint8_t* p, std::string_view name, Type type, T value)
+		{
+			if (p == nullptr)
+			{
+				return nullptr;
+			}
+
+			uint8_t* start = p;
+			p = header(p, Wrapper::PRIMITIVE, name);
+			*p++ = static_cast<uint8_t>(type);
+			Core::store<T>(p, value);
+			return trailer(p + sizeof(T), start);
+		}
+
+		template<typename T>
+		uint8_t* array(uint8_t* p, std::string_view name, Type type, const std::vector<T>& values)
+		{
+			if (p == nullptr || arraySize(name, values.size() * sizeof(T)) > INT32_MAX)
+			{
+				return nullptr;
+			}
+
+			uint8_t* start = p;
+			p = header(p, Wrapper::ARRAY, name);
+			*p++ = static_cast<uint8_t>(type);
+			Core::store<int32_t>(p, (int32_t)values.size());
+			p += sizeof(int32_t);
+			for (const T& value : values)
+			{
+				Core::store<T>(p, value);
+				p += sizeof(T);
+			}
+			return trailer(p, start);
+		}
+
+		// the type byte of a string is I8, as Array::createString writes it
+		inline uint8_t* string(uint8_t* p, std::string_view name, std::string_view text)
+		{
+			if (p == nullptr || arraySize(name, text.size()) > INT32_MAX)
+			{
+				return nullptr;
+			}
+
+			uint8_t* start = p;
+			p = header(p, Wrapper::STRING, name);
+			*p++ = static_cast<uint8_t>(Type::I8);
+			Core::store<int32_t>(p, (int32_t)text.size());
+			p += sizeof(int32_t);
+			std::copy(text.begin(), text.end(), p);
+			return trailer(p + text.size(), start);
+		}
+
+
+		// reading: every function checks the bounds and moves offset past
+		// what it read only on success
+
+		inline bool count(const uint8_t* buffer, size_t length, size_t& offset, int16_t& n)
+		{
+			if (offset > length || length - offset < sizeof n)
+			{
+				return false;
+			}
+
+			n = Core::load<int16_t>(buffer + offset);
+			offset += sizeof n;
+			return n >= 0;
+		}
+
+		// name of the next entity, which has to be a wrapper, offset stays put
+		inline bool peek(const uint8_t* buffer, size_t length, size_t offset, Wrapper wrapper, std::string_view& name)
+		{
+			uint8_t found;
+			return View::readHeader(buffer, length, offset, found, name)
+				&& (found & WRAPPER_MASK) == static_cast<uint8_t>(wrapper);
+		}
+
+		// an entity at depth, an unknown object is held to maxDepth as well
+		inline bool skip(const uint8_t* buffer, size_t length, size_t& offset, size_t depth, Wrapper wrapper)
+		{
+			switch (wrapper)
+			{
+			case Wrapper::PRIMITIVE: return View::skipPrimitive(buffer, length, offset);
+			case Wrapper::OBJECT: return View::skipObject(buffer, length, offset, depth < maxDepth ? maxDepth - depth : 0);
+			default: return View::skipArray(buffer, length, offset);
+			}
+		}
+
+		inline size_t trailerOf(uint8_t wrapper)
+		{
+			return trailerSize + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+		}
+
+		// a primitive of exactly type
+		template<typename T>
+		bool primitive(const uint8_t* buffer, size_t length, size_t& offset, Type type, T& value)
+		{
+			size_t it = offset;
+			uint8_t wrapper;
+			std::string_view name;
+			if (!View::readHeader(buffer, length, it, wrapper, name)
+				|| length - it < sizeof(uint8_t) + sizeof(T) + trailerOf(wrapper)
+				|| buffer[it] != static_cast<uint8_t>(type))
+			{
+				return false;
+			}
+
+			value = Core::load<T>(buffer + it + 1);
+			offset = it + sizeof(uint8_t) + sizeof(T) + trailerOf(wrapper);
+			return true;
+		}
+
+		// an array of exactly type, values keeps its capacity
+		template<typename T>
+		bool array(const uint8_t* buffer, size_t length, size_t& offset, Type type, std::vector<T>& values)
+		{
+			size_t it = offset;
+			ArrayView view;
+			if (!ArrayView::read(buffer, length, it, view) || view.getWrapper() != Wrapper::ARRAY || view.getType() != type)
+			{
+				return false;
+			}
+
+			values.resize(view.getCount());
+			if (sizeof(T) == 1 && !view.isSparse())
+			{
+				std::memcpy(values.data(), view.getData(), values.size());
+			}
+			else
+			{
+				view.copyTo<T>(values.data());
+			}
+			offset = it;
+			return true;
+		}
+
+		inline bool string(const uint8_t* buffer, size_t length, size_t& offset, std::string& text)
+		{
+			size_t it = offset;
+			ArrayView view;
+			if (!ArrayView::read(buffer, length, it, view) || view.getWrapper() != Wrapper::STRING)
+			{
+				return false;
+			}
+
+			text.assign(reinterpret_cast<const char*>(view.getData()), view.getByteSize());
+			offset = it;
+			return true;
+		}
+
+		// object header at depth, offset is left on the primitive count
+		inline bool enter(const uint8_t* buffer, size_t length, size_t& offset, size_t depth, uint8_t& wrapper)
+		{
+			std::string_view name;
+			wrapper = offset < length ? buffer[offset] : 0;
+			return depth < maxDepth && View::enterObject(buffer, length, offset, name);
+		}
+
+		inline bool leave(size_t length, size_t& offset, uint8_t wrapper)
+		{
+			if (offset > length || length - offset < trailerOf(wrapper))
+			{
+				return false;
+			}
+
+			offset += trailerOf(wrapper);
+			return true;
+		}
+
+		// skips a whole section of n entities
+		inline bool skip(const uint8_t* buffer, size_t length, size_t& offset, size_t depth, Wrapper wrapper, int16_t n)
+		{
+			for (int16_t i = 0; i < n; i++)
+			{
+				if (!skip(buffer, length, offset, depth, wrapper))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+
+		// lists of strings and of generated structs, an object whose
+		// entities all sit in one section; the names are not checked
+		inline bool element(const uint8_t* buffer, size_t length, size_t& offset, size_t, std::string& value)
+		{
+			return string(buffer, length, offset, value);
+		}
+
+		template<typename T>
+		bool element(const uint8_t* buffer, size_t length, size_t& offset, size_t depth, T& value)
+		{
+			return value.unpack(buffer, length, offset, depth);
+		}
+
+		template<typename T>
+		constexpr Wrapper elementWrapper = std::is_same<T, std::string>::value ? Wrapper::STRING : Wrapper::OBJECT;
+
+		template<typename T>
+		bool list(const uint8_t* buffer, size_t length, size_t& offset, size_t depth, std::vector<T>& values)
+		{
+			size_t it = offset;
+			uint8_t wrapper;
+			if (!enter(buffer, length, it, depth, wrapper))
+			{
+				return false;
+			}
+
+			values.clear();
+			for (uint8_t section = static_cast<uint8_t>(Wrapper::PRIMITIVE); section <= static_cast<uint8_t>(Wrapper::OBJECT); section++)
+			{
+				int16_t n;
+				if (!count(buffer, length, it, n))
+				{
+					return false;
+				}
+
+				if (static_cast<Wrapper>(section) != elementWrapper<T>)
+				{
+					if (!skip(buffer, length, it, depth + 1, static_cast<Wrapper>(section), n))
+					{
+						return false;
+					}
+					continue;
+				}
+
+				values.resize(n);
+				for (int16_t i = 0; i < n; i++)
+				{
+					std::string_view name;
+					if (!peek(buffer, length, it, elementWrapper<T>, name) || !element(buffer, length, it, depth + 1, values[i]))
+					{
+						return false;
+					}
+				}
+			}
+
+			if (!leave(length, it, wrapper))
+			{
+				return false;
+			}
+
+			offset = it;
+			return true;
+		}
+
+		template<typename T>
+		int32_t listSize(std::string_view name, const std::vector<T>& values)
+		{
+			if (values.size() > (size_t)INT16_MAX)
+			{
+				return -1;
+			}
+
+			int64_t children = 0;
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				if constexpr (std::is_same<T, std::string>::value)
+				{
+					children = add(children, arraySize(Index(i), values[i].size()));
+				}
+				else
+				{
+					children = add(children, values[i].getSize(Index(i)));
+				}
+			}
+			return objectSize(name, children);
+		}
+
+		template<typename T>
+		uint8_t* list(uint8_t* p, std::string_view name, const std::vector<T>& values)
+		{
+			if (p == nullptr || values.size() > (size_t)INT16_MAX)
+			{
+				return nullptr;
+			}
+
+			uint8_t* start = p;
+			p = header(p, Wrapper::OBJECT, name);
+			for (uint8_t section = static_cast<uint8_t>(Wrapper::PRIMITIVE); section <= static_cast<uint8_t>(Wrapper::OBJECT); section++)
+			{
+				if (static_cast<Wrapper>(section) != elementWrapper<T>)
+				{
+					p = count(p, 0);
+					continue;
+				}
+
+				p = count(p, (int16_t)values.size());
+				for (size_t i = 0; i < values.size(); i++)
+				{
+					if constexpr (std::is_same<T, std::string>::value)
+					{
+						p = string(p, Index(i), values[i]);
+					}
+					else
+					{
+						p = values[i].pack(p, Index(i));
+					}
+				}
+			}
+			return trailer(p, start);
+		}
+	}
+}
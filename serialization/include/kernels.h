@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace Core
+{
+	// bulk conversions behind the compact array types, sse2/f16c where
+	// available, plain loops the compiler can vectorize otherwise
+	namespace Kernels
+	{
+		// bit i lands in byte i / 8 at position i % 8, out gets (count + 7) / 8 bytes
+		void packBits(const bool* in, size_t count, uint8_t* out);
+		void unpackBits(const uint8_t* in, size_t count, bool* out);
+
+		// ieee binary16, round to nearest even
+		void floatToHalf(const float* in, size_t count, uint16_t* out);
+		void halfToFloat(const uint16_t* in, size_t count, float* out);
+
+		// upper half of a binary32, round to nearest even
+		void floatToBFloat16(const float* in, size_t count, uint16_t* out);
+		void bfloat16ToFloat(const uint16_t* in, size_t count, float* out);
+
+		// 16 bit words to and from the big endian wire order
+		void storeBE16(const uint16_t* in, size_t count, uint8_t* out);
+		void loadBE16(const uint8_t* in, size_t count, uint16_t* out);
+
+		// indices of the elements of width 1, 2, 4 or 8 bytes that have a
+		// non zero byte, all zero blocks are skipped 16 bytes at a time.
+		// Stops once more than limit are found and returns limit + 1.
+		size_t findNonZero(const uint8_t* in, size_t count, size_t width, uint32_t* indices, size_t limit);
+
+		// element i of values goes to out[index i], indices are big endian
+		// and the ones at or past count are dropped
+		void scatter(const uint8_t* values, const uint8_t* indices, size_t n, size_t width, size_t count, uint8_t* out);
+
+		// true when the n big endian indices strictly ascend and all are
+		// below bound, no early exit so the compares vectorize
+		bool isAscending(const uint8_t* indices, size_t n, uint32_t bound);
+	}
+}
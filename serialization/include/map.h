@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core.h"
+#include "root.h"
+#include "view.h"
+
+
+// keyed entities that can be looked up on the packed bytes. The key is the
+// entity's name, values are any entity, maps included:
+//   header, count(4), slots(4), bytes(4),
+//   slots x { crc32c(key)(4), offset(4) }, entities in insertion order,
+//   size(4), [hash]
+// slots is a power of two at least twice count, empty slots have offset
+// 0xFFFFFFFF and offsets are from the first entity. Probing is linear.
+namespace ObjectModel
+{
+	// values are packed when they are added, later edits to them don't
+	// show in the map
+	class Map : public Root
+	{
+		friend struct Entity;
+	private:
+		struct Key
+		{
+			uint32_t hash;
+			uint32_t offset;
+		};
+
+		// insertion order
+		std::vector<Key> keys;
+		std::vector<uint8_t> entities;
+		// open addressing over keys, index + 1 and 0 for empty
+		std::vector<uint32_t> table;
+	public:
+		Map(std::string name = "default");
+	public:
+		// false if key is already there
+		bool addEntity(Root* value);
+
+		inline int32_t getCount() const { return (int32_t)keys.size(); }
+		bool contains(std::string_view key) const;
+
+		void pack(std::vector<uint8_t>&, int16_t&) override;
+		void pack(Core::GatherList&) override;
+
+		static uint32_t hashKey(std::string_view key) { return Core::crc32c(key.data(), key.size()); }
+		static uint32_t slotsFor(size_t count);
+	protected:
+		uint32_t computeHash() const override;
+	private:
+		int64_t find(std::string_view key, uint32_t hash) const;
+		void packTable(uint8_t* p) const;
+		void resize();
+	};
+
+
+	// read-only window over a packed map, nothing is copied and read does
+	// not walk the entities, so get is O(1) on the bytes
+	class MapView
+	{
+	private:
+		const uint8_t* buffer = nullptr;
+		uint8_t wrapper = 0;
+		std::string_view name;
+		uint32_t count = 0;
+		uint32_t slots = 0;
+		const uint8_t* table = nullptr;
+		size_t first = 0;
+		size_t bytes = 0;
+	public:
+		// checks the header and the bounds, offset is moved past the map
+		static bool read(const uint8_t* buffer, size_t length, size_t& offset, MapView& out);
+		// skips a map, or any other entity
+		static bool skip(const uint8_t* buffer, size_t length, size_t& offset);
+	public:
+		inline std::string_view getName() const { return name; }
+		inline uint32_t getCount() const { return count; }
+		inline bool isHashed() const { return (wrapper & static_cast<uint8_t>(Flag::HASHED)) != 0; }
+
+		// offset of the value into the buffer given to read
+		bool find(std::string_view key, size_t& offset) const;
+
+		// a primitive of exactly type
+		template<typename T>
+		bool get(std::string_view key, Type type, T& value) const
+		{
+			size_t offset;
+			uint8_t found;
+			std::string_view ignored;
+			const size_t end = first + bytes;
+			if (!find(key, offset) || !View::readHeader(buffer, end, offset, found, ignored)
+				|| (found & WRAPPER_MASK) != static_cast<uint8_t>(Wrapper::PRIMITIVE)
+				|| end - offset < sizeof(uint8_t) + sizeof(T) || buffer[offset] != static_cast<uint8_t>(type))
+			{
+				return false;
+			}
+
+			value = Core::load<T>(buffer + offset + 1);
+			return true;
+		}
+
+		bool get(std::string_view key, ArrayView& out) const;
+		bool get(std::string_view key, MapView& out) const;
+
+		// f(name, wrapper, offset) for every value in insertion order,
+		// false when an entity doesn't parse
+		template<typename F>
+		bool forEach(F f) const
+		{
+			size_t offset = first;
+			const size_t end = first + bytes;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				size_t it = offset;
+				uint8_t found;
+				std::string_view key;
+				if (!View::readHeader(buffer, end, it, found, key))
+				{
+					return false;
+				}
+
+				f(key, static_cast<Wrapper>(found & WRAPPER_MASK), offset);
+				if (!skip(buffer, end, offset))
+				{
+					return false;
+				}
+			}
+			return offset == end;
+		}
+	};
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -11,9 +12,32 @@ namespace ObjectModel
 		PRIMITIVE = 1,
 		ARRAY,
 		STRING,
-		OBJECT
+		OBJECT,
+		// keyed entities with a lookup table, see map.h; only at the root
+		// or inside another map, objects have no section for it
+		MAP
 	};
 
+	// the high bits of the wrapper byte carry per-entity flags,
+	// the low bits keep the Wrapper itself
+	enum class Flag : uint8_t
+	{
+		HASHED = 0x80,
+		// a U8 array holding a BlobRef, the bytes live in a file, see blob.h
+		EXTERNAL = 0x40,
+		// an object whose sections are sorted by name, a directory follows
+		// the name: count(4), count x { crc32c(name)(4), offset(4) } ordered
+		// by hash then offset, offsets from the object's wrapper byte
+		SORTED = 0x20
+	};
+
+	constexpr uint8_t WRAPPER_MASK = 0x1F;
+
+	constexpr size_t getDirectorySize(uint32_t count)
+	{
+		return sizeof(int32_t) + (size_t)count * 2 * sizeof(uint32_t);
+	}
+
 	enum class Type : uint8_t
 	{
 		I8 = 1,
@@ -24,25 +48,90 @@ namespace ObjectModel
 		FLOAT,
 		DOUBLE,
 
-		BOOL
+		BOOL,
+
+		U8,
+		U16,
+		U32,
+		U64,
+
+		// stored as raw 16 bit patterns
+		F16,
+		BF16,
+
+		// bools packed 8 per byte, lsb first
+		BIT
 	};
 
-	template<typename ...>
-	uint8_t getTypeSize(Type type)
-	{
-		switch (type)
-		{
-		case Type::BOOL: return sizeof(bool); break;
-		case Type::I8: return sizeof(uint8_t); break;
-		case Type::I16: return sizeof(int16_t); break;
-		case Type::I32: return sizeof(int32_t); break;
-		case Type::I64: return sizeof(int64_t); break;
-		case Type::FLOAT: return sizeof(float); break;
-		case Type::DOUBLE: return sizeof(double); break;
-		}
-		return 0;
+	constexpr uint8_t typeSizes[] =
+	{
+		0,
+		sizeof(int8_t), sizeof(int16_t), sizeof(int32_t), sizeof(int64_t),
+		sizeof(float), sizeof(double),
+		sizeof(bool),
+		sizeof(uint8_t), sizeof(uint16_t), sizeof(uint32_t), sizeof(uint64_t),
+		sizeof(uint16_t), sizeof(uint16_t),
+		sizeof(uint8_t)
+	};
+
+	constexpr uint8_t getTypeSize(Type type)
+	{
+		return static_cast<uint8_t>(type) < sizeof typeSizes ? typeSizes[static_cast<uint8_t>(type)] : 0;
 	}
 
+	// bytes taken by count elements of type on the wire
+	constexpr int32_t getStorageSize(Type type, int32_t count)
+	{
+		return type == Type::BIT ? (count + 7) / 8 : count * getTypeSize(type);
+	}
+
+	// the high bit of an array's type byte selects the sparse layout,
+	// count stays the dense length and the payload is
+	//   nonzero(4), indices(4 each, ascending), values
+	// the low bits keep the element Type, BIT arrays are never sparse
+	constexpr uint8_t SPARSE = 0x80;
+	constexpr uint8_t TYPE_MASK = 0x7F;
+
+	constexpr bool isSparse(uint8_t type) { return (type & SPARSE) != 0; }
+
+	constexpr size_t getSparseSize(Type type, uint32_t nonZero)
+	{
+		return sizeof(uint32_t) + (size_t)nonZero * (sizeof(uint32_t) + getTypeSize(type));
+	}
+
+	static_assert(getTypeSize(Type::I64) == 8 && getTypeSize(Type::BF16) == 2, "type size table out of sync");
+	static_assert(getStorageSize(Type::BIT, 9) == 2, "bit arrays round up to whole bytes");
+
+
+	// the Type a native value is stored as, fixed at compile time so a value
+	// and its tag can't disagree. No specialization means no wire type:
+	// F16, BF16 and BIT have no native type of their own.
+	template<typename T>
+	struct TypeTraits;
+
+#define OM_TYPE_TRAITS(T, tag) \
+	template<> \
+	struct TypeTraits<T> \
+	{ \
+		static constexpr Type type = Type::tag; \
+		static constexpr size_t size = sizeof(T); \
+		static_assert(sizeof(T) == getTypeSize(Type::tag), "native size differs from the wire size"); \
+	};
+
+	OM_TYPE_TRAITS(int8_t, I8)
+	OM_TYPE_TRAITS(int16_t, I16)
+	OM_TYPE_TRAITS(int32_t, I32)
+	OM_TYPE_TRAITS(int64_t, I64)
+	OM_TYPE_TRAITS(float, FLOAT)
+	OM_TYPE_TRAITS(double, DOUBLE)
+	OM_TYPE_TRAITS(bool, BOOL)
+	OM_TYPE_TRAITS(uint8_t, U8)
+	OM_TYPE_TRAITS(uint16_t, U16)
+	OM_TYPE_TRAITS(uint32_t, U32)
+	OM_TYPE_TRAITS(uint64_t, U64)
+
+#undef OM_TYPE_TRAITS
+
 
 
 }
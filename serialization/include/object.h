@@ -7,8 +7,11 @@
 
 namespace ObjectModel
 {
+	struct NodePool;
+
 	class Object : public Root
 	{
+		friend class StackDecoder;
 	public:
 		int16_t primitiveCount = 0, arrayCount = 0, stringCount = 0, objectCount = 0;
 		std::vector<Primitive> primitives;
@@ -19,11 +22,22 @@ namespace ObjectModel
 		Object(std::string);
 		void addEntity(Root*);
 		void pack(std::vector<uint8_t>&, int16_t&);
+		void pack(Core::GatherList&);
 		static Object unpack(std::vector<uint8_t>&, int16_t&);
+		// decodes over an existing tree, children it no longer needs go to
+		// pool and are taken back from there before anything is allocated
+		static void unpack(const std::vector<uint8_t>&, int16_t&, Object& into, NodePool* pool = nullptr);
 		inline int16_t getPrimitiveCount() {return primitiveCount;}
 		inline int16_t getArrayCount() {return arrayCount;}
 		inline int16_t getStringCount() {return stringCount;}
 		inline int16_t getObjectCount() {return objectCount;}
+		bool verify() const override;
+
+		// canonical layout: every section kept sorted by name and a hash
+		// directory packed in front, see Flag::SORTED. Like setHashed, set
+		// it before adding the object to a parent.
+		void setSorted(bool on);
+		inline bool isSorted() const { return (wrapper & static_cast<uint8_t>(Flag::SORTED)) != 0; }
 
 
 		Primitive findPrimitiveByName(std::string name)
@@ -76,6 +90,15 @@ namespace ObjectModel
 			return new Object("SYSTEM:empty");
 
 		}
+	protected:
+		uint32_t computeHash() const override;
+	private:
+		inline size_t directorySize() const
+		{
+			return isSorted() ? getDirectorySize((uint32_t)(primitiveCount + arrayCount + stringCount + objectCount)) : 0;
+		}
+
+		void packDirectory(uint8_t* out) const;
 	};
 
 }
\ No newline at end of file
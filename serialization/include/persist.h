@@ -0,0 +1,64 @@
+#pragma once
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include "core.h"
+
+
+// writes packed roots to files without blocking the caller on every
+// open/write/close the way Util::retriveNsave does
+#ifndef _WIN32
+namespace ObjectModel
+{
+	struct PersistOptions
+	{
+		// saves queued or running before save blocks
+		size_t maxInFlight = 256;
+		// saves gathered into one submission, flush sends a partial one
+		size_t batch = 32;
+		// fsync every file before it is closed
+		bool sync = false;
+		// false skips io_uring and goes straight to the threads
+		bool uring = true;
+		// workers when io_uring isn't there
+		size_t threads = 4;
+	};
+
+
+	// on Linux each save is one linked open, write, close chain on an
+	// io_uring set up with raw syscalls, the file lives in a registered
+	// slot so nothing goes back to user space in between. Elsewhere, or
+	// when the kernel refuses, a pool of threads does the same with plain
+	// syscalls. Either way the root is packed in the calling thread, so
+	// it can be changed or freed as soon as save returns.
+	class Persister
+	{
+	public:
+		// 0 or the errno of the step that failed, run on the engine's
+		// thread; it must not call save
+		using Callback = std::function<void(int error)>;
+
+		class Engine;
+	private:
+		std::unique_ptr<Engine> engine;
+	public:
+		explicit Persister(PersistOptions options = PersistOptions());
+		// waits for everything in flight
+		~Persister();
+
+		Persister(const Persister&) = delete;
+		Persister& operator=(const Persister&) = delete;
+	public:
+		void save(Root& root, std::string path, Callback done);
+		std::future<int> save(Root& root, std::string path);
+
+		// submits a partial batch
+		void flush();
+		// flushes and returns once every save so far has completed
+		void wait();
+
+		bool usesUring() const;
+	};
+}
+#endif
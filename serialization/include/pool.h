@@ -0,0 +1,107 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "decoder.h"
+
+
+namespace ObjectModel
+{
+	class EntityPool;
+
+	// owns an entity taken from an EntityPool and gives it back when it
+	// goes out of scope, to the pool of the thread that lets go of it
+	template<typename T>
+	class Pooled
+	{
+	private:
+		std::unique_ptr<T> entity;
+	public:
+		Pooled() = default;
+
+		explicit Pooled(std::unique_ptr<T> entity)
+			:
+			entity(std::move(entity)) {}
+
+		Pooled(Pooled&&) = default;
+
+		Pooled& operator=(Pooled&& other)
+		{
+			if (this != &other)
+			{
+				release();
+				entity = std::move(other.entity);
+			}
+			return *this;
+		}
+
+		~Pooled() { release(); }
+	public:
+		inline T* get() const { return entity.get(); }
+		inline T* operator->() const { return entity.get(); }
+		inline T& operator*() const { return *entity; }
+		inline explicit operator bool() const { return entity != nullptr; }
+
+		// back to the pool now rather than at the end of the scope
+		void release();
+		// keeps the entity out of the pool for good
+		std::unique_ptr<T> detach() { return std::move(entity); }
+	};
+
+
+	// per thread free lists of entities, for servers that unpack and drop
+	// messages at a steady rate. An entity keeps its name and payload
+	// buffers while pooled and an object its children, so unpacking over
+	// one allocates nothing once the pool is warm. Payloads still shared
+	// with a copy are let go instead, and so are entities past the limits.
+	// A pool is not locked, use local() or one per thread.
+	class EntityPool
+	{
+	private:
+		std::vector<std::unique_ptr<Primitive>> primitives;
+		std::vector<std::unique_ptr<Array>> arrays;
+		std::vector<std::unique_ptr<Object>> objects;
+		// children pooled objects shed, Object::unpack refills from here
+		NodePool nodes;
+		// scratch for walking a released object
+		std::vector<Object*> pending;
+		size_t maxEntities;
+		size_t maxBytes;
+	public:
+		// at most maxEntities of each kind, nothing larger than maxBytes packed
+		explicit EntityPool(size_t maxEntities = 4096, size_t maxBytes = 64 * 1024)
+			:
+			maxEntities(maxEntities),
+			maxBytes(maxBytes) {}
+	public:
+		// stale contents, meant to be unpacked over
+		Pooled<Primitive> primitive();
+		Pooled<Array> array();
+		Pooled<Object> object();
+
+		Pooled<Primitive> unpackPrimitive(const std::vector<uint8_t>& buffer, int16_t& it);
+		// arrays and strings alike
+		Pooled<Array> unpackArray(const std::vector<uint8_t>& buffer, int16_t& it);
+		Pooled<Object> unpackObject(const std::vector<uint8_t>& buffer, int16_t& it);
+
+		void release(std::unique_ptr<Primitive> p);
+		void release(std::unique_ptr<Array> arr);
+		void release(std::unique_ptr<Object> o);
+
+		// entities on the free lists, children of pooled objects not counted
+		inline size_t getPooled() const { return primitives.size() + arrays.size() + objects.size(); }
+		void clear();
+
+		// the calling thread's pool, Pooled hands entities back to it
+		static EntityPool& local();
+	};
+
+
+	template<typename T>
+	void Pooled<T>::release()
+	{
+		if (entity)
+		{
+			EntityPool::local().release(std::move(entity));
+		}
+	}
+}
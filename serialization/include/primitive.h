@@ -2,15 +2,18 @@
 #include "root.h"
 #include <memory>
 #include "core.h"
+#include "gather.h"
 
 
 namespace ObjectModel
 {
 	class Primitive : public Root
 	{
+		friend class StackDecoder;
+		friend class EntityPool;
 	private:
 		uint8_t type = 0;
-		std::vector<uint8_t>* data = nullptr;
+		std::shared_ptr<std::vector<uint8_t>> data;
 	private:
 		Primitive();
 	public:
@@ -21,7 +24,9 @@ namespace ObjectModel
 			p->setName(name);
 			p->wrapper = static_cast<uint8_t>(Wrapper::PRIMITIVE);
 			p->type = static_cast<uint8_t>(type);
-			p->data = new std::vector<uint8_t>(sizeof value);
+			p->data = std::make_shared<std::vector<uint8_t>>(sizeof value);
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, sizeof value);
 			p->size += (int32_t)p->data->size();
 			int16_t iterator = 0;
 			Core::encode<T>(*p->data, iterator, value);
@@ -29,11 +34,37 @@ namespace ObjectModel
 			return p;
 		}
 
+		// the type follows from T
+		template<typename T>
+		static std::unique_ptr<Primitive> create(std::string name, T value)
+		{
+			return create<T>(name, TypeTraits<T>::type, value);
+		}
+
 		void pack(std::vector<uint8_t>&, int16_t&);
+		void pack(Core::GatherList&);
 		static Primitive unpack(const std::vector<uint8_t>&, int16_t&);
+		// decodes over an existing primitive, reusing its buffers
+		static void unpack(const std::vector<uint8_t>&, int16_t&, Primitive& into);
 
+		inline Type getType() const { return static_cast<Type>(type); }
 		std::vector<uint8_t> getData();
-		std::vector<uint8_t>* getPtrData() {return data;}
+		// read in place, false when the primitive isn't stored as a T
+		template<typename T>
+		bool get(T& out) const
+		{
+			if (type != static_cast<uint8_t>(TypeTraits<T>::type))
+			{
+				return false;
+			}
+
+			out = Core::load<T>(data->data());
+			return true;
+		}
+		std::vector<uint8_t>* getPtrData() {return data.get();}
+		const std::vector<uint8_t>* getPtrData() const {return data.get();}
+	protected:
+		uint32_t computeHash() const override;
 
 	};
 
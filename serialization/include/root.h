@@ -1,12 +1,52 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include <vector>
 #include "lib.h"
 #include "meta.h"
+#include "stats.h"
 
+namespace Core
+{
+	class GatherList;
+}
 
 namespace ObjectModel
 {
+	// the lazily computed hash of an entity. Packing only reads an object,
+	// but filling this cache writes, so it is atomic to let several threads
+	// pack one object at once; two of them may compute the same value twice.
+	// Copies take a snapshot, it is not shared.
+	class HashCache
+	{
+	private:
+		static constexpr uint64_t VALID = 1ull << 32;
+		std::atomic<uint64_t> bits{ 0 };
+	public:
+		HashCache() = default;
+
+		HashCache(const HashCache& other)
+			:
+			bits(other.bits.load(std::memory_order_relaxed)) {}
+
+		HashCache& operator=(const HashCache& other)
+		{
+			bits.store(other.bits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+	public:
+		// false when nothing is cached
+		inline bool get(uint32_t& hash) const
+		{
+			uint64_t value = bits.load(std::memory_order_relaxed);
+			hash = (uint32_t)value;
+			return (value & VALID) != 0;
+		}
+
+		inline void set(uint32_t hash) { bits.store(VALID | hash, std::memory_order_relaxed); }
+		inline void clear() { bits.store(0, std::memory_order_relaxed); }
+	};
+
 
 	class Root
 	{
@@ -16,6 +56,7 @@ namespace ObjectModel
 		mutable int16_t nameLength;
 		mutable std::string name;
 		mutable int32_t size;
+		mutable HashCache hash;
 	public:
 		Root()
 			:
@@ -31,11 +72,67 @@ namespace ObjectModel
 			this->name = name;
 			nameLength = (int16_t)name.length();
 			size += nameLength;
+			hash.clear();
 		}
 
 		inline std::string getName() const { return name; }
+		inline Wrapper getWrapper() const { return static_cast<Wrapper>(wrapper & WRAPPER_MASK); }
+
+		// a hashed entity stores its crc32c right after the size field,
+		// set it before adding the entity to a parent, the parent copies the size
+		void setHashed(bool on)
+		{
+			if (on == isHashed())
+			{
+				return;
+			}
+
+			wrapper ^= static_cast<uint8_t>(Flag::HASHED);
+			size += on ? (int32_t)sizeof(uint32_t) : -(int32_t)sizeof(uint32_t);
+		}
+
+		inline bool isHashed() const { return (wrapper & static_cast<uint8_t>(Flag::HASHED)) != 0; }
+
+		// cached until the entity is edited, unpack seeds it from the wire
+		uint32_t getHash() const
+		{
+			uint32_t value;
+			if (!hash.get(value))
+			{
+				value = computeHash();
+				hash.set(value);
+			}
+
+			return value;
+		}
+
+		inline void invalidateHash() const { hash.clear(); }
+
+		// recomputes the content hash and checks it against the stored one
+		virtual bool verify() const
+		{
+			uint32_t stored;
+			bool hadStored = hash.get(stored);
+			uint32_t computed = computeHash();
+			hash.set(computed);
+			return !hadStored || stored == computed;
+		}
 
 		virtual void pack(std::vector<uint8_t>&, int16_t&) = 0;
+		// scatter/gather variant, same bytes as pack
+		virtual void pack(Core::GatherList&) = 0;
+	protected:
+		virtual uint32_t computeHash() const = 0;
+
+		// wrapper, name length and name; size and optional hash
+		inline size_t headerSize() const { return sizeof wrapper + sizeof nameLength + name.size(); }
+		inline size_t trailerSize() const { return sizeof size + (isHashed() ? sizeof(uint32_t) : 0); }
+		uint8_t* packHeader(uint8_t* p) const;
+		uint8_t* packTrailer(uint8_t* p) const;
+
+		// the name is assigned in place so a reused entity keeps its capacity
+		void unpackHeader(const std::vector<uint8_t>& buffer, int16_t& it);
+		void unpackTrailer(const std::vector<uint8_t>& buffer, int16_t& it);
 	};
 }
 
@@ -1,10 +1,31 @@
 #pragma once
 
+// threads: independent objects can be packed and unpacked concurrently,
+// the only state they share is the atomic stats counters. One object may
+// be packed by many threads at once as long as nobody modifies it; copies
+// share payload buffers and unpacking over a copy reallocates them first.
+// Encoder, Decoder and StackDecoder are per caller, local() gives each
+// thread its own.
 
 #include "core.h"
+#include "stats.h"
+#include "gather.h"
 #include "root.h"
 #include "primitive.h"
 #include "array.h"
+#include "typed.h"
 #include "object.h"
+#include "entity.h"
+#include "view.h"
+#include "batch.h"
+#include "decoder.h"
+#include "validate.h"
+#include "pool.h"
+#include "stream.h"
+#include "blob.h"
+#include "map.h"
+#include "persist.h"
+#include "archive.h"
+#include "generated.h"
 
 
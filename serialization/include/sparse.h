@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "core.h"
+
+
+// the payload of a sparse array, see SPARSE in meta.h. Indices past count
+// in a hostile payload are dropped by expand and never read out of bounds.
+namespace ObjectModel
+{
+	namespace Sparse
+	{
+		inline uint32_t nonZero(const uint8_t* payload) { return Core::load<uint32_t>(payload); }
+		inline const uint8_t* indices(const uint8_t* payload) { return payload + sizeof(uint32_t); }
+		inline const uint8_t* values(const uint8_t* payload) { return payload + sizeof(uint32_t) * (1 + (size_t)nonZero(payload)); }
+
+		// payload bytes of an array with this type byte and count, a sparse
+		// header is read from p. False for unknown types, a header that
+		// doesn't fit in available or more values than count.
+		bool payloadSize(uint8_t type, int32_t count, const uint8_t* p, size_t available, size_t& bytes);
+
+		// count dense elements in wire order to a sparse payload, false and
+		// out untouched when that wouldn't be smaller
+		bool encode(Type type, const uint8_t* dense, int32_t count, std::vector<uint8_t>& out);
+
+		// back to count dense elements in wire order
+		void expand(Type type, const uint8_t* payload, int32_t count, uint8_t* out);
+
+		// the same straight to native values, out[i] for every i below count
+		template<typename T, typename Out>
+		void expand(const uint8_t* payload, int32_t count, Out&& out)
+		{
+			for (int32_t i = 0; i < count; i++)
+			{
+				out[i] = T();
+			}
+
+			const uint8_t* index = indices(payload);
+			const uint8_t* value = values(payload);
+			for (uint32_t k = 0, n = nonZero(payload); k < n; k++)
+			{
+				uint32_t i = Core::load<uint32_t>(index + k * sizeof(uint32_t));
+				if (i < (uint32_t)count)
+				{
+					out[i] = Core::load<T>(value + k * sizeof(T));
+				}
+			}
+		}
+
+		// position of index among the stored values, false for a zero
+		bool find(const uint8_t* payload, uint32_t index, uint32_t& slot);
+	}
+}
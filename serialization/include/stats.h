@@ -0,0 +1,94 @@
+#pragma once
+#include <ostream>
+#include <stdint.h>
+
+
+// opt-in instrumentation, configure with -DSERIALIZATION_STATS=ON. Without it
+// every OM_STAT_* / OM_SCOPED_TIMER expands to nothing and getStats reports zeros.
+namespace Core
+{
+	class GatherList;
+
+	struct Stats
+	{
+		// payload buffers of primitives and arrays
+		uint64_t allocations = 0;
+		uint64_t bytesAllocated = 0;
+
+		// counted once per outermost pack/unpack, nested entities don't add up twice
+		uint64_t bytesEncoded = 0;
+		uint64_t bytesDecoded = 0;
+		uint64_t packs = 0;
+		uint64_t unpacks = 0;
+		uint64_t packNanoseconds = 0;
+		uint64_t unpackNanoseconds = 0;
+
+		uint64_t primitivesCreated = 0;
+		uint64_t arraysCreated = 0;
+		uint64_t objectsCreated = 0;
+	};
+
+	Stats getStats();
+	void resetStats();
+	void dumpStats(std::ostream& out);
+	bool statsEnabled();
+
+	namespace Instrumentation
+	{
+		enum class Counter
+		{
+			ALLOCATIONS,
+			BYTES_ALLOCATED,
+			PRIMITIVES_CREATED,
+			ARRAYS_CREATED,
+			OBJECTS_CREATED
+		};
+
+		enum class Kind
+		{
+			PACK,
+			UNPACK
+		};
+
+		void add(Counter counter, uint64_t n);
+
+		// one pack/unpack spread over many calls, a streamed object: its
+		// bytes and the call are counted, the time in between is the caller's
+		void record(Kind kind, uint64_t bytes);
+
+		// times the outermost pack/unpack on this thread and counts the
+		// bytes its position moved by
+		class ScopedTimer
+		{
+		private:
+			Kind kind;
+			const int16_t* iterator = nullptr;
+			const size_t* offset = nullptr;
+			const GatherList* list = nullptr;
+			size_t start;
+			uint64_t began = 0;
+			bool outermost;
+		public:
+			ScopedTimer(Kind kind, const int16_t& iterator);
+			ScopedTimer(Kind kind, const size_t& offset);
+			ScopedTimer(Kind kind, const GatherList& list);
+			~ScopedTimer();
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+		private:
+			void begin();
+		};
+	}
+}
+
+
+#ifdef SERIALIZATION_STATS
+#define OM_STAT_ADD(counter, n) Core::Instrumentation::add(Core::Instrumentation::Counter::counter, (n))
+#define OM_SCOPED_TIMER(kind, position) Core::Instrumentation::ScopedTimer omScopedTimer(Core::Instrumentation::Kind::kind, (position))
+#define OM_STAT_RECORD(kind, bytes) Core::Instrumentation::record(Core::Instrumentation::Kind::kind, (bytes))
+#else
+#define OM_STAT_ADD(counter, n) ((void)0)
+#define OM_SCOPED_TIMER(kind, position) ((void)0)
+#define OM_STAT_RECORD(kind, bytes) ((void)0)
+#endif
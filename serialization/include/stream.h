@@ -0,0 +1,218 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core.h"
+#include "decoder.h"
+
+
+// streaming counterparts of pack/unpack for objects that don't fit in
+// memory, the bytes are the same as Object::pack would write
+#ifndef _WIN32
+namespace ObjectModel
+{
+	// writes an object as it is generated. Counts come before their section
+	// on the wire, so each one is written as a placeholder and patched once
+	// the section is done, sizes are trailers and just follow. Entities have
+	// to arrive in wire order: primitives, arrays, strings, objects. The fd
+	// must be seekable, patches that already left the buffer go out with
+	// pwrite. Streamed entities are never hashed.
+	class ObjectWriter
+	{
+	private:
+		struct Frame
+		{
+			uint64_t start;
+			uint64_t countPosition;
+			int8_t section;
+			int16_t count;
+		};
+
+		int fd;
+		bool failed = false;
+		uint64_t base = 0;
+		uint64_t flushed = 0;
+		std::vector<uint8_t> buffer;
+		size_t capacity;
+		std::vector<Frame> stack;
+
+		// the array or string in progress
+		bool inArray = false;
+		uint64_t arrayStart = 0;
+		uint64_t arrayCountPosition = 0;
+		int64_t arrayCount = 0;
+	public:
+		explicit ObjectWriter(int fd, size_t capacity = 64 * 1024);
+		// flushes, the fd stays open
+		~ObjectWriter();
+
+		ObjectWriter(const ObjectWriter&) = delete;
+		ObjectWriter& operator=(const ObjectWriter&) = delete;
+	public:
+		// every call returns false once anything failed, a write error or an
+		// entity out of order, and the output is unusable from then on
+		bool beginObject(std::string_view name);
+		bool endObject();
+
+		// value is already in wire order
+		bool primitive(std::string_view name, Type type, const uint8_t* value);
+
+		template<typename T>
+		bool primitive(std::string_view name, Type type, T value)
+		{
+			uint8_t bytes[sizeof(T)];
+			Core::store<T>(bytes, value);
+			return primitive(name, type, static_cast<const uint8_t*>(bytes));
+		}
+
+		bool beginArray(std::string_view name, Type type);
+		bool beginString(std::string_view name);
+
+		// bytes in wire order holding count elements, BIT chunks other than
+		// the last have to be whole bytes
+		bool append(const uint8_t* bytes, size_t length, int64_t count);
+
+		template<typename T>
+		bool append(const T* values, size_t n)
+		{
+			uint8_t chunk[4096];
+			constexpr size_t perChunk = sizeof chunk / sizeof(T);
+			for (size_t first = 0; first < n; first += perChunk)
+			{
+				size_t m = n - first < perChunk ? n - first : perChunk;
+				for (size_t i = 0; i < m; i++)
+				{
+					Core::store<T>(chunk + i * sizeof(T), values[first + i]);
+				}
+				if (!append(chunk, m * sizeof(T), (int64_t)m))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool endArray();
+
+		bool string(std::string_view name, std::string_view text);
+
+		// pushes the buffer out, true when every object was closed cleanly
+		bool finish();
+
+		inline bool good() const { return !failed; }
+		// bytes written so far, including what is still buffered
+		inline uint64_t position() const { return flushed + buffer.size(); }
+	private:
+		bool enter(int8_t section);
+		void advance(Frame& frame, int8_t section);
+		bool openArray(Wrapper wrapper, std::string_view name, Type type);
+		bool header(Wrapper wrapper, std::string_view name);
+		bool put(const void* bytes, size_t length);
+		bool patch(uint64_t at, const void* bytes, size_t length);
+		bool flush();
+		bool fail();
+	};
+
+
+	// pull parser over an fd: every next() hands out one event, arrays and
+	// strings come as chunks of whole elements, so memory stays at the
+	// buffer plus one frame per nesting level whatever the object size.
+	// Names and chunks point into the buffer and are valid until next().
+	class ObjectReader
+	{
+	public:
+		enum class Event
+		{
+			BEGIN_OBJECT,
+			END_OBJECT,
+			PRIMITIVE,
+			BEGIN_ARRAY,
+			ARRAY_CHUNK,
+			END_ARRAY,
+			// eof after the last top level object
+			END,
+			// see getStatus, and getError for a failed read
+			ERROR
+		};
+	private:
+		struct Frame
+		{
+			uint8_t wrapper;
+			int8_t section;
+			int16_t remaining;
+		};
+
+		int fd;
+		std::vector<uint8_t> buffer;
+		size_t begin = 0;
+		size_t end = 0;
+		// bytes moved out of the buffer, and where the top level object began
+		uint64_t shifted = 0;
+		uint64_t objectStart = 0;
+		bool eof = false;
+		int error = 0;
+		DecodeLimits limits;
+		DecodeStatus status = DecodeStatus::OK;
+		std::vector<Frame> stack;
+
+		// current event
+		uint8_t wrapper = 0;
+		uint8_t type = 0;
+		int32_t count = 0;
+		std::string_view name;
+		const uint8_t* data = nullptr;
+		size_t length = 0;
+
+		// payload bytes of the open array still to hand out
+		uint64_t arrayRemaining = 0;
+		bool inArray = false;
+
+		// sparse arrays are handed out dense: the indices are read on the
+		// first chunk and the values spread over zeroed chunks as they come.
+		// The index list is what the reader holds beyond its buffer, the
+		// array is refused with TOO_LARGE when the object would then span
+		// more than limits.maxSize
+		bool sparse = false;
+		bool indicesRead = false;
+		std::vector<uint32_t> indices;
+		size_t nextValue = 0;
+		uint64_t nextElement = 0;
+		std::vector<uint8_t> expanded;
+
+		// the name of a sorted object, its directory is read past
+		std::string objectName;
+	public:
+		// capacity is raised to fit the longest possible header
+		explicit ObjectReader(int fd, size_t capacity = 64 * 1024, DecodeLimits limits = DecodeLimits());
+	public:
+		Event next();
+
+		inline DecodeStatus getStatus() const { return status; }
+		// 0 or the errno of a failed read
+		inline int getError() const { return error; }
+		inline Wrapper getWrapper() const { return static_cast<Wrapper>(wrapper & WRAPPER_MASK); }
+		inline std::string_view getName() const { return name; }
+		inline Type getType() const { return static_cast<Type>(type); }
+		// elements of the array, the bytes of a string
+		inline int32_t getCount() const { return count; }
+		// primitive value or array chunk, in wire order and always dense
+		inline const uint8_t* getData() const { return data; }
+		inline size_t getLength() const { return length; }
+		inline size_t getDepth() const { return stack.size(); }
+
+		template<typename T>
+		inline T as() const { return Core::load<T>(data); }
+	private:
+		// at least n bytes buffered from begin on, compacting and reading as
+		// needed; false at eof or when the read fails
+		bool fill(size_t n);
+		Event fail(DecodeStatus why);
+		// buffers the header and the fields after the name, at is left past the name
+		bool header(Wrapper expected, size_t fields, size_t& at);
+		Event enterObject();
+		Event sparseChunk();
+		// drops n bytes of the stream
+		bool discard(uint64_t n);
+	};
+}
+#endif
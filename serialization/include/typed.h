@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include "root.h"
+#include "core.h"
+#include "gather.h"
+#include "sparse.h"
+#include "primitive.h"
+#include "array.h"
+
+
+// primitives and dense arrays that hold native values instead of wire
+// bytes. Encode and decode are picked from T at compile time and a value
+// is read without copying a byte vector. The bytes are the same as
+// Primitive and Array write, so either side can read the other. They
+// are packed on their own; toPrimitive/toArray give an entity that
+// Object::addEntity takes.
+namespace ObjectModel
+{
+	template<typename T>
+	class TypedPrimitive : public Root
+	{
+	private:
+		T value = T();
+	public:
+		TypedPrimitive()
+		{
+			wrapper = static_cast<uint8_t>(Wrapper::PRIMITIVE);
+			size += sizeof(uint8_t) + TypeTraits<T>::size;
+		}
+
+		TypedPrimitive(std::string name, T value)
+			:
+			TypedPrimitive()
+		{
+			setName(name);
+			this->value = value;
+		}
+	public:
+		static constexpr Type getType() { return TypeTraits<T>::type; }
+		inline T get() const { return value; }
+
+		void set(T value)
+		{
+			this->value = value;
+			invalidateHash();
+		}
+
+		std::unique_ptr<Primitive> toPrimitive() const
+		{
+			std::unique_ptr<Primitive> p = Primitive::create<T>(name, value);
+			p->setHashed(isHashed());
+			return p;
+		}
+
+		void pack(std::vector<uint8_t>& buffer, int16_t& it) override
+		{
+			OM_SCOPED_TIMER(PACK, it);
+			uint8_t* p = buffer.data() + it;
+			it += (int16_t)(write(p) - p);
+		}
+
+		void pack(Core::GatherList& out) override
+		{
+			OM_SCOPED_TIMER(PACK, out);
+			write(out.reserve(headerSize() + sizeof(uint8_t) + sizeof(T) + trailerSize()));
+		}
+
+		// false when the entity at it isn't a primitive stored as T,
+		// it and into are left alone then
+		static bool unpack(const std::vector<uint8_t>& buffer, int16_t& it, TypedPrimitive& into)
+		{
+			const uint8_t* p = buffer.data() + it;
+			int16_t nameLength = Core::load<int16_t>(p + 1);
+			if ((p[0] & WRAPPER_MASK) != static_cast<uint8_t>(Wrapper::PRIMITIVE) || p[3 + nameLength] != static_cast<uint8_t>(getType()))
+			{
+				return false;
+			}
+
+			OM_SCOPED_TIMER(UNPACK, it);
+			into.unpackHeader(buffer, it);
+			it += sizeof(uint8_t);
+			into.value = Core::load<T>(buffer.data() + it);
+			it += sizeof(T);
+			into.unpackTrailer(buffer, it);
+			return true;
+		}
+	protected:
+		uint32_t computeHash() const override
+		{
+			uint8_t header[] = { static_cast<uint8_t>(getWrapper()), static_cast<uint8_t>(getType()) };
+			uint8_t bytes[sizeof(T)];
+			Core::store<T>(bytes, value);
+
+			uint32_t crc = Core::crc32c(header, sizeof header);
+			crc = Core::crc32c(name.data(), name.size(), crc);
+			return Core::crc32c(bytes, sizeof bytes, crc);
+		}
+	private:
+		uint8_t* write(uint8_t* p) const
+		{
+			p = packHeader(p);
+			*p++ = static_cast<uint8_t>(getType());
+			Core::store<T>(p, value);
+			return packTrailer(p + sizeof(T));
+		}
+	};
+
+
+	// always packed dense, a sparse array is expanded on unpack
+	template<typename T>
+	class TypedArray : public Root
+	{
+	private:
+		std::vector<T> values;
+	public:
+		TypedArray()
+		{
+			wrapper = static_cast<uint8_t>(Wrapper::ARRAY);
+			size += sizeof(uint8_t) + sizeof(int32_t);
+		}
+
+		TypedArray(std::string name, std::vector<T> values)
+			:
+			TypedArray()
+		{
+			setName(name);
+			set(std::move(values));
+		}
+	public:
+		static constexpr Type getType() { return TypeTraits<T>::type; }
+		inline const std::vector<T>& get() const { return values; }
+		inline int32_t getCount() const { return (int32_t)values.size(); }
+
+		void set(std::vector<T> values)
+		{
+			size += (int32_t)(values.size() * sizeof(T)) - (int32_t)(this->values.size() * sizeof(T));
+			this->values = std::move(values);
+			invalidateHash();
+		}
+
+		// sparse when that is smaller, like createArray
+		std::unique_ptr<Array> toArray() const
+		{
+			std::unique_ptr<Array> arr = Array::createArray<T>(name, values);
+			arr->setHashed(isHashed());
+			return arr;
+		}
+
+		void pack(std::vector<uint8_t>& buffer, int16_t& it) override
+		{
+			OM_SCOPED_TIMER(PACK, it);
+			uint8_t* p = buffer.data() + it;
+			it += (int16_t)(write(p) - p);
+		}
+
+		void pack(Core::GatherList& out) override
+		{
+			OM_SCOPED_TIMER(PACK, out);
+			write(out.reserve(headerSize() + sizeof(uint8_t) + sizeof(int32_t) + values.size() * sizeof(T) + trailerSize()));
+		}
+
+		// false when the entity at it isn't an array of T (external arrays
+		// and strings included), it and into are left alone then
+		static bool unpack(const std::vector<uint8_t>& buffer, int16_t& it, TypedArray& into)
+		{
+			const uint8_t* p = buffer.data() + it;
+			int16_t nameLength = Core::load<int16_t>(p + 1);
+			if ((p[0] & (WRAPPER_MASK | static_cast<uint8_t>(Flag::EXTERNAL))) != static_cast<uint8_t>(Wrapper::ARRAY) || (p[3 + nameLength] & TYPE_MASK) != static_cast<uint8_t>(getType()))
+			{
+				return false;
+			}
+
+			OM_SCOPED_TIMER(UNPACK, it);
+			into.unpackHeader(buffer, it);
+			uint8_t type = buffer[it];
+			int32_t count = Core::load<int32_t>(buffer.data() + it + sizeof type);
+			it += sizeof type + sizeof count;
+
+			const uint8_t* payload = buffer.data() + it;
+			if (into.values.capacity() < (size_t)count)
+			{
+				OM_STAT_ADD(ALLOCATIONS, 1);
+				OM_STAT_ADD(BYTES_ALLOCATED, (size_t)count * sizeof(T));
+			}
+			into.values.resize(count);
+			size_t bytes = (size_t)count * sizeof(T);
+			if (isSparse(type))
+			{
+				Sparse::expand<T>(payload, count, into.values);
+				bytes = getSparseSize(getType(), Sparse::nonZero(payload));
+			}
+			else
+			{
+				for (int32_t i = 0; i < count; i++)
+				{
+					into.values[i] = Core::load<T>(payload + (size_t)i * sizeof(T));
+				}
+			}
+			it += (int16_t)bytes;
+			into.unpackTrailer(buffer, it);
+
+			// held dense, so the size and hash are no longer the wire's
+			if (isSparse(type))
+			{
+				into.size += (int32_t)((size_t)count * sizeof(T)) - (int32_t)bytes;
+				into.invalidateHash();
+			}
+			return true;
+		}
+	protected:
+		uint32_t computeHash() const override
+		{
+			int32_t count = getCount();
+			uint8_t header[] =
+			{
+				static_cast<uint8_t>(getWrapper()), static_cast<uint8_t>(getType()),
+				(uint8_t)(count >> 24), (uint8_t)(count >> 16), (uint8_t)(count >> 8), (uint8_t)count
+			};
+
+			uint32_t crc = Core::crc32c(header, sizeof header);
+			crc = Core::crc32c(name.data(), name.size(), crc);
+
+			// in wire order a block at a time
+			uint8_t block[256];
+			constexpr size_t perBlock = sizeof block / sizeof(T);
+			for (size_t i = 0; i < values.size(); i += perBlock)
+			{
+				size_t n = std::min(perBlock, values.size() - i);
+				for (size_t j = 0; j < n; j++)
+				{
+					Core::store<T>(block + j * sizeof(T), values[i + j]);
+				}
+				crc = Core::crc32c(block, n * sizeof(T), crc);
+			}
+			return crc;
+		}
+	private:
+		uint8_t* write(uint8_t* p) const
+		{
+			p = packHeader(p);
+			*p++ = static_cast<uint8_t>(getType());
+			Core::store<int32_t>(p, getCount());
+			p += sizeof(int32_t);
+			for (size_t i = 0; i < values.size(); i++, p += sizeof(T))
+			{
+				Core::store<T>(p, values[i]);
+			}
+			return packTrailer(p);
+		}
+	};
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include "decoder.h"
+
+
+// one pass over untrusted bytes before anything is decoded: every length,
+// count, type byte, flag, section and size field is checked, sparse
+// indices have to ascend below their count and a sorted object's
+// directory has to count its children. What passes can go through
+// StackDecoder's unchecked path.
+namespace ObjectModel
+{
+	// an object span Validator has passed. Nothing else makes one, so the
+	// unchecked decode can't be handed raw input by mistake. The bytes must
+	// outlive it and must not change.
+	class Trusted
+	{
+		friend class Validator;
+	private:
+		const uint8_t* buffer = nullptr;
+		size_t length = 0;
+	public:
+		Trusted() = default;
+	public:
+		inline const uint8_t* data() const { return buffer; }
+		inline size_t size() const { return length; }
+		inline bool isValid() const { return buffer != nullptr; }
+	};
+
+
+	// the StackDecoder walk without building anything, same limits and
+	// statuses, no recursion
+	class Validator
+	{
+	private:
+		struct Frame
+		{
+			size_t start;
+			uint8_t wrapper;
+			int8_t section;
+			int16_t remaining;
+			uint32_t children;
+			// entries of a sorted object's directory, -1 for none
+			int32_t directory;
+		};
+
+		std::vector<Frame> stack;
+		DecodeLimits limits;
+	public:
+		Validator(DecodeLimits limits = DecodeLimits())
+			:
+			limits(limits) {}
+	public:
+		// on OK out covers the object at offset and offset is moved past it,
+		// otherwise out is empty
+		DecodeStatus validate(const uint8_t* buffer, size_t length, size_t& offset, Trusted& out);
+		DecodeStatus validate(const std::vector<uint8_t>& buffer, size_t& offset, Trusted& out)
+		{
+			return validate(buffer.data(), buffer.size(), offset, out);
+		}
+
+		inline const DecodeLimits& getLimits() const { return limits; }
+
+		// per thread like StackDecoder::local, with the default limits
+		static Validator& local();
+	};
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <string_view>
+#include <algorithm>
+#include <stdint.h>
+#include "core.h"
+#include "sparse.h"
+
+
+namespace ObjectModel
+{
+	// read-only window over a packed Array or String, nothing is copied;
+	// the buffer has to outlive the view. Sparse arrays are read in place,
+	// get does a binary search over their indices.
+	class ArrayView
+	{
+	private:
+		uint8_t wrapper = 0;
+		uint8_t type = 0;
+		int32_t count = 0;
+		std::string_view name;
+		const uint8_t* data = nullptr;
+		size_t byteSize = 0;
+	public:
+		// parses the entity at offset and moves offset past it
+		static bool read(const uint8_t* buffer, size_t length, size_t& offset, ArrayView& out);
+	public:
+		inline Wrapper getWrapper() const { return static_cast<Wrapper>(wrapper & WRAPPER_MASK); }
+		inline bool hasFlag(Flag flag) const { return (wrapper & static_cast<uint8_t>(flag)) != 0; }
+		inline Type getType() const { return static_cast<Type>(type & TYPE_MASK); }
+		inline bool isSparse() const { return ObjectModel::isSparse(type); }
+		inline int32_t getCount() const { return count; }
+		inline std::string_view getName() const { return name; }
+		// the payload as it is on the wire, sparse or not
+		inline const uint8_t* getData() const { return data; }
+		inline size_t getByteSize() const { return byteSize; }
+		inline uint32_t getNonZeroCount() const { return isSparse() ? Sparse::nonZero(data) : (uint32_t)count; }
+
+		template<typename T>
+		inline T get(int32_t index) const
+		{
+			if (isSparse())
+			{
+				uint32_t slot;
+				return Sparse::find(data, (uint32_t)index, slot) ? Core::load<T>(Sparse::values(data) + (size_t)slot * sizeof(T)) : T();
+			}
+			return Core::load<T>(data + (size_t)index * sizeof(T));
+		}
+
+		// decodes [first, first + n) into native order, a plain loop over
+		// fixed size loads so the byte swaps vectorize
+		template<typename T>
+		void copyTo(T* out, int32_t first, int32_t n) const
+		{
+			if (isSparse())
+			{
+				std::fill(out, out + n, T());
+				forEachNonZero<T>([&](uint32_t index, T value)
+				{
+					if (index >= (uint32_t)first && index - (uint32_t)first < (uint32_t)n)
+					{
+						out[index - first] = value;
+					}
+				});
+				return;
+			}
+
+			const uint8_t* p = data + (size_t)first * sizeof(T);
+			for (int32_t i = 0; i < n; i++)
+			{
+				out[i] = Core::load<T>(p + (size_t)i * sizeof(T));
+			}
+		}
+
+		template<typename T>
+		void copyTo(T* out) const { copyTo<T>(out, 0, count); }
+
+		// f(index, value) for the stored values in index order, every
+		// element of a dense array
+		template<typename T, typename F>
+		void forEachNonZero(F f) const
+		{
+			if (!isSparse())
+			{
+				for (int32_t i = 0; i < count; i++)
+				{
+					f((uint32_t)i, Core::load<T>(data + (size_t)i * sizeof(T)));
+				}
+				return;
+			}
+
+			const uint8_t* indices = Sparse::indices(data);
+			const uint8_t* values = Sparse::values(data);
+			uint32_t n = Sparse::nonZero(data);
+			for (uint32_t i = 0; i < n; i++)
+			{
+				uint32_t index = Core::load<uint32_t>(indices + (size_t)i * sizeof(uint32_t));
+				if (index < (uint32_t)count)
+				{
+					f(index, Core::load<T>(values + (size_t)i * sizeof(T)));
+				}
+			}
+		}
+	};
+
+
+	// forward walking over packed entities without decoding them
+	namespace View
+	{
+		// wrapper byte, name and the leading fields every entity shares
+		bool readHeader(const uint8_t* buffer, size_t length, size_t& offset, uint8_t& wrapper, std::string_view& name);
+
+		bool skipPrimitive(const uint8_t* buffer, size_t length, size_t& offset);
+		bool skipArray(const uint8_t* buffer, size_t length, size_t& offset);
+		// walks the nested objects with a stack of its own, false past
+		// maxDepth objects counting this one
+		bool skipObject(const uint8_t* buffer, size_t length, size_t& offset, size_t maxDepth = SIZE_MAX);
+
+		// reads an object header and a sorted object's directory, offset is
+		// left on the primitive count
+		bool enterObject(const uint8_t* buffer, size_t length, size_t& offset, std::string_view& name);
+
+		// field is set to the child named key of the object at offset. A
+		// sorted object binary-searches its directory, others are walked.
+		bool findField(const uint8_t* buffer, size_t length, size_t offset, std::string_view key, size_t& field);
+	}
+}
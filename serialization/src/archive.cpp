@@ -0,0 +1,409 @@
+#include "../include/archive.h"
+
+#ifndef _WIN32
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace ObjectModel
+{
+	ArchiveWriter::ArchiveWriter(ArchiveOptions options)
+		:
+		options(options)
+	{
+		// O_DIRECT wants the memory, the offsets and the lengths aligned to
+		// the logical block size, which a page covers on every file system
+		long page = ::sysconf(_SC_PAGESIZE);
+		alignment = page > 0 ? (size_t)page : 4096;
+		capacity = (std::max(options.bufferSize, alignment) + alignment - 1) / alignment * alignment;
+	}
+
+
+	ArchiveWriter::~ArchiveWriter()
+	{
+		close();
+		std::free(buffers[0]);
+		std::free(buffers[1]);
+	}
+
+
+	bool ArchiveWriter::open(const std::string& path)
+	{
+		close();
+		for (uint8_t*& buffer : buffers)
+		{
+			void* memory = nullptr;
+			if (buffer == nullptr && ::posix_memalign(&memory, alignment, capacity) != 0)
+			{
+				return false;
+			}
+			buffer = buffer ? buffer : static_cast<uint8_t*>(memory);
+		}
+
+		int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		fd = -1;
+#ifdef O_DIRECT
+		if (options.direct)
+		{
+			fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+		}
+#endif
+		// tmpfs and a few others refuse O_DIRECT with EINVAL at open
+		direct = fd >= 0;
+		if (fd < 0)
+		{
+			fd = ::open(path.c_str(), flags, 0644);
+		}
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		current = 0;
+		used = 0;
+		offset = 0;
+		length = 0;
+		pending = false;
+		stopping = false;
+		error = 0;
+		io = std::thread(&ArchiveWriter::run, this);
+		return true;
+	}
+
+
+	bool ArchiveWriter::append(Root& root)
+	{
+		Core::Slice packed = encoder.encode(root);
+		return append(packed.data, packed.length);
+	}
+
+
+	bool ArchiveWriter::append(const uint8_t* bytes, size_t n)
+	{
+		if (fd < 0 || getError() != 0)
+		{
+			return false;
+		}
+
+		while (n > 0)
+		{
+			size_t m = std::min(n, capacity - used);
+			std::memcpy(buffers[current] + used, bytes, m);
+			used += m;
+			bytes += m;
+			n -= m;
+			length += m;
+
+			if (used == capacity && !submit(capacity))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	bool ArchiveWriter::close()
+	{
+		if (fd < 0)
+		{
+			return true;
+		}
+
+		bool ok = true;
+		if (used > 0)
+		{
+			// direct io only takes whole blocks, the padding is cut off below
+			size_t padded = (used + alignment - 1) / alignment * alignment;
+			std::memset(buffers[current] + used, 0, padded - used);
+			ok = submit(padded);
+		}
+		ok = drain() && ok;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		changed.notify_all();
+		io.join();
+
+		if (ok && offset != length && ::ftruncate(fd, (off_t)length) != 0)
+		{
+			ok = false;
+		}
+		if (ok && options.sync && ::fdatasync(fd) != 0)
+		{
+			ok = false;
+		}
+		if (::close(fd) != 0)
+		{
+			ok = false;
+		}
+		fd = -1;
+		return ok;
+	}
+
+
+	int ArchiveWriter::getError()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return error;
+	}
+
+
+	bool ArchiveWriter::submit(size_t bytes)
+	{
+		if (!drain())
+		{
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			pendingData = buffers[current];
+			pendingLength = bytes;
+			pendingOffset = offset;
+			pending = true;
+		}
+		changed.notify_all();
+
+		offset += bytes;
+		current ^= 1;
+		used = 0;
+		return true;
+	}
+
+
+	bool ArchiveWriter::drain()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, [this]() { return !pending; });
+		return error == 0;
+	}
+
+
+	void ArchiveWriter::run()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		while (true)
+		{
+			changed.wait(guard, [this]() { return pending || stopping; });
+			if (!pending)
+			{
+				return;
+			}
+
+			const uint8_t* data = pendingData;
+			size_t bytes = pendingLength;
+			uint64_t at = pendingOffset;
+			guard.unlock();
+			int result = write(data, bytes, at);
+			guard.lock();
+
+			if (error == 0)
+			{
+				error = result;
+			}
+			pending = false;
+			changed.notify_all();
+		}
+	}
+
+
+	int ArchiveWriter::write(const uint8_t* data, size_t bytes, uint64_t at)
+	{
+		uint64_t start = at;
+		size_t total = bytes;
+		while (bytes > 0)
+		{
+			ssize_t written = ::pwrite(fd, data, bytes, (off_t)at);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+#ifdef O_DIRECT
+				// some file systems take the flag at open and refuse the io
+				if (errno == EINVAL && isDirect())
+				{
+					int flags = ::fcntl(fd, F_GETFL);
+					if (flags >= 0 && ::fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0)
+					{
+						direct = false;
+						continue;
+					}
+				}
+#endif
+				return errno;
+			}
+			data += written;
+			bytes -= (size_t)written;
+			at += (uint64_t)written;
+		}
+
+		// without O_DIRECT the pages are written back now and dropped, the
+		// io thread waits for it rather than the packing
+		if (!isDirect() && options.dropBehind)
+		{
+#ifdef __linux__
+			::sync_file_range(fd, (off_t)start, (off_t)total, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+			::posix_fadvise(fd, (off_t)start, (off_t)total, POSIX_FADV_DONTNEED);
+		}
+		return 0;
+	}
+
+
+	ArchiveReader::ArchiveReader(ArchiveOptions options, DecodeLimits limits)
+		:
+		options(options),
+		decoder(limits) {}
+
+
+	ArchiveReader::~ArchiveReader()
+	{
+		close();
+	}
+
+
+	bool ArchiveReader::open(const std::string& path)
+	{
+		close();
+		fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		buffer.resize(std::max<size_t>(options.bufferSize, 4096));
+		begin = 0;
+		end = 0;
+		position = 0;
+		hinted = 0;
+		dropped = 0;
+		eof = false;
+		error = 0;
+		status = DecodeStatus::OK;
+		hint();
+		return true;
+	}
+
+
+	void ArchiveReader::close()
+	{
+		if (fd >= 0)
+		{
+			::close(fd);
+			fd = -1;
+		}
+	}
+
+
+	bool ArchiveReader::next(Object& into)
+	{
+		if (fd < 0 || status != DecodeStatus::OK || error != 0)
+		{
+			return false;
+		}
+
+		while (true)
+		{
+			size_t at = begin;
+			DecodeStatus result = decoder.decode(buffer.data(), end, at, into);
+			if (result == DecodeStatus::OK)
+			{
+				begin = at;
+				return true;
+			}
+			if (result != DecodeStatus::TRUNCATED)
+			{
+				status = result;
+				return false;
+			}
+			if (eof)
+			{
+				status = begin == end ? DecodeStatus::OK : DecodeStatus::TRUNCATED;
+				return false;
+			}
+			if (!fill())
+			{
+				return false;
+			}
+		}
+	}
+
+
+	bool ArchiveReader::fill()
+	{
+		if (begin > 0)
+		{
+			std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+			end -= begin;
+			begin = 0;
+		}
+		// a root bigger than the buffer, the decoder's maxSize bounds this
+		if (end == buffer.size())
+		{
+			buffer.resize(buffer.size() * 2);
+		}
+
+		// decoded pages won't be read again
+		uint64_t done = consumed() / 4096 * 4096;
+		if (options.dropBehind && done > dropped)
+		{
+			::posix_fadvise(fd, (off_t)dropped, (off_t)(done - dropped), POSIX_FADV_DONTNEED);
+			dropped = done;
+		}
+
+		while (true)
+		{
+			ssize_t got = ::read(fd, buffer.data() + end, buffer.size() - end);
+			if (got < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			// a failed read is not the end of the file, whatever the decoder
+			// had left to do
+			if (got < 0)
+			{
+				error = errno;
+				return false;
+			}
+			if (got == 0)
+			{
+				eof = true;
+				return true;
+			}
+			end += (size_t)got;
+			position += (uint64_t)got;
+			hint();
+			return true;
+		}
+	}
+
+
+	void ArchiveReader::hint()
+	{
+		// asked again once half the window is used up
+		if (options.readahead == 0 || hinted >= position + options.readahead / 2)
+		{
+			return;
+		}
+
+		uint64_t from = std::max(hinted, position);
+		uint64_t to = position + options.readahead;
+#ifdef __linux__
+		::readahead(fd, (off64_t)from, (size_t)(to - from));
+#else
+		::posix_fadvise(fd, (off_t)from, (off_t)(to - from), POSIX_FADV_WILLNEED);
+#endif
+		hinted = to;
+	}
+}
+#endif
@@ -5,15 +5,172 @@
 namespace ObjectModel
 {
 
-	int Array::count = 0;
-
 	Array::Array()
 	{
+		OM_STAT_ADD(ARRAYS_CREATED, 1);
 		size += sizeof type + sizeof count;
 	}
 
+	std::unique_ptr<Array> Array::createFromBytes(std::string name, Wrapper wrapper, Type type, int32_t count, std::vector<uint8_t> bytes)
+	{
+		std::unique_ptr<Array> arr = std::make_unique<Array>();
+		arr->setName(name);
+		arr->wrapper = static_cast<uint8_t>(wrapper);
+		arr->type = static_cast<uint8_t>(type);
+		arr->count = count;
+		arr->data = std::make_shared<std::vector<uint8_t>>(std::move(bytes));
+		OM_STAT_ADD(ALLOCATIONS, 1);
+		OM_STAT_ADD(BYTES_ALLOCATED, arr->data->size());
+		arr->size += (int32_t)arr->data->size();
+
+		return arr;
+	}
+
+
+	void Array::sparsify()
+	{
+		std::vector<uint8_t> sparse;
+		if (isSparse() || getWrapper() != Wrapper::ARRAY || !Sparse::encode(getType(), data->data(), count, sparse))
+		{
+			return;
+		}
+
+		size += (int32_t)sparse.size() - (int32_t)data->size();
+		data = std::make_shared<std::vector<uint8_t>>(std::move(sparse));
+		OM_STAT_ADD(ALLOCATIONS, 1);
+		OM_STAT_ADD(BYTES_ALLOCATED, data->size());
+		type |= SPARSE;
+		invalidateHash();
+	}
+
+
+	void Array::densify()
+	{
+		if (!isSparse())
+		{
+			return;
+		}
+
+		std::vector<uint8_t> dense((size_t)getStorageSize(getType(), count));
+		getBytes(dense.data());
+		size += (int32_t)dense.size() - (int32_t)data->size();
+		data = std::make_shared<std::vector<uint8_t>>(std::move(dense));
+		OM_STAT_ADD(ALLOCATIONS, 1);
+		OM_STAT_ADD(BYTES_ALLOCATED, data->size());
+		type &= TYPE_MASK;
+		invalidateHash();
+	}
+
+
+	void Array::getBytes(uint8_t* out) const
+	{
+		if (isSparse())
+		{
+			Sparse::expand(getType(), data->data(), count, out);
+		}
+		else
+		{
+			std::copy(data->begin(), data->end(), out);
+		}
+	}
+
+
+	std::unique_ptr<Array> Array::createBitArray(std::string name, const bool* value, int32_t count)
+	{
+		std::unique_ptr<Array> arr = std::make_unique<Array>();
+		arr->setName(name);
+		arr->wrapper = static_cast<uint8_t>(Wrapper::ARRAY);
+		arr->type = static_cast<uint8_t>(Type::BIT);
+		arr->count = count;
+		arr->data = std::make_shared<std::vector<uint8_t>>(getStorageSize(Type::BIT, count));
+		OM_STAT_ADD(ALLOCATIONS, 1);
+		OM_STAT_ADD(BYTES_ALLOCATED, arr->data->size());
+		arr->size += (int32_t)arr->data->size();
+		Core::Kernels::packBits(value, count, arr->data->data());
+
+		return arr;
+	}
+
+
+	std::unique_ptr<Array> Array::createBitArray(std::string name, const std::vector<bool>& value)
+	{
+		std::unique_ptr<Array> arr = createBitArray(name, nullptr, 0);
+		arr->count = (int32_t)value.size();
+		arr->data->assign(getStorageSize(Type::BIT, arr->count), 0);
+		arr->size += (int32_t)arr->data->size();
+
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			(*arr->data)[i / 8] |= (uint8_t)(value[i] << (i % 8));
+		}
+
+		return arr;
+	}
+
+
+	std::unique_ptr<Array> Array::createHalfArray(std::string name, Type type, const std::vector<float>& value)
+	{
+		std::unique_ptr<Array> arr = std::make_unique<Array>();
+		arr->setName(name);
+		arr->wrapper = static_cast<uint8_t>(Wrapper::ARRAY);
+		arr->type = static_cast<uint8_t>(type);
+		arr->count = (int32_t)value.size();
+		arr->data = std::make_shared<std::vector<uint8_t>>(getStorageSize(type, arr->count));
+		OM_STAT_ADD(ALLOCATIONS, 1);
+		OM_STAT_ADD(BYTES_ALLOCATED, arr->data->size());
+		arr->size += (int32_t)arr->data->size();
+
+		std::vector<uint16_t> halves(value.size());
+		if (type == Type::BF16)
+		{
+			Core::Kernels::floatToBFloat16(value.data(), value.size(), halves.data());
+		}
+		else
+		{
+			Core::Kernels::floatToHalf(value.data(), value.size(), halves.data());
+		}
+		Core::Kernels::storeBE16(halves.data(), halves.size(), arr->data->data());
+
+		return arr;
+	}
+
+
+	void Array::getBits(bool* out) const
+	{
+		Core::Kernels::unpackBits(data->data(), count, out);
+	}
+
+
+	void Array::getFloats(float* out) const
+	{
+		// a sparse payload holds fewer than count halves, they are spread
+		// out to the dense layout first
+		const uint8_t* bytes = data->data();
+		std::vector<uint8_t> dense;
+		if (isSparse())
+		{
+			dense.resize((size_t)count * sizeof(uint16_t));
+			getBytes(dense.data());
+			bytes = dense.data();
+		}
+
+		std::vector<uint16_t> halves(count);
+		Core::Kernels::loadBE16(bytes, count, halves.data());
+
+		if (getType() == Type::BF16)
+		{
+			Core::Kernels::bfloat16ToFloat(halves.data(), count, out);
+		}
+		else
+		{
+			Core::Kernels::halfToFloat(halves.data(), count, out);
+		}
+	}
+
+
 	void Array::pack(std::vector<uint8_t>& buffer, int16_t& iterator)
 	{
+		OM_SCOPED_TIMER(PACK, iterator);
 		Core::encode<uint8_t>(buffer, iterator, wrapper);
 		Core::encode<int16_t>(buffer, iterator, nameLength);
 		Core::encode<std::string>(buffer, iterator, name);
@@ -21,21 +178,31 @@ namespace ObjectModel
 		Core::encode<int32_t>(buffer, iterator, count);
 		Core::encode<uint8_t>(buffer, iterator, *data);
 		Core::encode<int32_t>(buffer, iterator, size);
+
+		if (isHashed())
+		{
+			Core::encode<uint32_t>(buffer, iterator, getHash());
+		}
+	}
+
+
+	void Array::pack(Core::GatherList& out)
+	{
+		OM_SCOPED_TIMER(PACK, out);
+		uint8_t* p = out.reserve(headerSize() + sizeof type + sizeof count);
+		p = packHeader(p);
+		*p++ = type;
+		Core::store<int32_t>(p, count);
+
+		out.reference(data->data(), data->size());
+		packTrailer(out.reserve(trailerSize()));
 	}
 
 
 	Array Array::unpack(std::vector<uint8_t>& buffer, int16_t& it)
 	{
 		Array arr;
-		arr.wrapper = Core::decode<uint8_t>(buffer, it);
-		arr.nameLength = Core::decode<int16_t>(buffer, it);
-		arr.name = Core::decode<std::string>(buffer, it);
-		arr.type = Core::decode<uint8_t>(buffer, it);
-		arr.count = Core::decode<int32_t>(buffer, it);
-		arr.data = new std::vector<uint8_t>(getTypeSize((Type)arr.type) * count);
-		Core::decode(buffer, it, *arr.data);
-		arr.size = Core::decode<int32_t>(buffer, it);
-
+		unpack(buffer, it, arr);
 
 		return arr;
 	}
@@ -44,17 +211,49 @@ namespace ObjectModel
 	Array Array::unpackS(std::vector<uint8_t>& buffer, int16_t& it)
 	{
 		Array str;
-		str.wrapper = Core::decode<uint8_t>(buffer, it);
-		str.nameLength = Core::decode<int16_t>(buffer, it);
-		str.name = Core::decode<std::string>(buffer, it);
-		str.type = Core::decode<uint8_t>(buffer, it);
-		str.count = Core::decode<int32_t>(buffer, it);
-		str.data = new std::vector<uint8_t>(str.count);
-		Core::decode(buffer, it, *str.data);
-		str.size = Core::decode<int32_t>(buffer, it);
-
+		unpack(buffer, it, str);
 
 		return str;
 	}
-}
 
+
+	void Array::unpack(const std::vector<uint8_t>& buffer, int16_t& it, Array& into)
+	{
+		OM_SCOPED_TIMER(UNPACK, it);
+		into.unpackHeader(buffer, it);
+		into.type = Core::decode<uint8_t>(buffer, it);
+		into.count = Core::decode<int32_t>(buffer, it);
+
+		// a copy handed out earlier keeps its bytes, only sole owners are reused
+		if (into.data == nullptr || into.data.use_count() > 1)
+		{
+			into.data = std::make_shared<std::vector<uint8_t>>();
+		}
+		// strings are I8, so the storage size is the byte count for them too
+		size_t bytes = 0;
+		Sparse::payloadSize(into.type, into.count, buffer.data() + it, buffer.size() - it, bytes);
+		if (into.data->capacity() < bytes)
+		{
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, bytes);
+		}
+		into.data->resize(bytes);
+		Core::decode(buffer, it, *into.data);
+
+		into.unpackTrailer(buffer, it);
+	}
+
+
+	uint32_t Array::computeHash() const
+	{
+		uint8_t header[] =
+		{
+			static_cast<uint8_t>(getWrapper()), type,
+			(uint8_t)(count >> 24), (uint8_t)(count >> 16), (uint8_t)(count >> 8), (uint8_t)count
+		};
+
+		uint32_t crc = Core::crc32c(header, sizeof header);
+		crc = Core::crc32c(name.data(), name.size(), crc);
+		return Core::crc32c(data->data(), data->size(), crc);
+	}
+}
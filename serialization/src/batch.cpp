@@ -0,0 +1,184 @@
+#include "../include/batch.h"
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		bool sameSchema(const Object& schema, const Object& row)
+		{
+			if (!row.arrays.empty() || !row.objects.empty()
+				|| row.primitives.size() != schema.primitives.size()
+				|| row.strings.size() != schema.strings.size())
+			{
+				return false;
+			}
+
+			for (size_t i = 0; i < schema.primitives.size(); i++)
+			{
+				if (row.primitives[i].getName() != schema.primitives[i].getName()
+					|| row.primitives[i].getType() != schema.primitives[i].getType())
+				{
+					return false;
+				}
+			}
+
+			for (size_t i = 0; i < schema.strings.size(); i++)
+			{
+				if (row.strings[i].getName() != schema.strings[i].getName())
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+	}
+
+
+	std::unique_ptr<Object> Batch::create(std::string name, const std::vector<Object>& rows)
+	{
+		std::unique_ptr<Object> batch = std::make_unique<Object>(name);
+		int32_t n = (int32_t)rows.size();
+
+		std::unique_ptr<Primitive> count = Primitive::create("rows", Type::I32, n);
+		batch->addEntity(count.get());
+
+		if (rows.empty())
+		{
+			return batch;
+		}
+
+		const Object& schema = rows.front();
+		for (const Object& row : rows)
+		{
+			if (!sameSchema(schema, row))
+			{
+				return nullptr;
+			}
+		}
+
+		for (size_t field = 0; field < schema.primitives.size(); field++)
+		{
+			Type type = schema.primitives[field].getType();
+			std::vector<uint8_t> bytes;
+			bytes.reserve((size_t)n * getTypeSize(type));
+
+			for (const Object& row : rows)
+			{
+				const std::vector<uint8_t>* data = row.primitives[field].getPtrData();
+				bytes.insert(bytes.end(), data->begin(), data->end());
+			}
+
+			std::unique_ptr<Array> column = Array::createFromBytes(schema.primitives[field].getName(), Wrapper::ARRAY, type, n, std::move(bytes));
+			batch->addEntity(column.get());
+		}
+
+		for (size_t field = 0; field < schema.strings.size(); field++)
+		{
+			std::vector<uint8_t> bytes;
+			std::vector<uint8_t> offsets(sizeof(uint32_t) * (n + 1));
+			uint32_t end = 0;
+
+			for (int32_t i = 0; i < n; i++)
+			{
+				const std::vector<uint8_t>* data = rows[i].strings[field].getPtrData();
+				bytes.insert(bytes.end(), data->begin(), data->end());
+				Core::store<uint32_t>(offsets.data() + sizeof(uint32_t) * i, end);
+				end += (uint32_t)data->size();
+			}
+			Core::store<uint32_t>(offsets.data() + sizeof(uint32_t) * n, end);
+
+			std::string fieldName = schema.strings[field].getName();
+			std::unique_ptr<Array> index = Array::createFromBytes(fieldName + ".offsets", Wrapper::ARRAY, Type::U32, n + 1, std::move(offsets));
+			std::unique_ptr<Array> column = Array::createFromBytes(fieldName, Wrapper::STRING, Type::I8, (int32_t)bytes.size(), std::move(bytes));
+			batch->addEntity(index.get());
+			batch->addEntity(column.get());
+		}
+
+		return batch;
+	}
+
+
+	int32_t Batch::rows(const uint8_t* buffer, size_t length)
+	{
+		size_t offset = 0;
+		std::string_view name;
+		if (!View::enterObject(buffer, length, offset, name) || length - offset < sizeof(int16_t))
+		{
+			return -1;
+		}
+
+		int16_t primitives = Core::load<int16_t>(buffer + offset);
+		offset += sizeof primitives;
+
+		for (int16_t i = 0; i < primitives; i++)
+		{
+			size_t at = offset;
+			uint8_t wrapper;
+			if (!View::readHeader(buffer, length, at, wrapper, name))
+			{
+				return -1;
+			}
+
+			if (name == "rows" && length - at >= 1 + sizeof(int32_t) && buffer[at] == static_cast<uint8_t>(Type::I32))
+			{
+				return Core::load<int32_t>(buffer + at + 1);
+			}
+
+			if (!View::skipPrimitive(buffer, length, offset))
+			{
+				return -1;
+			}
+		}
+
+		return -1;
+	}
+
+
+	bool Batch::column(const uint8_t* buffer, size_t length, std::string_view name, ArrayView& out)
+	{
+		size_t offset = 0;
+		std::string_view batchName;
+		if (!View::enterObject(buffer, length, offset, batchName) || length - offset < sizeof(int16_t))
+		{
+			return false;
+		}
+
+		int16_t primitives = Core::load<int16_t>(buffer + offset);
+		offset += sizeof primitives;
+		for (int16_t i = 0; i < primitives; i++)
+		{
+			if (!View::skipPrimitive(buffer, length, offset))
+			{
+				return false;
+			}
+		}
+
+		// arrays then strings, both sections hold ArrayView-shaped entities
+		for (int section = 0; section < 2; section++)
+		{
+			if (length - offset < sizeof(int16_t))
+			{
+				return false;
+			}
+
+			int16_t n = Core::load<int16_t>(buffer + offset);
+			offset += sizeof n;
+			for (int16_t i = 0; i < n; i++)
+			{
+				if (!ArrayView::read(buffer, length, offset, out))
+				{
+					return false;
+				}
+
+				if (out.getName() == name)
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,349 @@
+#include "../include/blob.h"
+#include "../include/decoder.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		// the blob section starts on this boundary whatever the page size
+		constexpr uint64_t sectionAlignment = 4096;
+
+		bool writeAll(int fd, const uint8_t* bytes, size_t length)
+		{
+			while (length > 0)
+			{
+				ssize_t written = ::write(fd, bytes, length);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return false;
+				}
+				bytes += written;
+				length -= (size_t)written;
+			}
+			return true;
+		}
+
+		// relative and without .. components
+		bool isContained(const std::string& path)
+		{
+			if (path.empty() || path[0] == '/')
+			{
+				return false;
+			}
+
+			for (size_t start = 0; start <= path.size(); )
+			{
+				size_t slash = path.find('/', start);
+				size_t end = slash == std::string::npos ? path.size() : slash;
+				if (path.compare(start, end - start, "..") == 0)
+				{
+					return false;
+				}
+				start = end + 1;
+			}
+			return true;
+		}
+
+		bool parse(const uint8_t* data, size_t byteSize, Type type, BlobRef& ref)
+		{
+			if (type != Type::U8 || byteSize < Blob::fixedSize)
+			{
+				return false;
+			}
+
+			ref.offset = Core::load<uint64_t>(data);
+			ref.length = Core::load<uint64_t>(data + sizeof(uint64_t));
+			ref.crc = Core::load<uint32_t>(data + 2 * sizeof(uint64_t));
+			ref.path.assign(reinterpret_cast<const char*>(data) + Blob::fixedSize, byteSize - Blob::fixedSize);
+			return ref.offset + ref.length >= ref.offset;
+		}
+	}
+
+
+	namespace Blob
+	{
+		std::unique_ptr<Array> create(std::string name, const BlobRef& ref)
+		{
+			std::vector<uint8_t> bytes(fixedSize + ref.path.size());
+			Core::store<uint64_t>(bytes.data(), ref.offset);
+			Core::store<uint64_t>(bytes.data() + sizeof(uint64_t), ref.length);
+			Core::store<uint32_t>(bytes.data() + 2 * sizeof(uint64_t), ref.crc);
+			std::copy(ref.path.begin(), ref.path.end(), bytes.begin() + fixedSize);
+
+			int32_t count = (int32_t)bytes.size();
+			std::unique_ptr<Array> arr = Array::createFromBytes(std::move(name), Wrapper::ARRAY, Type::U8, count, std::move(bytes));
+			arr->wrapper |= static_cast<uint8_t>(Flag::EXTERNAL);
+			return arr;
+		}
+
+
+		// two writers appending to one file at once may both see the same
+		// end, callers serialize appends per file
+		std::unique_ptr<Array> append(std::string name, const std::string& path, const uint8_t* bytes, size_t length)
+		{
+			int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+			if (fd < 0)
+			{
+				return nullptr;
+			}
+
+			off_t end = ::lseek(fd, 0, SEEK_END);
+			bool ok = end >= 0 && writeAll(fd, bytes, length);
+			ok = ::close(fd) == 0 && ok;
+			if (!ok)
+			{
+				return nullptr;
+			}
+
+			BlobRef ref;
+			ref.path = path;
+			ref.offset = (uint64_t)end;
+			ref.length = length;
+			ref.crc = Core::crc32c(bytes, length);
+			return create(std::move(name), ref);
+		}
+
+
+		bool read(const Array& entity, BlobRef& ref)
+		{
+			const std::vector<uint8_t>* data = entity.getPtrData();
+			return is(entity) && entity.getWrapper() == Wrapper::ARRAY && data != nullptr
+				&& parse(data->data(), data->size(), entity.getType(), ref);
+		}
+
+
+		bool read(const ArrayView& entity, BlobRef& ref)
+		{
+			return entity.hasFlag(Flag::EXTERNAL) && entity.getWrapper() == Wrapper::ARRAY
+				&& parse(entity.getData(), entity.getByteSize(), entity.getType(), ref);
+		}
+	}
+
+
+	BlobSpan::~BlobSpan()
+	{
+		release();
+	}
+
+
+	BlobSpan::BlobSpan(BlobSpan&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+
+	BlobSpan& BlobSpan::operator=(BlobSpan&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			fd = other.fd;
+			offset = other.offset;
+			length = other.length;
+			crc = other.crc;
+			mapping = other.mapping;
+			mappedLength = other.mappedLength;
+			bytes = other.bytes;
+			other.fd = -1;
+			other.mapping = nullptr;
+			other.mappedLength = 0;
+			other.bytes = nullptr;
+		}
+		return *this;
+	}
+
+
+	void BlobSpan::release()
+	{
+		if (mapping != nullptr)
+		{
+			::munmap(mapping, mappedLength);
+			mapping = nullptr;
+		}
+		if (fd >= 0)
+		{
+			::close(fd);
+			fd = -1;
+		}
+		bytes = nullptr;
+	}
+
+
+	const uint8_t* BlobSpan::data()
+	{
+		static const uint8_t empty = 0;
+		if (bytes != nullptr || fd < 0)
+		{
+			return bytes;
+		}
+		if (length == 0)
+		{
+			return bytes = &empty;
+		}
+
+		// a reference past the end of the file would fault on access
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || offset + length > (uint64_t)st.st_size)
+		{
+			return nullptr;
+		}
+
+		uint64_t page = (uint64_t)::sysconf(_SC_PAGESIZE);
+		uint64_t start = offset & ~(page - 1);
+		size_t span = (size_t)(offset - start + length);
+		void* p = ::mmap(nullptr, span, PROT_READ, MAP_PRIVATE, fd, (off_t)start);
+		if (p == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		mapping = p;
+		mappedLength = span;
+		bytes = static_cast<const uint8_t*>(p) + (offset - start);
+		return bytes;
+	}
+
+
+	bool BlobSpan::verify()
+	{
+		const uint8_t* p = data();
+		return p != nullptr && Core::crc32c(p, (size_t)length) == crc;
+	}
+
+
+	BlobSpan openBlob(const BlobRef& ref, const std::string& dir)
+	{
+		std::string path = ref.path;
+		if (!dir.empty())
+		{
+			// a reference from the file can't point out of its directory
+			if (!isContained(path))
+			{
+				return BlobSpan();
+			}
+			path = dir + "/" + path;
+		}
+
+		int fd = path.empty() ? -1 : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		return fd < 0 ? BlobSpan() : BlobSpan(fd, ref.offset, ref.length, ref.crc);
+	}
+
+
+	std::unique_ptr<Array> BlobSection::add(std::string name, const uint8_t* bytes, size_t length)
+	{
+		BlobRef ref;
+		ref.offset = size;
+		ref.length = length;
+		ref.crc = Core::crc32c(bytes, length);
+		blobs.push_back({ bytes, length });
+		size += length;
+		return Blob::create(std::move(name), ref);
+	}
+
+
+	// the root and the blobs go out in one writev, the blob bytes are
+	// referenced where they are
+	bool BlobSection::save(const std::string& path, Root& root)
+	{
+		static const uint8_t zeros[sectionAlignment] = {};
+
+		Core::GatherList list;
+		root.pack(list);
+		size_t pad = (size_t)((sectionAlignment - list.getSize() % sectionAlignment) % sectionAlignment);
+		list.reference(zeros, pad);
+		for (const Pending& blob : blobs)
+		{
+			list.reference(blob.bytes, blob.length);
+		}
+
+		int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		bool ok = Core::Util::writev(fd, list);
+		return ::close(fd) == 0 && ok;
+	}
+
+
+	void BlobSection::clear()
+	{
+		blobs.clear();
+		size = 0;
+	}
+
+
+	bool Container::open(const std::string& path, Object& into)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		size_t length = (size_t)st.st_size;
+		void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED)
+		{
+			return false;
+		}
+
+		// only the root is touched, the blob pages are never faulted in
+		size_t offset = 0;
+		DecodeStatus status = StackDecoder::local().decode(static_cast<const uint8_t*>(p), length, offset, into);
+		::munmap(p, length);
+		if (status != DecodeStatus::OK)
+		{
+			return false;
+		}
+
+		this->path = path;
+		size_t slash = path.rfind('/');
+		dir = slash == std::string::npos ? "." : path.substr(0, slash);
+		base = (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+		return true;
+	}
+
+
+	BlobSpan Container::blob(const Array& entity) const
+	{
+		BlobRef ref;
+		return Blob::read(entity, ref) ? blob(ref) : BlobSpan();
+	}
+
+
+	BlobSpan Container::blob(const BlobRef& ref) const
+	{
+		if (!ref.path.empty())
+		{
+			return openBlob(ref, dir);
+		}
+
+		BlobRef local = ref;
+		local.path = path;
+		local.offset += base;
+		return openBlob(local);
+	}
+}
+#endif
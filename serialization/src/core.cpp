@@ -1,4 +1,17 @@
 #include "../include/core.h"
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CORE_CRC32C_X86
+#elif defined(_M_X64)
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CORE_CRC32C_MSVC
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CORE_CRC32C_ARM
+#endif
 
 
 namespace Core
@@ -43,5 +56,144 @@ namespace Core
 			r->pack(buffer, iterator);
 			save(name.c_str(), buffer);
 		}
+
+
+		bool equals(ObjectModel::Root* a, ObjectModel::Root* b)
+		{
+			// different hashes can't be equal, same hashes still get a byte compare
+			if (a->getSize() != b->getSize() || a->getWrapper() != b->getWrapper() || a->getHash() != b->getHash())
+			{
+				return false;
+			}
+
+			int16_t ia = 0, ib = 0;
+			std::vector<uint8_t> left(a->getSize()), right(b->getSize());
+			a->pack(left, ia);
+			b->pack(right, ib);
+			return left == right;
+		}
+	}
+
+
+	namespace
+	{
+		const uint32_t* crcTable()
+		{
+			static const struct Table
+			{
+				uint32_t entries[256];
+				Table()
+				{
+					for (uint32_t i = 0; i < 256; i++)
+					{
+						uint32_t c = i;
+						for (int k = 0; k < 8; k++)
+						{
+							c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+						}
+						entries[i] = c;
+					}
+				}
+			} table;
+
+			return table.entries;
+		}
+
+		uint32_t crc32cSoftware(const uint8_t* p, size_t length, uint32_t crc)
+		{
+			const uint32_t* table = crcTable();
+			for (size_t i = 0; i < length; i++)
+			{
+				crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return crc;
+		}
+
+#if defined(CORE_CRC32C_X86)
+		__attribute__((target("sse4.2")))
+		uint32_t crc32cHardware(const uint8_t* p, size_t length, uint32_t crc)
+		{
+			uint64_t c = crc;
+			for (; length >= 8; p += 8, length -= 8)
+			{
+				uint64_t word;
+				std::memcpy(&word, p, sizeof word);
+				c = _mm_crc32_u64(c, word);
+			}
+			crc = (uint32_t)c;
+			for (; length > 0; p++, length--)
+			{
+				crc = _mm_crc32_u8(crc, *p);
+			}
+			return crc;
+		}
+
+		bool hasHardwareCrc()
+		{
+			static const bool supported = __builtin_cpu_supports("sse4.2");
+			return supported;
+		}
+#elif defined(CORE_CRC32C_MSVC)
+		uint32_t crc32cHardware(const uint8_t* p, size_t length, uint32_t crc)
+		{
+			uint64_t c = crc;
+			for (; length >= 8; p += 8, length -= 8)
+			{
+				uint64_t word;
+				std::memcpy(&word, p, sizeof word);
+				c = _mm_crc32_u64(c, word);
+			}
+			crc = (uint32_t)c;
+			for (; length > 0; p++, length--)
+			{
+				crc = _mm_crc32_u8(crc, *p);
+			}
+			return crc;
+		}
+
+		bool hasHardwareCrc()
+		{
+			static const bool supported = []()
+			{
+				int info[4];
+				__cpuid(info, 1);
+				return (info[2] & (1 << 20)) != 0;
+			}();
+			return supported;
+		}
+#elif defined(CORE_CRC32C_ARM)
+		uint32_t crc32cHardware(const uint8_t* p, size_t length, uint32_t crc)
+		{
+			for (; length >= 8; p += 8, length -= 8)
+			{
+				uint64_t word;
+				std::memcpy(&word, p, sizeof word);
+				crc = __crc32cd(crc, word);
+			}
+			for (; length > 0; p++, length--)
+			{
+				crc = __crc32cb(crc, *p);
+			}
+			return crc;
+		}
+
+		bool hasHardwareCrc() { return true; }
+#endif
+	}
+
+
+	uint32_t crc32c(const void* data, size_t length, uint32_t crc)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		crc = ~crc;
+
+#if defined(CORE_CRC32C_X86) || defined(CORE_CRC32C_MSVC) || defined(CORE_CRC32C_ARM)
+		if (hasHardwareCrc())
+		{
+			return ~crc32cHardware(p, length, crc);
+		}
+#endif
+
+		return ~crc32cSoftware(p, length, crc);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "../include/decoder.h"
+#include "../include/validate.h"
+
+
+namespace ObjectModel
+{
+	Core::Slice Encoder::encode(Root& root)
+	{
+		list.clear();
+		root.pack(list);
+
+		const std::vector<Core::Slice>& slices = list.finish();
+		return slices.empty() ? Core::Slice{ nullptr, 0 } : slices.front();
+	}
+
+
+	Encoder& Encoder::local()
+	{
+		thread_local Encoder encoder;
+		return encoder;
+	}
+
+
+	Object& Decoder::decode(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		Object::unpack(buffer, it, root, &pool);
+		return root;
+	}
+
+
+	Decoder& Decoder::local()
+	{
+		thread_local Decoder decoder;
+		return decoder;
+	}
+
+
+	StackDecoder& StackDecoder::local()
+	{
+		thread_local StackDecoder decoder;
+		return decoder;
+	}
+
+
+	namespace
+	{
+		inline size_t trailerSize(uint8_t wrapper)
+		{
+			return sizeof(int32_t) + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+		}
+
+		// drops the children a smaller message no longer has
+		template<typename T>
+		void fit(std::vector<T>& nodes, int16_t count)
+		{
+			while ((int16_t)nodes.size() > count)
+			{
+				nodes.pop_back();
+			}
+			nodes.reserve(count);
+		}
+
+		template<typename T, typename Make>
+		T& slot(std::vector<T>& nodes, int16_t i, Make make)
+		{
+			if (i < (int16_t)nodes.size())
+			{
+				return nodes[i];
+			}
+
+			nodes.push_back(make());
+			return nodes.back();
+		}
+	}
+
+
+	DecodeStatus StackDecoder::decode(const uint8_t* buffer, size_t length, size_t& offset, Object& into)
+	{
+		return run<true>(buffer, length, offset, into);
+	}
+
+
+	DecodeStatus StackDecoder::decode(const Trusted& trusted, Object& into)
+	{
+		if (!trusted.isValid())
+		{
+			return DecodeStatus::MALFORMED;
+		}
+
+		size_t offset = 0;
+		return run<false>(trusted.data(), trusted.size(), offset, into);
+	}
+
+
+	// unchecked, every test below that only guards against bad input folds
+	// away and what is left is the copying
+	template<bool checked>
+	DecodeStatus StackDecoder::run(const uint8_t* buffer, size_t length, size_t& offset, Object& into)
+	{
+		// offset only moves on success, a failed decode counts no bytes
+		OM_SCOPED_TIMER(UNPACK, offset);
+		if (offset > length)
+		{
+			return DecodeStatus::TRUNCATED;
+		}
+
+		if (limits.maxDepth == 0)
+		{
+			return DecodeStatus::TOO_DEEP;
+		}
+
+		// bytes past end are in the buffer but outside what the limits accept
+		size_t end = length - offset > limits.maxSize ? offset + limits.maxSize : length;
+		size_t it = offset;
+
+		auto missing = [&](size_t n) { return checked && end - it < n; };
+		auto shortage = [&](size_t n) { return length - it < n ? DecodeStatus::TRUNCATED : DecodeStatus::TOO_LARGE; };
+
+		// wrapper, name and the fixed size fields that follow the name
+		auto header = [&](auto& node, Wrapper expected, size_t fields)
+		{
+			if (missing(sizeof(uint8_t) + sizeof(int16_t)))
+			{
+				return shortage(sizeof(uint8_t) + sizeof(int16_t));
+			}
+
+			uint8_t wrapper = buffer[it];
+			int16_t nameLength = Core::load<int16_t>(buffer + it + 1);
+			if (checked && ((wrapper & WRAPPER_MASK) != static_cast<uint8_t>(expected) || nameLength < 0))
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			it += sizeof wrapper + sizeof nameLength;
+			if (missing((size_t)nameLength + fields))
+			{
+				return shortage((size_t)nameLength + fields);
+			}
+
+			node.wrapper = wrapper;
+			node.nameLength = nameLength;
+			node.name.assign(reinterpret_cast<const char*>(buffer) + it, nameLength);
+			it += nameLength;
+			return DecodeStatus::OK;
+		};
+
+		// callers have checked the bytes are there
+		auto trailer = [&](auto& node)
+		{
+			node.size = Core::load<int32_t>(buffer + it);
+			node.hash.clear();
+			if (node.isHashed())
+			{
+				node.hash.set(Core::load<uint32_t>(buffer + it + sizeof node.size));
+			}
+			it += trailerSize(node.wrapper);
+		};
+
+		auto payload = [&](auto& node, size_t bytes)
+		{
+			// a copy handed out earlier keeps its bytes, only sole owners are reused
+			if (node.data == nullptr || node.data.use_count() > 1)
+			{
+				node.data = std::make_shared<std::vector<uint8_t>>();
+			}
+			if (node.data->capacity() < bytes)
+			{
+				OM_STAT_ADD(ALLOCATIONS, 1);
+				OM_STAT_ADD(BYTES_ALLOCATED, bytes);
+			}
+			node.data->assign(buffer + it, buffer + it + bytes);
+			it += bytes;
+		};
+
+		auto primitive = [&](Primitive& p)
+		{
+			DecodeStatus status = header(p, Wrapper::PRIMITIVE, sizeof p.type);
+			if (status != DecodeStatus::OK)
+			{
+				return status;
+			}
+
+			size_t bytes = getTypeSize(static_cast<Type>(buffer[it]));
+			if (checked && bytes == 0)
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			size_t rest = sizeof p.type + bytes + trailerSize(p.wrapper);
+			if (missing(rest))
+			{
+				return shortage(rest);
+			}
+
+			p.type = buffer[it++];
+			payload(p, bytes);
+			trailer(p);
+			return DecodeStatus::OK;
+		};
+
+		auto array = [&](Array& arr, Wrapper expected)
+		{
+			DecodeStatus status = header(arr, expected, sizeof arr.type + sizeof arr.count);
+			if (status != DecodeStatus::OK)
+			{
+				return status;
+			}
+
+			uint8_t type = buffer[it];
+			int32_t count = Core::load<int32_t>(buffer + it + sizeof arr.type);
+			it += sizeof arr.type + sizeof arr.count;
+
+			// a sparse payload starts with its value count
+			if (isSparse(type) && missing(sizeof(uint32_t)))
+			{
+				return shortage(sizeof(uint32_t));
+			}
+
+			size_t bytes = 0;
+			bool sized = Sparse::payloadSize(type, count, buffer + it, end - it, bytes);
+			if (checked && !sized)
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			if (missing(bytes + trailerSize(arr.wrapper)))
+			{
+				return shortage(bytes + trailerSize(arr.wrapper));
+			}
+
+			arr.type = type;
+			arr.count = count;
+			payload(arr, bytes);
+			trailer(arr);
+			return DecodeStatus::OK;
+		};
+
+		// the directory of a sorted object is for readers that search
+		auto directory = [&](Object& node)
+		{
+			if (!node.isSorted())
+			{
+				return DecodeStatus::OK;
+			}
+			if (missing(sizeof(int32_t)))
+			{
+				return shortage(sizeof(int32_t));
+			}
+
+			int32_t count = Core::load<int32_t>(buffer + it);
+			if (checked && count < 0)
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			size_t bytes = getDirectorySize((uint32_t)count);
+			if (missing(bytes))
+			{
+				return shortage(bytes);
+			}
+			it += bytes;
+			return DecodeStatus::OK;
+		};
+
+		auto makePrimitive = []() { return Primitive(); };
+		auto makeArray = []() { return Array(); };
+		auto makeObject = []() { return Object(""); };
+
+		DecodeStatus status = header(into, Wrapper::OBJECT, 0);
+		if (status == DecodeStatus::OK)
+		{
+			status = directory(into);
+		}
+		if (status != DecodeStatus::OK)
+		{
+			return status;
+		}
+
+		// section -1 means the primitive count hasn't been read yet
+		stack.clear();
+		stack.push_back(Frame{ &into, -1, 0, 0 });
+
+		while (!stack.empty())
+		{
+			Frame& frame = stack.back();
+			Object& object = *frame.object;
+
+			if (frame.index == frame.count)
+			{
+				if (frame.section == 3)
+				{
+					if (missing(trailerSize(object.wrapper)))
+					{
+						return shortage(trailerSize(object.wrapper));
+					}
+					trailer(object);
+					stack.pop_back();
+					continue;
+				}
+
+				if (missing(sizeof(int16_t)))
+				{
+					return shortage(sizeof(int16_t));
+				}
+
+				int16_t count = Core::load<int16_t>(buffer + it);
+				if (checked && count < 0)
+				{
+					return DecodeStatus::MALFORMED;
+				}
+				it += sizeof count;
+
+				frame.section++;
+				frame.index = 0;
+				frame.count = count;
+
+				switch (frame.section)
+				{
+				case 0: object.primitiveCount = count; fit(object.primitives, count); break;
+				case 1: object.arrayCount = count; fit(object.arrays, count); break;
+				case 2: object.stringCount = count; fit(object.strings, count); break;
+				case 3: object.objectCount = count; fit(object.objects, count); break;
+				}
+				continue;
+			}
+
+			int16_t i = frame.index++;
+			switch (frame.section)
+			{
+			case 0: status = primitive(slot(object.primitives, i, makePrimitive)); break;
+			case 1: status = array(slot(object.arrays, i, makeArray), Wrapper::ARRAY); break;
+			case 2: status = array(slot(object.strings, i, makeArray), Wrapper::STRING); break;
+			case 3:
+			{
+				if (checked && stack.size() >= limits.maxDepth)
+				{
+					return DecodeStatus::TOO_DEEP;
+				}
+
+				Object& child = slot(object.objects, i, makeObject);
+				status = header(child, Wrapper::OBJECT, 0);
+				if (status == DecodeStatus::OK)
+				{
+					status = directory(child);
+				}
+				if (status == DecodeStatus::OK)
+				{
+					// frame is dangling after this, the loop picks up the child
+					stack.push_back(Frame{ &child, -1, 0, 0 });
+				}
+				break;
+			}
+			}
+
+			if (status != DecodeStatus::OK)
+			{
+				return status;
+			}
+		}
+
+		offset = it;
+		return DecodeStatus::OK;
+	}
+}
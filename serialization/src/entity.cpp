@@ -0,0 +1,380 @@
+#include "../include/entity.h"
+#include "../include/map.h"
+#include "../include/object.h"
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		template<class... Ts> struct overloaded : Ts... { using Ts::operator()...; };
+		template<class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
+
+		constexpr size_t sectionCount = 4;
+
+		int32_t headerSize(const Entity& e)
+		{
+			return (int32_t)(sizeof(uint8_t) + sizeof(int16_t) + e.name.size());
+		}
+
+		int32_t trailerSize(const Entity& e)
+		{
+			return (int32_t)(sizeof(int32_t) + (e.hashed ? sizeof(uint32_t) : 0));
+		}
+
+		uint32_t crcOf(uint32_t crc, uint32_t h)
+		{
+			uint8_t bytes[] = { (uint8_t)(h >> 24), (uint8_t)(h >> 16), (uint8_t)(h >> 8), (uint8_t)h };
+			return Core::crc32c(bytes, sizeof bytes, crc);
+		}
+	}
+
+
+	bool Entity::from(const Root& root, Entity& out)
+	{
+		switch (root.getWrapper())
+		{
+		case Wrapper::PRIMITIVE:
+		{
+			const Primitive& p = static_cast<const Primitive&>(root);
+			out = Entity{ p.getName(), PrimitiveValue{ p.getType(), *p.getPtrData() } };
+			out.hashed = p.isHashed();
+			return true;
+		}
+		case Wrapper::ARRAY:
+		{
+			// entities are always dense
+			const Array& arr = static_cast<const Array&>(root);
+			bool external = (arr.wrapper & static_cast<uint8_t>(Flag::EXTERNAL)) != 0;
+			out = Entity{ arr.getName(), ArrayValue{ arr.getType(), arr.getCount(), *arr.getPtrData(), external } };
+			if (arr.isSparse())
+			{
+				ArrayValue& value = std::get<ArrayValue>(out.value);
+				value.data.resize(getStorageSize(arr.getType(), arr.getCount()));
+				arr.getBytes(value.data.data());
+			}
+			out.hashed = arr.isHashed();
+			return true;
+		}
+		case Wrapper::STRING:
+		{
+			const Array& str = static_cast<const Array&>(root);
+			const std::vector<uint8_t>& bytes = *str.getPtrData();
+			out = string(str.getName(), std::string(bytes.begin(), bytes.end()));
+			out.hashed = str.isHashed();
+			return true;
+		}
+		case Wrapper::OBJECT:
+		{
+			const Object& obj = static_cast<const Object&>(root);
+			Entity e = object(obj.getName());
+			e.hashed = obj.isHashed();
+
+			ObjectValue& children = std::get<ObjectValue>(e.value);
+			children.children.resize(obj.primitives.size() + obj.arrays.size() + obj.strings.size() + obj.objects.size());
+			size_t i = 0;
+			for (auto& p : obj.primitives) from(p, children.children[i++]);
+			for (auto& arr : obj.arrays) from(arr, children.children[i++]);
+			for (auto& str : obj.strings) from(str, children.children[i++]);
+			for (auto& o : obj.objects) from(o, children.children[i++]);
+			out = std::move(e);
+			return true;
+		}
+		case Wrapper::MAP:
+		{
+			// the values are kept packed, one after the other in insertion order
+			const Map& map = static_cast<const Map&>(root);
+			Entity e = object(map.getName());
+			e.hashed = map.isHashed();
+
+			ObjectValue& children = std::get<ObjectValue>(e.value);
+			children.children.reserve(map.keys.size());
+			for (size_t i = 0; i < map.keys.size(); i++)
+			{
+				auto first = map.entities.begin() + map.keys[i].offset;
+				auto last = i + 1 < map.keys.size() ? map.entities.begin() + map.keys[i + 1].offset : map.entities.end();
+				std::vector<uint8_t> packed(first, last);
+				int16_t it = 0;
+				children.children.push_back(unpack(packed, it));
+			}
+			out = std::move(e);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+
+	int32_t Entity::getSize() const
+	{
+		int32_t body = std::visit(overloaded
+		{
+			[](const PrimitiveValue& p) { return (int32_t)(sizeof(uint8_t) + p.data.size()); },
+			[](const ArrayValue& arr) { return (int32_t)(sizeof(uint8_t) + sizeof(int32_t) + arr.data.size()); },
+			[](const StringValue& str) { return (int32_t)(sizeof(uint8_t) + sizeof(int32_t) + str.text.size()); },
+			[](const ObjectValue& o)
+			{
+				int32_t total = (int32_t)(sectionCount * sizeof(int16_t));
+				for (const Entity& child : o.children)
+				{
+					total += child.getSize();
+				}
+				return total;
+			}
+		}, value);
+
+		return headerSize(*this) + body + trailerSize(*this);
+	}
+
+
+	// same crc32c layout as the Root classes, so both agree on a hash
+	uint32_t Entity::getHash() const
+	{
+		uint8_t wrapper = static_cast<uint8_t>(getWrapper());
+
+		return std::visit(overloaded
+		{
+			[&](const PrimitiveValue& p)
+			{
+				uint8_t header[] = { wrapper, static_cast<uint8_t>(p.type) };
+				uint32_t crc = Core::crc32c(header, sizeof header);
+				crc = Core::crc32c(name.data(), name.size(), crc);
+				return Core::crc32c(p.data.data(), p.data.size(), crc);
+			},
+			[&](const ArrayValue& arr)
+			{
+				uint8_t header[2 + sizeof(int32_t)] = { wrapper, static_cast<uint8_t>(arr.type) };
+				Core::store<int32_t>(header + 2, arr.count);
+				uint32_t crc = Core::crc32c(header, sizeof header);
+				crc = Core::crc32c(name.data(), name.size(), crc);
+				return Core::crc32c(arr.data.data(), arr.data.size(), crc);
+			},
+			[&](const StringValue& str)
+			{
+				uint8_t header[2 + sizeof(int32_t)] = { wrapper, static_cast<uint8_t>(Type::I8) };
+				Core::store<int32_t>(header + 2, (int32_t)str.text.size());
+				uint32_t crc = Core::crc32c(header, sizeof header);
+				crc = Core::crc32c(name.data(), name.size(), crc);
+				return Core::crc32c(str.text.data(), str.text.size(), crc);
+			},
+			[&](const ObjectValue& o)
+			{
+				uint32_t crc = Core::crc32c(&wrapper, sizeof wrapper);
+				crc = Core::crc32c(name.data(), name.size(), crc);
+				for (size_t section = 0; section < sectionCount; section++)
+				{
+					for (const Entity& child : o.children)
+					{
+						if (child.value.index() == section)
+						{
+							crc = crcOf(crc, child.getHash());
+						}
+					}
+				}
+				return crc;
+			}
+		}, value);
+	}
+
+
+	Entity& Entity::add(Entity child)
+	{
+		std::vector<Entity>& children = std::get<ObjectValue>(value).children;
+		children.push_back(std::move(child));
+		return children.back();
+	}
+
+
+	Entity* Entity::find(std::string_view childName)
+	{
+		return const_cast<Entity*>(static_cast<const Entity*>(this)->find(childName));
+	}
+
+
+	const Entity* Entity::find(std::string_view childName) const
+	{
+		const ObjectValue* o = std::get_if<ObjectValue>(&value);
+		if (o == nullptr)
+		{
+			return nullptr;
+		}
+
+		for (const Entity& child : o->children)
+		{
+			if (child.name == childName)
+			{
+				return &child;
+			}
+		}
+
+		return nullptr;
+	}
+
+
+	void Entity::pack(std::vector<uint8_t>& buffer, int16_t& it) const
+	{
+		OM_SCOPED_TIMER(PACK, it);
+		int16_t start = it;
+		uint8_t wrapper = static_cast<uint8_t>(getWrapper()) | (hashed ? static_cast<uint8_t>(Flag::HASHED) : 0);
+		const ArrayValue* arr = std::get_if<ArrayValue>(&value);
+		if (arr != nullptr && arr->external)
+		{
+			wrapper |= static_cast<uint8_t>(Flag::EXTERNAL);
+		}
+
+		Core::encode<uint8_t>(buffer, it, wrapper);
+		Core::encode<int16_t>(buffer, it, (int16_t)name.size());
+		Core::encode<std::string>(buffer, it, name);
+
+		std::visit(overloaded
+		{
+			[&](const PrimitiveValue& p)
+			{
+				Core::encode<uint8_t>(buffer, it, static_cast<uint8_t>(p.type));
+				Core::encode<uint8_t>(buffer, it, p.data);
+			},
+			[&](const ArrayValue& arr)
+			{
+				Core::encode<uint8_t>(buffer, it, static_cast<uint8_t>(arr.type));
+				Core::encode<int32_t>(buffer, it, arr.count);
+				Core::encode<uint8_t>(buffer, it, arr.data);
+			},
+			[&](const StringValue& str)
+			{
+				Core::encode<uint8_t>(buffer, it, static_cast<uint8_t>(Type::I8));
+				Core::encode<int32_t>(buffer, it, (int32_t)str.text.size());
+				Core::encode<std::string>(buffer, it, str.text);
+			},
+			[&](const ObjectValue& o)
+			{
+				// one pass per wire section over the insertion ordered children
+				for (size_t section = 0; section < sectionCount; section++)
+				{
+					int16_t count = 0;
+					for (const Entity& child : o.children)
+					{
+						count += child.value.index() == section ? 1 : 0;
+					}
+
+					Core::encode<int16_t>(buffer, it, count);
+					for (const Entity& child : o.children)
+					{
+						if (child.value.index() == section)
+						{
+							child.pack(buffer, it);
+						}
+					}
+				}
+			}
+		}, value);
+
+		// the trailer counts itself
+		Core::encode<int32_t>(buffer, it, (int32_t)(it - start) + trailerSize(*this));
+
+		if (hashed)
+		{
+			Core::encode<uint32_t>(buffer, it, getHash());
+		}
+	}
+
+
+	Entity Entity::unpack(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		OM_SCOPED_TIMER(UNPACK, it);
+		Entity e;
+		uint8_t wrapper = Core::decode<uint8_t>(buffer, it);
+		int16_t nameLength = Core::decode<int16_t>(buffer, it);
+		e.name.assign(reinterpret_cast<const char*>(buffer.data()) + it, nameLength);
+		it += nameLength;
+		e.hashed = (wrapper & static_cast<uint8_t>(Flag::HASHED)) != 0;
+
+		switch (static_cast<Wrapper>(wrapper & WRAPPER_MASK))
+		{
+		case Wrapper::PRIMITIVE:
+		{
+			PrimitiveValue p{ static_cast<Type>(Core::decode<uint8_t>(buffer, it)), {} };
+			p.data.resize(getTypeSize(p.type));
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, p.data.size());
+			Core::decode(buffer, it, p.data);
+			e.value = std::move(p);
+			break;
+		}
+		case Wrapper::ARRAY:
+		{
+			uint8_t type = Core::decode<uint8_t>(buffer, it);
+			bool external = (wrapper & static_cast<uint8_t>(Flag::EXTERNAL)) != 0;
+			ArrayValue arr{ static_cast<Type>(type & TYPE_MASK), 0, {}, external };
+			arr.count = Core::decode<int32_t>(buffer, it);
+			arr.data.resize(getStorageSize(arr.type, arr.count));
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, arr.data.size());
+			if (isSparse(type))
+			{
+				size_t bytes = 0;
+				Sparse::payloadSize(type, arr.count, buffer.data() + it, buffer.size() - it, bytes);
+				Sparse::expand(arr.type, buffer.data() + it, arr.count, arr.data.data());
+				it += (int16_t)bytes;
+			}
+			else
+			{
+				Core::decode(buffer, it, arr.data);
+			}
+			e.value = std::move(arr);
+			break;
+		}
+		case Wrapper::STRING:
+		{
+			it += sizeof(uint8_t);
+			int32_t length = Core::decode<int32_t>(buffer, it);
+			e.value = StringValue{ std::string(buffer.begin() + it, buffer.begin() + it + length) };
+			it += length;
+			break;
+		}
+		case Wrapper::MAP:
+		{
+			// an object of the values, the table follows from their names
+			int32_t count = Core::decode<int32_t>(buffer, it);
+			int32_t slots = Core::decode<int32_t>(buffer, it);
+			it += (int16_t)(sizeof(int32_t) + (size_t)slots * 2 * sizeof(uint32_t));
+
+			ObjectValue o;
+			for (int32_t i = 0; i < count; i++)
+			{
+				o.children.push_back(unpack(buffer, it));
+			}
+			e.value = std::move(o);
+			break;
+		}
+		default:
+		{
+			// entities keep insertion order, a sorted object's directory is dropped
+			if (wrapper & static_cast<uint8_t>(Flag::SORTED))
+			{
+				it += (int16_t)(getDirectorySize((uint32_t)Core::decode<int32_t>(buffer, it)) - sizeof(int32_t));
+			}
+
+			ObjectValue o;
+			for (size_t section = 0; section < sectionCount; section++)
+			{
+				int16_t count = Core::decode<int16_t>(buffer, it);
+				for (int16_t i = 0; i < count; i++)
+				{
+					o.children.push_back(unpack(buffer, it));
+				}
+			}
+			e.value = std::move(o);
+			break;
+		}
+		}
+
+		it += sizeof(int32_t);
+		if (e.hashed)
+		{
+			it += sizeof(uint32_t);
+		}
+
+		return e;
+	}
+}
@@ -0,0 +1,155 @@
+#include "../include/gather.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
+
+namespace Core
+{
+	uint8_t* GatherList::reserve(size_t n)
+	{
+		size_t offset = scratch.size();
+		scratch.resize(offset + n);
+		size += n;
+
+		// consecutive scratch writes share one segment
+		if (!segments.empty() && segments.back().external == nullptr)
+		{
+			segments.back().length += n;
+		}
+		else
+		{
+			segments.push_back({ nullptr, offset, n });
+		}
+
+		return scratch.data() + offset;
+	}
+
+
+	void GatherList::reference(const uint8_t* data, size_t length)
+	{
+		if (length < threshold)
+		{
+			std::memcpy(reserve(length), data, length);
+			return;
+		}
+
+		segments.push_back({ data, 0, length });
+		size += length;
+	}
+
+
+	const std::vector<Slice>& GatherList::finish()
+	{
+		slices.clear();
+		for (const Segment& segment : segments)
+		{
+			if (segment.length == 0)
+			{
+				continue;
+			}
+
+			const uint8_t* base = segment.external ? segment.external : scratch.data() + segment.offset;
+			slices.push_back({ base, segment.length });
+		}
+
+		return slices;
+	}
+
+
+	void GatherList::clear()
+	{
+		size = 0;
+		scratch.clear();
+		segments.clear();
+		slices.clear();
+	}
+
+
+	namespace Util
+	{
+#ifndef _WIN32
+		bool writev(int fd, GatherList& list)
+		{
+			const std::vector<Slice>& slices = list.finish();
+			std::vector<struct iovec> iov(slices.size());
+			for (size_t i = 0; i < slices.size(); i++)
+			{
+				iov[i].iov_base = const_cast<uint8_t*>(slices[i].data);
+				iov[i].iov_len = slices[i].length;
+			}
+
+			size_t first = 0;
+			while (first < iov.size())
+			{
+				int n = (int)std::min<size_t>(iov.size() - first, IOV_MAX);
+				ssize_t written = ::writev(fd, iov.data() + first, n);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return false;
+				}
+
+				// drop what went out, trim the slice it stopped in
+				size_t left = (size_t)written;
+				while (first < iov.size() && left >= iov[first].iov_len)
+				{
+					left -= iov[first].iov_len;
+					first++;
+				}
+				if (left > 0)
+				{
+					iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + left;
+					iov[first].iov_len -= left;
+				}
+			}
+
+			return true;
+		}
+
+
+		bool sendmsg(int fd, const struct sockaddr* to, socklen_t toLength, GatherList& list)
+		{
+			const std::vector<Slice>& slices = list.finish();
+			if (slices.size() > IOV_MAX)
+			{
+				return false;
+			}
+
+			std::vector<struct iovec> iov(slices.size());
+			for (size_t i = 0; i < slices.size(); i++)
+			{
+				iov[i].iov_base = const_cast<uint8_t*>(slices[i].data);
+				iov[i].iov_len = slices[i].length;
+			}
+
+			struct msghdr message;
+			std::memset(&message, 0, sizeof message);
+			message.msg_name = const_cast<struct sockaddr*>(to);
+			message.msg_namelen = to ? toLength : 0;
+			message.msg_iov = iov.data();
+			message.msg_iovlen = iov.size();
+
+			ssize_t sent;
+			do
+			{
+				sent = ::sendmsg(fd, &message, 0);
+			} while (sent < 0 && errno == EINTR);
+
+			return sent == (ssize_t)list.getSize();
+		}
+#endif
+	}
+}
@@ -0,0 +1,384 @@
+#include "../include/kernels.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define KERNELS_SSE2
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KERNELS_F16C
+#endif
+
+
+namespace Core
+{
+	namespace Kernels
+	{
+		namespace
+		{
+			uint16_t toHalf(float value)
+			{
+				uint32_t f;
+				std::memcpy(&f, &value, sizeof f);
+
+				uint32_t sign = (f >> 16) & 0x8000;
+				uint32_t exponent = (f >> 23) & 0xFF;
+				uint32_t mantissa = f & 0x7FFFFF;
+
+				if (exponent == 0xFF)
+				{
+					return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 | (mantissa >> 13) : 0));
+				}
+
+				int32_t e = (int32_t)exponent - 127 + 15;
+				if (e >= 0x1F)
+				{
+					return (uint16_t)(sign | 0x7C00);
+				}
+
+				if (e <= 0)
+				{
+					if (e < -10)
+					{
+						return (uint16_t)sign;
+					}
+
+					mantissa |= 0x800000;
+					uint32_t shift = (uint32_t)(14 - e);
+					uint32_t half = mantissa >> shift;
+					uint32_t rest = mantissa & ((1u << shift) - 1);
+					uint32_t halfway = 1u << (shift - 1);
+					if (rest > halfway || (rest == halfway && (half & 1)))
+					{
+						half++;
+					}
+					return (uint16_t)(sign | half);
+				}
+
+				uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+				uint32_t rest = mantissa & 0x1FFF;
+				if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+				{
+					// may carry into the exponent, which rounds up to inf correctly
+					half++;
+				}
+				return (uint16_t)(sign | half);
+			}
+
+			float fromHalf(uint16_t h)
+			{
+				uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+				uint32_t exponent = (h >> 10) & 0x1F;
+				uint32_t mantissa = h & 0x3FF;
+				uint32_t f;
+
+				if (exponent == 0x1F)
+				{
+					f = sign | 0x7F800000 | (mantissa << 13);
+				}
+				else if (exponent != 0)
+				{
+					f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+				}
+				else if (mantissa == 0)
+				{
+					f = sign;
+				}
+				else
+				{
+					// subnormal half, normalize it
+					exponent = 127 - 15 + 1;
+					while (!(mantissa & 0x400))
+					{
+						mantissa <<= 1;
+						exponent--;
+					}
+					f = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+				}
+
+				float value;
+				std::memcpy(&value, &f, sizeof value);
+				return value;
+			}
+
+#if defined(KERNELS_F16C)
+			__attribute__((target("avx,f16c")))
+			size_t floatToHalfF16C(const float* in, size_t count, uint16_t* out)
+			{
+				size_t i = 0;
+				for (; i + 8 <= count; i += 8)
+				{
+					__m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+				}
+				return i;
+			}
+
+			__attribute__((target("avx,f16c")))
+			size_t halfToFloatF16C(const uint16_t* in, size_t count, float* out)
+			{
+				size_t i = 0;
+				for (; i + 8 <= count; i += 8)
+				{
+					__m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+					_mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+				}
+				return i;
+			}
+
+			bool hasF16C()
+			{
+				static const bool supported = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+				return supported;
+			}
+#endif
+		}
+
+
+		void packBits(const bool* in, size_t count, uint8_t* out)
+		{
+			size_t i = 0;
+
+#if defined(KERNELS_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+				int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(v, zero));
+				out[i / 8] = (uint8_t)mask;
+				out[i / 8 + 1] = (uint8_t)(mask >> 8);
+			}
+#endif
+
+			for (; i < count; i += 8)
+			{
+				uint8_t byte = 0;
+				for (size_t b = 0; b < 8 && i + b < count; b++)
+				{
+					byte |= (uint8_t)((in[i + b] ? 1 : 0) << b);
+				}
+				out[i / 8] = byte;
+			}
+		}
+
+
+		void unpackBits(const uint8_t* in, size_t count, bool* out)
+		{
+			size_t i = 0;
+
+#if defined(KERNELS_SSE2)
+			const __m128i select = _mm_set_epi8(
+				(char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+				(char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+			const __m128i one = _mm_set1_epi8(1);
+			for (; i + 16 <= count; i += 16)
+			{
+				// low byte feeds lanes 0-7, high byte lanes 8-15
+				__m128i bytes = _mm_set_epi8(
+					(char)in[i / 8 + 1], (char)in[i / 8 + 1], (char)in[i / 8 + 1], (char)in[i / 8 + 1],
+					(char)in[i / 8 + 1], (char)in[i / 8 + 1], (char)in[i / 8 + 1], (char)in[i / 8 + 1],
+					(char)in[i / 8], (char)in[i / 8], (char)in[i / 8], (char)in[i / 8],
+					(char)in[i / 8], (char)in[i / 8], (char)in[i / 8], (char)in[i / 8]);
+				__m128i bits = _mm_cmpeq_epi8(_mm_and_si128(bytes, select), select);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_and_si128(bits, one));
+			}
+#endif
+
+			for (; i < count; i++)
+			{
+				out[i] = ((in[i / 8] >> (i % 8)) & 1) != 0;
+			}
+		}
+
+
+		void floatToHalf(const float* in, size_t count, uint16_t* out)
+		{
+			size_t i = 0;
+
+#if defined(KERNELS_F16C)
+			if (hasF16C())
+			{
+				i = floatToHalfF16C(in, count, out);
+			}
+#endif
+
+			for (; i < count; i++)
+			{
+				out[i] = toHalf(in[i]);
+			}
+		}
+
+
+		void halfToFloat(const uint16_t* in, size_t count, float* out)
+		{
+			size_t i = 0;
+
+#if defined(KERNELS_F16C)
+			if (hasF16C())
+			{
+				i = halfToFloatF16C(in, count, out);
+			}
+#endif
+
+			for (; i < count; i++)
+			{
+				out[i] = fromHalf(in[i]);
+			}
+		}
+
+
+		void floatToBFloat16(const float* in, size_t count, uint16_t* out)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t f;
+				std::memcpy(&f, in + i, sizeof f);
+
+				uint32_t rounded = (f + 0x7FFF + ((f >> 16) & 1)) >> 16;
+				bool nan = (f & 0x7FFFFFFF) > 0x7F800000;
+				out[i] = (uint16_t)(nan ? (f >> 16) | 0x40 : rounded);
+			}
+		}
+
+
+		void bfloat16ToFloat(const uint16_t* in, size_t count, float* out)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t f = (uint32_t)in[i] << 16;
+				std::memcpy(out + i, &f, sizeof f);
+			}
+		}
+
+
+		void storeBE16(const uint16_t* in, size_t count, uint8_t* out)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				out[2 * i] = (uint8_t)(in[i] >> 8);
+				out[2 * i + 1] = (uint8_t)in[i];
+			}
+		}
+
+
+		void loadBE16(const uint8_t* in, size_t count, uint16_t* out)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				out[i] = (uint16_t)((in[2 * i] << 8) | in[2 * i + 1]);
+			}
+		}
+
+
+		size_t findNonZero(const uint8_t* in, size_t count, size_t width, uint32_t* indices, size_t limit)
+		{
+			size_t found = 0;
+			size_t i = 0;
+
+#if defined(KERNELS_SSE2)
+			// one mask bit per byte, an element is zero when all its bits are set
+			const __m128i zero = _mm_setzero_si128();
+			const size_t perBlock = 16 / width;
+			const unsigned elementMask = (1u << width) - 1;
+			for (; i + perBlock <= count; i += perBlock)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * width));
+				unsigned zeros = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+				if (zeros == 0xFFFF)
+				{
+					continue;
+				}
+
+				for (size_t e = 0; e < perBlock; e++)
+				{
+					if (((zeros >> (e * width)) & elementMask) != elementMask)
+					{
+						if (found == limit)
+						{
+							return limit + 1;
+						}
+						indices[found++] = (uint32_t)(i + e);
+					}
+				}
+			}
+#endif
+
+			for (; i < count; i++)
+			{
+				const uint8_t* p = in + i * width;
+				bool nonZero = false;
+				for (size_t b = 0; b < width; b++)
+				{
+					nonZero |= p[b] != 0;
+				}
+				if (nonZero)
+				{
+					if (found == limit)
+					{
+						return limit + 1;
+					}
+					indices[found++] = (uint32_t)i;
+				}
+			}
+
+			return found;
+		}
+
+
+		namespace
+		{
+			// a constant width so the copies compile to single moves
+			template<size_t width>
+			void scatterFixed(const uint8_t* values, const uint8_t* indices, size_t n, size_t count, uint8_t* out)
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					const uint8_t* p = indices + 4 * i;
+					uint32_t index = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+					if (index >= count)
+					{
+						continue;
+					}
+					std::memcpy(out + (size_t)index * width, values + i * width, width);
+				}
+			}
+		}
+
+
+		void scatter(const uint8_t* values, const uint8_t* indices, size_t n, size_t width, size_t count, uint8_t* out)
+		{
+			switch (width)
+			{
+			case 1: scatterFixed<1>(values, indices, n, count, out); break;
+			case 2: scatterFixed<2>(values, indices, n, count, out); break;
+			case 4: scatterFixed<4>(values, indices, n, count, out); break;
+			case 8: scatterFixed<8>(values, indices, n, count, out); break;
+			}
+		}
+
+
+		bool isAscending(const uint8_t* indices, size_t n, uint32_t bound)
+		{
+			if (n == 0)
+			{
+				return true;
+			}
+
+			auto at = [indices](size_t i)
+			{
+				const uint8_t* p = indices + 4 * i;
+				return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+			};
+
+			// neighbours compared independently, nothing carried between lanes
+			uint32_t bad = 0;
+			for (size_t i = 0; i + 1 < n; i++)
+			{
+				bad |= at(i) >= at(i + 1);
+			}
+			return bad == 0 && at(n - 1) < bound;
+		}
+	}
+}
@@ -0,0 +1,312 @@
+#include "../include/map.h"
+#include "../include/gather.h"
+#include <climits>
+#include <cstdint>
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		constexpr uint32_t EMPTY = 0xFFFFFFFF;
+		constexpr size_t slotSize = 2 * sizeof(uint32_t);
+		// count, slots and bytes
+		constexpr size_t fixedSize = 3 * sizeof(int32_t);
+
+		inline size_t trailerSize(uint8_t wrapper)
+		{
+			return sizeof(int32_t) + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+		}
+	}
+
+
+	Map::Map(std::string name)
+	{
+		setName(name);
+		wrapper = static_cast<uint8_t>(Wrapper::MAP);
+		size += (int32_t)fixedSize;
+	}
+
+
+	uint32_t Map::slotsFor(size_t count)
+	{
+		uint32_t slots = count == 0 ? 0 : 2;
+		while (slots < 2 * count)
+		{
+			slots *= 2;
+		}
+		return slots;
+	}
+
+
+	int64_t Map::find(std::string_view key, uint32_t hash) const
+	{
+		if (table.empty())
+		{
+			return -1;
+		}
+
+		uint32_t mask = (uint32_t)table.size() - 1;
+		for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask)
+		{
+			if (table[slot] == 0)
+			{
+				return -1;
+			}
+
+			const Key& k = keys[table[slot] - 1];
+			if (k.hash == hash)
+			{
+				size_t it = k.offset;
+				uint8_t found;
+				std::string_view name;
+				View::readHeader(entities.data(), entities.size(), it, found, name);
+				if (name == key)
+				{
+					return slot;
+				}
+			}
+		}
+	}
+
+
+	bool Map::contains(std::string_view key) const
+	{
+		return find(key, hashKey(key)) >= 0;
+	}
+
+
+	void Map::resize()
+	{
+		table.assign(slotsFor(keys.size()), 0);
+		uint32_t mask = (uint32_t)table.size() - 1;
+		for (uint32_t i = 0; i < (uint32_t)keys.size(); i++)
+		{
+			uint32_t slot = keys[i].hash & mask;
+			while (table[slot] != 0)
+			{
+				slot = (slot + 1) & mask;
+			}
+			table[slot] = i + 1;
+		}
+	}
+
+
+	bool Map::addEntity(Root* value)
+	{
+		std::string key = value->getName();
+		uint32_t hash = hashKey(key);
+		if (find(key, hash) >= 0)
+		{
+			return false;
+		}
+
+		// not Encoder::local(), a slice the caller holds from it stays valid
+		thread_local Core::GatherList scratch(SIZE_MAX);
+		scratch.clear();
+		value->pack(scratch);
+		const std::vector<Core::Slice>& slices = scratch.finish();
+		Core::Slice packed = slices.empty() ? Core::Slice{ nullptr, 0 } : slices.front();
+		if (entities.size() + packed.length > (size_t)INT32_MAX / 2)
+		{
+			return false;
+		}
+
+		keys.push_back({ hash, (uint32_t)entities.size() });
+		entities.insert(entities.end(), packed.data, packed.data + packed.length);
+		if (2 * keys.size() > table.size())
+		{
+			resize();
+		}
+		else
+		{
+			uint32_t mask = (uint32_t)table.size() - 1;
+			uint32_t slot = hash & mask;
+			while (table[slot] != 0)
+			{
+				slot = (slot + 1) & mask;
+			}
+			table[slot] = (uint32_t)keys.size();
+		}
+
+		size = (int32_t)(headerSize() + fixedSize + table.size() * slotSize + entities.size() + trailerSize());
+		invalidateHash();
+		return true;
+	}
+
+
+	void Map::packTable(uint8_t* p) const
+	{
+		for (uint32_t index : table)
+		{
+			Core::store<uint32_t>(p, index == 0 ? 0 : keys[index - 1].hash);
+			Core::store<uint32_t>(p + sizeof(uint32_t), index == 0 ? EMPTY : keys[index - 1].offset);
+			p += slotSize;
+		}
+	}
+
+
+	void Map::pack(std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		OM_SCOPED_TIMER(PACK, it);
+		Core::encode<uint8_t>(buffer, it, wrapper);
+		Core::encode<int16_t>(buffer, it, nameLength);
+		Core::encode<std::string>(buffer, it, name);
+		Core::encode<int32_t>(buffer, it, (int32_t)keys.size());
+		Core::encode<int32_t>(buffer, it, (int32_t)table.size());
+		Core::encode<int32_t>(buffer, it, (int32_t)entities.size());
+
+		std::vector<uint8_t> packed(table.size() * slotSize);
+		packTable(packed.data());
+		Core::encode<uint8_t>(buffer, it, packed);
+		Core::encode<uint8_t>(buffer, it, entities);
+		Core::encode<int32_t>(buffer, it, size);
+
+		if (isHashed())
+		{
+			Core::encode<uint32_t>(buffer, it, getHash());
+		}
+	}
+
+
+	void Map::pack(Core::GatherList& out)
+	{
+		OM_SCOPED_TIMER(PACK, out);
+		uint8_t* p = packHeader(out.reserve(headerSize() + fixedSize + table.size() * slotSize));
+		Core::store<int32_t>(p, (int32_t)keys.size());
+		Core::store<int32_t>(p + sizeof(int32_t), (int32_t)table.size());
+		Core::store<int32_t>(p + 2 * sizeof(int32_t), (int32_t)entities.size());
+		packTable(p + fixedSize);
+
+		out.reference(entities.data(), entities.size());
+		packTrailer(out.reserve(trailerSize()));
+	}
+
+
+	// the table follows from the keys, so the entities cover the content
+	uint32_t Map::computeHash() const
+	{
+		uint8_t header[] =
+		{
+			static_cast<uint8_t>(getWrapper()),
+			(uint8_t)(keys.size() >> 24), (uint8_t)(keys.size() >> 16), (uint8_t)(keys.size() >> 8), (uint8_t)keys.size()
+		};
+
+		uint32_t crc = Core::crc32c(header, sizeof header);
+		crc = Core::crc32c(name.data(), name.size(), crc);
+		return Core::crc32c(entities.data(), entities.size(), crc);
+	}
+
+
+	bool MapView::read(const uint8_t* buffer, size_t length, size_t& offset, MapView& out)
+	{
+		size_t it = offset;
+		if (!View::readHeader(buffer, length, it, out.wrapper, out.name)
+			|| (out.wrapper & WRAPPER_MASK) != static_cast<uint8_t>(Wrapper::MAP)
+			|| length - it < fixedSize)
+		{
+			return false;
+		}
+
+		int32_t count = Core::load<int32_t>(buffer + it);
+		int32_t slots = Core::load<int32_t>(buffer + it + sizeof(int32_t));
+		int32_t bytes = Core::load<int32_t>(buffer + it + 2 * sizeof(int32_t));
+		it += fixedSize;
+
+		// a full table would make a miss probe forever
+		if (count < 0 || slots < 0 || bytes < 0 || (slots & (slots - 1)) != 0 || (int64_t)count * 2 > slots)
+		{
+			return false;
+		}
+
+		size_t tableBytes = (size_t)slots * slotSize;
+		if (length - it < tableBytes + (size_t)bytes + trailerSize(out.wrapper))
+		{
+			return false;
+		}
+
+		out.buffer = buffer;
+		out.count = (uint32_t)count;
+		out.slots = (uint32_t)slots;
+		out.table = buffer + it;
+		out.first = it + tableBytes;
+		out.bytes = (size_t)bytes;
+		offset = out.first + out.bytes + trailerSize(out.wrapper);
+		return true;
+	}
+
+
+	bool MapView::skip(const uint8_t* buffer, size_t length, size_t& offset)
+	{
+		if (offset >= length)
+		{
+			return false;
+		}
+
+		switch (static_cast<Wrapper>(buffer[offset] & WRAPPER_MASK))
+		{
+		case Wrapper::PRIMITIVE: return View::skipPrimitive(buffer, length, offset);
+		case Wrapper::ARRAY:
+		case Wrapper::STRING: return View::skipArray(buffer, length, offset);
+		case Wrapper::OBJECT: return View::skipObject(buffer, length, offset);
+		case Wrapper::MAP:
+		{
+			MapView view;
+			return read(buffer, length, offset, view);
+		}
+		default: return false;
+		}
+	}
+
+
+	bool MapView::find(std::string_view key, size_t& offset) const
+	{
+		if (slots == 0)
+		{
+			return false;
+		}
+
+		uint32_t hash = Map::hashKey(key);
+		uint32_t mask = slots - 1;
+		uint32_t slot = hash & mask;
+		for (uint32_t probes = 0; probes < slots; probes++, slot = (slot + 1) & mask)
+		{
+			const uint8_t* p = table + (size_t)slot * slotSize;
+			uint32_t at = Core::load<uint32_t>(p + sizeof(uint32_t));
+			if (at == EMPTY)
+			{
+				return false;
+			}
+			if (Core::load<uint32_t>(p) != hash || at >= bytes)
+			{
+				continue;
+			}
+
+			// the table could be stale or hostile, the name decides
+			size_t it = first + at;
+			uint8_t found;
+			std::string_view name;
+			if (View::readHeader(buffer, first + bytes, it, found, name) && name == key)
+			{
+				offset = first + at;
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	bool MapView::get(std::string_view key, ArrayView& out) const
+	{
+		size_t offset;
+		return find(key, offset) && ArrayView::read(buffer, first + bytes, offset, out)
+			&& (out.getWrapper() == Wrapper::ARRAY || out.getWrapper() == Wrapper::STRING);
+	}
+
+
+	bool MapView::get(std::string_view key, MapView& out) const
+	{
+		size_t offset;
+		return find(key, offset) && read(buffer, first + bytes, offset, out);
+	}
+}
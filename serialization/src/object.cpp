@@ -1,27 +1,106 @@
 #include "../include/object.h"
 #include "../include/core.h"
+#include "../include/decoder.h"
+#include <algorithm>
 
 
 namespace ObjectModel
 {
 	Object::Object(std::string name = "default")
 	{
+		OM_STAT_ADD(OBJECTS_CREATED, 1);
 		setName(name);
 		wrapper = static_cast<uint8_t>(Wrapper::OBJECT);
 		size += (sizeof(int16_t)) * 4;
 	}
 
+	namespace
+	{
+		template<typename T>
+		bool byName(const T& a, const T& b) { return a.getName() < b.getName(); }
+
+		// a sorted object keeps every section sorted as it grows
+		template<typename T>
+		void insert(std::vector<T>& nodes, const T& node, bool sorted)
+		{
+			nodes.insert(sorted ? std::upper_bound(nodes.begin(), nodes.end(), node, byName<T>) : nodes.end(), node);
+		}
+	}
+
+
 	void Object::addEntity(Root* r)
 	{
-		switch (r->wrapper)
+		// typed entities share the wrappers but not the classes, see typed.h
+		switch (r->wrapper & WRAPPER_MASK)
 		{
-		case 1: primitives.push_back(*dynamic_cast<Primitive*>(r)); primitiveCount += 1; break;
-		case 2: arrays.push_back(*dynamic_cast<Array*>(r)); arrayCount += 1; break;
-		case 3: strings.push_back(*dynamic_cast<Array*>(r)); stringCount += 1; break;
-		case 4: objects.push_back(*dynamic_cast<Object*>(r)); objectCount += 1; break;
+		case 1: if (Primitive* p = dynamic_cast<Primitive*>(r)) { insert(primitives, *p, isSorted()); primitiveCount += 1; break; } return;
+		case 2: if (Array* arr = dynamic_cast<Array*>(r)) { insert(arrays, *arr, isSorted()); arrayCount += 1; break; } return;
+		case 3: if (Array* str = dynamic_cast<Array*>(r)) { insert(strings, *str, isSorted()); stringCount += 1; break; } return;
+		case 4: if (Object* o = dynamic_cast<Object*>(r)) { insert(objects, *o, isSorted()); objectCount += 1; break; } return;
+		default: return;
 		}
 
-		size += r->getSize();
+		size += r->getSize() + (isSorted() ? (int32_t)(2 * sizeof(uint32_t)) : 0);
+		invalidateHash();
+	}
+
+
+	void Object::setSorted(bool on)
+	{
+		if (on == isSorted())
+		{
+			return;
+		}
+
+		if (on)
+		{
+			std::stable_sort(primitives.begin(), primitives.end(), byName<Primitive>);
+			std::stable_sort(arrays.begin(), arrays.end(), byName<Array>);
+			std::stable_sort(strings.begin(), strings.end(), byName<Array>);
+			std::stable_sort(objects.begin(), objects.end(), byName<Object>);
+			wrapper |= static_cast<uint8_t>(Flag::SORTED);
+			size += (int32_t)directorySize();
+		}
+		else
+		{
+			size -= (int32_t)directorySize();
+			wrapper &= ~static_cast<uint8_t>(Flag::SORTED);
+		}
+		invalidateHash();
+	}
+
+
+	void Object::packDirectory(uint8_t* out) const
+	{
+		thread_local std::vector<std::pair<uint32_t, uint32_t>> entries;
+		entries.clear();
+
+		size_t at = headerSize() + directorySize();
+		auto add = [&](const Root& child)
+		{
+			std::string name = child.getName();
+			entries.push_back({ Core::crc32c(name.data(), name.size()), (uint32_t)at });
+			at += child.getSize();
+		};
+
+		at += sizeof primitiveCount;
+		for (auto& p : primitives) add(p);
+		at += sizeof arrayCount;
+		for (auto& arr : arrays) add(arr);
+		at += sizeof stringCount;
+		for (auto& str : strings) add(str);
+		at += sizeof objectCount;
+		for (auto& o : objects) add(o);
+
+		std::sort(entries.begin(), entries.end());
+		Core::store<int32_t>(out, (int32_t)entries.size());
+		out += sizeof(int32_t);
+		for (auto& entry : entries)
+		{
+			Core::store<uint32_t>(out, entry.first);
+			Core::store<uint32_t>(out + sizeof(uint32_t), entry.second);
+			out += 2 * sizeof(uint32_t);
+		}
 	}
 
 
@@ -29,32 +108,40 @@ namespace ObjectModel
 
 	void Object::pack(std::vector<uint8_t>& buffer, int16_t& it)
 	{
+		OM_SCOPED_TIMER(PACK, it);
 		Core::encode<uint8_t>(buffer, it, wrapper);
 		Core::encode<int16_t>(buffer, it, nameLength);
 		Core::encode<std::string>(buffer, it, name);
 
+		if (isSorted())
+		{
+			std::vector<uint8_t> directory(directorySize());
+			packDirectory(directory.data());
+			Core::encode<uint8_t>(buffer, it, directory);
+		}
+
 		// refactor this into std::vector<Entities*> entities;
 		// for (auto e : entities) {e.pack(b,i};}
 		Core::encode<int16_t>(buffer, it, primitiveCount);
-		for (auto p : primitives)
+		for (auto& p : primitives)
 		{
 			p.pack(buffer, it);
 		}
 
 		Core::encode<int16_t>(buffer, it, arrayCount);
-		for (auto arr : arrays)
+		for (auto& arr : arrays)
 		{
 			arr.pack(buffer, it);
 		}
 
 		Core::encode<int16_t>(buffer, it, stringCount);
-		for (auto str : strings)
+		for (auto& str : strings)
 		{
 			str.pack(buffer, it);
 		}
 
 		Core::encode<int16_t>(buffer, it, objectCount);
-		for (auto o : objects)
+		for (auto& o : objects)
 		{
 			o.pack(buffer, it);
 		}
@@ -62,44 +149,158 @@ namespace ObjectModel
 
 		Core::encode<int32_t>(buffer, it, size);
 
+		if (isHashed())
+		{
+			Core::encode<uint32_t>(buffer, it, getHash());
+		}
 	}
 
-	Object Object::unpack(std::vector<uint8_t>& buffer, int16_t& it)
+	void Object::pack(Core::GatherList& out)
 	{
-		Object obj;
-		obj.wrapper = Core::decode<uint8_t>(buffer, it);
-		obj.nameLength = Core::decode<int16_t>(buffer, it);
-		obj.name = Core::decode<std::string>(buffer, it);
+		OM_SCOPED_TIMER(PACK, out);
+		uint8_t* p = packHeader(out.reserve(headerSize() + directorySize()));
+		if (isSorted())
+		{
+			packDirectory(p);
+		}
 
-		// refactor this into:
-		// for (auto e : entities) {e.entities.push_back(e.unpack(b,i));}
-		obj.primitiveCount = Core::decode<int16_t>(buffer, it);
-		for (int i = 0; i < obj.primitiveCount; i++)
+		Core::store<int16_t>(out.reserve(sizeof primitiveCount), primitiveCount);
+		for (auto& p : primitives)
 		{
-			obj.primitives.push_back(Primitive::unpack(buffer, it));
+			p.pack(out);
 		}
 
-		obj.arrayCount = Core::decode<int16_t>(buffer, it);
-		for (int i = 0; i < obj.arrayCount; i++)
+		Core::store<int16_t>(out.reserve(sizeof arrayCount), arrayCount);
+		for (auto& arr : arrays)
 		{
-			obj.arrays.push_back(Array::unpack(buffer, it));
+			arr.pack(out);
 		}
 
-		obj.stringCount = Core::decode<int16_t>(buffer, it);
-		for (int i = 0; i < obj.stringCount; i++)
+		Core::store<int16_t>(out.reserve(sizeof stringCount), stringCount);
+		for (auto& str : strings)
 		{
-			obj.strings.push_back(Array::unpackS(buffer, it));
+			str.pack(out);
 		}
 
-		obj.objectCount = Core::decode<int16_t>(buffer, it);
-		for (int i = 0; i < obj.objectCount; i++)
+		Core::store<int16_t>(out.reserve(sizeof objectCount), objectCount);
+		for (auto& o : objects)
 		{
-			obj.objects.push_back(unpack(buffer, it));
+			o.pack(out);
 		}
 
-		obj.size = Core::decode<int32_t>(buffer, it);
+		packTrailer(out.reserve(trailerSize()));
+	}
+
+
+	namespace
+	{
+		template<typename T, typename Fill, typename Make>
+		void refill(std::vector<T>& nodes, std::vector<T>* spare, int16_t count, Fill fill, Make make)
+		{
+			while ((int16_t)nodes.size() > count)
+			{
+				if (spare)
+				{
+					spare->push_back(std::move(nodes.back()));
+				}
+				nodes.pop_back();
+			}
+
+			for (int16_t i = 0; i < count; i++)
+			{
+				if (i < (int16_t)nodes.size())
+				{
+					fill(nodes[i]);
+				}
+				else if (spare && !spare->empty())
+				{
+					nodes.push_back(std::move(spare->back()));
+					spare->pop_back();
+					fill(nodes.back());
+				}
+				else
+				{
+					nodes.push_back(make());
+				}
+			}
+		}
+	}
 
 
+	Object Object::unpack(std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		Object obj;
+		unpack(buffer, it, obj);
+
 		return obj;
 	}
-}
\ No newline at end of file
+
+
+	void Object::unpack(const std::vector<uint8_t>& buffer, int16_t& it, Object& into, NodePool* pool)
+	{
+		OM_SCOPED_TIMER(UNPACK, it);
+		into.unpackHeader(buffer, it);
+		if (into.isSorted())
+		{
+			it += (int16_t)(getDirectorySize((uint32_t)Core::decode<int32_t>(buffer, it)) - sizeof(int32_t));
+		}
+
+		auto fillPrimitive = [&](Primitive& p) { Primitive::unpack(buffer, it, p); };
+		auto fillArray = [&](Array& arr) { Array::unpack(buffer, it, arr); };
+		auto fillObject = [&](Object& o) { unpack(buffer, it, o, pool); };
+
+		into.primitiveCount = Core::decode<int16_t>(buffer, it);
+		refill(into.primitives, pool ? &pool->primitives : nullptr, into.primitiveCount, fillPrimitive,
+			[&]() { return Primitive::unpack(buffer, it); });
+
+		into.arrayCount = Core::decode<int16_t>(buffer, it);
+		refill(into.arrays, pool ? &pool->arrays : nullptr, into.arrayCount, fillArray,
+			[&]() { Array arr; fillArray(arr); return arr; });
+
+		into.stringCount = Core::decode<int16_t>(buffer, it);
+		refill(into.strings, pool ? &pool->arrays : nullptr, into.stringCount, fillArray,
+			[&]() { Array str; fillArray(str); return str; });
+
+		into.objectCount = Core::decode<int16_t>(buffer, it);
+		refill(into.objects, pool ? &pool->objects : nullptr, into.objectCount, fillObject,
+			[&]() { Object o; fillObject(o); return o; });
+
+		into.unpackTrailer(buffer, it);
+	}
+
+
+	// merkle style: children contribute their cached hashes, so editing one
+	// child only rehashes the path up to the root
+	uint32_t Object::computeHash() const
+	{
+		uint8_t header[] = { static_cast<uint8_t>(getWrapper()) };
+		uint32_t crc = Core::crc32c(header, sizeof header);
+		crc = Core::crc32c(name.data(), name.size(), crc);
+
+		auto combine = [&crc](const Root& child)
+		{
+			uint32_t h = child.getHash();
+			uint8_t bytes[] = { (uint8_t)(h >> 24), (uint8_t)(h >> 16), (uint8_t)(h >> 8), (uint8_t)h };
+			crc = Core::crc32c(bytes, sizeof bytes, crc);
+		};
+
+		for (auto& p : primitives) combine(p);
+		for (auto& arr : arrays) combine(arr);
+		for (auto& str : strings) combine(str);
+		for (auto& o : objects) combine(o);
+
+		return crc;
+	}
+
+
+	bool Object::verify() const
+	{
+		bool valid = true;
+		for (auto& p : primitives) valid &= p.verify();
+		for (auto& arr : arrays) valid &= arr.verify();
+		for (auto& str : strings) valid &= str.verify();
+		for (auto& o : objects) valid &= o.verify();
+
+		return Root::verify() && valid;
+	}
+}
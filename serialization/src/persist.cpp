@@ -0,0 +1,647 @@
+#include "../include/persist.h"
+#include "../include/gather.h"
+
+#ifndef _WIN32
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define PERSIST_URING
+#endif
+#endif
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		constexpr int openFlags = O_WRONLY | O_CREAT | O_TRUNC;
+		constexpr mode_t openMode = 0644;
+
+		struct Request
+		{
+			std::string path;
+			// one contiguous slice, the threshold keeps every byte in scratch
+			Core::GatherList bytes{ SIZE_MAX };
+			Persister::Callback done;
+			int error = 0;
+			// completions still to come, io_uring only
+			int pending = 0;
+			bool opened = false;
+			bool closed = false;
+		};
+	}
+
+
+	// slots, the in-flight limit and completion; the engines only move bytes
+	class Persister::Engine
+	{
+	protected:
+		PersistOptions options;
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::vector<Request> requests;
+		std::vector<uint32_t> spare;
+	public:
+		explicit Engine(PersistOptions options)
+			:
+			options(options),
+			requests(options.maxInFlight)
+		{
+			for (uint32_t slot = (uint32_t)requests.size(); slot > 0; slot--)
+			{
+				spare.push_back(slot - 1);
+			}
+		}
+
+		virtual ~Engine() = default;
+
+		virtual bool isUring() const = 0;
+
+		void save(Root& root, std::string path, Callback done)
+		{
+			uint32_t slot;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (spare.empty())
+				{
+					// a slot only comes back once the batch holding it is out
+					flushLocked();
+					changed.wait(lock, [&] { return !spare.empty(); });
+				}
+				slot = spare.back();
+				spare.pop_back();
+			}
+
+			// the slot is ours until it completes, pack without the lock
+			Request& r = requests[slot];
+			r.path = std::move(path);
+			r.done = std::move(done);
+			r.error = 0;
+			r.opened = false;
+			r.closed = false;
+			r.bytes.clear();
+			root.pack(r.bytes);
+			r.bytes.finish();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			enqueue(slot);
+		}
+
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			flushLocked();
+		}
+
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			flushLocked();
+			changed.wait(lock, [&] { return spare.size() == requests.size(); });
+		}
+	protected:
+		// both with the mutex held
+		virtual void enqueue(uint32_t slot) = 0;
+		virtual void flushLocked() = 0;
+
+		// the callback runs before the slot is given back, so wait() sees it done
+		void complete(uint32_t slot)
+		{
+			Request& r = requests[slot];
+			if (r.done)
+			{
+				r.done(r.error);
+				r.done = nullptr;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			spare.push_back(slot);
+			changed.notify_all();
+		}
+	};
+
+
+	namespace
+	{
+		class ThreadEngine : public Persister::Engine
+		{
+		private:
+			std::vector<std::thread> workers;
+			std::deque<uint32_t> batched;
+			std::deque<uint32_t> ready;
+			std::condition_variable work;
+			bool stopping = false;
+		public:
+			explicit ThreadEngine(PersistOptions options)
+				:
+				Engine(options)
+			{
+				for (size_t i = 0; i < options.threads; i++)
+				{
+					workers.emplace_back([this] { run(); });
+				}
+			}
+
+			~ThreadEngine() override
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				work.notify_all();
+				for (std::thread& worker : workers)
+				{
+					worker.join();
+				}
+			}
+
+			bool isUring() const override { return false; }
+		protected:
+			void enqueue(uint32_t slot) override
+			{
+				batched.push_back(slot);
+				if (batched.size() >= options.batch)
+				{
+					flushLocked();
+				}
+			}
+
+			void flushLocked() override
+			{
+				if (batched.empty())
+				{
+					return;
+				}
+				ready.insert(ready.end(), batched.begin(), batched.end());
+				batched.clear();
+				work.notify_all();
+			}
+		private:
+			void run()
+			{
+				std::vector<uint32_t> taken;
+				for (;;)
+				{
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						work.wait(lock, [&] { return stopping || !ready.empty(); });
+						if (ready.empty())
+						{
+							return;
+						}
+						while (!ready.empty() && taken.size() < options.batch)
+						{
+							taken.push_back(ready.front());
+							ready.pop_front();
+						}
+					}
+
+					for (uint32_t slot : taken)
+					{
+						write(requests[slot]);
+						complete(slot);
+					}
+					taken.clear();
+				}
+			}
+
+			void write(Request& r)
+			{
+				int fd = ::open(r.path.c_str(), openFlags | O_CLOEXEC, openMode);
+				if (fd < 0)
+				{
+					r.error = errno;
+					return;
+				}
+
+				if (!Core::Util::writev(fd, r.bytes))
+				{
+					r.error = errno ? errno : EIO;
+				}
+				else if (options.sync && ::fsync(fd) != 0)
+				{
+					r.error = errno;
+				}
+
+				if (::close(fd) != 0 && r.error == 0)
+				{
+					r.error = errno;
+				}
+			}
+		};
+
+
+#ifdef PERSIST_URING
+		// the ring is driven with raw syscalls, no liburing. Every save is an
+		// open into a registered file slot linked to the write, an optional
+		// fsync and the close, so a failed step cancels the rest of its chain.
+		class UringEngine : public Persister::Engine
+		{
+		private:
+			enum Stage : uint8_t
+			{
+				OPEN,
+				WRITE,
+				SYNC,
+				CLOSE,
+				// closes a slot whose chain broke after the open
+				CLEANUP
+			};
+
+			static constexpr uint64_t STOP = ~0ull;
+
+			int fd = -1;
+			void* ring = MAP_FAILED;
+			size_t ringSize = 0;
+			void* completions = MAP_FAILED;
+			size_t completionsSize = 0;
+			io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+			size_t sqesSize = 0;
+
+			unsigned* sqHead = nullptr;
+			unsigned* sqTail = nullptr;
+			unsigned* sqArray = nullptr;
+			unsigned sqMask = 0;
+			unsigned* cqHead = nullptr;
+			unsigned* cqTail = nullptr;
+			unsigned cqMask = 0;
+			io_uring_cqe* cqes = nullptr;
+
+			// prepared but not published, published but not submitted
+			unsigned tail = 0;
+			unsigned unsubmitted = 0;
+			size_t batched = 0;
+			std::thread reaper;
+		public:
+			explicit UringEngine(PersistOptions options)
+				:
+				Engine(options) {}
+
+			~UringEngine() override
+			{
+				if (reaper.joinable())
+				{
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						io_uring_sqe* sqe = prepare(IORING_OP_NOP, 0);
+						sqe->user_data = STOP;
+						submit();
+					}
+					reaper.join();
+				}
+
+				if (sqes != MAP_FAILED)
+				{
+					::munmap(sqes, sqesSize);
+				}
+				if (completions != MAP_FAILED && completions != ring)
+				{
+					::munmap(completions, completionsSize);
+				}
+				if (ring != MAP_FAILED)
+				{
+					::munmap(ring, ringSize);
+				}
+				if (fd >= 0)
+				{
+					::close(fd);
+				}
+			}
+
+			bool isUring() const override { return true; }
+
+			// false when the kernel lacks io_uring, registered files or
+			// direct opens, the caller falls back to threads then
+			bool start()
+			{
+				// every chain plus a cleanup close per slot and the stop nop
+				size_t stages = options.sync ? 4 : 3;
+				unsigned entries = 1;
+				while (entries < options.maxInFlight * (stages + 1) + 1)
+				{
+					entries *= 2;
+				}
+
+				io_uring_params params;
+				std::memset(&params, 0, sizeof params);
+				fd = (int)::syscall(__NR_io_uring_setup, entries, &params);
+				if (fd < 0)
+				{
+					return false;
+				}
+
+				ringSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				completionsSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (single)
+				{
+					ringSize = completionsSize = std::max(ringSize, completionsSize);
+				}
+
+				ring = ::mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+				if (ring == MAP_FAILED)
+				{
+					return false;
+				}
+				completions = single ? ring : ::mmap(nullptr, completionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+				if (completions == MAP_FAILED)
+				{
+					return false;
+				}
+				sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+				void* mapped = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+				if (mapped == MAP_FAILED)
+				{
+					return false;
+				}
+				sqes = static_cast<io_uring_sqe*>(mapped);
+
+				uint8_t* sq = static_cast<uint8_t*>(ring);
+				sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+				sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				uint8_t* cq = static_cast<uint8_t*>(completions);
+				cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+				tail = *sqTail;
+
+				// one empty file slot per request
+				std::vector<int> slots(requests.size(), -1);
+				if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES, slots.data(), (unsigned)slots.size()) < 0)
+				{
+					return false;
+				}
+
+				if (!probe())
+				{
+					return false;
+				}
+
+				reaper = std::thread([this] { reap(); });
+				return true;
+			}
+		protected:
+			void enqueue(uint32_t slot) override
+			{
+				Request& r = requests[slot];
+				const Core::Slice& bytes = r.bytes.finish().front();
+				r.pending = options.sync ? 4 : 3;
+
+				io_uring_sqe* sqe = prepare(IORING_OP_OPENAT, tag(slot, OPEN));
+				sqe->fd = AT_FDCWD;
+				sqe->addr = reinterpret_cast<uint64_t>(r.path.c_str());
+				sqe->len = openMode;
+				sqe->open_flags = openFlags;
+				sqe->file_index = slot + 1;
+				sqe->flags = IOSQE_IO_LINK;
+
+				sqe = prepare(IORING_OP_WRITE, tag(slot, WRITE));
+				sqe->fd = (int)slot;
+				sqe->addr = reinterpret_cast<uint64_t>(bytes.data);
+				sqe->len = (uint32_t)bytes.length;
+				sqe->off = 0;
+				sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+
+				if (options.sync)
+				{
+					sqe = prepare(IORING_OP_FSYNC, tag(slot, SYNC));
+					sqe->fd = (int)slot;
+					sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+				}
+
+				sqe = prepare(IORING_OP_CLOSE, tag(slot, CLOSE));
+				sqe->file_index = slot + 1;
+
+				if (++batched >= options.batch)
+				{
+					flushLocked();
+				}
+			}
+
+			void flushLocked() override
+			{
+				submit();
+				batched = 0;
+			}
+		private:
+			static uint64_t tag(uint32_t slot, Stage stage) { return ((uint64_t)slot << 8) | stage; }
+
+			io_uring_sqe* prepare(uint8_t opcode, uint64_t data)
+			{
+				unsigned index = tail & sqMask;
+				io_uring_sqe* sqe = &sqes[index];
+				std::memset(sqe, 0, sizeof *sqe);
+				sqe->opcode = opcode;
+				sqe->user_data = data;
+				sqArray[index] = index;
+				tail++;
+				unsubmitted++;
+				return sqe;
+			}
+
+			void submit()
+			{
+				__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+				while (unsubmitted > 0)
+				{
+					int n = (int)::syscall(__NR_io_uring_enter, fd, unsubmitted, 0, 0, nullptr, 0);
+					if (n < 0)
+					{
+						if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+						{
+							continue;
+						}
+						return;
+					}
+					unsubmitted -= (unsigned)n;
+				}
+			}
+
+			// a direct open and close of /dev/null before anything depends on it
+			bool probe()
+			{
+				io_uring_sqe* sqe = prepare(IORING_OP_OPENAT, 0);
+				sqe->fd = AT_FDCWD;
+				sqe->addr = reinterpret_cast<uint64_t>("/dev/null");
+				sqe->open_flags = O_WRONLY;
+				sqe->file_index = 1;
+				sqe->flags = IOSQE_IO_LINK;
+				prepare(IORING_OP_CLOSE, 1)->file_index = 1;
+
+				__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+				int n;
+				do
+				{
+					n = (int)::syscall(__NR_io_uring_enter, fd, 2, 2, IORING_ENTER_GETEVENTS, nullptr, 0);
+				}
+				while (n < 0 && errno == EINTR);
+				unsubmitted = 0;
+
+				bool ok = n == 2;
+				unsigned head = *cqHead;
+				unsigned end = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+				for (; head != end; head++)
+				{
+					ok &= cqes[head & cqMask].res >= 0;
+				}
+				__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+				return ok;
+			}
+
+			void reap()
+			{
+				std::vector<uint32_t> finished;
+				bool stop = false;
+				while (!stop)
+				{
+					int n = (int)::syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+					if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+					{
+						return;
+					}
+
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						unsigned head = *cqHead;
+						unsigned end = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+						for (; head != end; head++)
+						{
+							const io_uring_cqe& cqe = cqes[head & cqMask];
+							if (cqe.user_data == STOP)
+							{
+								stop = true;
+								continue;
+							}
+							handle((uint32_t)(cqe.user_data >> 8), static_cast<Stage>(cqe.user_data & 0xFF), cqe.res, finished);
+						}
+						__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+						// cleanup closes don't wait for a batch
+						submit();
+					}
+
+					for (uint32_t slot : finished)
+					{
+						complete(slot);
+					}
+					finished.clear();
+				}
+			}
+
+			// with the mutex held
+			void handle(uint32_t slot, Stage stage, int res, std::vector<uint32_t>& finished)
+			{
+				Request& r = requests[slot];
+				if (res < 0 && res != -ECANCELED && r.error == 0)
+				{
+					r.error = -res;
+				}
+				if (stage == OPEN && res >= 0)
+				{
+					r.opened = true;
+				}
+				// a short write breaks the chain like an error does
+				if (stage == WRITE && res >= 0 && (size_t)res != r.bytes.getSize() && r.error == 0)
+				{
+					r.error = EIO;
+				}
+				if ((stage == CLOSE || stage == CLEANUP) && res != -ECANCELED)
+				{
+					r.closed = true;
+				}
+
+				if (--r.pending > 0)
+				{
+					return;
+				}
+
+				if (r.opened && !r.closed)
+				{
+					prepare(IORING_OP_CLOSE, tag(slot, CLEANUP))->file_index = slot + 1;
+					r.pending = 1;
+					return;
+				}
+
+				finished.push_back(slot);
+			}
+		};
+#endif
+	}
+
+
+	Persister::Persister(PersistOptions options)
+	{
+		options.maxInFlight = std::min<size_t>(std::max<size_t>(options.maxInFlight, 1), 4096);
+		options.batch = std::max<size_t>(options.batch, 1);
+		options.threads = std::max<size_t>(options.threads, 1);
+
+#ifdef PERSIST_URING
+		if (options.uring)
+		{
+			std::unique_ptr<UringEngine> uring = std::make_unique<UringEngine>(options);
+			if (uring->start())
+			{
+				engine = std::move(uring);
+				return;
+			}
+		}
+#endif
+		engine = std::make_unique<ThreadEngine>(options);
+	}
+
+
+	Persister::~Persister()
+	{
+		engine->wait();
+	}
+
+
+	void Persister::save(Root& root, std::string path, Callback done)
+	{
+		engine->save(root, std::move(path), std::move(done));
+	}
+
+
+	std::future<int> Persister::save(Root& root, std::string path)
+	{
+		std::shared_ptr<std::promise<int>> promise = std::make_shared<std::promise<int>>();
+		std::future<int> result = promise->get_future();
+		engine->save(root, std::move(path), [promise](int error) { promise->set_value(error); });
+		return result;
+	}
+
+
+	void Persister::flush()
+	{
+		engine->flush();
+	}
+
+
+	void Persister::wait()
+	{
+		engine->wait();
+	}
+
+
+	bool Persister::usesUring() const
+	{
+		return engine->isUring();
+	}
+}
+#endif
@@ -0,0 +1,148 @@
+#include "../include/pool.h"
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		// a payload stays with its entity only while nothing else holds it
+		void trim(std::shared_ptr<std::vector<uint8_t>>& data, size_t maxBytes)
+		{
+			if (data && (data.use_count() > 1 || data->capacity() > maxBytes))
+			{
+				data.reset();
+			}
+		}
+
+		template<typename T>
+		void cap(std::vector<T>& nodes, size_t limit)
+		{
+			if (nodes.size() > limit)
+			{
+				nodes.erase(nodes.begin() + limit, nodes.end());
+			}
+		}
+
+		template<typename T, typename Make>
+		Pooled<T> take(std::vector<std::unique_ptr<T>>& free, Make make)
+		{
+			if (free.empty())
+			{
+				return Pooled<T>(make());
+			}
+
+			std::unique_ptr<T> entity = std::move(free.back());
+			free.pop_back();
+			return Pooled<T>(std::move(entity));
+		}
+	}
+
+
+	Pooled<Primitive> EntityPool::primitive()
+	{
+		return take(primitives, []() { return std::unique_ptr<Primitive>(new Primitive()); });
+	}
+
+
+	Pooled<Array> EntityPool::array()
+	{
+		return take(arrays, []() { return std::make_unique<Array>(); });
+	}
+
+
+	Pooled<Object> EntityPool::object()
+	{
+		return take(objects, []() { return std::make_unique<Object>(""); });
+	}
+
+
+	Pooled<Primitive> EntityPool::unpackPrimitive(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		Pooled<Primitive> p = primitive();
+		Primitive::unpack(buffer, it, *p);
+		return p;
+	}
+
+
+	Pooled<Array> EntityPool::unpackArray(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		Pooled<Array> arr = array();
+		Array::unpack(buffer, it, *arr);
+		return arr;
+	}
+
+
+	Pooled<Object> EntityPool::unpackObject(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		Pooled<Object> o = object();
+		Object::unpack(buffer, it, *o, &nodes);
+
+		// a large message once shouldn't pin its children for good
+		cap(nodes.primitives, maxEntities);
+		cap(nodes.arrays, maxEntities);
+		cap(nodes.objects, maxEntities);
+		return o;
+	}
+
+
+	void EntityPool::release(std::unique_ptr<Primitive> p)
+	{
+		if (p == nullptr || primitives.size() >= maxEntities || (size_t)p->getSize() > maxBytes)
+		{
+			return;
+		}
+
+		trim(p->data, maxBytes);
+		primitives.push_back(std::move(p));
+	}
+
+
+	void EntityPool::release(std::unique_ptr<Array> arr)
+	{
+		if (arr == nullptr || arrays.size() >= maxEntities || (size_t)arr->getSize() > maxBytes)
+		{
+			return;
+		}
+
+		trim(arr->data, maxBytes);
+		arrays.push_back(std::move(arr));
+	}
+
+
+	void EntityPool::release(std::unique_ptr<Object> o)
+	{
+		if (o == nullptr || objects.size() >= maxEntities || (size_t)o->getSize() > maxBytes)
+		{
+			return;
+		}
+
+		// the whole subtree, children keep their buffers like pooled entities
+		pending.assign(1, o.get());
+		while (!pending.empty())
+		{
+			Object* node = pending.back();
+			pending.pop_back();
+			for (auto& p : node->primitives) trim(p.data, maxBytes);
+			for (auto& arr : node->arrays) trim(arr.data, maxBytes);
+			for (auto& str : node->strings) trim(str.data, maxBytes);
+			for (auto& child : node->objects) pending.push_back(&child);
+		}
+		objects.push_back(std::move(o));
+	}
+
+
+	void EntityPool::clear()
+	{
+		primitives.clear();
+		arrays.clear();
+		objects.clear();
+		nodes = NodePool();
+	}
+
+
+	EntityPool& EntityPool::local()
+	{
+		thread_local EntityPool pool;
+		return pool;
+	}
+}
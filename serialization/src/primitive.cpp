@@ -7,36 +7,69 @@ namespace ObjectModel
 
 	Primitive::Primitive()
 	{
+		OM_STAT_ADD(PRIMITIVES_CREATED, 1);
 		size += sizeof type;
 	}
 
 
 	void Primitive::pack(std::vector<uint8_t>& buffer, int16_t& iterator)
 	{
+		OM_SCOPED_TIMER(PACK, iterator);
 		Core::encode<uint8_t>(buffer, iterator, wrapper);
 		Core::encode<int16_t>(buffer, iterator, nameLength);
 		Core::encode<std::string>(buffer, iterator, name);
 		Core::encode<uint8_t>(buffer, iterator, type);
 		Core::encode<uint8_t>(buffer, iterator, *data);
 		Core::encode<int32_t>(buffer, iterator, size);
-		
+
+		if (isHashed())
+		{
+			Core::encode<uint32_t>(buffer, iterator, getHash());
+		}
+	}
+
+
+	void Primitive::pack(Core::GatherList& out)
+	{
+		OM_SCOPED_TIMER(PACK, out);
+		uint8_t* p = out.reserve(headerSize() + sizeof type + data->size() + trailerSize());
+		p = packHeader(p);
+		*p++ = type;
+		p = std::copy(data->begin(), data->end(), p);
+		packTrailer(p);
 	}
 
 
 	Primitive Primitive::unpack(const std::vector<uint8_t>& buffer, int16_t& it)
 	{
 		Primitive p;
+		unpack(buffer, it, p);
 
-		p.wrapper = Core::decode<uint8_t>(buffer, it);
-		p.nameLength = Core::decode<int16_t>(buffer, it);
-		p.name = Core::decode<std::string>(buffer, it);
-		p.type = Core::decode<uint8_t>(buffer, it);
-		p.data = new std::vector<uint8_t>(getTypeSize((Type)p.type));
-		Core::decode(buffer, it, *p.data);
-		p.size = Core::decode<int32_t>(buffer, it);
+		return p;
+	}
 
 
-		return p;
+	void Primitive::unpack(const std::vector<uint8_t>& buffer, int16_t& it, Primitive& into)
+	{
+		OM_SCOPED_TIMER(UNPACK, it);
+		into.unpackHeader(buffer, it);
+		into.type = Core::decode<uint8_t>(buffer, it);
+
+		// a copy handed out earlier keeps its bytes, only sole owners are reused
+		if (into.data == nullptr || into.data.use_count() > 1)
+		{
+			into.data = std::make_shared<std::vector<uint8_t>>();
+		}
+		size_t bytes = getTypeSize((Type)into.type);
+		if (into.data->capacity() < bytes)
+		{
+			OM_STAT_ADD(ALLOCATIONS, 1);
+			OM_STAT_ADD(BYTES_ALLOCATED, bytes);
+		}
+		into.data->resize(bytes);
+		Core::decode(buffer, it, *into.data);
+
+		into.unpackTrailer(buffer, it);
 	}
 
 
@@ -46,6 +79,15 @@ namespace ObjectModel
 	}
 
 
+	uint32_t Primitive::computeHash() const
+	{
+		uint8_t header[] = { static_cast<uint8_t>(getWrapper()), type };
+		uint32_t crc = Core::crc32c(header, sizeof header);
+		crc = Core::crc32c(name.data(), name.size(), crc);
+		return Core::crc32c(data->data(), data->size(), crc);
+	}
+
+
 	
 
 }
\ No newline at end of file
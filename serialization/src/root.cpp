@@ -0,0 +1,51 @@
+#include "../include/root.h"
+#include "../include/core.h"
+
+
+namespace ObjectModel
+{
+	uint8_t* Root::packHeader(uint8_t* p) const
+	{
+		*p++ = wrapper;
+		Core::store<int16_t>(p, nameLength);
+		p += sizeof nameLength;
+		std::copy(name.begin(), name.end(), p);
+		return p + name.size();
+	}
+
+
+	uint8_t* Root::packTrailer(uint8_t* p) const
+	{
+		Core::store<int32_t>(p, size);
+		p += sizeof size;
+
+		if (isHashed())
+		{
+			Core::store<uint32_t>(p, getHash());
+			p += sizeof(uint32_t);
+		}
+
+		return p;
+	}
+
+
+	void Root::unpackHeader(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		wrapper = Core::decode<uint8_t>(buffer, it);
+		nameLength = Core::decode<int16_t>(buffer, it);
+		name.assign(reinterpret_cast<const char*>(buffer.data()) + it, nameLength);
+		it += nameLength;
+	}
+
+
+	void Root::unpackTrailer(const std::vector<uint8_t>& buffer, int16_t& it)
+	{
+		size = Core::decode<int32_t>(buffer, it);
+		hash.clear();
+
+		if (isHashed())
+		{
+			hash.set(Core::decode<uint32_t>(buffer, it));
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#include "../include/sparse.h"
+#include "../include/kernels.h"
+
+
+namespace ObjectModel
+{
+	namespace Sparse
+	{
+		bool payloadSize(uint8_t type, int32_t count, const uint8_t* p, size_t available, size_t& bytes)
+		{
+			Type base = static_cast<Type>(type & TYPE_MASK);
+			if (count < 0 || getTypeSize(base) == 0)
+			{
+				return false;
+			}
+
+			if (!isSparse(type))
+			{
+				// size_t so a hostile count can't wrap the int32 storage size
+				bytes = base == Type::BIT ? ((size_t)count + 7) / 8 : (size_t)count * getTypeSize(base);
+				return true;
+			}
+
+			if (base == Type::BIT || available < sizeof(uint32_t))
+			{
+				return false;
+			}
+
+			uint32_t n = nonZero(p);
+			if (n > (uint32_t)count)
+			{
+				return false;
+			}
+
+			bytes = getSparseSize(base, n);
+			return true;
+		}
+
+
+		bool encode(Type type, const uint8_t* dense, int32_t count, std::vector<uint8_t>& out)
+		{
+			size_t width = getTypeSize(type);
+			size_t denseSize = (size_t)count * width;
+			if (count <= 0 || type == Type::BIT || width == 0 || denseSize <= sizeof(uint32_t))
+			{
+				return false;
+			}
+
+			// the most values that still come out strictly smaller
+			size_t limit = (denseSize - sizeof(uint32_t) - 1) / (sizeof(uint32_t) + width);
+
+			thread_local std::vector<uint32_t> found;
+			found.resize(limit + 1);
+			size_t n = Core::Kernels::findNonZero(dense, (size_t)count, width, found.data(), limit);
+			if (n > limit)
+			{
+				return false;
+			}
+
+			out.resize(getSparseSize(type, (uint32_t)n));
+			uint8_t* p = out.data();
+			Core::store<uint32_t>(p, (uint32_t)n);
+			p += sizeof(uint32_t);
+			for (size_t i = 0; i < n; i++)
+			{
+				Core::store<uint32_t>(p + i * sizeof(uint32_t), found[i]);
+			}
+			p += n * sizeof(uint32_t);
+			for (size_t i = 0; i < n; i++)
+			{
+				std::memcpy(p + i * width, dense + (size_t)found[i] * width, width);
+			}
+			return true;
+		}
+
+
+		void expand(Type type, const uint8_t* payload, int32_t count, uint8_t* out)
+		{
+			size_t width = getTypeSize(type);
+			std::memset(out, 0, (size_t)count * width);
+			Core::Kernels::scatter(values(payload), indices(payload), nonZero(payload), width, (size_t)count, out);
+		}
+
+
+		bool find(const uint8_t* payload, uint32_t index, uint32_t& slot)
+		{
+			const uint8_t* at = indices(payload);
+			uint32_t low = 0;
+			uint32_t high = nonZero(payload);
+			while (low < high)
+			{
+				uint32_t middle = low + (high - low) / 2;
+				uint32_t value = Core::load<uint32_t>(at + (size_t)middle * sizeof(uint32_t));
+				if (value == index)
+				{
+					slot = middle;
+					return true;
+				}
+				if (value < index)
+				{
+					low = middle + 1;
+				}
+				else
+				{
+					high = middle;
+				}
+			}
+			return false;
+		}
+	}
+}
@@ -0,0 +1,169 @@
+#include "../include/stats.h"
+#include "../include/gather.h"
+#include <atomic>
+#include <chrono>
+
+
+namespace Core
+{
+	namespace
+	{
+		struct Counters
+		{
+			std::atomic<uint64_t> values[5];
+			std::atomic<uint64_t> bytes[2];
+			std::atomic<uint64_t> calls[2];
+			std::atomic<uint64_t> nanoseconds[2];
+		};
+
+		Counters& counters()
+		{
+			static Counters instance{};
+			return instance;
+		}
+
+		thread_local int depth = 0;
+
+		uint64_t now()
+		{
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		uint64_t read(const std::atomic<uint64_t>& value)
+		{
+			return value.load(std::memory_order_relaxed);
+		}
+	}
+
+
+	Stats getStats()
+	{
+		Counters& c = counters();
+		Stats stats;
+		stats.allocations = read(c.values[(int)Instrumentation::Counter::ALLOCATIONS]);
+		stats.bytesAllocated = read(c.values[(int)Instrumentation::Counter::BYTES_ALLOCATED]);
+		stats.primitivesCreated = read(c.values[(int)Instrumentation::Counter::PRIMITIVES_CREATED]);
+		stats.arraysCreated = read(c.values[(int)Instrumentation::Counter::ARRAYS_CREATED]);
+		stats.objectsCreated = read(c.values[(int)Instrumentation::Counter::OBJECTS_CREATED]);
+		stats.bytesEncoded = read(c.bytes[(int)Instrumentation::Kind::PACK]);
+		stats.bytesDecoded = read(c.bytes[(int)Instrumentation::Kind::UNPACK]);
+		stats.packs = read(c.calls[(int)Instrumentation::Kind::PACK]);
+		stats.unpacks = read(c.calls[(int)Instrumentation::Kind::UNPACK]);
+		stats.packNanoseconds = read(c.nanoseconds[(int)Instrumentation::Kind::PACK]);
+		stats.unpackNanoseconds = read(c.nanoseconds[(int)Instrumentation::Kind::UNPACK]);
+		return stats;
+	}
+
+
+	void resetStats()
+	{
+		Counters& c = counters();
+		for (auto& v : c.values) v.store(0, std::memory_order_relaxed);
+		for (auto& v : c.bytes) v.store(0, std::memory_order_relaxed);
+		for (auto& v : c.calls) v.store(0, std::memory_order_relaxed);
+		for (auto& v : c.nanoseconds) v.store(0, std::memory_order_relaxed);
+	}
+
+
+	void dumpStats(std::ostream& out)
+	{
+		if (!statsEnabled())
+		{
+			out << "serialization stats: disabled (build with SERIALIZATION_STATS)" << std::endl;
+			return;
+		}
+
+		Stats s = getStats();
+		out << "serialization stats:" << std::endl;
+		out << "\t |allocations:" << s.allocations << " (" << s.bytesAllocated << " bytes)" << std::endl;
+		out << "\t |created:" << s.primitivesCreated << " primitives, " << s.arraysCreated << " arrays, " << s.objectsCreated << " objects" << std::endl;
+		out << "\t |pack:" << s.packs << " calls, " << s.bytesEncoded << " bytes, " << s.packNanoseconds / 1000 << " us" << std::endl;
+		out << "\t |unpack:" << s.unpacks << " calls, " << s.bytesDecoded << " bytes, " << s.unpackNanoseconds / 1000 << " us" << std::endl;
+	}
+
+
+	bool statsEnabled()
+	{
+#ifdef SERIALIZATION_STATS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+
+	namespace Instrumentation
+	{
+		void add(Counter counter, uint64_t n)
+		{
+			counters().values[(int)counter].fetch_add(n, std::memory_order_relaxed);
+		}
+
+
+		ScopedTimer::ScopedTimer(Kind kind, const int16_t& iterator)
+			:
+			kind(kind),
+			iterator(&iterator),
+			start((size_t)(uint16_t)iterator),
+			outermost(depth++ == 0)
+		{
+			begin();
+		}
+
+
+		void record(Kind kind, uint64_t bytes)
+		{
+			Counters& c = counters();
+			c.calls[(int)kind].fetch_add(1, std::memory_order_relaxed);
+			c.bytes[(int)kind].fetch_add(bytes, std::memory_order_relaxed);
+		}
+
+
+		ScopedTimer::ScopedTimer(Kind kind, const size_t& offset)
+			:
+			kind(kind),
+			offset(&offset),
+			start(offset),
+			outermost(depth++ == 0)
+		{
+			begin();
+		}
+
+
+		ScopedTimer::ScopedTimer(Kind kind, const GatherList& list)
+			:
+			kind(kind),
+			list(&list),
+			start(list.getSize()),
+			outermost(depth++ == 0)
+		{
+			begin();
+		}
+
+
+		void ScopedTimer::begin()
+		{
+			if (outermost)
+			{
+				began = now();
+			}
+		}
+
+
+		ScopedTimer::~ScopedTimer()
+		{
+			depth--;
+			if (!outermost)
+			{
+				return;
+			}
+
+			size_t end = list ? list->getSize() : offset ? *offset : (size_t)(uint16_t)*iterator;
+			Counters& c = counters();
+			c.nanoseconds[(int)kind].fetch_add(now() - began, std::memory_order_relaxed);
+			c.calls[(int)kind].fetch_add(1, std::memory_order_relaxed);
+			c.bytes[(int)kind].fetch_add(end - start, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,721 @@
+#include "../include/stream.h"
+
+#ifndef _WIN32
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		inline size_t trailerSize(uint8_t wrapper)
+		{
+			return sizeof(int32_t) + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+		}
+
+		bool writeAll(int fd, const uint8_t* bytes, size_t length)
+		{
+			while (length > 0)
+			{
+				ssize_t written = ::write(fd, bytes, length);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return false;
+				}
+				bytes += written;
+				length -= (size_t)written;
+			}
+			return true;
+		}
+	}
+
+
+	ObjectWriter::ObjectWriter(int fd, size_t capacity)
+		:
+		fd(fd),
+		capacity(capacity)
+	{
+		// pwrite takes absolute offsets, the stream may not start at zero
+		off_t at = ::lseek(fd, 0, SEEK_CUR);
+		base = at < 0 ? 0 : (uint64_t)at;
+		buffer.reserve(capacity);
+	}
+
+
+	ObjectWriter::~ObjectWriter()
+	{
+		if (!failed)
+		{
+			flush();
+		}
+	}
+
+
+	bool ObjectWriter::fail()
+	{
+		failed = true;
+		return false;
+	}
+
+
+	bool ObjectWriter::flush()
+	{
+		if (!writeAll(fd, buffer.data(), buffer.size()))
+		{
+			return fail();
+		}
+
+		flushed += buffer.size();
+		buffer.clear();
+		return true;
+	}
+
+
+	bool ObjectWriter::put(const void* bytes, size_t length)
+	{
+		if (buffer.size() + length > capacity && !flush())
+		{
+			return false;
+		}
+
+		// chunks past the buffer size skip the copy
+		if (length >= capacity)
+		{
+			if (!writeAll(fd, static_cast<const uint8_t*>(bytes), length))
+			{
+				return fail();
+			}
+			flushed += length;
+			return true;
+		}
+
+		const uint8_t* p = static_cast<const uint8_t*>(bytes);
+		buffer.insert(buffer.end(), p, p + length);
+		return true;
+	}
+
+
+	bool ObjectWriter::patch(uint64_t at, const void* bytes, size_t length)
+	{
+		if (at >= flushed)
+		{
+			std::memcpy(buffer.data() + (at - flushed), bytes, length);
+			return true;
+		}
+
+		// a count straddling the flush point gets both halves rewritten
+		ssize_t written;
+		do
+		{
+			written = ::pwrite(fd, bytes, length, (off_t)(base + at));
+		} while (written < 0 && errno == EINTR);
+
+		if (written != (ssize_t)length)
+		{
+			return fail();
+		}
+
+		if (at + length > flushed)
+		{
+			size_t tail = (size_t)(at + length - flushed);
+			std::memcpy(buffer.data(), static_cast<const uint8_t*>(bytes) + (length - tail), tail);
+		}
+		return true;
+	}
+
+
+	bool ObjectWriter::header(Wrapper wrapper, std::string_view name)
+	{
+		if (name.size() > INT16_MAX)
+		{
+			return fail();
+		}
+
+		uint8_t bytes[sizeof(uint8_t) + sizeof(int16_t)];
+		bytes[0] = static_cast<uint8_t>(wrapper);
+		Core::store<int16_t>(bytes + 1, (int16_t)name.size());
+		return put(bytes, sizeof bytes) && put(name.data(), name.size());
+	}
+
+
+	// closes sections up to the given one, leaving a zero count for each
+	// section that is opened on the way
+	void ObjectWriter::advance(Frame& frame, int8_t section)
+	{
+		while (frame.section < section)
+		{
+			if (frame.section >= 0)
+			{
+				uint8_t bytes[sizeof(int16_t)];
+				Core::store<int16_t>(bytes, frame.count);
+				patch(frame.countPosition, bytes, sizeof bytes);
+			}
+
+			frame.section++;
+			if (frame.section <= 3)
+			{
+				uint8_t zero[sizeof(int16_t)] = {};
+				frame.countPosition = position();
+				frame.count = 0;
+				put(zero, sizeof zero);
+			}
+		}
+	}
+
+
+	bool ObjectWriter::enter(int8_t section)
+	{
+		if (failed || inArray || stack.empty())
+		{
+			return fail();
+		}
+
+		Frame& frame = stack.back();
+		if (section < frame.section || (section == frame.section && frame.count == INT16_MAX))
+		{
+			return fail();
+		}
+
+		advance(frame, section);
+		frame.count++;
+		return !failed;
+	}
+
+
+	bool ObjectWriter::beginObject(std::string_view name)
+	{
+		if (failed || inArray || (!stack.empty() && !enter(3)))
+		{
+			return fail();
+		}
+
+		stack.push_back(Frame{ position(), 0, -1, 0 });
+		return header(Wrapper::OBJECT, name);
+	}
+
+
+	bool ObjectWriter::endObject()
+	{
+		if (failed || inArray || stack.empty())
+		{
+			return fail();
+		}
+
+		Frame& frame = stack.back();
+		advance(frame, 4);
+
+		uint64_t size = position() + sizeof(int32_t) - frame.start;
+		if (size > INT32_MAX)
+		{
+			return fail();
+		}
+
+		uint8_t bytes[sizeof(int32_t)];
+		Core::store<int32_t>(bytes, (int32_t)size);
+		stack.pop_back();
+		if (stack.empty())
+		{
+			OM_STAT_RECORD(PACK, size);
+		}
+		return put(bytes, sizeof bytes) && !failed;
+	}
+
+
+	bool ObjectWriter::primitive(std::string_view name, Type type, const uint8_t* value)
+	{
+		size_t bytes = getTypeSize(type);
+		if (bytes == 0 || !enter(0))
+		{
+			return fail();
+		}
+
+		uint64_t start = position();
+		uint8_t t = static_cast<uint8_t>(type);
+		if (!header(Wrapper::PRIMITIVE, name) || !put(&t, sizeof t) || !put(value, bytes))
+		{
+			return false;
+		}
+
+		uint8_t size[sizeof(int32_t)];
+		Core::store<int32_t>(size, (int32_t)(position() + sizeof size - start));
+		return put(size, sizeof size);
+	}
+
+
+	bool ObjectWriter::openArray(Wrapper wrapper, std::string_view name, Type type)
+	{
+		if (getTypeSize(type) == 0 || !enter(wrapper == Wrapper::ARRAY ? 1 : 2))
+		{
+			return fail();
+		}
+
+		arrayStart = position();
+		uint8_t t = static_cast<uint8_t>(type);
+		if (!header(wrapper, name) || !put(&t, sizeof t))
+		{
+			return false;
+		}
+
+		// patched by endArray
+		uint8_t zero[sizeof(int32_t)] = {};
+		arrayCountPosition = position();
+		arrayCount = 0;
+		inArray = true;
+		return put(zero, sizeof zero);
+	}
+
+
+	bool ObjectWriter::beginArray(std::string_view name, Type type)
+	{
+		return openArray(Wrapper::ARRAY, name, type);
+	}
+
+
+	bool ObjectWriter::beginString(std::string_view name)
+	{
+		return openArray(Wrapper::STRING, name, Type::I8);
+	}
+
+
+	bool ObjectWriter::append(const uint8_t* bytes, size_t length, int64_t count)
+	{
+		if (failed || !inArray)
+		{
+			return fail();
+		}
+
+		arrayCount += count;
+		return put(bytes, length);
+	}
+
+
+	bool ObjectWriter::endArray()
+	{
+		if (failed || !inArray)
+		{
+			return fail();
+		}
+
+		uint64_t size = position() + sizeof(int32_t) - arrayStart;
+		if (arrayCount > INT32_MAX || size > INT32_MAX)
+		{
+			return fail();
+		}
+
+		uint8_t bytes[sizeof(int32_t)];
+		Core::store<int32_t>(bytes, (int32_t)arrayCount);
+		if (!patch(arrayCountPosition, bytes, sizeof bytes))
+		{
+			return false;
+		}
+
+		inArray = false;
+		Core::store<int32_t>(bytes, (int32_t)size);
+		return put(bytes, sizeof bytes);
+	}
+
+
+	bool ObjectWriter::string(std::string_view name, std::string_view text)
+	{
+		return beginString(name)
+			&& append(reinterpret_cast<const uint8_t*>(text.data()), text.size(), (int64_t)text.size())
+			&& endArray();
+	}
+
+
+	bool ObjectWriter::finish()
+	{
+		return !failed && flush() && stack.empty() && !inArray;
+	}
+
+
+	ObjectReader::ObjectReader(int fd, size_t capacity, DecodeLimits limits)
+		:
+		fd(fd),
+		buffer(std::max<size_t>(capacity, 64 * 1024)),
+		limits(limits) {}
+
+
+	bool ObjectReader::fill(size_t n)
+	{
+		if (end - begin >= n)
+		{
+			return true;
+		}
+
+		if (begin > 0)
+		{
+			std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+			shifted += begin;
+			end -= begin;
+			begin = 0;
+		}
+
+		while (end < n && !eof)
+		{
+			ssize_t got = ::read(fd, buffer.data() + end, buffer.size() - end);
+			if (got < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			// a failed read is not the end of the stream
+			if (got < 0)
+			{
+				error = errno;
+				return false;
+			}
+			if (got == 0)
+			{
+				eof = true;
+				break;
+			}
+			end += (size_t)got;
+		}
+
+		return end >= n;
+	}
+
+
+	ObjectReader::Event ObjectReader::fail(DecodeStatus why)
+	{
+		status = why;
+		return Event::ERROR;
+	}
+
+
+	bool ObjectReader::header(Wrapper expected, size_t fields, size_t& at)
+	{
+		if (!fill(sizeof(uint8_t) + sizeof(int16_t)))
+		{
+			status = DecodeStatus::TRUNCATED;
+			return false;
+		}
+
+		wrapper = buffer[begin];
+		int16_t nameLength = Core::load<int16_t>(buffer.data() + begin + 1);
+		if ((wrapper & WRAPPER_MASK) != static_cast<uint8_t>(expected) || nameLength < 0)
+		{
+			status = DecodeStatus::MALFORMED;
+			return false;
+		}
+
+		at = sizeof(uint8_t) + sizeof(int16_t) + nameLength;
+		if (!fill(at + fields))
+		{
+			status = DecodeStatus::TRUNCATED;
+			return false;
+		}
+		return true;
+	}
+
+
+	ObjectReader::Event ObjectReader::enterObject()
+	{
+		if (stack.size() >= limits.maxDepth)
+		{
+			return fail(DecodeStatus::TOO_DEEP);
+		}
+
+		size_t at;
+		if (!header(Wrapper::OBJECT, 0, at))
+		{
+			return Event::ERROR;
+		}
+
+		uint64_t directory = 0;
+		if (wrapper & static_cast<uint8_t>(Flag::SORTED))
+		{
+			if (!fill(at + sizeof(int32_t)))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+
+			int32_t entries = Core::load<int32_t>(buffer.data() + begin + at);
+			if (entries < 0)
+			{
+				return fail(DecodeStatus::MALFORMED);
+			}
+			directory = getDirectorySize((uint32_t)entries);
+		}
+
+		name = std::string_view(reinterpret_cast<const char*>(buffer.data()) + begin + 3, at - 3);
+		if (stack.empty())
+		{
+			objectStart = shifted + begin;
+		}
+		begin += at;
+		stack.push_back(Frame{ wrapper, -1, 0 });
+
+		if (directory > 0)
+		{
+			// the name has to outlive the reads that drop the directory
+			objectName.assign(name);
+			name = objectName;
+			if (!discard(directory))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+		}
+		return Event::BEGIN_OBJECT;
+	}
+
+
+	bool ObjectReader::discard(uint64_t n)
+	{
+		while (n > 0)
+		{
+			if (end == begin && !fill(1))
+			{
+				return false;
+			}
+
+			size_t chunk = (size_t)std::min<uint64_t>(n, end - begin);
+			begin += chunk;
+			n -= chunk;
+		}
+		return true;
+	}
+
+
+	ObjectReader::Event ObjectReader::next()
+	{
+		data = nullptr;
+		length = 0;
+		name = std::string_view();
+
+		if (status != DecodeStatus::OK || error != 0)
+		{
+			return Event::ERROR;
+		}
+
+		if (inArray && sparse)
+		{
+			return sparseChunk();
+		}
+
+		if (inArray)
+		{
+			if (arrayRemaining > 0)
+			{
+				// whole elements only, BIT and strings go byte by byte
+				size_t unit = getWrapper() == Wrapper::STRING || getType() == Type::BIT ? 1 : getTypeSize(getType());
+				if (!fill(unit))
+				{
+					return fail(DecodeStatus::TRUNCATED);
+				}
+
+				size_t n = (size_t)std::min<uint64_t>(arrayRemaining, end - begin);
+				n -= n % unit;
+				data = buffer.data() + begin;
+				length = n;
+				begin += n;
+				arrayRemaining -= n;
+				return Event::ARRAY_CHUNK;
+			}
+
+			if (!fill(trailerSize(wrapper)))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+			begin += trailerSize(wrapper);
+			inArray = false;
+			return Event::END_ARRAY;
+		}
+
+		// back to back top level objects are read one after the other
+		if (stack.empty())
+		{
+			if (fill(1))
+			{
+				return enterObject();
+			}
+			return error != 0 ? Event::ERROR : Event::END;
+		}
+
+		Frame* frame = &stack.back();
+		while (frame->remaining == 0)
+		{
+			if (frame->section == 3)
+			{
+				wrapper = frame->wrapper;
+				if (!fill(trailerSize(wrapper)))
+				{
+					return fail(DecodeStatus::TRUNCATED);
+				}
+				begin += trailerSize(wrapper);
+				stack.pop_back();
+				if (stack.empty())
+				{
+					OM_STAT_RECORD(UNPACK, shifted + begin - objectStart);
+				}
+				return Event::END_OBJECT;
+			}
+
+			if (!fill(sizeof(int16_t)))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+
+			int16_t n = Core::load<int16_t>(buffer.data() + begin);
+			if (n < 0)
+			{
+				return fail(DecodeStatus::MALFORMED);
+			}
+			begin += sizeof n;
+			frame->section++;
+			frame->remaining = n;
+		}
+
+		frame->remaining--;
+		size_t at;
+		switch (frame->section)
+		{
+		case 0:
+		{
+			if (!header(Wrapper::PRIMITIVE, sizeof type, at))
+			{
+				return Event::ERROR;
+			}
+
+			type = buffer[begin + at];
+			length = getTypeSize(getType());
+			size_t rest = sizeof type + length + trailerSize(wrapper);
+			if (length == 0)
+			{
+				return fail(DecodeStatus::MALFORMED);
+			}
+			if (!fill(at + rest))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+
+			name = std::string_view(reinterpret_cast<const char*>(buffer.data()) + begin + 3, at - 3);
+			data = buffer.data() + begin + at + sizeof type;
+			begin += at + rest;
+			return Event::PRIMITIVE;
+		}
+		case 1:
+		case 2:
+		{
+			if (!header(frame->section == 1 ? Wrapper::ARRAY : Wrapper::STRING, sizeof type + sizeof count, at))
+			{
+				return Event::ERROR;
+			}
+
+			type = buffer[begin + at];
+			count = Core::load<int32_t>(buffer.data() + begin + at + sizeof type);
+			sparse = isSparse(type);
+			type &= TYPE_MASK;
+			if (count < 0 || getTypeSize(getType()) == 0 || (sparse && (frame->section != 1 || getType() == Type::BIT)))
+			{
+				return fail(DecodeStatus::MALFORMED);
+			}
+			indicesRead = false;
+			nextValue = 0;
+			nextElement = 0;
+
+			arrayRemaining = getType() == Type::BIT ? ((uint64_t)count + 7) / 8 : (uint64_t)count * getTypeSize(getType());
+			name = std::string_view(reinterpret_cast<const char*>(buffer.data()) + begin + 3, at - 3);
+			begin += at + sizeof type + sizeof count;
+			inArray = true;
+			return Event::BEGIN_ARRAY;
+		}
+		default:
+			return enterObject();
+		}
+	}
+
+
+	ObjectReader::Event ObjectReader::sparseChunk()
+	{
+		size_t width = getTypeSize(getType());
+		if (!indicesRead)
+		{
+			if (!fill(sizeof(uint32_t)))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+
+			uint32_t n = Core::load<uint32_t>(buffer.data() + begin);
+			begin += sizeof n;
+			if (n > (uint32_t)count)
+			{
+				return fail(DecodeStatus::MALFORMED);
+			}
+
+			// the values follow all of the indices, so those are held until
+			// the last chunk; the object has to stay within maxSize for it
+			uint64_t spanned = shifted + begin - objectStart + getSparseSize(getType(), n) - sizeof n + trailerSize(wrapper);
+			if (spanned > limits.maxSize)
+			{
+				return fail(DecodeStatus::TOO_LARGE);
+			}
+
+			// ascending and in range, so values can be placed as they arrive
+			indices.clear();
+			while (indices.size() < n)
+			{
+				if (!fill(sizeof(uint32_t)))
+				{
+					return fail(DecodeStatus::TRUNCATED);
+				}
+
+				size_t take = std::min<size_t>(n - indices.size(), (end - begin) / sizeof(uint32_t));
+				for (size_t i = 0; i < take; i++)
+				{
+					uint32_t index = Core::load<uint32_t>(buffer.data() + begin + i * sizeof(uint32_t));
+					if (index >= (uint32_t)count || (!indices.empty() && index <= indices.back()))
+					{
+						return fail(DecodeStatus::MALFORMED);
+					}
+					indices.push_back(index);
+				}
+				begin += take * sizeof(uint32_t);
+			}
+			indicesRead = true;
+		}
+
+		if (nextElement == (uint64_t)count)
+		{
+			if (!fill(trailerSize(wrapper)))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+			begin += trailerSize(wrapper);
+			inArray = false;
+			sparse = false;
+			// a long index list isn't kept past its array
+			if (indices.capacity() * sizeof(uint32_t) > buffer.size())
+			{
+				std::vector<uint32_t>().swap(indices);
+			}
+			return Event::END_ARRAY;
+		}
+
+		size_t n = (size_t)std::min<uint64_t>((uint64_t)count - nextElement, std::max<size_t>(1, buffer.size() / width));
+		uint64_t last = nextElement + n;
+		expanded.assign(n * width, 0);
+		for (; nextValue < indices.size() && indices[nextValue] < last; nextValue++)
+		{
+			if (!fill(width))
+			{
+				return fail(DecodeStatus::TRUNCATED);
+			}
+			std::memcpy(expanded.data() + (size_t)(indices[nextValue] - nextElement) * width, buffer.data() + begin, width);
+			begin += width;
+		}
+
+		nextElement = last;
+		data = expanded.data();
+		length = expanded.size();
+		return Event::ARRAY_CHUNK;
+	}
+}
+#endif
@@ -0,0 +1,254 @@
+#include "../include/validate.h"
+#include "../include/kernels.h"
+#include "../include/sparse.h"
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		inline size_t trailerSize(uint8_t wrapper)
+		{
+			return sizeof(int32_t) + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+		}
+
+		constexpr uint8_t flag(Flag f) { return static_cast<uint8_t>(f); }
+	}
+
+
+	Validator& Validator::local()
+	{
+		thread_local Validator validator;
+		return validator;
+	}
+
+
+	DecodeStatus Validator::validate(const uint8_t* buffer, size_t length, size_t& offset, Trusted& out)
+	{
+		out = Trusted();
+		if (offset > length)
+		{
+			return DecodeStatus::TRUNCATED;
+		}
+
+		if (limits.maxDepth == 0)
+		{
+			return DecodeStatus::TOO_DEEP;
+		}
+
+		size_t end = length - offset > limits.maxSize ? offset + limits.maxSize : length;
+		size_t it = offset;
+
+		auto missing = [&](size_t n) { return end - it < n; };
+		auto shortage = [&](size_t n) { return length - it < n ? DecodeStatus::TRUNCATED : DecodeStatus::TOO_LARGE; };
+
+		// flags outside allowed are as malformed as a wrong wrapper
+		auto header = [&](Wrapper expected, uint8_t allowed, size_t fields, uint8_t& wrapper)
+		{
+			if (missing(sizeof(uint8_t) + sizeof(int16_t)))
+			{
+				return shortage(sizeof(uint8_t) + sizeof(int16_t));
+			}
+
+			wrapper = buffer[it];
+			int16_t nameLength = Core::load<int16_t>(buffer + it + 1);
+			if ((wrapper & WRAPPER_MASK) != static_cast<uint8_t>(expected) || (wrapper & ~WRAPPER_MASK & ~allowed) != 0 || nameLength < 0)
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			it += sizeof wrapper + sizeof nameLength;
+			if (missing((size_t)nameLength + fields))
+			{
+				return shortage((size_t)nameLength + fields);
+			}
+			it += nameLength;
+			return DecodeStatus::OK;
+		};
+
+		// the size field has to match the bytes walked since start
+		auto trailer = [&](size_t start, uint8_t wrapper)
+		{
+			if (missing(trailerSize(wrapper)))
+			{
+				return shortage(trailerSize(wrapper));
+			}
+
+			int32_t size = Core::load<int32_t>(buffer + it);
+			it += trailerSize(wrapper);
+			return size >= 0 && (size_t)size == it - start ? DecodeStatus::OK : DecodeStatus::MALFORMED;
+		};
+
+		auto primitive = [&]()
+		{
+			size_t start = it;
+			uint8_t wrapper;
+			DecodeStatus status = header(Wrapper::PRIMITIVE, flag(Flag::HASHED), sizeof(uint8_t), wrapper);
+			if (status != DecodeStatus::OK)
+			{
+				return status;
+			}
+
+			// a sparse bit puts the type past the size table
+			size_t bytes = getTypeSize(static_cast<Type>(buffer[it]));
+			if (bytes == 0)
+			{
+				return DecodeStatus::MALFORMED;
+			}
+			if (missing(sizeof(uint8_t) + bytes))
+			{
+				return shortage(sizeof(uint8_t) + bytes);
+			}
+
+			it += sizeof(uint8_t) + bytes;
+			return trailer(start, wrapper);
+		};
+
+		auto array = [&](Wrapper expected)
+		{
+			size_t start = it;
+			uint8_t wrapper;
+			uint8_t allowed = flag(Flag::HASHED) | (expected == Wrapper::ARRAY ? flag(Flag::EXTERNAL) : 0);
+			DecodeStatus status = header(expected, allowed, sizeof(uint8_t) + sizeof(int32_t), wrapper);
+			if (status != DecodeStatus::OK)
+			{
+				return status;
+			}
+
+			uint8_t type = buffer[it];
+			int32_t count = Core::load<int32_t>(buffer + it + sizeof type);
+			it += sizeof type + sizeof count;
+
+			// readers take a string's count as its byte length
+			Type base = static_cast<Type>(type & TYPE_MASK);
+			if (expected == Wrapper::STRING && (isSparse(type) || base == Type::BIT || getTypeSize(base) != 1))
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			if (isSparse(type) && missing(sizeof(uint32_t)))
+			{
+				return shortage(sizeof(uint32_t));
+			}
+
+			size_t bytes;
+			if (!Sparse::payloadSize(type, count, buffer + it, end - it, bytes))
+			{
+				return DecodeStatus::MALFORMED;
+			}
+			if (missing(bytes))
+			{
+				return shortage(bytes);
+			}
+
+			if (isSparse(type) && !Core::Kernels::isAscending(Sparse::indices(buffer + it), Sparse::nonZero(buffer + it), (uint32_t)count))
+			{
+				return DecodeStatus::MALFORMED;
+			}
+
+			it += bytes;
+			return trailer(start, wrapper);
+		};
+
+		// header and directory, the sections are walked by the loop
+		auto object = [&]()
+		{
+			size_t start = it;
+			uint8_t wrapper;
+			DecodeStatus status = header(Wrapper::OBJECT, flag(Flag::HASHED) | flag(Flag::SORTED), 0, wrapper);
+			if (status != DecodeStatus::OK)
+			{
+				return status;
+			}
+
+			int32_t directory = -1;
+			if (wrapper & flag(Flag::SORTED))
+			{
+				if (missing(sizeof(int32_t)))
+				{
+					return shortage(sizeof(int32_t));
+				}
+
+				directory = Core::load<int32_t>(buffer + it);
+				if (directory < 0)
+				{
+					return DecodeStatus::MALFORMED;
+				}
+				if (missing(getDirectorySize((uint32_t)directory)))
+				{
+					return shortage(getDirectorySize((uint32_t)directory));
+				}
+				it += getDirectorySize((uint32_t)directory);
+			}
+
+			stack.push_back(Frame{ start, wrapper, -1, 0, 0, directory });
+			return DecodeStatus::OK;
+		};
+
+		stack.clear();
+		DecodeStatus status = object();
+		while (status == DecodeStatus::OK && !stack.empty())
+		{
+			Frame& frame = stack.back();
+			if (frame.remaining == 0)
+			{
+				if (frame.section == 3)
+				{
+					if (frame.directory >= 0 && (uint32_t)frame.directory != frame.children)
+					{
+						return DecodeStatus::MALFORMED;
+					}
+
+					status = trailer(frame.start, frame.wrapper);
+					stack.pop_back();
+					continue;
+				}
+
+				if (missing(sizeof(int16_t)))
+				{
+					return shortage(sizeof(int16_t));
+				}
+
+				int16_t count = Core::load<int16_t>(buffer + it);
+				if (count < 0)
+				{
+					return DecodeStatus::MALFORMED;
+				}
+				it += sizeof count;
+
+				frame.section++;
+				frame.remaining = count;
+				frame.children += (uint32_t)count;
+				continue;
+			}
+
+			frame.remaining--;
+			switch (frame.section)
+			{
+			case 0: status = primitive(); break;
+			case 1: status = array(Wrapper::ARRAY); break;
+			case 2: status = array(Wrapper::STRING); break;
+			case 3:
+			{
+				if (stack.size() >= limits.maxDepth)
+				{
+					return DecodeStatus::TOO_DEEP;
+				}
+				// frame is dangling after this, the loop picks up the child
+				status = object();
+				break;
+			}
+			}
+		}
+
+		if (status != DecodeStatus::OK)
+		{
+			return status;
+		}
+
+		out.buffer = buffer + offset;
+		out.length = it - offset;
+		offset = it;
+		return DecodeStatus::OK;
+	}
+}
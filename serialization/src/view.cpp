@@ -0,0 +1,314 @@
+#include "../include/view.h"
+#include <vector>
+
+
+namespace ObjectModel
+{
+	namespace
+	{
+		inline size_t trailerSize(uint8_t wrapper)
+		{
+			return sizeof(int32_t) + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+		}
+	}
+
+
+	bool ArrayView::read(const uint8_t* buffer, size_t length, size_t& offset, ArrayView& out)
+	{
+		size_t it = offset;
+		if (!View::readHeader(buffer, length, it, out.wrapper, out.name))
+		{
+			return false;
+		}
+
+		if (length - it < sizeof out.type + sizeof out.count)
+		{
+			return false;
+		}
+
+		out.type = buffer[it];
+		out.count = Core::load<int32_t>(buffer + it + 1);
+		it += sizeof out.type + sizeof out.count;
+
+		if (out.count < 0)
+		{
+			return false;
+		}
+
+		if ((out.wrapper & WRAPPER_MASK) == static_cast<uint8_t>(Wrapper::STRING))
+		{
+			out.byteSize = (size_t)out.count;
+		}
+		else if (!out.isSparse())
+		{
+			out.byteSize = (size_t)getStorageSize(out.getType(), out.count);
+		}
+		else if (!Sparse::payloadSize(out.type, out.count, buffer + it, length - it, out.byteSize))
+		{
+			return false;
+		}
+
+		if (length - it < out.byteSize + trailerSize(out.wrapper))
+		{
+			return false;
+		}
+
+		out.data = buffer + it;
+		offset = it + out.byteSize + trailerSize(out.wrapper);
+		return true;
+	}
+
+
+	namespace View
+	{
+		namespace
+		{
+			// one entity of an object's section
+			inline bool skipChild(int section, const uint8_t* buffer, size_t length, size_t& offset)
+			{
+				switch (section)
+				{
+				case 0: return skipPrimitive(buffer, length, offset);
+				case 1:
+				case 2: return skipArray(buffer, length, offset);
+				default: return skipObject(buffer, length, offset);
+				}
+			}
+		}
+
+
+		bool readHeader(const uint8_t* buffer, size_t length, size_t& offset, uint8_t& wrapper, std::string_view& name)
+		{
+			if (offset > length || length - offset < sizeof wrapper + sizeof(int16_t))
+			{
+				return false;
+			}
+
+			wrapper = buffer[offset];
+			int16_t nameLength = Core::load<int16_t>(buffer + offset + 1);
+			offset += sizeof wrapper + sizeof nameLength;
+
+			if (nameLength < 0 || length - offset < (size_t)nameLength)
+			{
+				return false;
+			}
+
+			name = std::string_view(reinterpret_cast<const char*>(buffer + offset), nameLength);
+			offset += nameLength;
+			return true;
+		}
+
+
+		bool skipPrimitive(const uint8_t* buffer, size_t length, size_t& offset)
+		{
+			uint8_t wrapper;
+			std::string_view name;
+			if (!readHeader(buffer, length, offset, wrapper, name) || length - offset < 1)
+			{
+				return false;
+			}
+
+			size_t rest = 1 + getTypeSize(static_cast<Type>(buffer[offset])) + trailerSize(wrapper);
+			if (length - offset < rest)
+			{
+				return false;
+			}
+
+			offset += rest;
+			return true;
+		}
+
+
+		bool skipArray(const uint8_t* buffer, size_t length, size_t& offset)
+		{
+			ArrayView view;
+			return ArrayView::read(buffer, length, offset, view);
+		}
+
+
+		bool enterObject(const uint8_t* buffer, size_t length, size_t& offset, std::string_view& name)
+		{
+			uint8_t wrapper;
+			if (!readHeader(buffer, length, offset, wrapper, name) || (wrapper & WRAPPER_MASK) != static_cast<uint8_t>(Wrapper::OBJECT))
+			{
+				return false;
+			}
+
+			if (wrapper & static_cast<uint8_t>(Flag::SORTED))
+			{
+				if (length - offset < sizeof(int32_t))
+				{
+					return false;
+				}
+
+				int32_t count = Core::load<int32_t>(buffer + offset);
+				if (count < 0 || length - offset < getDirectorySize((uint32_t)count))
+				{
+					return false;
+				}
+				offset += getDirectorySize((uint32_t)count);
+			}
+			return true;
+		}
+
+
+		bool findField(const uint8_t* buffer, size_t length, size_t offset, std::string_view key, size_t& field)
+		{
+			size_t start = offset;
+			uint8_t wrapper = offset < length ? buffer[offset] : 0;
+			std::string_view name;
+			if (!enterObject(buffer, length, offset, name))
+			{
+				return false;
+			}
+
+			if (wrapper & static_cast<uint8_t>(Flag::SORTED))
+			{
+				// enterObject checked the directory fits
+				size_t it = start + sizeof wrapper + sizeof(int16_t) + name.size();
+				uint32_t count = Core::load<uint32_t>(buffer + it);
+				const uint8_t* entries = buffer + it + sizeof(int32_t);
+				uint32_t hash = Core::crc32c(key.data(), key.size());
+
+				uint32_t low = 0;
+				uint32_t high = count;
+				while (low < high)
+				{
+					uint32_t middle = low + (high - low) / 2;
+					if (Core::load<uint32_t>(entries + (size_t)middle * 2 * sizeof(uint32_t)) < hash)
+					{
+						low = middle + 1;
+					}
+					else
+					{
+						high = middle;
+					}
+				}
+
+				// the directory could be stale or hostile, the name decides
+				for (; low < count; low++)
+				{
+					const uint8_t* entry = entries + (size_t)low * 2 * sizeof(uint32_t);
+					if (Core::load<uint32_t>(entry) != hash)
+					{
+						return false;
+					}
+
+					size_t at = Core::load<uint32_t>(entry + sizeof(uint32_t));
+					if (at >= length - start)
+					{
+						continue;
+					}
+
+					size_t child = start + at;
+					uint8_t found;
+					if (readHeader(buffer, length, child, found, name) && name == key)
+					{
+						field = start + at;
+						return true;
+					}
+				}
+				return false;
+			}
+
+			for (int section = 0; section < 4; section++)
+			{
+				if (length - offset < sizeof(int16_t))
+				{
+					return false;
+				}
+
+				int16_t n = Core::load<int16_t>(buffer + offset);
+				offset += sizeof n;
+				for (int16_t i = 0; i < n; i++)
+				{
+					size_t child = offset;
+					uint8_t found;
+					if (readHeader(buffer, length, child, found, name) && name == key)
+					{
+						field = offset;
+						return true;
+					}
+					if (!skipChild(section, buffer, length, offset))
+					{
+						return false;
+					}
+				}
+			}
+			return false;
+		}
+
+
+		bool skipObject(const uint8_t* buffer, size_t length, size_t& offset, size_t maxDepth)
+		{
+			struct Frame
+			{
+				uint8_t wrapper;
+				int8_t section;
+				int16_t remaining;
+			};
+
+			// nesting costs heap and not call frames, hostile input can't
+			// run the thread's stack out
+			thread_local std::vector<Frame> stack;
+			stack.clear();
+
+			size_t it = offset;
+			bool enter = true;
+			while (true)
+			{
+				if (enter)
+				{
+					uint8_t wrapper = it < length ? buffer[it] : 0;
+					std::string_view name;
+					if (stack.size() >= maxDepth || !enterObject(buffer, length, it, name))
+					{
+						return false;
+					}
+					stack.push_back(Frame{ wrapper, -1, 0 });
+					enter = false;
+				}
+
+				Frame& frame = stack.back();
+				if (frame.remaining > 0)
+				{
+					frame.remaining--;
+					if (frame.section == 3)
+					{
+						enter = true;
+					}
+					else if (!skipChild(frame.section, buffer, length, it))
+					{
+						return false;
+					}
+					continue;
+				}
+
+				if (frame.section == 3)
+				{
+					if (length - it < trailerSize(frame.wrapper))
+					{
+						return false;
+					}
+
+					it += trailerSize(frame.wrapper);
+					stack.pop_back();
+					if (stack.empty())
+					{
+						offset = it;
+						return true;
+					}
+					continue;
+				}
+
+				if (length - it < sizeof(int16_t))
+				{
+					return false;
+				}
+				frame.remaining = Core::load<int16_t>(buffer + it);
+				frame.section++;
+				it += sizeof(int16_t);
+			}
+		}
+	}
+}
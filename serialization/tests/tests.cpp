@@ -1,6 +1,67 @@
 #include "../include/serialization.h"
 #include <gtest/gtest.h>
 #include "gmock/gmock.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <thread>
+
+#ifdef SERIALIZATION_TOOLS
+#include "../tools/abcdump/dump.h"
+#include "../tools/abcjson/convert.h"
+#include "chain.abc.h"
+#include "json.hh"
+#include "server.h"
+#endif
+
+
+// every heap allocation in the test binary goes through here
+static std::atomic<size_t> allocations{0};
+
+// every form of new takes its memory from malloc, or aligned_alloc when an
+// alignment is asked for, and every form of delete hands it to free
+static void* allocate(size_t n, size_t alignment = 0)
+{
+  allocations++;
+  n = n ? n : 1;
+  if (alignment == 0)
+  {
+    return std::malloc(n);
+  }
+  return std::aligned_alloc(alignment, (n + alignment - 1) / alignment * alignment);
+}
+
+static void* allocateOrThrow(size_t n, size_t alignment = 0)
+{
+  if (void* p = allocate(n, alignment))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t n) { return allocateOrThrow(n); }
+void* operator new[](size_t n) { return allocateOrThrow(n); }
+void* operator new(size_t n, std::align_val_t a) { return allocateOrThrow(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a) { return allocateOrThrow(n, (size_t)a); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return allocate(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return allocate(n); }
+void* operator new(size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate(n, (size_t)a); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
 
 
 using ::testing::StartsWith;
@@ -64,3 +125,2077 @@ TEST(Core, object)
 
 }
 
+
+
+TEST(Core, hash)
+{
+  using namespace ObjectModel;
+
+  EXPECT_EQ(0xE3069283u, Core::crc32c("123456789", 9));
+  EXPECT_EQ(Core::crc32c("123456789", 9), Core::crc32c("6789", 4, Core::crc32c("12345", 5)));
+
+  int32_t foo = 231;
+  std::unique_ptr<Primitive> p = Primitive::create("int32", Type::I32, foo);
+  std::string name = "wndtn";
+  std::unique_ptr<Array> str = Array::createString("String", Type::I8, name);
+
+  Object inner("Inner");
+  inner.addEntity(p.get());
+  inner.addEntity(str.get());
+
+  Object obj("Foo");
+  obj.setHashed(true);
+  obj.addEntity(&inner);
+
+  uint32_t innerHash = obj.objects[0].getHash();
+  uint32_t before = obj.getHash();
+
+  int16_t it = 0;
+  std::vector<uint8_t> buffer(obj.getSize());
+  obj.pack(buffer, it);
+  EXPECT_EQ(obj.getSize(), it);
+
+  int16_t it2 = 0;
+  Object copy = Object::unpack(buffer, it2);
+  EXPECT_TRUE(copy.isHashed());
+  EXPECT_EQ(before, copy.getHash());
+  EXPECT_TRUE(copy.verify());
+  EXPECT_TRUE(Core::Util::equals(&obj, &copy));
+
+  int64_t bar = 1;
+  std::unique_ptr<Primitive> p2 = Primitive::create("int64", Type::I64, bar);
+  obj.addEntity(p2.get());
+  EXPECT_NE(before, obj.getHash());
+  EXPECT_EQ(innerHash, obj.objects[0].getHash());
+  EXPECT_FALSE(Core::Util::equals(&obj, &copy));
+
+  std::string packed(buffer.begin(), buffer.end());
+  buffer[packed.find("wndtn")] = 'W';
+  int16_t it3 = 0;
+  Object corrupted = Object::unpack(buffer, it3);
+  EXPECT_FALSE(corrupted.verify());
+}
+
+
+TEST(Core, compactTypes)
+{
+  using namespace ObjectModel;
+
+  static_assert(getTypeSize(Type::U32) == sizeof(uint32_t), "");
+  static_assert(getTypeSize(Type::F16) == 2, "");
+
+  bool bits[37];
+  for (int i = 0; i < 37; i++) bits[i] = (i % 3) == 0;
+  std::unique_ptr<Array> bitmap = Array::createBitArray("bitmap", bits, 37);
+  EXPECT_EQ(5u, bitmap->getPtrData()->size());
+
+  std::vector<float> values{1.0f, -2.5f, 65504.0f, 0.1f, 1e-7f, 3.14159f, 100.0f, -0.0f, 7.0f};
+  std::unique_ptr<Array> half = Array::createHalfArray("half", Type::F16, values);
+  std::unique_ptr<Array> brain = Array::createHalfArray("brain", Type::BF16, values);
+
+  std::vector<uint16_t> ports{80, 443, 65535};
+  std::unique_ptr<Array> unsigned16 = Array::createArray("ports", Type::U16, ports);
+
+  Object obj("Sensors");
+  obj.addEntity(bitmap.get());
+  obj.addEntity(half.get());
+  obj.addEntity(brain.get());
+  obj.addEntity(unsigned16.get());
+
+  int16_t it = 0;
+  std::vector<uint8_t> buffer(obj.getSize());
+  obj.pack(buffer, it);
+
+  int16_t it2 = 0;
+  Object copy = Object::unpack(buffer, it2);
+  ASSERT_EQ(4u, copy.arrays.size());
+  EXPECT_EQ(obj.getSize(), it2);
+
+  bool unpacked[37];
+  copy.arrays[0].getBits(unpacked);
+  EXPECT_EQ(37, copy.arrays[0].getCount());
+  for (int i = 0; i < 37; i++) EXPECT_EQ(bits[i], unpacked[i]) << i;
+
+  std::vector<float> halves(values.size()), brains(values.size());
+  copy.arrays[1].getFloats(halves.data());
+  copy.arrays[2].getFloats(brains.data());
+  EXPECT_FLOAT_EQ(1.0f, halves[0]);
+  EXPECT_FLOAT_EQ(-2.5f, halves[1]);
+  EXPECT_FLOAT_EQ(65504.0f, halves[2]);
+  EXPECT_NEAR(0.1f, halves[3], 1e-4);
+  EXPECT_NEAR(1e-7f, halves[4], 1e-7);
+  EXPECT_NEAR(3.14159f, brains[5], 0.02);
+  EXPECT_FLOAT_EQ(100.0f, brains[6]);
+
+  int16_t it3 = 0;
+  EXPECT_EQ(65535, Core::decode<uint16_t>(std::vector<uint8_t>(copy.arrays[3].getPtrData()->begin() + 4, copy.arrays[3].getPtrData()->end()), it3));
+  EXPECT_EQ(3, copy.arrays[3].getCount());
+
+  uint16_t h = 0;
+  float one = 1.0f;
+  Core::Kernels::floatToHalf(&one, 1, &h);
+  EXPECT_EQ(0x3C00, h);
+  Core::Kernels::floatToBFloat16(&one, 1, &h);
+  EXPECT_EQ(0x3F80, h);
+}
+
+
+TEST(Core, batch)
+{
+  using namespace ObjectModel;
+
+  std::vector<Object> blocks;
+  for (int32_t i = 0; i < 300; i++)
+  {
+    Object block("block");
+    std::unique_ptr<Primitive> counter = Primitive::create("counter", Type::I32, i);
+    std::unique_ptr<Primitive> difficulty = Primitive::create("difficulty", Type::I64, (int64_t)(i % 4));
+    std::unique_ptr<Array> hash = Array::createString("hash", Type::I8, std::string(i % 7, 'a' + i % 26));
+    block.addEntity(counter.get());
+    block.addEntity(difficulty.get());
+    block.addEntity(hash.get());
+    blocks.push_back(block);
+  }
+
+  std::unique_ptr<Object> batch = Batch::create("chain", blocks);
+  ASSERT_NE(nullptr, batch);
+
+  int16_t it = 0;
+  std::vector<uint8_t> buffer(batch->getSize());
+  batch->pack(buffer, it);
+  EXPECT_EQ(batch->getSize(), it);
+
+  EXPECT_EQ(300, Batch::rows(buffer.data(), buffer.size()));
+
+  ArrayView counters;
+  ASSERT_TRUE(Batch::column(buffer.data(), buffer.size(), "counter", counters));
+  EXPECT_EQ(Type::I32, counters.getType());
+  EXPECT_EQ(299 * 300 / 2, Batch::sum<int32_t>(counters));
+  EXPECT_EQ(42, counters.get<int32_t>(42));
+
+  ArrayView difficulty;
+  ASSERT_TRUE(Batch::column(buffer.data(), buffer.size(), "difficulty", difficulty));
+  std::vector<int32_t> hard;
+  Batch::select<int64_t>(difficulty, [](int64_t d) { return d == 3; }, hard);
+  EXPECT_EQ(75u, hard.size());
+  EXPECT_EQ(3, hard.front());
+
+  ArrayView offsets, hashes;
+  ASSERT_TRUE(Batch::column(buffer.data(), buffer.size(), "hash.offsets", offsets));
+  ASSERT_TRUE(Batch::column(buffer.data(), buffer.size(), "hash", hashes));
+  EXPECT_EQ(Wrapper::STRING, hashes.getWrapper());
+  uint32_t first = offsets.get<uint32_t>(10), last = offsets.get<uint32_t>(11);
+  EXPECT_EQ("kkk", std::string(reinterpret_cast<const char*>(hashes.getData()) + first, last - first));
+
+  ArrayView missing;
+  EXPECT_FALSE(Batch::column(buffer.data(), buffer.size(), "nonce", missing));
+
+  blocks.push_back(Object("odd"));
+  EXPECT_EQ(nullptr, Batch::create("chain", blocks));
+
+  // nesting deep enough to run out a recursive walk's call stack
+  const size_t levels = 300000;
+  const uint8_t level[] = { 0x04, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+  std::vector<uint8_t> deep;
+  deep.reserve(levels * (sizeof level + 4) + 16);
+  for (size_t i = 0; i < levels; i++)
+  {
+    deep.insert(deep.end(), level, level + sizeof level);
+  }
+  const uint8_t innermost[] = { 0x04, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  deep.insert(deep.end(), innermost, innermost + sizeof innermost);
+  for (size_t i = 0; i <= levels; i++)
+  {
+    const uint8_t trailer[] = { 0, 0, 0, 0 };
+    deep.insert(deep.end(), trailer, trailer + sizeof trailer);
+  }
+  size_t offset = 0;
+  EXPECT_TRUE(View::skipObject(deep.data(), deep.size(), offset));
+  EXPECT_EQ(offset, deep.size());
+  offset = 0;
+  EXPECT_FALSE(View::skipObject(deep.data(), deep.size(), offset, 64));
+  EXPECT_EQ(offset, 0u);
+  offset = 0;
+  EXPECT_FALSE(View::skipObject(deep.data(), deep.size() - 1, offset));
+  size_t field;
+  EXPECT_FALSE(View::findField(deep.data(), deep.size(), 0, "missing", field));
+}
+
+
+TEST(Core, gather)
+{
+  using namespace ObjectModel;
+
+  std::vector<int32_t> samples(2000);
+  for (int32_t i = 0; i < 2000; i++) samples[i] = i * 7;
+  std::unique_ptr<Array> big = Array::createArray("samples", Type::I32, samples);
+  std::unique_ptr<Array> small = Array::createString("tag", Type::I8, std::string("abc"));
+  std::unique_ptr<Primitive> p = Primitive::create("int32", Type::I32, 5);
+
+  Object obj("Frame");
+  obj.setHashed(true);
+  obj.addEntity(p.get());
+  obj.addEntity(big.get());
+  obj.addEntity(small.get());
+
+  int16_t it = 0;
+  std::vector<uint8_t> contiguous(obj.getSize());
+  obj.pack(contiguous, it);
+
+  Core::GatherList list;
+  obj.pack(list);
+  const std::vector<Core::Slice>& slices = list.finish();
+
+  EXPECT_EQ(contiguous.size(), list.getSize());
+  EXPECT_LT(list.getScratchSize(), 100u);
+
+  std::vector<uint8_t> flattened;
+  bool referenced = false;
+  for (const Core::Slice& s : slices)
+  {
+    referenced |= s.data == obj.arrays[0].getPtrData()->data();
+    flattened.insert(flattened.end(), s.data, s.data + s.length);
+  }
+  EXPECT_TRUE(referenced);
+  EXPECT_EQ(contiguous, flattened);
+
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  ASSERT_TRUE(Core::Util::writev(fileno(file), list));
+  rewind(file);
+  std::vector<uint8_t> written(contiguous.size() + 1);
+  EXPECT_EQ(contiguous.size(), fread(written.data(), 1, written.size(), file));
+  written.pop_back();
+  EXPECT_EQ(contiguous, written);
+  fclose(file);
+}
+
+
+TEST(Core, reusableContexts)
+{
+  using namespace ObjectModel;
+
+  std::unique_ptr<Primitive> p = Primitive::create("a rather long primitive name", Type::I64, (int64_t)42);
+  std::vector<double> readings{1.5, 2.5, 3.5, 4.5};
+  std::unique_ptr<Array> arr = Array::createArray("readings", Type::DOUBLE, readings);
+  std::unique_ptr<Array> str = Array::createString("note", Type::I8, std::string("a string well past the small buffer"));
+
+  Object inner("inner object with a long name");
+  inner.addEntity(p.get());
+  inner.addEntity(str.get());
+
+  Object request("request");
+  request.addEntity(p.get());
+  request.addEntity(arr.get());
+  request.addEntity(&inner);
+
+  Object small("small");
+  small.addEntity(str.get());
+
+  Encoder encoder;
+  Decoder decoder;
+  std::vector<uint8_t> wire;
+  wire.reserve(4096);
+
+  auto roundTrip = [&](Object& message)
+  {
+    Core::Slice packed = encoder.encode(message);
+    wire.assign(packed.data, packed.data + packed.length);
+    int16_t it = 0;
+    return &decoder.decode(wire, it);
+  };
+
+  for (int i = 0; i < 3; i++)
+  {
+    roundTrip(request);
+    roundTrip(small);
+  }
+
+  size_t before = allocations;
+  Object* decoded = nullptr;
+  for (int i = 0; i < 1000; i++)
+  {
+    roundTrip(small);
+    decoded = roundTrip(request);
+  }
+  EXPECT_EQ(before, allocations.load());
+
+  ASSERT_EQ(1u, decoded->objects.size());
+  EXPECT_EQ("inner object with a long name", decoded->objects[0].getName());
+  EXPECT_EQ(4, decoded->arrays[0].getCount());
+  int16_t it = 0;
+  EXPECT_EQ(42, Core::decode<int64_t>(decoded->primitives[0].getData(), it));
+
+  std::vector<uint8_t> legacy(request.getSize());
+  int16_t it2 = 0;
+  request.pack(legacy, it2);
+  EXPECT_EQ(legacy, wire);
+}
+
+
+TEST(Core, stats)
+{
+  using namespace ObjectModel;
+
+  Core::resetStats();
+
+  std::vector<int32_t> values{1, 2, 3, 4};
+  std::unique_ptr<Array> arr = Array::createArray("values", Type::I32, values);
+  std::unique_ptr<Primitive> p = Primitive::create("int32", Type::I32, 7);
+  Object inner("inner");
+  inner.addEntity(p.get());
+  Object obj("outer");
+  obj.addEntity(arr.get());
+  obj.addEntity(&inner);
+
+  int16_t it = 0;
+  std::vector<uint8_t> buffer(obj.getSize());
+  obj.pack(buffer, it);
+  int16_t it2 = 0;
+  Object copy = Object::unpack(buffer, it2);
+
+  Core::Stats stats = Core::getStats();
+  std::ostringstream dump;
+  Core::dumpStats(dump);
+
+  if (!Core::statsEnabled())
+  {
+    EXPECT_EQ(0u, stats.packs);
+    EXPECT_EQ(0u, stats.allocations);
+    EXPECT_THAT(dump.str(), StartsWith("serialization stats: disabled"));
+    return;
+  }
+
+  EXPECT_EQ(1u, stats.packs);
+  EXPECT_EQ(1u, stats.unpacks);
+  EXPECT_EQ((uint64_t)obj.getSize(), stats.bytesEncoded);
+  EXPECT_EQ((uint64_t)obj.getSize(), stats.bytesDecoded);
+  EXPECT_EQ(2u, stats.primitivesCreated);
+  EXPECT_EQ(2u, stats.arraysCreated);
+  EXPECT_EQ(4u, stats.objectsCreated);
+  EXPECT_EQ(4u, stats.allocations);
+  EXPECT_EQ(2u * (16 + 4), stats.bytesAllocated);
+  EXPECT_THAT(dump.str(), StartsWith("serialization stats:\n"));
+
+  // the other decoders and writers count the same bytes
+  Core::resetStats();
+  size_t offset = 0;
+  Object decoded("");
+  ASSERT_EQ(DecodeStatus::OK, StackDecoder::local().decode(buffer.data(), buffer.size(), offset, decoded));
+  int16_t it3 = 0;
+  Entity entity = Entity::unpack(buffer, it3);
+  std::vector<uint8_t> repacked(entity.getSize());
+  int16_t it4 = 0;
+  entity.pack(repacked, it4);
+  stats = Core::getStats();
+  EXPECT_EQ(2u, stats.unpacks);
+  EXPECT_EQ(2u * obj.getSize(), stats.bytesDecoded);
+  EXPECT_EQ(1u, stats.packs);
+  EXPECT_EQ((uint64_t)obj.getSize(), stats.bytesEncoded);
+
+  Core::resetStats();
+  TypedArray<int32_t> typed("values", values);
+  std::vector<uint8_t> typedBytes(typed.getSize());
+  int16_t it5 = 0;
+  typed.pack(typedBytes, it5);
+  it5 = 0;
+  ASSERT_TRUE(TypedArray<int32_t>::unpack(typedBytes, it5, typed));
+  stats = Core::getStats();
+  EXPECT_EQ(1u, stats.packs);
+  EXPECT_EQ(1u, stats.unpacks);
+  EXPECT_EQ((uint64_t)typedBytes.size(), stats.bytesDecoded);
+
+  Core::resetStats();
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  {
+    ObjectWriter writer(fileno(file));
+    writer.beginObject("outer");
+    writer.primitive<int32_t>("int32", Type::I32, 7);
+    writer.endObject();
+    ASSERT_TRUE(writer.finish());
+  }
+  rewind(file);
+  {
+    ObjectReader reader(fileno(file));
+    while (reader.next() != ObjectReader::Event::END)
+    {
+    }
+  }
+  fclose(file);
+  stats = Core::getStats();
+  EXPECT_EQ(1u, stats.packs);
+  EXPECT_EQ(1u, stats.unpacks);
+  EXPECT_EQ(stats.bytesEncoded, stats.bytesDecoded);
+  EXPECT_GT(stats.bytesDecoded, 0u);
+}
+
+
+TEST(Core, entity)
+{
+  using namespace ObjectModel;
+
+  std::vector<int16_t> data{5, 10, 15, 20};
+
+  Entity foo = Entity::object("Foo");
+  foo.add(Entity::string("String", "wndtn"));
+  foo.add(Entity::primitive("int32", Type::I32, (int32_t)231));
+  foo.add(Entity::array("ArrayOfInt16", Type::I16, data));
+  foo.add(Entity::primitive("int64", Type::I64, (int64_t)1));
+
+  Entity bar = Entity::object("Bar");
+  bar.hashed = true;
+  bar.add(foo);
+
+  std::unique_ptr<Primitive> p = Primitive::create("int32", Type::I32, (int32_t)231);
+  std::unique_ptr<Primitive> p2 = Primitive::create("int64", Type::I64, (int64_t)1);
+  std::unique_ptr<Array> arr = Array::createArray("ArrayOfInt16", Type::I16, data);
+  std::unique_ptr<Array> str = Array::createString("String", Type::I8, std::string("wndtn"));
+  Object obj("Foo");
+  obj.addEntity(p.get());
+  obj.addEntity(p2.get());
+  obj.addEntity(arr.get());
+  obj.addEntity(str.get());
+  Object obj2("Bar");
+  obj2.setHashed(true);
+  obj2.addEntity(&obj);
+
+  ASSERT_EQ(obj2.getSize(), bar.getSize());
+  EXPECT_EQ(obj2.getHash(), bar.getHash());
+
+  int16_t it = 0;
+  std::vector<uint8_t> legacy(obj2.getSize());
+  obj2.pack(legacy, it);
+
+  int16_t it2 = 0;
+  std::vector<uint8_t> packed(bar.getSize());
+  bar.pack(packed, it2);
+  EXPECT_EQ(legacy, packed);
+
+  int16_t it3 = 0;
+  Entity copy = Entity::unpack(legacy, it3);
+  EXPECT_EQ(it, it3);
+  ASSERT_NE(nullptr, copy.find("Foo"));
+  EXPECT_EQ(231, copy.find("Foo")->find("int32")->as<int32_t>());
+  EXPECT_EQ(nullptr, copy.find("Foo")->find("missing"));
+
+  Entity converted;
+  ASSERT_TRUE(Entity::from(obj2, converted));
+  int16_t it4 = 0;
+  std::vector<uint8_t> repacked(converted.getSize());
+  converted.pack(repacked, it4);
+  EXPECT_EQ(legacy, repacked);
+}
+
+
+TEST(Core, stackDecoder)
+{
+  using namespace ObjectModel;
+
+  std::unique_ptr<Primitive> p = Primitive::create("int32", Type::I32, (int32_t)231);
+  std::unique_ptr<Array> arr = Array::createArray("ArrayOfInt16", Type::I16, std::vector<int16_t>{5, 10, 15, 20});
+  std::unique_ptr<Array> str = Array::createString("String", Type::I8, std::string("wndtn"));
+  str->setHashed(true);
+  Object inner("Foo");
+  inner.addEntity(p.get());
+  inner.addEntity(arr.get());
+  inner.addEntity(str.get());
+  Object outer("Bar");
+  outer.setHashed(true);
+  outer.addEntity(p.get());
+  outer.addEntity(&inner);
+
+  int16_t it = 0;
+  std::vector<uint8_t> buffer(outer.getSize());
+  outer.pack(buffer, it);
+
+  StackDecoder decoder;
+  Object result("");
+  size_t offset = 0;
+  ASSERT_EQ(DecodeStatus::OK, decoder.decode(buffer, offset, result));
+  EXPECT_EQ(buffer.size(), offset);
+  EXPECT_TRUE(result.verify());
+  EXPECT_EQ(outer.getHash(), result.getHash());
+
+  int16_t it2 = 0;
+  std::vector<uint8_t> repacked(result.getSize());
+  result.pack(repacked, it2);
+  EXPECT_EQ(buffer, repacked);
+
+  // every cut short prefix fails cleanly and leaves offset alone
+  for (size_t n = 0; n < buffer.size(); n++)
+  {
+    offset = 0;
+    EXPECT_EQ(DecodeStatus::TRUNCATED, decoder.decode(buffer.data(), n, offset, result));
+    EXPECT_EQ(0u, offset);
+  }
+
+  offset = 0;
+  StackDecoder small(DecodeLimits{ 64, buffer.size() - 1 });
+  EXPECT_EQ(DecodeStatus::TOO_LARGE, small.decode(buffer, offset, result));
+
+  std::vector<uint8_t> negative = buffer;
+  negative[3 + 3] = 0xFF;  // primitive count of Bar
+  offset = 0;
+  EXPECT_EQ(DecodeStatus::MALFORMED, decoder.decode(negative, offset, result));
+
+  // far deeper than the recursive unpack could take, and past the int16 iterator
+  const int depth = 20000;
+  std::vector<uint8_t> deep;
+  for (int i = 0; i < depth; i++)
+  {
+    uint8_t level[] = { 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, (uint8_t)(i + 1 < depth) };
+    deep.insert(deep.end(), level, level + sizeof level);
+  }
+  for (int i = 0; i < depth; i++)
+  {
+    uint8_t size[] = { 0, 0, 0, 15 };
+    deep.insert(deep.end(), size, size + sizeof size);
+  }
+
+  offset = 0;
+  EXPECT_EQ(DecodeStatus::TOO_DEEP, decoder.decode(deep, offset, result));
+
+  offset = 0;
+  StackDecoder unbounded(DecodeLimits{ (size_t)depth, SIZE_MAX });
+  ASSERT_EQ(DecodeStatus::OK, unbounded.decode(deep, offset, result));
+  EXPECT_EQ(deep.size(), offset);
+  EXPECT_EQ(1, result.getObjectCount());
+}
+
+
+TEST(Core, stream)
+{
+  using namespace ObjectModel;
+
+  std::unique_ptr<Primitive> p = Primitive::create("int32", Type::I32, (int32_t)231);
+  std::unique_ptr<Array> arr = Array::createArray("ArrayOfInt16", Type::I16, std::vector<int16_t>{5, 10, 15, 20});
+  std::unique_ptr<Array> str = Array::createString("String", Type::I8, std::string("wndtn"));
+  Object inner("inner");
+  inner.addEntity(str.get());
+  Object outer("outer");
+  outer.addEntity(p.get());
+  outer.addEntity(arr.get());
+  outer.addEntity(&inner);
+
+  int16_t it = 0;
+  std::vector<uint8_t> expected(outer.getSize());
+  outer.pack(expected, it);
+
+  // a tiny buffer so most counts are patched after they were flushed
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  {
+    ObjectWriter writer(fileno(file), 8);
+    int16_t firstHalf[] = {5, 10};
+    int16_t secondHalf[] = {15, 20};
+    EXPECT_TRUE(writer.beginObject("outer"));
+    EXPECT_TRUE(writer.primitive("int32", Type::I32, (int32_t)231));
+    EXPECT_TRUE(writer.beginArray("ArrayOfInt16", Type::I16));
+    EXPECT_TRUE(writer.append(firstHalf, 2));
+    EXPECT_TRUE(writer.append(secondHalf, 2));
+    EXPECT_TRUE(writer.endArray());
+    EXPECT_TRUE(writer.beginObject("inner"));
+    EXPECT_TRUE(writer.string("String", "wndtn"));
+    EXPECT_TRUE(writer.endObject());
+    EXPECT_TRUE(writer.endObject());
+    EXPECT_TRUE(writer.finish());
+  }
+
+  rewind(file);
+  std::vector<uint8_t> written(expected.size() + 1);
+  EXPECT_EQ(expected.size(), fread(written.data(), 1, written.size(), file));
+  written.pop_back();
+  EXPECT_EQ(expected, written);
+  fclose(file);
+
+  // out of order entities are refused
+  file = tmpfile();
+  {
+    ObjectWriter writer(fileno(file));
+    EXPECT_TRUE(writer.beginObject("o"));
+    EXPECT_TRUE(writer.string("s", "x"));
+    EXPECT_FALSE(writer.primitive("late", Type::I8, (int8_t)1));
+    EXPECT_FALSE(writer.good());
+  }
+  fclose(file);
+
+  // an array a lot bigger than the reader buffer comes back in chunks
+  const int32_t n = 100000;
+  file = tmpfile();
+  {
+    ObjectWriter writer(fileno(file));
+    writer.beginObject("log");
+    writer.primitive("segment", Type::I32, (int32_t)7);
+    writer.beginArray("values", Type::I32);
+    std::vector<int32_t> chunk(1000);
+    for (int32_t first = 0; first < n; first += 1000)
+    {
+      for (int32_t i = 0; i < 1000; i++) chunk[i] = first + i;
+      writer.append(chunk.data(), chunk.size());
+    }
+    writer.endArray();
+    writer.endObject();
+    EXPECT_TRUE(writer.finish());
+  }
+  rewind(file);
+
+  ObjectReader reader(fileno(file));
+  EXPECT_EQ(ObjectReader::Event::BEGIN_OBJECT, reader.next());
+  EXPECT_EQ("log", reader.getName());
+  ASSERT_EQ(ObjectReader::Event::PRIMITIVE, reader.next());
+  EXPECT_EQ("segment", reader.getName());
+  EXPECT_EQ(7, reader.as<int32_t>());
+  ASSERT_EQ(ObjectReader::Event::BEGIN_ARRAY, reader.next());
+  EXPECT_EQ(n, reader.getCount());
+
+  int chunks = 0;
+  int32_t next = 0;
+  bool ordered = true;
+  ObjectReader::Event event;
+  while ((event = reader.next()) == ObjectReader::Event::ARRAY_CHUNK)
+  {
+    EXPECT_EQ(0u, reader.getLength() % sizeof(int32_t));
+    for (size_t i = 0; i < reader.getLength(); i += sizeof(int32_t))
+    {
+      ordered &= Core::load<int32_t>(reader.getData() + i) == next++;
+    }
+    chunks++;
+  }
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(n, next);
+  EXPECT_GT(chunks, 1);
+  EXPECT_EQ(ObjectReader::Event::END_ARRAY, event);
+  EXPECT_EQ(ObjectReader::Event::END_OBJECT, reader.next());
+  EXPECT_EQ(ObjectReader::Event::END, reader.next());
+  EXPECT_EQ(DecodeStatus::OK, reader.getStatus());
+  EXPECT_EQ(0, reader.getError());
+  fclose(file);
+
+  // a read that fails at a root boundary isn't the end of the stream
+  int pipes[2];
+  ASSERT_EQ(0, pipe(pipes));
+  ObjectReader failing(pipes[1]);
+  EXPECT_EQ(ObjectReader::Event::ERROR, failing.next());
+  EXPECT_EQ(EBADF, failing.getError());
+  EXPECT_EQ(ObjectReader::Event::ERROR, failing.next());
+  close(pipes[0]);
+  close(pipes[1]);
+}
+
+
+TEST(Core, threads)
+{
+  using namespace ObjectModel;
+
+  // every thread builds its own message and runs it through each encoder
+  // and decoder; they also all pack one shared hashed object, whose hash
+  // cache they race to fill
+  auto build = [](int seed)
+  {
+    Object obj("message");
+    obj.setHashed(true);
+    std::unique_ptr<Primitive> id = Primitive::create("id", Type::I64, (int64_t)seed);
+    std::unique_ptr<Array> values = Array::createArray("values", Type::I32, std::vector<int32_t>(seed % 50 + 1, seed));
+    std::unique_ptr<Array> bits = Array::createBitArray("bits", std::vector<bool>(seed % 13 + 1, true));
+    std::unique_ptr<Array> text = Array::createString("text", Type::I8, std::string(seed % 30, 'x'));
+    Object inner("inner");
+    inner.setHashed(true);
+    inner.addEntity(id.get());
+    obj.addEntity(values.get());
+    obj.addEntity(bits.get());
+    obj.addEntity(text.get());
+    obj.addEntity(&inner);
+    return obj;
+  };
+
+  auto packed = [](Object& obj)
+  {
+    std::vector<uint8_t> buffer(obj.getSize());
+    int16_t it = 0;
+    obj.pack(buffer, it);
+    return buffer;
+  };
+
+  Object shared = build(1000);
+  std::vector<uint8_t> sharedBytes = packed(shared);
+  shared.invalidateHash();
+  shared.objects[0].invalidateHash();
+
+  constexpr int threads = 8;
+  constexpr int rounds = 300;
+  std::atomic<int> failures{ 0 };
+  std::vector<std::thread> pool;
+
+  for (int t = 0; t < threads; t++)
+  {
+    pool.emplace_back([&, t]()
+    {
+      for (int i = 0; i < rounds; i++)
+      {
+        int seed = t * rounds + i;
+        Object obj = build(seed);
+        std::vector<uint8_t> bytes = packed(obj);
+
+        Core::Slice slice = Encoder::local().encode(obj);
+        bool ok = std::equal(bytes.begin(), bytes.end(), slice.data) && slice.length == bytes.size();
+
+        int16_t it = 0;
+        Object& decoded = Decoder::local().decode(bytes, it);
+        ok = ok && decoded.verify() && Core::Util::equals(&decoded, &obj);
+
+        // decoding over a copy of the shared object must not reach its payloads
+        Object copy = shared;
+        size_t offset = 0;
+        ok = ok && StackDecoder::local().decode(bytes, offset, copy) == DecodeStatus::OK && Core::Util::equals(&copy, &obj);
+
+        std::vector<uint8_t> sharedAgain(shared.getSize());
+        int16_t it2 = 0;
+        shared.pack(sharedAgain, it2);
+        ok = ok && sharedAgain == sharedBytes;
+
+        failures += ok ? 0 : 1;
+      }
+    });
+  }
+  for (std::thread& thread : pool)
+  {
+    thread.join();
+  }
+
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_EQ(packed(shared), sharedBytes);
+  EXPECT_TRUE(shared.verify());
+}
+
+
+TEST(Core, blob)
+{
+  using namespace ObjectModel;
+
+  char dir[] = "/tmp/blobXXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  std::string side = std::string(dir) + "/side.bin";
+  std::string packed = std::string(dir) + "/packed.abc";
+
+  std::vector<uint8_t> big(100000);
+  for (size_t i = 0; i < big.size(); i++)
+  {
+    big[i] = (uint8_t)(i * 7);
+  }
+  std::vector<uint8_t> small = {1, 2, 3};
+
+  // side file: the second append lands after the first
+  std::unique_ptr<Array> first = Blob::append("first", side, small.data(), small.size());
+  std::unique_ptr<Array> second = Blob::append("second", side, big.data(), big.size());
+  ASSERT_NE(nullptr, first);
+  ASSERT_NE(nullptr, second);
+  EXPECT_EQ(nullptr, Blob::append("x", std::string(dir) + "/missing/side.bin", small.data(), small.size()));
+
+  BlobRef ref;
+  ASSERT_TRUE(Blob::read(*second, ref));
+  EXPECT_EQ(ref.offset, small.size());
+  EXPECT_EQ(ref.length, big.size());
+
+  // container: a root with one inline array, one section blob, one side
+  // blob next to it
+  BlobSection section;
+  std::unique_ptr<Array> inSection = section.add("section", big.data(), big.size());
+  std::unique_ptr<Array> plain = Array::createArray("plain", Type::I32, std::vector<int32_t>{4, 5});
+  BlobRef nextTo = ref;
+  nextTo.path = "side.bin";
+  std::unique_ptr<Array> relative = Blob::create("second", nextTo);
+  Object root("root");
+  root.addEntity(plain.get());
+  root.addEntity(inSection.get());
+  root.addEntity(relative.get());
+  ASSERT_TRUE(section.save(packed, root));
+
+  Container container;
+  Object opened("");
+  ASSERT_TRUE(container.open(packed, opened));
+  ASSERT_EQ(opened.arrays.size(), 3u);
+  EXPECT_FALSE(Blob::is(opened.arrays[0]));
+  EXPECT_FALSE(container.blob(opened.arrays[0]).isValid());
+
+  BlobSpan span = container.blob(opened.arrays[1]);
+  ASSERT_TRUE(span.isValid());
+  EXPECT_FALSE(span.isMapped());
+  EXPECT_EQ(span.size(), big.size());
+  ASSERT_NE(nullptr, span.data());
+  EXPECT_TRUE(span.isMapped());
+  EXPECT_EQ(0, memcmp(span.data(), big.data(), big.size()));
+  EXPECT_TRUE(span.verify());
+
+  BlobSpan fromSide = container.blob(opened.arrays[2]);
+  EXPECT_TRUE(fromSide.verify());
+  EXPECT_EQ(0, memcmp(fromSide.data(), big.data(), big.size()));
+
+  // a container's references stay in its directory
+  BlobRef escape = ref;
+  EXPECT_FALSE(container.blob(escape).isValid());
+  escape.path = std::string("../") + (strrchr(dir, '/') + 1) + "/side.bin";
+  EXPECT_FALSE(container.blob(escape).isValid());
+  escape.path = "sub/../side.bin";
+  EXPECT_FALSE(container.blob(escape).isValid());
+  escape.path = "..";
+  EXPECT_FALSE(container.blob(escape).isValid());
+  EXPECT_TRUE(openBlob(ref).isValid());
+  escape.path = "./side.bin";
+  EXPECT_TRUE(container.blob(escape).isValid());
+
+  // a generic reader still sees a U8 array and the flag survives
+  Core::Slice bytes = Encoder::local().encode(root);
+  size_t offset = 0;
+  std::string_view name;
+  ASSERT_TRUE(View::enterObject(bytes.data, bytes.length, offset, name));
+  offset += 2 * sizeof(int16_t);
+  ArrayView view;
+  ASSERT_TRUE(ArrayView::read(bytes.data, bytes.length, offset, view));
+  ASSERT_TRUE(ArrayView::read(bytes.data, bytes.length, offset, view));
+  EXPECT_EQ(view.getType(), Type::U8);
+  EXPECT_TRUE(view.hasFlag(Flag::EXTERNAL));
+  EXPECT_TRUE(Blob::read(view, ref));
+  EXPECT_EQ(ref.length, big.size());
+
+  // through Entity and back the reference stays a blob
+  Entity converted;
+  ASSERT_TRUE(Entity::from(root, converted));
+  EXPECT_TRUE(std::get<ArrayValue>(converted.find("second")->value).external);
+  EXPECT_FALSE(std::get<ArrayValue>(converted.find("plain")->value).external);
+  std::vector<uint8_t> repacked(converted.getSize());
+  int16_t it = 0;
+  converted.pack(repacked, it);
+  EXPECT_EQ(repacked, std::vector<uint8_t>(bytes.data, bytes.data + bytes.length));
+  it = 0;
+  Entity unpacked = Entity::unpack(repacked, it);
+  EXPECT_TRUE(std::get<ArrayValue>(unpacked.find("second")->value).external);
+  it = 0;
+  Object reopened = Object::unpack(repacked, it);
+  ASSERT_EQ(reopened.arrays.size(), 3u);
+  EXPECT_TRUE(Blob::is(reopened.arrays[2]));
+  EXPECT_TRUE(container.blob(reopened.arrays[2]).verify());
+
+  // corruption is caught by verify, a reference past the end doesn't map
+  FILE* file = fopen(side.c_str(), "r+b");
+  ASSERT_NE(nullptr, file);
+  fseek(file, (long)small.size() + 10, SEEK_SET);
+  fputc(big[10] ^ 0xFF, file);
+  fclose(file);
+  EXPECT_FALSE(container.blob(opened.arrays[2]).verify());
+
+  Blob::read(*second, ref);
+  ref.length += 1;
+  EXPECT_EQ(nullptr, openBlob(ref).data());
+  ref.path = std::string(dir) + "/none.bin";
+  EXPECT_FALSE(openBlob(ref).isValid());
+
+  remove(side.c_str());
+  remove(packed.c_str());
+  rmdir(dir);
+}
+
+
+#ifdef SERIALIZATION_TOOLS
+TEST(Core, jsonConverter)
+{
+  using namespace ObjectModel;
+  using json = nlohmann::json;
+
+  auto convert = [](const std::string& text, std::string& back)
+  {
+    FILE* in = tmpfile();
+    FILE* abc = tmpfile();
+    FILE* out = tmpfile();
+    fwrite(text.data(), 1, text.size(), in);
+    rewind(in);
+
+    Json::Result result = Json::toAbc(in, abc);
+    if (result.ok)
+    {
+      rewind(abc);
+      result = Json::fromAbc(abc, out);
+      back.resize(result.bytesOut);
+      rewind(out);
+      EXPECT_EQ(back.size(), fread(&back[0], 1, back.size(), out));
+    }
+
+    fclose(in);
+    fclose(abc);
+    fclose(out);
+    return result;
+  };
+
+  // the shape BlockChain::serialize writes
+  std::string chain = R"({"length": 2, "data": [
+    {"difficulty": 4, "counter": 0, "minedtime": "2023-01-01 | 12:00:00", "previousHash": "", "hash": "00ab",
+     "nonce": "17", "data": [104, 105, -3]},
+    {"difficulty": 4, "counter": 1, "minedtime": "2023-01-01 | 12:00:05", "previousHash": "00ab", "hash": "00cd",
+     "nonce": "9001", "data": []}],
+    "mixed": [1, 2.5, "three", null, true, [4, 5], {"six": 6}], "big": 18446744073709551615,
+    "escaped": "tab\there \"quoted\" \\ \u0001", "none": null})";
+
+  std::string back;
+  Json::Result result = convert(chain, back);
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(1u, result.objects);
+
+  json expected = json::parse(chain);
+  json actual = json::parse(back);
+  // mixed lists come back grouped by kind, the rest is unchanged
+  EXPECT_EQ(json::parse(R"([1, 2.5, true, null, [4, 5], "three", {"six": 6}])"), actual["mixed"]);
+  expected.erase("mixed");
+  actual.erase("mixed");
+  EXPECT_EQ(expected, actual);
+
+  // a top level array becomes one root object per element
+  std::string stream = R"([{"a": 1}, {"a": 2}, {"a": 3}])";
+  result = convert(stream, back);
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(3u, result.objects);
+  EXPECT_EQ(json::parse(stream), json::parse(back));
+
+  std::string wide = "{";
+  for (int i = 0; i <= INT16_MAX; i++)
+  {
+    wide += (i ? ",\"k" : "\"k") + std::to_string(i) + "\":1";
+  }
+  wide += "}";
+  result = convert(wide, back);
+  EXPECT_FALSE(result.ok);
+  EXPECT_THAT(result.error, StartsWith("more than INT16_MAX primitives"));
+
+  EXPECT_FALSE(convert("[1, 2]", back).ok);
+  EXPECT_FALSE(convert("{\"a\": ", back).ok);
+
+  // numbers no one array type holds exactly stay exact
+  std::string wideRange = R"({"g": [-1, 18446744073709551615], "h": [0.5, 18446744073709551615]})";
+  result = convert(wideRange, back);
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(json::parse(wideRange), json::parse(back));
+
+  // an object key can't be taken for a list
+  result = convert(R"({"g[]": {"a": 1}})", back);
+  EXPECT_FALSE(result.ok);
+  EXPECT_THAT(result.error, StartsWith("key \"g[]\""));
+  result = convert(R"({"g[]": [1, 2], "h[]": 3})", back);
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(json::parse(R"({"g[]": [1, 2], "h[]": 3})"), json::parse(back));
+}
+
+TEST(Core, generated)
+{
+  using namespace ObjectModel;
+
+  chain::Transaction tx{ "alice", "bob", 1000, { 1, 2, 3 } };
+  chain::Block block;
+  block.height = 7;
+  block.time = -1;
+  block.difficulty = 2.5;
+  block.valid = true;
+  block.version = 65535;
+  block.reward = 0.5f;
+  block.hash = std::string(64, 'a');
+  block.nonces = { 1, -2, 3 };
+  block.coinbase = tx;
+  block.transactions = { tx, chain::Transaction{ "bob", "carol", 5, {} } };
+  block.tags = { "x", "" };
+  block.uncles.resize(1);
+  block.uncles[0].height = 6;
+
+  std::vector<uint8_t> buffer(block.getSize());
+  ASSERT_EQ(block.pack(buffer.data()), buffer.data() + buffer.size());
+
+  // the generic decoders read it, and pack it back to the same bytes
+  int16_t it = 0;
+  Entity generic = Entity::unpack(buffer, it);
+  EXPECT_EQ(it, (int16_t)buffer.size());
+  EXPECT_EQ(generic.getSize(), block.getSize());
+  EXPECT_EQ(generic.find("height")->as<int32_t>(), 7);
+  EXPECT_EQ(std::get<ObjectValue>(generic.find("transactions[]")->value).children.size(), 2u);
+  std::vector<uint8_t> repacked(generic.getSize());
+  int16_t it2 = 0;
+  generic.pack(repacked, it2);
+  EXPECT_EQ(repacked, buffer);
+
+  chain::Block copy;
+  size_t offset = 0;
+  ASSERT_TRUE(copy.unpack(buffer, offset));
+  EXPECT_EQ(offset, buffer.size());
+  EXPECT_EQ(copy, block);
+
+  // any order, unknown entities skipped, missing fields reset
+  Entity other = Entity::object("other");
+  other.add(Entity::string("hash", "h"));
+  other.add(Entity::primitive<int64_t>("unknown", Type::I64, 1));
+  other.add(Entity::primitive<int32_t>("height", Type::I32, 9));
+  other.add(Entity::array<int32_t>("nonces", Type::I32, { 4 }));
+  other.add(Entity::object("extra")).add(Entity::primitive<int8_t>("x", Type::I8, 1));
+  std::vector<uint8_t> otherBytes(other.getSize());
+  int16_t it3 = 0;
+  other.pack(otherBytes, it3);
+
+  offset = 0;
+  ASSERT_TRUE(copy.unpack(otherBytes, offset));
+  EXPECT_EQ(copy.height, 9);
+  EXPECT_EQ(copy.hash, "h");
+  EXPECT_EQ(copy.nonces, std::vector<int32_t>{ 4 });
+  EXPECT_EQ(copy.time, 0);
+  EXPECT_TRUE(copy.transactions.empty());
+  EXPECT_EQ(copy.coinbase, chain::Transaction());
+
+  // a field of another type, a cut off buffer
+  Entity wrongType = Entity::object("wrong");
+  wrongType.add(Entity::primitive<int64_t>("height", Type::I64, 9));
+  std::vector<uint8_t> wrongBytes(wrongType.getSize());
+  int16_t it4 = 0;
+  wrongType.pack(wrongBytes, it4);
+  offset = 0;
+  EXPECT_FALSE(copy.unpack(wrongBytes, offset));
+  EXPECT_EQ(offset, 0u);
+
+  for (size_t cut = 0; cut < buffer.size(); cut++)
+  {
+    offset = 0;
+    EXPECT_FALSE(copy.unpack(buffer.data(), cut, offset)) << cut;
+  }
+
+  // nesting past Generated::maxDepth is refused
+  chain::Block deep;
+  for (size_t i = 0; i < Generated::maxDepth; i++)
+  {
+    chain::Block parent;
+    parent.uncles.push_back(std::move(deep));
+    deep = std::move(parent);
+  }
+  std::vector<uint8_t> deepBytes(deep.getSize());
+  deep.pack(deepBytes.data());
+  offset = 0;
+  EXPECT_FALSE(copy.unpack(deepBytes, offset));
+
+  // an unknown field is skipped within the same depth limit
+  Entity unknown = Entity::object("unknown");
+  for (size_t i = 0; i < Generated::maxDepth; i++)
+  {
+    Entity parent = Entity::object("unknown");
+    parent.add(std::move(unknown));
+    unknown = std::move(parent);
+  }
+  Entity skipped = Entity::object("skipped");
+  skipped.add(std::move(unknown));
+  std::vector<uint8_t> skippedBytes(skipped.getSize());
+  int16_t it5 = 0;
+  skipped.pack(skippedBytes, it5);
+  offset = 0;
+  EXPECT_FALSE(copy.unpack(skippedBytes, offset));
+
+  // a list past the int16 count, a payload past the int32 size
+  chain::Block wide;
+  wide.tags.assign(INT16_MAX + 1, "t");
+  EXPECT_EQ(wide.getSize(), -1);
+  std::vector<uint8_t> wideBytes((size_t)(INT16_MAX + 1) * 32);
+  EXPECT_EQ(wide.pack(wideBytes.data()), nullptr);
+  int16_t it6 = 0;
+  EXPECT_FALSE(wide.pack(wideBytes, it6));
+  EXPECT_EQ(it6, 0);
+  wide.tags.pop_back();
+  EXPECT_GT(wide.getSize(), 0);
+  EXPECT_EQ(Generated::objectSize("block", Generated::arraySize("nonces", (size_t)INT32_MAX)), -1);
+  EXPECT_EQ(Generated::objectSize("block", Generated::add(Generated::arraySize("a", INT32_MAX / 2), Generated::arraySize("b", INT32_MAX / 2))), -1);
+  EXPECT_EQ(Generated::objectSize("block", Generated::add(0, -1)), -1);
+}
+
+TEST(Core, dump)
+{
+  using namespace ObjectModel;
+
+  Entity root = Entity::object("root");
+  root.add(Entity::primitive<int32_t>("height", Type::I32, 7));
+  root.add(Entity::array<int16_t>("values", Type::I16, { 1, 2, 3, 4 }));
+  root.add(Entity::string("name", "abc"));
+  Entity& list = root.add(Entity::object("items"));
+  for (int i = 0; i < 5; i++)
+  {
+    list.add(Entity::primitive<int8_t>("item" + std::to_string(i), Type::I8, (int8_t)i));
+  }
+  std::vector<uint8_t> buffer(root.getSize());
+  int16_t it = 0;
+  root.pack(buffer, it);
+
+  auto run = [&](const Dump::Options& options, const std::vector<uint8_t>& bytes, Dump::Result& result)
+  {
+    char* text = nullptr;
+    size_t size = 0;
+    std::FILE* out = open_memstream(&text, &size);
+    result = Dump::dump(bytes.data(), bytes.size(), options, out);
+    std::fclose(out);
+    std::string copy(text, size);
+    std::free(text);
+    return copy;
+  };
+
+  Dump::Options options;
+  options.samples = 2;
+  options.children = 3;
+  Dump::Result result;
+  std::string text = run(options, buffer, result);
+  EXPECT_TRUE(result.ok);
+  EXPECT_EQ(result.roots, 1u);
+  EXPECT_EQ(result.entities[0], 6u);
+  EXPECT_NE(text.find("primitive \"height\" i32 = 7"), std::string::npos) << text;
+  EXPECT_NE(text.find("array \"values\" i16[4] = 1 2 ..."), std::string::npos) << text;
+  EXPECT_NE(text.find("string \"name\" [3] = \"ab\"..."), std::string::npos) << text;
+  EXPECT_NE(text.find("... 2 more primitives"), std::string::npos) << text;
+
+  options.path = "root/items/item4";
+  text = run(options, buffer, result);
+  EXPECT_EQ(result.matches, 1u);
+  EXPECT_NE(text.find("primitive \"item4\" i8 = 4"), std::string::npos) << text;
+  EXPECT_EQ(text.find("height"), std::string::npos) << text;
+
+  // a wrong size field is reported, a cut off file stops the walk
+  std::vector<uint8_t> badSize = buffer;
+  badSize[badSize.size() - 1] ^= 1;
+  run(Dump::Options(), badSize, result);
+  EXPECT_TRUE(result.ok);
+  EXPECT_EQ(result.badSizes, 1u);
+
+  std::vector<uint8_t> cut(buffer.begin(), buffer.end() - 3);
+  run(Dump::Options(), cut, result);
+  EXPECT_FALSE(result.ok);
+  EXPECT_NE(result.error.find("truncated trailer"), std::string::npos) << result.error;
+
+  // a map's values are any entity, maps included
+  std::unique_ptr<Primitive> level = Primitive::create("level", Type::I32, (int32_t)3);
+  Map inner("inner");
+  inner.addEntity(level.get());
+  Object object("object");
+  object.addEntity(level.get());
+  Map map("settings");
+  map.addEntity(level.get());
+  map.addEntity(&inner);
+  map.addEntity(&object);
+  std::vector<uint8_t> packedMap(map.getSize());
+  it = 0;
+  map.pack(packedMap, it);
+  text = run(Dump::Options(), packedMap, result);
+  EXPECT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.entities[4], 2u);
+  EXPECT_EQ(result.badSizes, 0u);
+  EXPECT_NE(text.find("map \"settings\" 3 keys, 8 slots {"), std::string::npos) << text;
+  EXPECT_NE(text.find("primitive \"level\" i32 = 3"), std::string::npos) << text;
+}
+#endif
+
+
+TEST(Core, map)
+{
+  using namespace ObjectModel;
+
+  Map map("settings");
+  for (int32_t i = 0; i < 1000; i++)
+  {
+    std::unique_ptr<Primitive> p = Primitive::create("key" + std::to_string(i), Type::I32, i * 3);
+    EXPECT_TRUE(map.addEntity(p.get()));
+  }
+  std::unique_ptr<Primitive> again = Primitive::create("key7", Type::I32, (int32_t)0);
+  EXPECT_FALSE(map.addEntity(again.get()));
+
+  std::unique_ptr<Array> str = Array::createString("title", Type::I8, std::string("wndtn"));
+  Object object("object");
+  object.addEntity(str.get());
+  Map inner("inner");
+  inner.addEntity(str.get());
+  EXPECT_TRUE(map.addEntity(str.get()));
+  EXPECT_TRUE(map.addEntity(&object));
+  EXPECT_TRUE(map.addEntity(&inner));
+  map.setHashed(true);
+  EXPECT_EQ(map.getCount(), 1003);
+  EXPECT_TRUE(map.contains("key999"));
+  EXPECT_FALSE(map.contains("key1000"));
+
+  // maps don't fit in an object section and are left out
+  Object parent("parent");
+  parent.addEntity(&map);
+  EXPECT_EQ(parent.getSize(), Object("parent").getSize());
+
+  Core::Slice bytes = Encoder::local().encode(map);
+  ASSERT_EQ(bytes.length, (size_t)map.getSize());
+
+  size_t offset = 0;
+  MapView view;
+  ASSERT_TRUE(MapView::read(bytes.data, bytes.length, offset, view));
+  EXPECT_EQ(offset, bytes.length);
+  EXPECT_EQ(view.getName(), "settings");
+  EXPECT_EQ(view.getCount(), 1003u);
+  EXPECT_TRUE(view.isHashed());
+
+  for (int32_t i = 0; i < 1000; i++)
+  {
+    int32_t value = -1;
+    EXPECT_TRUE(view.get("key" + std::to_string(i), Type::I32, value));
+    EXPECT_EQ(value, i * 3);
+  }
+  int32_t value;
+  EXPECT_FALSE(view.get("key1000", Type::I32, value));
+  EXPECT_FALSE(view.get("key1", Type::I64, value));
+  EXPECT_FALSE(view.get("title", Type::I32, value));
+
+  ArrayView text;
+  ASSERT_TRUE(view.get("title", text));
+  EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(text.getData()), text.getByteSize()), "wndtn");
+  MapView nested;
+  ASSERT_TRUE(view.get("inner", nested));
+  ASSERT_TRUE(nested.get("title", text));
+  EXPECT_FALSE(view.get("object", nested));
+
+  size_t at;
+  ASSERT_TRUE(view.find("object", at));
+  std::string_view name;
+  EXPECT_TRUE(View::enterObject(bytes.data, bytes.length, at, name));
+  EXPECT_EQ(name, "object");
+
+  // insertion order
+  std::vector<std::string> keys;
+  EXPECT_TRUE(view.forEach([&](std::string_view key, Wrapper, size_t) { keys.emplace_back(key); }));
+  ASSERT_EQ(keys.size(), 1003u);
+  EXPECT_EQ(keys[0], "key0");
+  EXPECT_EQ(keys[999], "key999");
+  EXPECT_EQ(keys[1002], "inner");
+
+  // the legacy pack writes the same bytes
+  Map small("small");
+  small.addEntity(str.get());
+  small.addEntity(&inner);
+  int16_t it = 0;
+  std::vector<uint8_t> legacy(small.getSize());
+  small.pack(legacy, it);
+  Core::Slice gathered = Encoder::local().encode(small);
+  EXPECT_EQ(legacy, std::vector<uint8_t>(gathered.data, gathered.data + gathered.length));
+
+  // entities hold a map as an object of its values, nested maps included
+  Entity converted;
+  ASSERT_TRUE(Entity::from(small, converted));
+  ASSERT_NE(nullptr, converted.find("inner"));
+  ASSERT_NE(nullptr, converted.find("inner")->find("title"));
+  EXPECT_EQ(std::get<StringValue>(converted.find("inner")->find("title")->value).text, "wndtn");
+  it = 0;
+  Entity unpacked = Entity::unpack(legacy, it);
+  EXPECT_EQ(it, (int16_t)legacy.size());
+  EXPECT_EQ(std::get<ObjectValue>(unpacked.value).children.size(), 2u);
+  EXPECT_EQ(unpacked.find("title")->getWrapper(), Wrapper::STRING);
+
+  // a table pointing at the wrong entity misses instead of misreading,
+  // truncation is refused
+  offset = 0;
+  ASSERT_TRUE(MapView::read(legacy.data(), legacy.size(), offset, view));
+  for (size_t i = 0; i < 4; i++)
+  {
+    legacy[3 + 5 + 12 + i * 8] ^= 0x55;
+  }
+  offset = 0;
+  ASSERT_TRUE(MapView::read(legacy.data(), legacy.size(), offset, view));
+  EXPECT_FALSE(view.get("title", text));
+  offset = 0;
+  EXPECT_FALSE(MapView::read(legacy.data(), legacy.size() - 1, offset, view));
+}
+
+
+TEST(Core, sparse)
+{
+  using namespace ObjectModel;
+
+  // createArray encodes with the int16 iterator, stay below 32k
+  std::vector<int32_t> values(4000);
+  values[3] = 7;
+  values[2048] = -1;
+  values[3999] = 1 << 20;
+  std::unique_ptr<Array> arr = Array::createArray("features", Type::I32, values);
+  EXPECT_TRUE(arr->isSparse());
+  EXPECT_EQ(arr->getType(), Type::I32);
+  EXPECT_EQ(arr->getCount(), 4000);
+  EXPECT_EQ(arr->getPtrData()->size(), getSparseSize(Type::I32, 3));
+
+  std::vector<uint8_t> dense(values.size() * sizeof(int32_t));
+  std::vector<uint8_t> expanded(dense.size());
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    Core::store<int32_t>(dense.data() + i * sizeof(int32_t), values[i]);
+  }
+  arr->getBytes(expanded.data());
+  EXPECT_EQ(dense, expanded);
+
+  // only when strictly smaller, and -0.0 isn't a zero
+  EXPECT_FALSE(Array::createArray("full", Type::I16, std::vector<int16_t>{1, 2, 3, 4})->isSparse());
+  EXPECT_FALSE(Array::createArray("short", Type::I32, std::vector<int32_t>{0, 5})->isSparse());
+  std::unique_ptr<Array> negative = Array::createArray("negative", Type::DOUBLE, std::vector<double>(8, 0.0));
+  EXPECT_EQ(negative->getPtrData()->size(), getSparseSize(Type::DOUBLE, 0));
+  std::vector<double> signs(8, 0.0);
+  signs[5] = -0.0;
+  std::unique_ptr<Array> signed0 = Array::createArray("signed", Type::DOUBLE, signs);
+  ASSERT_TRUE(signed0->isSparse());
+  EXPECT_EQ(Sparse::nonZero(signed0->getPtrData()->data()), 1u);
+
+  // the kernel against a plain scan, every width, a tail and the limit
+  for (size_t width : {1, 2, 4, 8})
+  {
+    std::vector<uint8_t> bytes(width * 101);
+    for (size_t i = 0; i < bytes.size(); i += 13)
+    {
+      bytes[i] = 1;
+    }
+    std::vector<uint32_t> expected;
+    for (size_t e = 0; e < 101; e++)
+    {
+      if (std::any_of(bytes.begin() + e * width, bytes.begin() + (e + 1) * width, [](uint8_t b) { return b != 0; }))
+      {
+        expected.push_back((uint32_t)e);
+      }
+    }
+    std::vector<uint32_t> found(101);
+    found.resize(Core::Kernels::findNonZero(bytes.data(), 101, width, found.data(), 101));
+    EXPECT_EQ(expected, found);
+    EXPECT_EQ(3u, Core::Kernels::findNonZero(bytes.data(), 101, width, found.data(), 2));
+  }
+
+  Object obj("sample");
+  obj.addEntity(arr.get());
+  Core::Slice bytes = Encoder::local().encode(obj);
+  EXPECT_EQ(bytes.length, (size_t)obj.getSize());
+
+  size_t offset = 0;
+  std::string_view name;
+  ASSERT_TRUE(View::enterObject(bytes.data, bytes.length, offset, name));
+  offset += sizeof(int16_t) * 2;
+  ArrayView view;
+  ASSERT_TRUE(ArrayView::read(bytes.data, bytes.length, offset, view));
+  EXPECT_TRUE(view.isSparse());
+  EXPECT_EQ(view.getNonZeroCount(), 3u);
+  bool same = true;
+  for (int32_t i = 0; i < view.getCount(); i++)
+  {
+    same &= view.get<int32_t>(i) == values[i];
+  }
+  EXPECT_TRUE(same);
+  std::vector<int32_t> window(10, -5);
+  view.copyTo<int32_t>(window.data(), 2045, 10);
+  EXPECT_EQ(window, std::vector<int32_t>(values.begin() + 2045, values.begin() + 2055));
+  int32_t sum = 0;
+  view.forEachNonZero<int32_t>([&](uint32_t, int32_t value) { sum += value; });
+  EXPECT_EQ(sum, 6 + (1 << 20));
+
+  // both decoders keep the sparse payload, entities come out dense
+  StackDecoder decoder;
+  Object decoded("");
+  offset = 0;
+  ASSERT_EQ(DecodeStatus::OK, decoder.decode(bytes.data, bytes.length, offset, decoded));
+  ASSERT_TRUE(decoded.arrays[0].isSparse());
+  decoded.arrays[0].getBytes(expanded.data());
+  EXPECT_EQ(dense, expanded);
+
+  std::vector<uint8_t> legacy(bytes.data, bytes.data + bytes.length);
+  int16_t it = 0;
+  Object unpacked = Object::unpack(legacy, it);
+  EXPECT_EQ(*unpacked.arrays[0].getPtrData(), *arr->getPtrData());
+  it = 0;
+  Entity entity = Entity::unpack(legacy, it);
+  EXPECT_EQ(std::get<ArrayValue>(std::get<ObjectValue>(entity.value).children[0].value).data, dense);
+  Entity converted;
+  ASSERT_TRUE(Entity::from(*arr, converted));
+  EXPECT_EQ(std::get<ArrayValue>(converted.value).data, dense);
+
+  // the stream reader hands out dense chunks
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  fwrite(bytes.data, 1, bytes.length, file);
+  rewind(file);
+  {
+    ObjectReader reader(fileno(file), 1024);
+    EXPECT_EQ(ObjectReader::Event::BEGIN_OBJECT, reader.next());
+    ASSERT_EQ(ObjectReader::Event::BEGIN_ARRAY, reader.next());
+    EXPECT_EQ(reader.getType(), Type::I32);
+    std::vector<uint8_t> streamed;
+    ObjectReader::Event event;
+    while ((event = reader.next()) == ObjectReader::Event::ARRAY_CHUNK)
+    {
+      streamed.insert(streamed.end(), reader.getData(), reader.getData() + reader.getLength());
+    }
+    EXPECT_EQ(ObjectReader::Event::END_ARRAY, event);
+    EXPECT_EQ(streamed, dense);
+    EXPECT_EQ(ObjectReader::Event::END_OBJECT, reader.next());
+  }
+  fclose(file);
+
+  // a value count past the dense length is refused, an index past it ignored
+  std::vector<uint8_t> hostile(bytes.data, bytes.data + bytes.length);
+  size_t payload = 3 + name.size() + 2 + 2 + 3 + view.getName().size() + 1 + 4;
+  Core::store<uint32_t>(hostile.data() + payload + 4 + 2 * sizeof(uint32_t), 30000);
+  offset = 0;
+  ASSERT_TRUE(View::enterObject(hostile.data(), hostile.size(), offset, name));
+  offset += sizeof(int16_t) * 2;
+  ASSERT_TRUE(ArrayView::read(hostile.data(), hostile.size(), offset, view));
+  EXPECT_EQ(view.get<int32_t>(2048), -1);
+  EXPECT_EQ(view.get<int32_t>(3999), 0);
+  int stored = 0;
+  view.forEachNonZero<int32_t>([&](uint32_t, int32_t) { stored++; });
+  EXPECT_EQ(stored, 2);
+  Core::store<uint32_t>(hostile.data() + payload, 4001);
+  offset = 0;
+  EXPECT_EQ(DecodeStatus::MALFORMED, decoder.decode(hostile.data(), hostile.size(), offset, decoded));
+
+  // the stream reader holds the index list, so the count is held to maxSize
+  // before any of it is read
+  Core::store<int32_t>(hostile.data() + payload - 4, INT32_MAX);
+  Core::store<uint32_t>(hostile.data() + payload, INT32_MAX);
+  for (size_t maxSize : {(size_t)INT32_MAX, (size_t)32})
+  {
+    std::vector<uint8_t>& input = maxSize == 32 ? legacy : hostile;
+    FILE* limited = tmpfile();
+    ASSERT_NE(nullptr, limited);
+    fwrite(input.data(), 1, input.size(), limited);
+    rewind(limited);
+    DecodeLimits limits;
+    limits.maxSize = maxSize;
+    ObjectReader reader(fileno(limited), 1024, limits);
+    EXPECT_EQ(ObjectReader::Event::BEGIN_OBJECT, reader.next());
+    ASSERT_EQ(ObjectReader::Event::BEGIN_ARRAY, reader.next());
+    EXPECT_EQ(ObjectReader::Event::ERROR, reader.next());
+    EXPECT_EQ(DecodeStatus::TOO_LARGE, reader.getStatus());
+    fclose(limited);
+  }
+
+  arr->densify();
+  EXPECT_FALSE(arr->isSparse());
+  EXPECT_EQ(*arr->getPtrData(), dense);
+
+  // half floats come out of a sparse payload, built or unpacked
+  std::vector<uint16_t> halves(64);
+  halves[10] = 0x3C00;
+  halves[40] = 0xC000;
+  std::vector<float> expected(64, 0.0f);
+  expected[10] = 1.0f;
+  expected[40] = -2.0f;
+  std::unique_ptr<Array> half = Array::createArray("h", Type::F16, halves);
+  ASSERT_TRUE(half->isSparse());
+  std::vector<float> floats(64, 5.0f);
+  half->getFloats(floats.data());
+  EXPECT_EQ(floats, expected);
+
+  Object halfObject("halves");
+  halfObject.addEntity(half.get());
+  std::vector<uint8_t> halfBytes(halfObject.getSize());
+  it = 0;
+  halfObject.pack(halfBytes, it);
+  it = 0;
+  Object halfUnpacked = Object::unpack(halfBytes, it);
+  ASSERT_TRUE(halfUnpacked.arrays[0].isSparse());
+  std::fill(floats.begin(), floats.end(), 5.0f);
+  halfUnpacked.arrays[0].getFloats(floats.data());
+  EXPECT_EQ(floats, expected);
+}
+
+
+TEST(Core, persist)
+{
+  using namespace ObjectModel;
+
+  char dir[] = "/tmp/persistXXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+
+  std::vector<std::unique_ptr<Object>> roots;
+  std::vector<std::unique_ptr<Primitive>> fields;
+  for (int i = 0; i < 20; i++)
+  {
+    roots.push_back(std::make_unique<Object>("root" + std::to_string(i)));
+    fields.push_back(Primitive::create("value", Type::I32, i));
+    roots.back()->addEntity(fields.back().get());
+  }
+
+  // a small in-flight limit and batch so both get exercised
+  for (bool uring : {true, false})
+  {
+    PersistOptions options;
+    options.maxInFlight = 4;
+    options.batch = 3;
+    options.threads = 2;
+    options.uring = uring;
+    options.sync = uring;
+    Persister persister(options);
+    if (!uring)
+    {
+      EXPECT_FALSE(persister.usesUring());
+    }
+
+    std::atomic<int> done{0};
+    std::atomic<int> failed{0};
+    for (size_t i = 0; i < roots.size(); i++)
+    {
+      persister.save(*roots[i], std::string(dir) + "/" + roots[i]->getName() + ".abc", [&](int error)
+      {
+        done++;
+        failed += error != 0;
+      });
+    }
+    std::future<int> missing = persister.save(*roots[0], std::string(dir) + "/missing/x.abc");
+    persister.wait();
+    EXPECT_EQ(done.load(), 20);
+    EXPECT_EQ(failed.load(), 0);
+    EXPECT_EQ(missing.get(), ENOENT);
+
+    for (size_t i = 0; i < roots.size(); i++)
+    {
+      std::string path = std::string(dir) + "/" + roots[i]->getName() + ".abc";
+      Core::Slice expected = Encoder::local().encode(*roots[i]);
+      std::vector<uint8_t> saved = Core::Util::load(path.c_str());
+      ASSERT_EQ(saved.size(), expected.length);
+      EXPECT_EQ(0, memcmp(saved.data(), expected.data, expected.length));
+      remove(path.c_str());
+    }
+  }
+
+  // the destructor waits for what's still queued
+  std::string last = std::string(dir) + "/last.abc";
+  {
+    Persister persister;
+    persister.save(*roots[0], last, nullptr);
+  }
+  EXPECT_EQ(Core::Util::load(last.c_str()).size(), (size_t)roots[0]->getSize());
+  remove(last.c_str());
+  rmdir(dir);
+}
+
+
+TEST(Core, sortedObject)
+{
+  using namespace ObjectModel;
+
+  std::vector<std::unique_ptr<Primitive>> prims;
+  for (int32_t i = 0; i < 50; i++)
+  {
+    prims.push_back(Primitive::create("p" + std::to_string(i), Type::I32, i));
+  }
+  std::unique_ptr<Array> arr = Array::createArray("numbers", Type::I16, std::vector<int16_t>{1, 2, 3});
+  std::unique_ptr<Array> str = Array::createString("title", Type::I8, std::string("sorted"));
+  auto packed = [](Object& obj)
+  {
+    std::vector<uint8_t> buffer(obj.getSize());
+    int16_t it = 0;
+    obj.pack(buffer, it);
+    return buffer;
+  };
+
+  // sorted before or after the adds, in any order, the bytes agree
+  Object inner("inner");
+  inner.addEntity(str.get());
+  inner.setSorted(true);
+  Object a("root");
+  a.setSorted(true);
+  Object b("root");
+  for (size_t i = 0; i < prims.size(); i++)
+  {
+    a.addEntity(prims[i].get());
+    b.addEntity(prims[prims.size() - 1 - i].get());
+  }
+  a.addEntity(arr.get());
+  a.addEntity(str.get());
+  a.addEntity(&inner);
+  b.addEntity(&inner);
+  b.addEntity(str.get());
+  b.addEntity(arr.get());
+  b.setSorted(true);
+  EXPECT_TRUE(a.isSorted());
+  EXPECT_EQ(a.getSize(), b.getSize());
+  EXPECT_EQ(packed(a), packed(b));
+  EXPECT_EQ(a.primitives.front().getName(), "p0");
+
+  Core::Slice bytes = Encoder::local().encode(a);
+  ASSERT_EQ(bytes.length, (size_t)a.getSize());
+  EXPECT_EQ(std::vector<uint8_t>(bytes.data, bytes.data + bytes.length), packed(a));
+
+  // binary search on the raw buffer, plain objects are walked
+  size_t field = 0;
+  for (int32_t i = 0; i < 50; i++)
+  {
+    std::string key = "p" + std::to_string(i);
+    ASSERT_TRUE(View::findField(bytes.data, bytes.length, 0, key, field));
+    EXPECT_EQ(Core::load<int32_t>(bytes.data + field + 3 + key.size() + 1), i);
+  }
+  ASSERT_TRUE(View::findField(bytes.data, bytes.length, 0, "inner", field));
+  size_t nested = 0;
+  EXPECT_TRUE(View::findField(bytes.data, bytes.length, field, "title", nested));
+  EXPECT_FALSE(View::findField(bytes.data, bytes.length, 0, "missing", field));
+
+  Object plain("plain");
+  plain.addEntity(arr.get());
+  plain.addEntity(prims[3].get());
+  std::vector<uint8_t> plainBytes = packed(plain);
+  EXPECT_TRUE(View::findField(plainBytes.data(), plainBytes.size(), 0, "p3", field));
+  EXPECT_FALSE(View::findField(plainBytes.data(), plainBytes.size(), 0, "p4", field));
+
+  // every reader skips the directory
+  size_t offset = 0;
+  EXPECT_TRUE(View::skipObject(bytes.data, bytes.length, offset));
+  EXPECT_EQ(offset, bytes.length);
+
+  std::vector<uint8_t> buffer = packed(a);
+  int16_t it = 0;
+  Object unpacked = Object::unpack(buffer, it);
+  EXPECT_TRUE(unpacked.isSorted());
+  EXPECT_EQ(packed(unpacked), buffer);
+
+  Object decoded("");
+  offset = 0;
+  ASSERT_EQ(StackDecoder::local().decode(bytes.data, bytes.length, offset, decoded), DecodeStatus::OK);
+  EXPECT_EQ(decoded.objects[0].strings.size(), 1u);
+  EXPECT_EQ(packed(decoded), buffer);
+
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  fwrite(bytes.data, 1, bytes.length, file);
+  rewind(file);
+  {
+    // a small buffer so the directory is dropped over several reads
+    ObjectReader reader(fileno(file), 64);
+    ASSERT_EQ(ObjectReader::Event::BEGIN_OBJECT, reader.next());
+    EXPECT_EQ(reader.getName(), "root");
+    int primitives = 0;
+    ObjectReader::Event event;
+    while ((event = reader.next()) != ObjectReader::Event::END && event != ObjectReader::Event::ERROR)
+    {
+      primitives += event == ObjectReader::Event::PRIMITIVE ? 1 : 0;
+    }
+    EXPECT_EQ(reader.getStatus(), DecodeStatus::OK);
+    EXPECT_EQ(primitives, 50);
+  }
+  fclose(file);
+
+  it = 0;
+  Entity entity = Entity::unpack(buffer, it);
+  ASSERT_NE(nullptr, entity.find("p42"));
+  EXPECT_EQ(entity.find("p42")->as<int32_t>(), 42);
+  EXPECT_EQ(it, (int16_t)buffer.size());
+
+  // a hostile directory can only make a lookup miss
+  std::vector<uint8_t> hostile = buffer;
+  size_t directory = 3 + 4 + sizeof(int32_t);
+  for (size_t i = 0; i < 53; i++)
+  {
+    Core::store<uint32_t>(hostile.data() + directory + i * 8 + 4, 0xFFFFFFF0u - (uint32_t)i);
+  }
+  EXPECT_FALSE(View::findField(hostile.data(), hostile.size(), 0, "p7", field));
+  Core::store<int32_t>(hostile.data() + 7, 1 << 30);
+  EXPECT_FALSE(View::findField(hostile.data(), hostile.size(), 0, "p7", field));
+  offset = 0;
+  EXPECT_FALSE(View::skipObject(hostile.data(), hostile.size(), offset));
+}
+
+
+TEST(Core, validate)
+{
+  using namespace ObjectModel;
+
+  std::vector<int32_t> values(200);
+  values[17] = 5;
+  values[150] = -9;
+  std::unique_ptr<Array> sparse = Array::createArray("sparse", Type::I32, values);
+  std::unique_ptr<Array> str = Array::createString("title", Type::I8, std::string("checked"));
+  std::unique_ptr<Primitive> prim = Primitive::create("value", Type::I64, (int64_t)-3);
+  Object inner("inner");
+  inner.setSorted(true);
+  inner.addEntity(str.get());
+  inner.addEntity(prim.get());
+  Object root("root");
+  root.setHashed(true);
+  root.addEntity(prim.get());
+  root.addEntity(sparse.get());
+  root.addEntity(str.get());
+  root.addEntity(&inner);
+  ASSERT_TRUE(sparse->isSparse());
+
+  Core::Slice slice = Encoder::local().encode(root);
+  std::vector<uint8_t> bytes(slice.data, slice.data + slice.length);
+
+  size_t offset = 0;
+  Trusted trusted;
+  ASSERT_EQ(Validator::local().validate(bytes, offset, trusted), DecodeStatus::OK);
+  EXPECT_EQ(offset, bytes.size());
+  EXPECT_EQ(trusted.size(), bytes.size());
+
+  Object fast("");
+  ASSERT_EQ(StackDecoder::local().decode(trusted, fast), DecodeStatus::OK);
+  Core::Slice again = Encoder::local().encode(fast);
+  EXPECT_EQ(std::vector<uint8_t>(again.data, again.data + again.length), bytes);
+  EXPECT_EQ(StackDecoder::local().decode(Trusted(), fast), DecodeStatus::MALFORMED);
+
+  // no prefix passes, and whatever passes after a flipped byte the checked
+  // decoder takes as well
+  for (size_t n = 0; n < bytes.size(); n++)
+  {
+    offset = 0;
+    EXPECT_NE(Validator::local().validate(bytes.data(), n, offset, trusted), DecodeStatus::OK);
+    EXPECT_FALSE(trusted.isValid());
+  }
+  for (size_t i = 0; i < bytes.size(); i++)
+  {
+    for (uint8_t flip : {0x01, 0x80, 0xFF})
+    {
+      std::vector<uint8_t> bad = bytes;
+      bad[i] ^= flip;
+      offset = 0;
+      if (Validator::local().validate(bad, offset, trusted) == DecodeStatus::OK)
+      {
+        Object checked("");
+        size_t at = 0;
+        ASSERT_EQ(StackDecoder::local().decode(bad, at, checked), DecodeStatus::OK) << i;
+        EXPECT_EQ(at, offset);
+        EXPECT_EQ(StackDecoder::local().decode(trusted, fast), DecodeStatus::OK);
+      }
+    }
+  }
+
+  // what the checked decoder lets through but the validator doesn't
+  auto status = [](std::vector<uint8_t> buffer)
+  {
+    size_t at = 0;
+    Trusted out;
+    return Validator::local().validate(buffer, at, out);
+  };
+
+  std::vector<uint8_t> bad = bytes;
+  bad[0] |= 0x40;
+  EXPECT_EQ(status(bad), DecodeStatus::MALFORMED);
+
+  bad = bytes;
+  Core::store<int32_t>(bad.data() + bad.size() - 8, root.getSize() + 1);
+  EXPECT_EQ(status(bad), DecodeStatus::MALFORMED);
+
+  // swap the two sparse indices
+  size_t payload = 3 + 4 + 2 + prim->getSize() + 2 + 3 + 6 + 5 + 4;
+  ASSERT_EQ(Core::load<uint32_t>(bytes.data() + payload), 17u);
+  bad = bytes;
+  Core::store<uint32_t>(bad.data() + payload, 150);
+  Core::store<uint32_t>(bad.data() + payload + 4, 17);
+  EXPECT_EQ(status(bad), DecodeStatus::MALFORMED);
+  size_t at = 0;
+  EXPECT_EQ(StackDecoder::local().decode(bad, at, fast), DecodeStatus::OK);
+
+  Validator shallow(DecodeLimits{ 1, SIZE_MAX });
+  offset = 0;
+  EXPECT_EQ(shallow.validate(bytes, offset, trusted), DecodeStatus::TOO_DEEP);
+  Validator small(DecodeLimits{ 64, 16 });
+  offset = 0;
+  EXPECT_EQ(small.validate(bytes, offset, trusted), DecodeStatus::TOO_LARGE);
+}
+
+
+TEST(Core, pool)
+{
+  using namespace ObjectModel;
+
+  EntityPool& pool = EntityPool::local();
+  pool.clear();
+
+  std::unique_ptr<Primitive> value = Primitive::create("value", Type::I32, (int32_t)42);
+  std::vector<uint8_t> packet(value->getSize());
+  int16_t it = 0;
+  value->pack(packet, it);
+
+  // the same entity and payload come back once released
+  const void* entity;
+  const void* payload;
+  {
+    it = 0;
+    Pooled<Primitive> p = pool.unpackPrimitive(packet, it);
+    EXPECT_EQ(Core::load<int32_t>(p->getPtrData()->data()), 42);
+    entity = p.get();
+    payload = p->getPtrData();
+  }
+  EXPECT_EQ(pool.getPooled(), 1u);
+  {
+    it = 0;
+    Pooled<Primitive> p = pool.unpackPrimitive(packet, it);
+    EXPECT_EQ(p.get(), entity);
+    EXPECT_EQ(p->getPtrData(), payload);
+    EXPECT_EQ(pool.getPooled(), 0u);
+
+    // a payload a copy still holds is let go
+    Primitive copy = *p;
+    p.release();
+    EXPECT_FALSE(p);
+    EXPECT_EQ(pool.getPooled(), 1u);
+    EXPECT_EQ(Core::load<int32_t>(copy.getPtrData()->data()), 42);
+    EXPECT_EQ(pool.primitive()->getPtrData(), nullptr);
+  }
+
+  // objects keep their children and decode over them
+  std::unique_ptr<Array> arr = Array::createArray("numbers", Type::I16, std::vector<int16_t>{1, 2, 3});
+  Object message("message");
+  message.addEntity(value.get());
+  message.addEntity(arr.get());
+  std::vector<uint8_t> bytes(message.getSize());
+  it = 0;
+  message.pack(bytes, it);
+
+  const void* child;
+  {
+    it = 0;
+    Pooled<Object> o = pool.unpackObject(bytes, it);
+    ASSERT_EQ(o->arrays.size(), 1u);
+    child = o->arrays[0].getPtrData();
+  }
+  {
+    it = 0;
+    Pooled<Object> o = pool.unpackObject(bytes, it);
+    EXPECT_EQ(o->arrays[0].getPtrData(), child);
+    std::vector<uint8_t> again(o->getSize());
+    int16_t at = 0;
+    o->pack(again, at);
+    EXPECT_EQ(again, bytes);
+
+    std::unique_ptr<Object> kept = o.detach();
+    EXPECT_FALSE(o);
+  }
+  EXPECT_EQ(pool.getPooled(), 1u);
+
+  // limits, and a handle dropped on another thread feeds that thread's pool
+  EntityPool small(1, 64);
+  small.release(std::make_unique<Array>());
+  small.release(std::make_unique<Array>());
+  EXPECT_EQ(small.getPooled(), 1u);
+  small.release(Array::createString("long", Type::I8, std::string(100, 'x')));
+  EXPECT_EQ(small.getPooled(), 1u);
+
+  size_t before = pool.getPooled();
+  Pooled<Primitive> moved = pool.primitive();
+  std::thread([&]() { moved = Pooled<Primitive>(); }).join();
+  EXPECT_EQ(pool.getPooled(), before - 1);
+  pool.clear();
+}
+
+
+TEST(Core, typed)
+{
+  using namespace ObjectModel;
+
+  auto packed = [](Root& r)
+  {
+    std::vector<uint8_t> buffer(r.getSize());
+    int16_t it = 0;
+    r.pack(buffer, it);
+    return buffer;
+  };
+
+  // the type comes from T, reads go through native values
+  std::unique_ptr<Primitive> p = Primitive::create("value", (int64_t)-3);
+  EXPECT_EQ(p->getType(), Type::I64);
+  int64_t i64 = 0;
+  EXPECT_TRUE(p->get(i64));
+  EXPECT_EQ(i64, -3);
+  int32_t i32 = 0;
+  EXPECT_FALSE(p->get(i32));
+
+  // typed entities write exactly what Primitive and Array write
+  TypedPrimitive<double> d("ratio", 0.25);
+  d.setHashed(true);
+  std::unique_ptr<Primitive> plain = d.toPrimitive();
+  std::vector<uint8_t> bytes(d.getSize()), expected = packed(*plain);
+  int16_t it = 0;
+  d.pack(bytes, it);
+  EXPECT_EQ(bytes, expected);
+  EXPECT_EQ(it, (int16_t)bytes.size());
+
+  TypedPrimitive<double> back;
+  it = 0;
+  ASSERT_TRUE(TypedPrimitive<double>::unpack(bytes, it, back));
+  EXPECT_EQ(back.get(), 0.25);
+  EXPECT_EQ(back.getName(), "ratio");
+  EXPECT_TRUE(back.verify());
+  TypedPrimitive<float> wrong;
+  it = 0;
+  EXPECT_FALSE(TypedPrimitive<float>::unpack(bytes, it, wrong));
+  EXPECT_EQ(it, 0);
+
+  std::vector<uint16_t> values{ 1, 2, 65535, 4 };
+  TypedArray<uint16_t> arr("values", values);
+  std::unique_ptr<Array> dense = Array::createArray("values", values);
+  EXPECT_EQ(dense->getType(), Type::U16);
+  EXPECT_EQ(packed(arr), packed(*dense));
+
+  std::vector<uint16_t> read(values.size());
+  EXPECT_TRUE(dense->get(read.data()));
+  EXPECT_EQ(read, values);
+
+  // a sparse array comes back dense with a matching size
+  std::vector<int32_t> mostlyZero(64);
+  mostlyZero[5] = 7;
+  mostlyZero[60] = -1;
+  std::unique_ptr<Array> sparse = Array::createArray("sparse", mostlyZero);
+  ASSERT_TRUE(sparse->isSparse());
+  bytes = packed(*sparse);
+  TypedArray<int32_t> expanded;
+  it = 0;
+  ASSERT_TRUE(TypedArray<int32_t>::unpack(bytes, it, expanded));
+  EXPECT_EQ(it, (int16_t)bytes.size());
+  EXPECT_EQ(expanded.get(), mostlyZero);
+  EXPECT_EQ(expanded.getSize(), TypedArray<int32_t>("sparse", mostlyZero).getSize());
+  std::vector<int32_t> fromArray(64);
+  EXPECT_TRUE(sparse->get(fromArray.data()));
+  EXPECT_EQ(fromArray, mostlyZero);
+
+  // objects take only the plain classes
+  Object o("o");
+  o.addEntity(&arr);
+  EXPECT_EQ(o.arrays.size(), 0u);
+  std::unique_ptr<Array> converted = arr.toArray();
+  o.addEntity(converted.get());
+  EXPECT_EQ(o.arrays.size(), 1u);
+}
+
+
+TEST(Core, archive)
+{
+  using namespace ObjectModel;
+
+  char dir[] = "/tmp/archiveXXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  std::string path = std::string(dir) + "/roots.abc";
+
+  std::vector<std::unique_ptr<Object>> roots;
+  std::vector<std::unique_ptr<Array>> payloads;
+  size_t total = 0;
+  for (int i = 0; i < 300; i++)
+  {
+    roots.push_back(std::make_unique<Object>("root" + std::to_string(i)));
+    payloads.push_back(Array::createArray("data", std::vector<int32_t>(i + 1, i)));
+    roots.back()->addEntity(payloads.back().get());
+    total += roots.back()->getSize();
+  }
+
+  // one page buffers, so roots straddle them and the tail is padded
+  for (bool direct : {true, false})
+  {
+    ArchiveOptions options;
+    options.bufferSize = 1;
+    options.direct = direct;
+    options.readahead = 4096;
+    {
+      ArchiveWriter writer(options);
+      ASSERT_TRUE(writer.open(path));
+      for (const std::unique_ptr<Object>& root : roots)
+      {
+        ASSERT_TRUE(writer.append(*root));
+      }
+      EXPECT_EQ(writer.size(), total);
+      EXPECT_TRUE(writer.close());
+      if (!direct)
+      {
+        EXPECT_FALSE(writer.isDirect());
+      }
+    }
+    EXPECT_EQ(Core::Util::load(path.c_str()).size(), total);
+
+    ArchiveReader reader(options);
+    ASSERT_TRUE(reader.open(path));
+    Object into("");
+    size_t count = 0;
+    while (reader.next(into))
+    {
+      ASSERT_LT(count, roots.size());
+      EXPECT_EQ(into.getName(), roots[count]->getName());
+      EXPECT_EQ(*into.arrays[0].getPtrData(), *payloads[count]->getPtrData());
+      count++;
+    }
+    EXPECT_EQ(reader.getStatus(), DecodeStatus::OK);
+    EXPECT_EQ(count, roots.size());
+    EXPECT_EQ(reader.consumed(), total);
+  }
+
+  // a file cut inside a root
+  ASSERT_EQ(truncate(path.c_str(), (off_t)total - 3), 0);
+  ArchiveReader reader;
+  ASSERT_TRUE(reader.open(path));
+  Object into("");
+  size_t count = 0;
+  while (reader.next(into))
+  {
+    count++;
+  }
+  EXPECT_EQ(count, roots.size() - 1);
+  EXPECT_EQ(reader.getStatus(), DecodeStatus::TRUNCATED);
+  EXPECT_EQ(reader.getError(), 0);
+
+  // a read that fails isn't a clean end
+  ArchiveReader failing;
+  ASSERT_TRUE(failing.open(dir));
+  EXPECT_FALSE(failing.next(into));
+  EXPECT_EQ(failing.getError(), EISDIR);
+
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+
+#ifdef SERIALIZATION_TOOLS
+TEST(Core, server)
+{
+  // one datagram per syscall and whole batches
+  for (size_t batch : {1u, 32u})
+  {
+    Net::Server server(0, "127.0.0.1");
+    server.setVerbose(false);
+    server.setBatch(batch);
+    ASSERT_TRUE(server.open());
+    std::thread loop([&]() { server.start(); });
+
+    sockaddr_in to{};
+    to.sin_family = AF_INET;
+    to.sin_port = htons((uint16_t)server.getPort());
+    inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval timeout{ 2, 0 };
+    ASSERT_EQ(connect(fd, (const sockaddr*)&to, sizeof to), 0);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+    // text is echoed, a primitive gets the int16 one back
+    char reply[SIZE];
+    ASSERT_EQ(send(fd, "hello", 5, 0), 5);
+    ASSERT_EQ(recv(fd, reply, sizeof reply, 0), 5);
+    EXPECT_EQ(std::string(reply, 5), "hello");
+
+    std::unique_ptr<Primitive> p = Primitive::create("value", (int32_t)7);
+    std::vector<uint8_t> bytes(p->getSize());
+    int16_t it = 0;
+    p->pack(bytes, it);
+    ASSERT_EQ(send(fd, bytes.data(), bytes.size(), 0), (ssize_t)bytes.size());
+    ssize_t got = recv(fd, reply, sizeof reply, 0);
+    ASSERT_GT(got, 0);
+    std::vector<uint8_t> answer(reply, reply + got);
+    it = 0;
+    Primitive back = Primitive::unpack(answer, it);
+    int16_t value = 0;
+    EXPECT_EQ(back.getName(), "int16");
+    EXPECT_TRUE(back.get(value));
+    EXPECT_EQ(value, 75);
+
+    // a burst is drained in one go, every datagram answered in order
+    for (int i = 0; i < 200; i++)
+    {
+      char c = (char)('a' + i % 26);
+      send(fd, &c, 1, 0);
+    }
+    int answered = 0;
+    while (answered < 200 && recv(fd, reply, sizeof reply, 0) == 1)
+    {
+      EXPECT_EQ(reply[0], (char)('a' + answered % 26));
+      answered++;
+    }
+    EXPECT_EQ(answered, 200);
+    EXPECT_EQ(server.getDropped(), 0u);
+
+    server.stop();
+    loop.join();
+    EXPECT_EQ(server.getReceived(), 202u);
+    close(fd);
+  }
+}
+#endif
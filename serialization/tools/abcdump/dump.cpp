@@ -0,0 +1,530 @@
+#include "dump.h"
+#include "../../include/serialization.h"
+#include <string_view>
+#include <vector>
+
+
+namespace ObjectModel
+{
+	namespace Dump
+	{
+		namespace
+		{
+			const char* typeNames[] = { "?", "i8", "i16", "i32", "i64", "float", "double", "bool", "u8", "u16", "u32", "u64", "f16", "bf16", "bit" };
+			const char* wrapperNames[] = { "primitive", "array", "string", "object", "map" };
+
+			inline const char* typeName(uint8_t type)
+			{
+				return type < sizeof typeNames / sizeof *typeNames ? typeNames[type] : "?";
+			}
+
+			inline size_t trailerOf(uint8_t wrapper)
+			{
+				return sizeof(int32_t) + ((wrapper & static_cast<uint8_t>(Flag::HASHED)) ? sizeof(uint32_t) : 0);
+			}
+
+			constexpr size_t passEvery = 16 << 20;
+
+			// one element of type in wire order
+			void printValue(std::FILE* out, Type type, const uint8_t* p)
+			{
+				switch (type)
+				{
+				case Type::I8: std::fprintf(out, "%d", Core::load<int8_t>(p)); break;
+				case Type::I16: std::fprintf(out, "%d", Core::load<int16_t>(p)); break;
+				case Type::I32: std::fprintf(out, "%d", Core::load<int32_t>(p)); break;
+				case Type::I64: std::fprintf(out, "%lld", (long long)Core::load<int64_t>(p)); break;
+				case Type::U8: std::fprintf(out, "%u", Core::load<uint8_t>(p)); break;
+				case Type::U16: std::fprintf(out, "%u", Core::load<uint16_t>(p)); break;
+				case Type::U32: std::fprintf(out, "%u", Core::load<uint32_t>(p)); break;
+				case Type::U64: std::fprintf(out, "%llu", (unsigned long long)Core::load<uint64_t>(p)); break;
+				case Type::FLOAT: std::fprintf(out, "%g", Core::load<float>(p)); break;
+				case Type::DOUBLE: std::fprintf(out, "%.17g", Core::load<double>(p)); break;
+				case Type::BOOL: std::fputs(p[0] ? "true" : "false", out); break;
+				case Type::F16:
+				case Type::BF16:
+				{
+					uint16_t bits = Core::load<uint16_t>(p);
+					float value;
+					if (type == Type::F16)
+					{
+						Core::Kernels::halfToFloat(&bits, 1, &value);
+					}
+					else
+					{
+						Core::Kernels::bfloat16ToFloat(&bits, 1, &value);
+					}
+					std::fprintf(out, "%g", value);
+					break;
+				}
+				default: std::fprintf(out, "0x%02x", p[0]); break;
+				}
+			}
+
+			void printText(std::FILE* out, std::string_view text)
+			{
+				for (char c : text)
+				{
+					if (c == '"' || c == '\\')
+					{
+						std::fprintf(out, "\\%c", c);
+					}
+					else if ((unsigned char)c < 0x20 || (unsigned char)c >= 0x7f)
+					{
+						std::fprintf(out, "\\x%02x", (unsigned char)c);
+					}
+					else
+					{
+						std::fputc(c, out);
+					}
+				}
+			}
+
+
+			class Walker
+			{
+			private:
+				struct Frame
+				{
+					size_t start;
+					std::string_view name;
+					uint8_t wrapper;
+					// objects count sections, a map has a single run of values
+					int8_t section;
+					int32_t remaining;
+					// path components matched down to here, -1 off the path
+					int matched;
+					bool printing;
+					size_t shown;
+					size_t elided;
+					// where a map's values end
+					size_t end;
+				};
+
+				static bool isMap(const Frame& frame)
+				{
+					return (frame.wrapper & WRAPPER_MASK) == static_cast<uint8_t>(Wrapper::MAP);
+				}
+
+				const uint8_t* data;
+				size_t length;
+				const Options& options;
+				std::FILE* out;
+				Result& result;
+
+				std::vector<std::string_view> path;
+				std::vector<Frame> stack;
+				size_t offset = 0;
+				size_t nextPass = passEvery;
+			public:
+				Walker(const uint8_t* data, size_t length, const Options& options, std::FILE* out, Result& result)
+					:
+					data(data),
+					length(length),
+					options(options),
+					out(out),
+					result(result)
+				{
+					std::string_view rest = options.path;
+					while (!rest.empty() || (!options.path.empty() && path.empty()))
+					{
+						size_t slash = rest.find('/');
+						path.push_back(rest.substr(0, slash));
+						rest = slash == std::string_view::npos ? std::string_view() : rest.substr(slash + 1);
+					}
+					stack.reserve(64);
+				}
+			public:
+				bool run()
+				{
+					while (offset < length || !stack.empty())
+					{
+						if (options.passed && offset >= nextPass)
+						{
+							options.passed(offset);
+							nextPass = offset + passEvery;
+						}
+
+						if (stack.empty())
+						{
+							result.roots++;
+						}
+						else
+						{
+							Frame& frame = stack.back();
+							if (frame.remaining == 0)
+							{
+								if (!nextSection(frame))
+								{
+									return false;
+								}
+								continue;
+							}
+							frame.remaining--;
+						}
+
+						if (!entity())
+						{
+							return false;
+						}
+					}
+					return true;
+				}
+			private:
+				bool fail(size_t at, const std::string& what)
+				{
+					result.ok = false;
+					result.error = "@" + std::to_string(at) + ": " + what;
+					return false;
+				}
+
+				void line(size_t at, size_t depth)
+				{
+					size_t base = path.empty() ? 0 : path.size() - 1;
+					std::fprintf(out, "@%-12zu%*s", at, (int)(2 * (depth - base)), "");
+				}
+
+				// the size field and hash of the entity that started at start
+				bool trailer(size_t start, uint8_t wrapper, bool visible)
+				{
+					if (length - offset < trailerOf(wrapper))
+					{
+						return fail(start, "truncated trailer");
+					}
+
+					int32_t size = Core::load<int32_t>(data + offset);
+					offset += trailerOf(wrapper);
+
+					bool hashed = (wrapper & static_cast<uint8_t>(Flag::HASHED)) != 0;
+					bool badSize = size < 0 || (size_t)size != offset - start;
+					result.badSizes += badSize ? 1 : 0;
+
+					if (visible)
+					{
+						if (hashed)
+						{
+							std::fprintf(out, "  crc 0x%08x", Core::load<uint32_t>(data + offset - sizeof(uint32_t)));
+						}
+						if (badSize)
+						{
+							std::fprintf(out, "  BAD SIZE FIELD %d, spans %zu", size, offset - start);
+						}
+						std::fputc('\n', out);
+					}
+					return true;
+				}
+
+				bool nextSection(Frame& frame)
+				{
+					size_t depth = stack.size() - 1;
+					if (frame.printing && frame.elided > 0)
+					{
+						line(offset, depth + 1);
+						std::fprintf(out, "... %zu more %ss\n", frame.elided, isMap(frame) ? "value" : wrapperNames[frame.section]);
+					}
+
+					if (isMap(frame) && offset != frame.end)
+					{
+						return fail(offset, "map values don't end at " + std::to_string(frame.end));
+					}
+					if (frame.section == 3 || isMap(frame))
+					{
+						size_t start = frame.start;
+						uint8_t wrapper = frame.wrapper;
+						bool printing = frame.printing;
+						if (printing)
+						{
+							line(offset, depth);
+							std::fprintf(out, "} \"");
+							printText(out, frame.name);
+							std::fprintf(out, "\" %zu bytes", offset + trailerOf(wrapper) - start);
+						}
+
+						stack.pop_back();
+						return trailer(start, wrapper, printing);
+					}
+
+					if (length - offset < sizeof(int16_t))
+					{
+						return fail(offset, "truncated section count");
+					}
+
+					int16_t count = Core::load<int16_t>(data + offset);
+					if (count < 0)
+					{
+						return fail(offset, "negative section count");
+					}
+
+					offset += sizeof count;
+					frame.section++;
+					frame.remaining = count;
+					frame.shown = 0;
+					frame.elided = 0;
+					return true;
+				}
+
+				bool entity()
+				{
+					size_t start = offset;
+					size_t depth = stack.size();
+					uint8_t wrapper;
+					std::string_view name;
+					if (!View::readHeader(data, length, offset, wrapper, name))
+					{
+						return fail(start, "truncated header");
+					}
+
+					uint8_t kind = wrapper & WRAPPER_MASK;
+					if (kind < static_cast<uint8_t>(Wrapper::PRIMITIVE) || kind > static_cast<uint8_t>(Wrapper::MAP))
+					{
+						char what[32];
+						std::snprintf(what, sizeof what, "unknown wrapper 0x%02x", wrapper);
+						return fail(start, what);
+					}
+					// a map's values are any entity, an object's follow its sections
+					if (!stack.empty() && !isMap(stack.back()) && kind != stack.back().section + 1)
+					{
+						return fail(start, std::string("a ") + wrapperNames[kind - 1] + " in the " + wrapperNames[stack.back().section] + " section");
+					}
+
+					result.entities[kind - 1]++;
+					int matched = matchedBy(name, depth);
+					bool visible = isVisible(matched, depth);
+
+					switch (static_cast<Wrapper>(kind))
+					{
+					case Wrapper::PRIMITIVE: return primitive(start, wrapper, name, depth, visible);
+					case Wrapper::OBJECT:
+					{
+						result.maxDepth = std::max(result.maxDepth, depth + 1);
+						int32_t directory = -1;
+						if (wrapper & static_cast<uint8_t>(Flag::SORTED))
+						{
+							if (length - offset < sizeof(int32_t))
+							{
+								return fail(offset, "truncated directory");
+							}
+							directory = Core::load<int32_t>(data + offset);
+							if (directory < 0 || length - offset < getDirectorySize((uint32_t)directory))
+							{
+								return fail(offset, "bad directory");
+							}
+							offset += getDirectorySize((uint32_t)directory);
+						}
+						if (visible)
+						{
+							line(start, depth);
+							std::fprintf(out, "object \"");
+							printText(out, name);
+							if (directory >= 0)
+							{
+								std::fprintf(out, "\" sorted, %d in directory {\n", directory);
+							}
+							else
+							{
+								std::fprintf(out, "\" {\n");
+							}
+						}
+						stack.push_back(Frame{ start, name, wrapper, -1, 0, matched, visible, 0, 0, 0 });
+						return true;
+					}
+					case Wrapper::MAP: return map(start, wrapper, name, depth, matched, visible);
+					default: return array(start, wrapper, name, depth, visible);
+					}
+				}
+
+				int matchedBy(std::string_view name, size_t depth) const
+				{
+					int parent = stack.empty() ? 0 : stack.back().matched;
+					if (parent == (int)path.size())
+					{
+						return parent;
+					}
+					if (parent == (int)depth && depth < path.size() && path[depth] == name)
+					{
+						return (int)depth + 1;
+					}
+					return -1;
+				}
+
+				// counts path matches and the children a parent shows
+				bool isVisible(int matched, size_t depth)
+				{
+					bool match = !path.empty() && matched == (int)path.size() && (stack.empty() || stack.back().matched != matched);
+					result.matches += match ? 1 : 0;
+
+					if (options.summary || matched != (int)path.size() || depth > options.depth)
+					{
+						return false;
+					}
+					if (stack.empty() || match)
+					{
+						return true;
+					}
+
+					Frame& parent = stack.back();
+					if (!parent.printing)
+					{
+						return false;
+					}
+					if (options.children && parent.shown >= options.children)
+					{
+						parent.elided++;
+						return false;
+					}
+					parent.shown++;
+					return true;
+				}
+
+				bool map(size_t start, uint8_t wrapper, std::string_view name, size_t depth, int matched, bool visible)
+				{
+					// checks the counts and that the table and values fit
+					size_t it = start;
+					MapView view;
+					if (!MapView::read(data, length, it, view))
+					{
+						return fail(start, "truncated or malformed map");
+					}
+
+					uint32_t slots = Core::load<uint32_t>(data + offset + sizeof(int32_t));
+					uint32_t bytes = Core::load<uint32_t>(data + offset + 2 * sizeof(int32_t));
+					offset += 3 * sizeof(int32_t) + (size_t)slots * 2 * sizeof(uint32_t);
+					result.maxDepth = std::max(result.maxDepth, depth + 1);
+
+					if (visible)
+					{
+						line(start, depth);
+						std::fprintf(out, "map \"");
+						printText(out, name);
+						std::fprintf(out, "\" %u keys, %u slots {\n", view.getCount(), slots);
+					}
+					stack.push_back(Frame{ start, name, wrapper, 0, (int32_t)view.getCount(), matched, visible, 0, 0, offset + bytes });
+					return true;
+				}
+
+				bool primitive(size_t start, uint8_t wrapper, std::string_view name, size_t depth, bool visible)
+				{
+					if (length - offset < 1)
+					{
+						return fail(start, "truncated primitive");
+					}
+
+					Type type = static_cast<Type>(data[offset]);
+					size_t size = getTypeSize(type);
+					if (size == 0)
+					{
+						return fail(start, std::string("unknown type ") + std::to_string(data[offset]));
+					}
+					if (length - offset - 1 < size)
+					{
+						return fail(start, "truncated primitive");
+					}
+
+					if (visible)
+					{
+						line(start, depth);
+						std::fprintf(out, "primitive \"");
+						printText(out, name);
+						std::fprintf(out, "\" %s = ", typeName(data[offset]));
+						printValue(out, type, data + offset + 1);
+					}
+
+					offset += 1 + size;
+					return trailer(start, wrapper, visible);
+				}
+
+				bool array(size_t start, uint8_t wrapper, std::string_view name, size_t depth, bool visible)
+				{
+					size_t it = start;
+					ArrayView view;
+					if (!ArrayView::read(data, length, it, view))
+					{
+						return fail(start, "truncated or negative array");
+					}
+
+					bool isString = view.getWrapper() == Wrapper::STRING;
+					if (!isString && getTypeSize(view.getType()) == 0)
+					{
+						return fail(start, std::string("unknown type ") + std::to_string(static_cast<uint8_t>(view.getType())));
+					}
+
+					if (visible)
+					{
+						line(start, depth);
+						std::fprintf(out, "%s \"", isString ? "string" : "array");
+						printText(out, name);
+
+						size_t shown = std::min<size_t>(options.samples, view.getCount());
+						if (isString)
+						{
+							std::fprintf(out, "\" [%d] = \"", view.getCount());
+							printText(out, std::string_view(reinterpret_cast<const char*>(view.getData()), shown));
+							std::fprintf(out, "\"%s", shown < (size_t)view.getCount() ? "..." : "");
+						}
+						else
+						{
+							std::fprintf(out, "\" %s[%d] =", typeName(static_cast<uint8_t>(view.getType())), view.getCount());
+							if (view.isSparse())
+							{
+								std::fprintf(out, " sparse %u:", view.getNonZeroCount());
+							}
+							static const uint8_t zero[8] = {};
+							for (size_t i = 0; i < shown; i++)
+							{
+								std::fputc(' ', out);
+								uint32_t slot;
+								if (view.getType() == Type::BIT)
+								{
+									std::fputc(view.getData()[i / 8] >> (i % 8) & 1 ? '1' : '0', out);
+								}
+								else if (!view.isSparse())
+								{
+									printValue(out, view.getType(), view.getData() + i * getTypeSize(view.getType()));
+								}
+								else
+								{
+									bool stored = Sparse::find(view.getData(), (uint32_t)i, slot);
+									printValue(out, view.getType(), stored ? Sparse::values(view.getData()) + slot * getTypeSize(view.getType()) : zero);
+								}
+							}
+							std::fprintf(out, "%s", shown < (size_t)view.getCount() ? " ..." : "");
+						}
+					}
+
+					// the trailer is checked here, ArrayView only skipped it
+					offset = it - trailerOf(wrapper);
+					return trailer(start, wrapper, visible);
+				}
+			};
+		}
+
+
+		Result dump(const uint8_t* data, size_t length, const Options& options, std::FILE* out)
+		{
+			Result result;
+			Walker walker(data, length, options, out, result);
+			walker.run();
+
+			std::fprintf(out, "%llu roots, %llu primitives, %llu arrays, %llu strings, %llu objects, depth %zu, %zu bytes\n",
+				(unsigned long long)result.roots, (unsigned long long)result.entities[0], (unsigned long long)result.entities[1],
+				(unsigned long long)result.entities[2], (unsigned long long)result.entities[3], result.maxDepth, length);
+			if (result.entities[4] > 0)
+			{
+				std::fprintf(out, "%llu maps\n", (unsigned long long)result.entities[4]);
+			}
+			if (!options.path.empty())
+			{
+				std::fprintf(out, "%llu matches for %s\n", (unsigned long long)result.matches, options.path.c_str());
+			}
+			if (result.badSizes > 0)
+			{
+				std::fprintf(out, "%llu size fields don't match\n", (unsigned long long)result.badSizes);
+			}
+			if (!result.ok)
+			{
+				std::fprintf(out, "error %s\n", result.error.c_str());
+			}
+			return result;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <stdint.h>
+#include <string>
+
+
+// walks packed entities front to back with the View readers and prints
+// them, nothing is decoded into a tree. Memory is the nesting depth; the
+// bytes themselves are whatever the caller maps.
+namespace ObjectModel
+{
+	namespace Dump
+	{
+		struct Options
+		{
+			// array elements and string bytes shown per entity
+			size_t samples = 8;
+			// entities printed per section of an object, 0 for all; the rest
+			// are still walked and checked
+			size_t children = 16;
+			// objects nested deeper than this are walked but not printed
+			size_t depth = SIZE_MAX;
+			// names from the root down separated by /, "" matches a root
+			// named "" so /height is height in an abcjson root. Only the
+			// matches and what is under them are printed.
+			std::string path;
+			// totals only
+			bool summary = false;
+			// called every 16MB with an offset the walk won't read before
+			// again, so a caller can drop the mapped pages behind it
+			std::function<void(size_t)> passed;
+		};
+
+		struct Result
+		{
+			bool ok = true;
+			// "@offset: what", the walk stops at the first malformed entity
+			std::string error;
+			uint64_t roots = 0;
+			// by Wrapper - 1
+			uint64_t entities[5] = {};
+			uint64_t matches = 0;
+			size_t maxDepth = 0;
+			// size fields that don't match the bytes the entity spans
+			uint64_t badSizes = 0;
+		};
+
+		Result dump(const uint8_t* data, size_t length, const Options& options, std::FILE* out);
+	}
+}
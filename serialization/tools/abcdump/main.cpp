@@ -0,0 +1,95 @@
+#include "dump.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// abcdump [--path a/b] [--depth n] [--children n] [--samples n] [--summary] <file>
+int main(int argc, char** argv)
+{
+	ObjectModel::Dump::Options options;
+	const char* file = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto number = [&](size_t& into)
+		{
+			if (i + 1 >= argc)
+			{
+				return false;
+			}
+			into = std::strtoull(argv[++i], nullptr, 10);
+			return true;
+		};
+
+		bool ok = true;
+		if (std::strcmp(argv[i], "--path") == 0 && i + 1 < argc) options.path = argv[++i];
+		else if (std::strcmp(argv[i], "--depth") == 0) ok = number(options.depth);
+		else if (std::strcmp(argv[i], "--children") == 0) ok = number(options.children);
+		else if (std::strcmp(argv[i], "--samples") == 0) ok = number(options.samples);
+		else if (std::strcmp(argv[i], "--summary") == 0) options.summary = true;
+		else if (argv[i][0] != '-' && !file) file = argv[i];
+		else ok = false;
+
+		if (!ok)
+		{
+			file = nullptr;
+			break;
+		}
+	}
+
+	if (!file)
+	{
+		std::fprintf(stderr, "usage: %s [--path a/b] [--depth n] [--children n] [--samples n] [--summary] <file>\n", argv[0]);
+		return 2;
+	}
+
+	int fd = open(file, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0)
+	{
+		std::fprintf(stderr, "%s: %s\n", file, std::strerror(errno));
+		return 1;
+	}
+
+	size_t length = (size_t)st.st_size;
+	const uint8_t* data = nullptr;
+	if (length > 0)
+	{
+		void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+		{
+			std::fprintf(stderr, "%s: %s\n", file, std::strerror(errno));
+			return 1;
+		}
+		data = static_cast<const uint8_t*>(map);
+		madvise(map, length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	// the walk never goes back, pages behind it are dropped so resident
+	// memory stays flat however large the file
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t released = 0;
+	options.passed = [&](size_t offset)
+	{
+		size_t upto = offset / page * page;
+		if (upto > released)
+		{
+			madvise(const_cast<uint8_t*>(data) + released, upto - released, MADV_DONTNEED);
+			released = upto;
+		}
+	};
+
+	ObjectModel::Dump::Result result = ObjectModel::Dump::dump(data, length, options, stdout);
+
+	if (data)
+	{
+		munmap(const_cast<uint8_t*>(data), length);
+	}
+	return result.ok && result.badSizes == 0 ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+# abcgen_generate(<target> <schema>...): runs abcgen over each schema at
+# build time and compiles the generated <stem>.abc.cpp into target, which
+# also has to build or link the serialization sources
+set(ABCGEN_RUNTIME_DIR ${PROJECT_SOURCE_DIR}/include CACHE INTERNAL "generated.h lives here")
+
+function(abcgen_generate target)
+  set(out ${CMAKE_CURRENT_BINARY_DIR}/abcgen)
+  file(MAKE_DIRECTORY ${out})
+
+  foreach(schema ${ARGN})
+    get_filename_component(path ${schema} ABSOLUTE)
+    get_filename_component(stem ${schema} NAME_WE)
+    add_custom_command(
+      OUTPUT ${out}/${stem}.abc.h ${out}/${stem}.abc.cpp
+      COMMAND abcgen ${path} ${out}
+      DEPENDS abcgen ${path}
+      COMMENT "abcgen ${schema}"
+      VERBATIM
+    )
+    target_sources(${target} PRIVATE ${out}/${stem}.abc.h ${out}/${stem}.abc.cpp)
+  endforeach()
+
+  target_include_directories(${target} PRIVATE ${out} ${ABCGEN_RUNTIME_DIR})
+endfunction()
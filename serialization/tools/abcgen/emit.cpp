@@ -0,0 +1,407 @@
+#include "schema.h"
+
+
+namespace Schema
+{
+	namespace
+	{
+		// the Wrapper section a field lands in
+		enum Section
+		{
+			PRIMITIVES,
+			ARRAYS,
+			STRINGS,
+			OBJECTS
+		};
+
+		const char* wrappers[] = { "Wrapper::PRIMITIVE", "Wrapper::ARRAY", "Wrapper::STRING", "Wrapper::OBJECT" };
+
+		Section sectionOf(const Field& f)
+		{
+			switch (f.kind)
+			{
+			case Kind::SCALAR: return f.list ? ARRAYS : PRIMITIVES;
+			case Kind::STRING: return f.list ? OBJECTS : STRINGS;
+			default: return OBJECTS;
+			}
+		}
+
+		// name on the wire, lists are objects named like abcjson names them
+		std::string wireName(const Field& f)
+		{
+			return "\"" + f.name + (f.list && f.kind != Kind::SCALAR ? "[]" : "") + "\"";
+		}
+
+		std::string cppType(const Field& f)
+		{
+			std::string element = f.kind == Kind::SCALAR ? findScalar(f.type)->cpp : f.kind == Kind::STRING ? "std::string" : f.type;
+			return f.list ? "std::vector<" + element + ">" : element;
+		}
+
+		std::string typeOf(const Field& f)
+		{
+			return std::string("Type::") + findScalar(f.type)->type;
+		}
+
+
+		class Writer
+		{
+		private:
+			std::string text;
+		public:
+			// one line at depth tabs, a blank one without arguments
+			void line(int depth = 0, const std::string& s = std::string())
+			{
+				if (!s.empty())
+				{
+					text.append(depth, '\t');
+					text += s;
+				}
+				text += '\n';
+			}
+
+			inline std::string take() { return std::move(text); }
+		};
+
+		std::string banner(const std::string& source)
+		{
+			return "// generated by abcgen from " + source + ", do not edit";
+		}
+
+		// wraps the body in the schema namespace, if there is one
+		int open(Writer& w, const Schema& schema)
+		{
+			if (schema.space.empty())
+			{
+				return 0;
+			}
+			w.line(0, "namespace " + schema.space);
+			w.line(0, "{");
+			return 1;
+		}
+
+		void close(Writer& w, const Schema& schema)
+		{
+			if (!schema.space.empty())
+			{
+				w.line(0, "}");
+			}
+		}
+
+
+		void declare(Writer& w, int d, const Struct& s)
+		{
+			std::string self = "\"" + s.name + "\"";
+
+			w.line(d, "struct " + s.name);
+			w.line(d, "{");
+			for (const Field& f : s.fields)
+			{
+				std::string init = f.kind == Kind::SCALAR && !f.list ? (f.type == "bool" ? " = false" : " = 0") : "";
+				w.line(d + 1, cppType(f) + " " + f.name + init + ";");
+			}
+			if (!s.fields.empty())
+			{
+				w.line();
+			}
+
+			w.line(d + 1, "// bytes pack writes under name, -1 when a list, a payload or the");
+			w.line(d + 1, "// whole is past what the wire's counts and sizes hold");
+			w.line(d + 1, "int32_t getSize(std::string_view name = " + self + ") const;");
+			w.line(d + 1, "// getSize(name) bytes at p, the same Object::pack writes, returns the");
+			w.line(d + 1, "// end or nullptr when getSize(name) is -1");
+			w.line(d + 1, "uint8_t* pack(uint8_t* p, std::string_view name = " + self + ") const;");
+			w.line(d + 1, "// false and it untouched when it doesn't fit in buffer or the int16 it");
+			w.line(d + 1, "bool pack(std::vector<uint8_t>& buffer, int16_t& it, std::string_view name = " + self + ") const;");
+			w.line();
+			w.line(d + 1, "// any object whose entities have the schema types, in any order;");
+			w.line(d + 1, "// unknown ones are skipped, fields the bytes don't carry are reset.");
+			w.line(d + 1, "// offset moves past the object only on success");
+			w.line(d + 1, "bool unpack(const uint8_t* buffer, size_t length, size_t& offset, size_t depth = 0);");
+			w.line(d + 1, "bool unpack(const std::vector<uint8_t>& buffer, size_t& offset) { return unpack(buffer.data(), buffer.size(), offset); }");
+			w.line();
+			w.line(d + 1, "bool operator==(const " + s.name + "& other) const;");
+			w.line(d + 1, "bool operator!=(const " + s.name + "& other) const { return !(*this == other); }");
+			w.line(d, "};");
+		}
+
+
+		void defineSize(Writer& w, int d, const Struct& s)
+		{
+			w.line(d, "int32_t " + s.name + "::getSize(std::string_view name) const");
+			w.line(d, "{");
+			w.line(d + 1, "int64_t children = 0;");
+			for (int section = PRIMITIVES; section <= OBJECTS; section++)
+			{
+				for (const Field& f : s.fields)
+				{
+					if (sectionOf(f) != section)
+					{
+						continue;
+					}
+
+					std::string size;
+					switch (section)
+					{
+					case PRIMITIVES: size = "Generated::primitiveSize(" + wireName(f) + ", " + typeOf(f) + ")"; break;
+					case ARRAYS: size = "Generated::arraySize(" + wireName(f) + ", " + f.name + ".size() * sizeof(" + findScalar(f.type)->cpp + "))"; break;
+					case STRINGS: size = "Generated::arraySize(" + wireName(f) + ", " + f.name + ".size())"; break;
+					default: size = f.list ? "Generated::listSize(" + wireName(f) + ", " + f.name + ")" : f.name + ".getSize(" + wireName(f) + ")"; break;
+					}
+					w.line(d + 1, "children = Generated::add(children, " + size + ");");
+				}
+			}
+			w.line(d + 1, "return Generated::objectSize(name, children);");
+			w.line(d, "}");
+		}
+
+
+		void definePack(Writer& w, int d, const Struct& s)
+		{
+			w.line(d, "uint8_t* " + s.name + "::pack(uint8_t* p, std::string_view name) const");
+			w.line(d, "{");
+			w.line(d + 1, "uint8_t* start = p;");
+			w.line(d + 1, "p = Generated::header(p, Wrapper::OBJECT, name);");
+
+			for (int section = PRIMITIVES; section <= OBJECTS; section++)
+			{
+				int n = 0;
+				for (const Field& f : s.fields)
+				{
+					n += sectionOf(f) == section ? 1 : 0;
+				}
+
+				w.line();
+				w.line(d + 1, "p = Generated::count(p, " + std::to_string(n) + ");");
+				for (const Field& f : s.fields)
+				{
+					if (sectionOf(f) != section)
+					{
+						continue;
+					}
+
+					std::string write;
+					switch (section)
+					{
+					case PRIMITIVES: write = "Generated::primitive<" + cppType(f) + ">(p, " + wireName(f) + ", " + typeOf(f) + ", " + f.name + ")"; break;
+					case ARRAYS: write = "Generated::array<" + std::string(findScalar(f.type)->cpp) + ">(p, " + wireName(f) + ", " + typeOf(f) + ", " + f.name + ")"; break;
+					case STRINGS: write = "Generated::string(p, " + wireName(f) + ", " + f.name + ")"; break;
+					default: write = f.list ? "Generated::list(p, " + wireName(f) + ", " + f.name + ")" : f.name + ".pack(p, " + wireName(f) + ")"; break;
+					}
+					w.line(d + 1, "p = " + write + ";");
+				}
+			}
+
+			w.line();
+			w.line(d + 1, "return Generated::trailer(p, start);");
+			w.line(d, "}");
+			w.line();
+			w.line();
+			w.line(d, "bool " + s.name + "::pack(std::vector<uint8_t>& buffer, int16_t& it, std::string_view name) const");
+			w.line(d, "{");
+			w.line(d + 1, "int32_t size = getSize(name);");
+			w.line(d + 1, "if (size < 0 || it < 0 || (size_t)it + size > std::min<size_t>(buffer.size(), INT16_MAX))");
+			w.line(d + 1, "{");
+			w.line(d + 2, "return false;");
+			w.line(d + 1, "}");
+			w.line();
+			w.line(d + 1, "it = (int16_t)(pack(buffer.data() + it, name) - buffer.data());");
+			w.line(d + 1, "return true;");
+			w.line(d, "}");
+		}
+
+
+		void defineUnpack(Writer& w, int d, const Struct& s)
+		{
+			w.line(d, "bool " + s.name + "::unpack(const uint8_t* buffer, size_t length, size_t& offset, size_t depth)");
+			w.line(d, "{");
+			w.line(d + 1, "size_t it = offset;");
+			w.line(d + 1, "uint8_t wrapper;");
+			w.line(d + 1, "int16_t n;");
+			w.line(d + 1, "bool seen[" + std::to_string(s.fields.empty() ? 1 : s.fields.size()) + "] = {};");
+			w.line();
+			w.line(d + 1, "if (!Generated::enter(buffer, length, it, depth, wrapper))");
+			w.line(d + 1, "{");
+			w.line(d + 2, "return false;");
+			w.line(d + 1, "}");
+
+			for (int section = PRIMITIVES; section <= OBJECTS; section++)
+			{
+				std::string wrapper = wrappers[section];
+				bool any = false;
+				for (const Field& f : s.fields)
+				{
+					any = any || sectionOf(f) == section;
+				}
+
+				w.line();
+				if (!any)
+				{
+					w.line(d + 1, "if (!Generated::count(buffer, length, it, n) || !Generated::skip(buffer, length, it, depth + 1, " + wrapper + ", n))");
+					w.line(d + 1, "{");
+					w.line(d + 2, "return false;");
+					w.line(d + 1, "}");
+					continue;
+				}
+
+				w.line(d + 1, "if (!Generated::count(buffer, length, it, n))");
+				w.line(d + 1, "{");
+				w.line(d + 2, "return false;");
+				w.line(d + 1, "}");
+				w.line(d + 1, "for (int16_t i = 0; i < n; i++)");
+				w.line(d + 1, "{");
+				w.line(d + 2, "std::string_view field;");
+				w.line(d + 2, "if (!Generated::peek(buffer, length, it, " + wrapper + ", field))");
+				w.line(d + 2, "{");
+				w.line(d + 3, "return false;");
+				w.line(d + 2, "}");
+				w.line();
+				w.line(d + 2, "bool ok;");
+
+				bool first = true;
+				for (size_t i = 0; i < s.fields.size(); i++)
+				{
+					const Field& f = s.fields[i];
+					if (sectionOf(f) != section)
+					{
+						continue;
+					}
+
+					std::string read;
+					switch (section)
+					{
+					case PRIMITIVES: read = "Generated::primitive<" + cppType(f) + ">(buffer, length, it, " + typeOf(f) + ", " + f.name + ")"; break;
+					case ARRAYS: read = "Generated::array<" + std::string(findScalar(f.type)->cpp) + ">(buffer, length, it, " + typeOf(f) + ", " + f.name + ")"; break;
+					case STRINGS: read = "Generated::string(buffer, length, it, " + f.name + ")"; break;
+					default: read = f.list ? "Generated::list(buffer, length, it, depth + 1, " + f.name + ")" : f.name + ".unpack(buffer, length, it, depth + 1)"; break;
+					}
+
+					w.line(d + 2, std::string(first ? "if" : "else if") + " (field == " + wireName(f) + ")");
+					w.line(d + 2, "{");
+					w.line(d + 3, "ok = seen[" + std::to_string(i) + "] = " + read + ";");
+					w.line(d + 2, "}");
+					first = false;
+				}
+				w.line(d + 2, "else");
+				w.line(d + 2, "{");
+				w.line(d + 3, "ok = Generated::skip(buffer, length, it, depth + 1, " + wrapper + ");");
+				w.line(d + 2, "}");
+				w.line();
+				w.line(d + 2, "if (!ok)");
+				w.line(d + 2, "{");
+				w.line(d + 3, "return false;");
+				w.line(d + 2, "}");
+				w.line(d + 1, "}");
+			}
+
+			w.line();
+			w.line(d + 1, "if (!Generated::leave(length, it, wrapper))");
+			w.line(d + 1, "{");
+			w.line(d + 2, "return false;");
+			w.line(d + 1, "}");
+
+			for (size_t i = 0; i < s.fields.size(); i++)
+			{
+				const Field& f = s.fields[i];
+				std::string reset = f.list || f.kind == Kind::STRING ? f.name + ".clear()"
+					: f.kind == Kind::OBJECT ? f.name + " = " + f.type + "()"
+					: f.name + " = {}";
+
+				w.line();
+				w.line(d + 1, "if (!seen[" + std::to_string(i) + "])");
+				w.line(d + 1, "{");
+				w.line(d + 2, reset + ";");
+				w.line(d + 1, "}");
+			}
+
+			w.line();
+			w.line(d + 1, "offset = it;");
+			w.line(d + 1, "return true;");
+			w.line(d, "}");
+		}
+
+
+		void defineEquals(Writer& w, int d, const Struct& s)
+		{
+			w.line(d, "bool " + s.name + "::operator==(const " + s.name + "& other) const");
+			w.line(d, "{");
+			if (s.fields.empty())
+			{
+				w.line(d + 1, "return true;");
+			}
+			for (size_t i = 0; i < s.fields.size(); i++)
+			{
+				const std::string& name = s.fields[i].name;
+				std::string compare = name + " == other." + name;
+				if (s.fields.size() == 1)
+				{
+					w.line(d + 1, "return " + compare + ";");
+				}
+				else if (i == 0)
+				{
+					w.line(d + 1, "return " + compare);
+				}
+				else
+				{
+					w.line(d + 2, "&& " + compare + (i + 1 == s.fields.size() ? ";" : ""));
+				}
+			}
+			w.line(d, "}");
+		}
+	}
+
+
+	std::string emitHeader(const Schema& schema, const std::string& source)
+	{
+		Writer w;
+		w.line(0, banner(source));
+		w.line(0, "#pragma once");
+		w.line(0, "#include <string>");
+		w.line(0, "#include <string_view>");
+		w.line(0, "#include <vector>");
+		w.line(0, "#include \"generated.h\"");
+		w.line();
+		w.line();
+
+		int d = open(w, schema);
+		for (const Struct& s : schema.structs)
+		{
+			w.line(d, "struct " + s.name + ";");
+		}
+
+		for (const Struct& s : schema.structs)
+		{
+			w.line();
+			w.line();
+			declare(w, d, s);
+		}
+		close(w, schema);
+		return w.take();
+	}
+
+
+	std::string emitSource(const Schema& schema, const std::string& stem, const std::string& source)
+	{
+		Writer w;
+		w.line(0, banner(source));
+		w.line(0, "#include \"" + stem + ".abc.h\"");
+		w.line();
+		w.line();
+
+		int d = open(w, schema);
+		w.line(d, "using namespace ObjectModel;");
+
+		for (const Struct& s : schema.structs)
+		{
+			void (*parts[])(Writer&, int, const Struct&) = { defineSize, definePack, defineUnpack, defineEquals };
+			for (auto part : parts)
+			{
+				w.line();
+				w.line();
+				part(w, d, s);
+			}
+		}
+		close(w, schema);
+		return w.take();
+	}
+}
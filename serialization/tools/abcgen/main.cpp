@@ -0,0 +1,66 @@
+#include "schema.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+
+namespace
+{
+	// only rewritten when the text changed, so dependents don't rebuild
+	bool write(const std::string& path, const std::string& text)
+	{
+		std::ifstream old(path, std::ios::binary);
+		std::stringstream current;
+		current << old.rdbuf();
+		if (old && current.str() == text)
+		{
+			return true;
+		}
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << text;
+		return (bool)out;
+	}
+}
+
+
+// abcgen <schema> <out dir>: writes <out dir>/<stem>.abc.h and .abc.cpp
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::fprintf(stderr, "usage: %s <schema> <out dir>\n", argv[0]);
+		return 2;
+	}
+
+	std::string path = argv[1];
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::fprintf(stderr, "%s: cannot read\n", path.c_str());
+		return 1;
+	}
+
+	std::stringstream text;
+	text << in.rdbuf();
+
+	Schema::Schema schema;
+	std::string error;
+	if (!Schema::parse(text.str(), schema, error))
+	{
+		std::fprintf(stderr, "%s:%s\n", path.c_str(), error.c_str());
+		return 1;
+	}
+
+	std::string file = path.substr(path.find_last_of("/\\") + 1);
+	std::string stem = file.substr(0, file.find('.'));
+	std::string out = std::string(argv[2]) + "/" + stem;
+
+	if (!write(out + ".abc.h", Schema::emitHeader(schema, file))
+		|| !write(out + ".abc.cpp", Schema::emitSource(schema, stem, file)))
+	{
+		std::fprintf(stderr, "%s: cannot write\n", out.c_str());
+		return 1;
+	}
+	return 0;
+}
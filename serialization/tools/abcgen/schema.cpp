@@ -0,0 +1,381 @@
+#include "schema.h"
+#include <cctype>
+#include <map>
+#include <set>
+
+
+namespace Schema
+{
+	namespace
+	{
+		const Scalar scalars[] =
+		{
+			{ "i8", "int8_t", "I8" },
+			{ "i16", "int16_t", "I16" },
+			{ "i32", "int32_t", "I32" },
+			{ "i64", "int64_t", "I64" },
+			{ "u8", "uint8_t", "U8" },
+			{ "u16", "uint16_t", "U16" },
+			{ "u32", "uint32_t", "U32" },
+			{ "u64", "uint64_t", "U64" },
+			{ "float", "float", "FLOAT" },
+			{ "double", "double", "DOUBLE" },
+			{ "bool", "bool", "BOOL" }
+		};
+
+		// members every generated struct has
+		const std::set<std::string> reserved = { "getSize", "pack", "unpack", "operator" };
+
+		struct Token
+		{
+			std::string text;
+			int line;
+		};
+
+		class Lexer
+		{
+		private:
+			const std::string& text;
+			size_t at = 0;
+			int line = 1;
+		public:
+			explicit Lexer(const std::string& text)
+				:
+				text(text) {}
+		public:
+			// empty text at the end, otherwise an identifier or one of { } ; [ ] ::
+			bool next(Token& token, std::string& error)
+			{
+				skipBlank();
+				token.line = line;
+				token.text.clear();
+
+				if (at == text.size())
+				{
+					return true;
+				}
+
+				char c = text[at];
+				if (std::isalpha((unsigned char)c) || c == '_')
+				{
+					size_t start = at;
+					while (at < text.size() && (std::isalnum((unsigned char)text[at]) || text[at] == '_'))
+					{
+						at++;
+					}
+					token.text = text.substr(start, at - start);
+					return true;
+				}
+
+				if (text.compare(at, 2, "::") == 0)
+				{
+					token.text = "::";
+					at += 2;
+					return true;
+				}
+
+				if (c == '{' || c == '}' || c == ';' || c == '[' || c == ']')
+				{
+					token.text = c;
+					at++;
+					return true;
+				}
+
+				error = std::to_string(line) + ": unexpected '" + c + "'";
+				return false;
+			}
+		private:
+			void skipBlank()
+			{
+				while (at < text.size())
+				{
+					if (text[at] == '\n')
+					{
+						line++;
+						at++;
+					}
+					else if (std::isspace((unsigned char)text[at]))
+					{
+						at++;
+					}
+					else if (text.compare(at, 2, "//") == 0)
+					{
+						while (at < text.size() && text[at] != '\n')
+						{
+							at++;
+						}
+					}
+					else
+					{
+						return;
+					}
+				}
+			}
+		};
+
+		bool isIdentifier(const std::string& s)
+		{
+			return !s.empty() && (std::isalpha((unsigned char)s[0]) || s[0] == '_');
+		}
+
+
+		class Parser
+		{
+		private:
+			Lexer lexer;
+			Token token;
+			std::string& error;
+		public:
+			Parser(const std::string& text, std::string& error)
+				:
+				lexer(text),
+				error(error) {}
+		public:
+			bool parse(Schema& schema)
+			{
+				if (!advance())
+				{
+					return false;
+				}
+
+				while (!token.text.empty())
+				{
+					if (token.text == "namespace")
+					{
+						if (!advance() || !parseNamespace(schema.space))
+						{
+							return false;
+						}
+					}
+					else if (token.text == "object")
+					{
+						Struct s;
+						if (!parseStruct(s))
+						{
+							return false;
+						}
+						schema.structs.push_back(std::move(s));
+					}
+					else
+					{
+						return fail("expected namespace or object");
+					}
+				}
+				return true;
+			}
+		private:
+			bool advance() { return lexer.next(token, error); }
+
+			bool fail(const std::string& message)
+			{
+				error = std::to_string(token.line) + ": " + message + (token.text.empty() ? " at end of file" : ", found '" + token.text + "'");
+				return false;
+			}
+
+			bool expect(const char* text)
+			{
+				if (token.text != text)
+				{
+					return fail(std::string("expected '") + text + "'");
+				}
+				return advance();
+			}
+
+			bool identifier(std::string& into, const char* what)
+			{
+				if (!isIdentifier(token.text))
+				{
+					return fail(std::string("expected ") + what);
+				}
+				into = token.text;
+				return advance();
+			}
+
+			bool parseNamespace(std::string& space)
+			{
+				if (!space.empty())
+				{
+					return fail("namespace given twice");
+				}
+
+				std::string part;
+				if (!identifier(part, "a namespace name"))
+				{
+					return false;
+				}
+				space = part;
+
+				while (token.text == "::")
+				{
+					if (!advance() || !identifier(part, "a namespace name"))
+					{
+						return false;
+					}
+					space += "::" + part;
+				}
+				return expect(";");
+			}
+
+			bool parseStruct(Struct& s)
+			{
+				s.line = token.line;
+				if (!advance() || !identifier(s.name, "an object name") || !expect("{"))
+				{
+					return false;
+				}
+
+				while (token.text != "}")
+				{
+					Field field;
+					field.line = token.line;
+					if (!identifier(field.type, "a field type"))
+					{
+						return false;
+					}
+
+					if (token.text == "[")
+					{
+						if (!advance() || !expect("]"))
+						{
+							return false;
+						}
+						field.list = true;
+					}
+
+					if (!identifier(field.name, "a field name") || !expect(";"))
+					{
+						return false;
+					}
+
+					field.kind = findScalar(field.type) ? Kind::SCALAR : field.type == "string" ? Kind::STRING : Kind::OBJECT;
+					s.fields.push_back(std::move(field));
+				}
+				return advance();
+			}
+		};
+
+
+		bool fail(std::string& error, int line, const std::string& message)
+		{
+			error = std::to_string(line) + ": " + message;
+			return false;
+		}
+
+		bool check(const Schema& schema, std::string& error)
+		{
+			std::map<std::string, const Struct*> names;
+			for (const Struct& s : schema.structs)
+			{
+				if (findScalar(s.name) || s.name == "string" || !names.emplace(s.name, &s).second)
+				{
+					return fail(error, s.line, "object " + s.name + " declared twice or named like a type");
+				}
+			}
+
+			for (const Struct& s : schema.structs)
+			{
+				std::set<std::string> fields;
+				for (const Field& f : s.fields)
+				{
+					if (!fields.insert(f.name).second)
+					{
+						return fail(error, f.line, "field " + f.name + " declared twice in " + s.name);
+					}
+					if (reserved.count(f.name) || f.name == s.name)
+					{
+						return fail(error, f.line, "field " + f.name + " clashes with a generated member");
+					}
+					if (f.kind == Kind::OBJECT && !names.count(f.type))
+					{
+						return fail(error, f.line, "unknown type " + f.type);
+					}
+					if (f.kind == Kind::SCALAR && f.list && f.type == "bool")
+					{
+						return fail(error, f.line, "bool[] has no wire form, use u8[]");
+					}
+				}
+			}
+			return true;
+		}
+
+		// every struct after the ones it holds by value, lists are vectors and
+		// may refer to anything, themselves included
+		bool order(Schema& schema, std::string& error)
+		{
+			std::map<std::string, size_t> index;
+			for (size_t i = 0; i < schema.structs.size(); i++)
+			{
+				index[schema.structs[i].name] = i;
+			}
+
+			// 0 unvisited, 1 on the path, 2 done
+			std::vector<int> state(schema.structs.size(), 0);
+			std::vector<Struct> sorted;
+
+			struct Visit
+			{
+				Schema& schema;
+				std::map<std::string, size_t>& index;
+				std::vector<int>& state;
+				std::vector<Struct>& sorted;
+				std::string& error;
+
+				bool operator()(size_t i)
+				{
+					if (state[i] == 2)
+					{
+						return true;
+					}
+					if (state[i] == 1)
+					{
+						return fail(error, schema.structs[i].line, "object " + schema.structs[i].name + " contains itself, make the field a list");
+					}
+
+					state[i] = 1;
+					for (const Field& f : schema.structs[i].fields)
+					{
+						if (f.kind == Kind::OBJECT && !f.list && !(*this)(index[f.type]))
+						{
+							return false;
+						}
+					}
+					state[i] = 2;
+					sorted.push_back(schema.structs[i]);
+					return true;
+				}
+			};
+
+			Visit visit{ schema, index, state, sorted, error };
+			for (size_t i = 0; i < schema.structs.size(); i++)
+			{
+				if (!visit(i))
+				{
+					return false;
+				}
+			}
+
+			schema.structs = std::move(sorted);
+			return true;
+		}
+	}
+
+
+	const Scalar* findScalar(const std::string& name)
+	{
+		for (const Scalar& scalar : scalars)
+		{
+			if (name == scalar.name)
+			{
+				return &scalar;
+			}
+		}
+		return nullptr;
+	}
+
+
+	bool parse(const std::string& text, Schema& schema, std::string& error)
+	{
+		Parser parser(text, error);
+		return parser.parse(schema) && check(schema, error) && order(schema, error);
+	}
+}
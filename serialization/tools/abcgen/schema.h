@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+
+
+// the abcgen schema language:
+//
+//	// comment
+//	namespace chain;
+//
+//	object Transaction
+//	{
+//		string from;
+//		u64 amount;
+//		u8[] signature;
+//	}
+//
+//	object Block
+//	{
+//		i32 height;
+//		Transaction coinbase;
+//		Transaction[] transactions;
+//		string[] tags;
+//	}
+//
+// Field types are i8..i64, u8..u64, float, double, bool, string and the
+// objects of the schema. [] makes a numeric type an Array and a string or
+// object a list, an Object named "<field>[]" whose elements are named by
+// index, the layout abcjson uses for JSON lists.
+namespace Schema
+{
+	enum class Kind
+	{
+		// a Primitive, or an Array when list is set
+		SCALAR,
+		STRING,
+		OBJECT
+	};
+
+	struct Scalar
+	{
+		const char* name;
+		const char* cpp;
+		// the ObjectModel::Type enumerator
+		const char* type;
+	};
+
+	// nullptr when name isn't a scalar type
+	const Scalar* findScalar(const std::string& name);
+
+	struct Field
+	{
+		Kind kind;
+		// the schema spelling, i32 or Transaction
+		std::string type;
+		std::string name;
+		bool list = false;
+		int line = 0;
+	};
+
+	struct Struct
+	{
+		std::string name;
+		std::vector<Field> fields;
+		int line = 0;
+	};
+
+	struct Schema
+	{
+		// C++ namespace, may be nested with ::
+		std::string space;
+		// declaration order, fixed up by parse so that every struct comes
+		// after the ones it holds by value
+		std::vector<Struct> structs;
+	};
+
+	// "line: message" in error on failure
+	bool parse(const std::string& text, Schema& schema, std::string& error);
+
+	// <stem>.abc.h and <stem>.abc.cpp, source is named in the banner
+	std::string emitHeader(const Schema& schema, const std::string& source);
+	std::string emitSource(const Schema& schema, const std::string& stem, const std::string& source);
+}
@@ -0,0 +1,1059 @@
+#include "convert.h"
+#include "../../include/serialization.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+#include "json.hh"
+
+
+namespace ObjectModel
+{
+	namespace Json
+	{
+		namespace
+		{
+			using json = nlohmann::json;
+
+			// elements of a numeric array are spilled as a tag and 8 bytes until
+			// the array ends and its type is known
+			enum class Spilled : uint8_t
+			{
+				INT,
+				UNSIGNED,
+				FLOAT
+			};
+
+			constexpr size_t spillSize = 1 + sizeof(int64_t);
+
+			Type integerType(int64_t min, int64_t max)
+			{
+				if (min >= INT8_MIN && max <= INT8_MAX) return Type::I8;
+				if (min >= INT16_MIN && max <= INT16_MAX) return Type::I16;
+				if (min >= INT32_MIN && max <= INT32_MAX) return Type::I32;
+				return Type::I64;
+			}
+
+			// one spilled value in the wire order of type
+			void storeAs(uint8_t* p, Type type, Spilled kind, const uint8_t* bits)
+			{
+				int64_t i = Core::load<int64_t>(bits);
+				double d = kind == Spilled::FLOAT ? Core::load<double>(bits)
+					: kind == Spilled::UNSIGNED ? (double)(uint64_t)i : (double)i;
+
+				switch (type)
+				{
+				case Type::I8: *p = (uint8_t)i; break;
+				case Type::I16: Core::store<int16_t>(p, (int16_t)i); break;
+				case Type::I32: Core::store<int32_t>(p, (int32_t)i); break;
+				case Type::I64: Core::store<int64_t>(p, i); break;
+				case Type::U64: Core::store<uint64_t>(p, (uint64_t)i); break;
+				default: Core::store<double>(p, d); break;
+				}
+			}
+
+			// a section or the numbers of an open frame: kept in memory up to
+			// limit bytes, moved to a temp file past that
+			class Spill
+			{
+			private:
+				std::vector<uint8_t> memory;
+				std::FILE* file = nullptr;
+				bool owned = true;
+				bool spilled = false;
+				size_t limit;
+			public:
+				explicit Spill(size_t limit)
+					:
+					limit(limit) {}
+
+				// straight through to a file that isn't ours
+				explicit Spill(std::FILE* file)
+					:
+					file(file),
+					owned(false),
+					spilled(true),
+					limit(0) {}
+
+				~Spill()
+				{
+					if (owned && file)
+					{
+						std::fclose(file);
+					}
+				}
+
+				Spill(const Spill&) = delete;
+				Spill& operator=(const Spill&) = delete;
+
+				// whatever a finished sibling left behind is overwritten
+				void reset()
+				{
+					memory.clear();
+					spilled = false;
+					if (file)
+					{
+						std::rewind(file);
+					}
+				}
+
+				bool write(const void* bytes, size_t length)
+				{
+					if (!spilled && memory.size() + length <= limit)
+					{
+						const uint8_t* p = static_cast<const uint8_t*>(bytes);
+						memory.insert(memory.end(), p, p + length);
+						return true;
+					}
+
+					if (!spilled)
+					{
+						if (!file && !(file = std::tmpfile()))
+						{
+							return false;
+						}
+						if (std::fwrite(memory.data(), 1, memory.size(), file) != memory.size())
+						{
+							return false;
+						}
+						memory.clear();
+						spilled = true;
+					}
+					return std::fwrite(bytes, 1, length, file) == length;
+				}
+
+				// nullptr once it went to the file
+				inline const std::vector<uint8_t>* inMemory() const { return spilled ? nullptr : &memory; }
+
+				// reads the spilled bytes front to back, after the writes are done
+				bool rewindFile() { return std::fseek(file, 0, SEEK_SET) == 0; }
+				bool read(void* into, size_t size, size_t n) { return std::fread(into, size, n, file) == n; }
+			};
+
+			constexpr size_t spillLimit = 256 * 1024;
+
+			// what an open object or array at one depth writes into, reused by
+			// every sibling that comes after it
+			struct Level
+			{
+				Spill sections[4] = { Spill(spillLimit), Spill(spillLimit), Spill(spillLimit), Spill(spillLimit) };
+				Spill values = Spill(spillLimit);
+			};
+
+			enum class Kind
+			{
+				OBJECT,
+				NUMBERS,
+				LIST
+			};
+
+			struct Frame
+			{
+				Kind kind;
+				std::string name;
+				int64_t counts[4] = {};
+				uint64_t sizes[4] = {};
+
+				// numbers spilled so far
+				int64_t values = 0;
+				bool floats = false;
+				bool big = false;
+				int64_t min = INT64_MAX;
+				int64_t max = INT64_MIN;
+
+				// name of the next list element
+				int64_t next = 0;
+			};
+
+
+			// nlohmann SAX handler writing the wire format as the events come
+			class Builder
+			{
+			private:
+				Spill output;
+				std::vector<Frame> frames;
+				std::vector<std::unique_ptr<Level>> levels;
+				std::string pendingKey;
+				bool topArray = false;
+				int64_t roots = 0;
+				std::vector<uint8_t> entity;
+				std::vector<uint8_t> chunk;
+			public:
+				std::string error;
+				uint64_t written = 0;
+			public:
+				Builder(std::FILE* out)
+					:
+					output(out),
+					chunk(64 * 1024) {}
+
+				inline int64_t getRoots() const { return roots; }
+			public:
+				bool null()
+				{
+					uint8_t type = static_cast<uint8_t>(Type::BIT);
+					return scalar(Wrapper::ARRAY, &type, 1);
+				}
+
+				bool boolean(bool value)
+				{
+					uint8_t bytes[] = { static_cast<uint8_t>(Type::BOOL), (uint8_t)value };
+					return scalar(Wrapper::PRIMITIVE, bytes, sizeof bytes);
+				}
+
+				bool number_integer(int64_t value)
+				{
+					return number(Spilled::INT, value);
+				}
+
+				bool number_unsigned(uint64_t value)
+				{
+					return number(value > INT64_MAX ? Spilled::UNSIGNED : Spilled::INT, (int64_t)value);
+				}
+
+				bool number_float(double value, const std::string&)
+				{
+					int64_t bits;
+					std::memcpy(&bits, &value, sizeof bits);
+					return number(Spilled::FLOAT, bits);
+				}
+
+				bool string(std::string& value)
+				{
+					if (value.size() > INT32_MAX)
+					{
+						return fail("string longer than INT32_MAX bytes");
+					}
+
+					if (!prepare())
+					{
+						return false;
+					}
+
+					if (!header(Wrapper::STRING, nextName()))
+					{
+						return false;
+					}
+
+					uint8_t count[sizeof(int32_t)];
+					Core::store<int32_t>(count, (int32_t)value.size());
+					entity.push_back(static_cast<uint8_t>(Type::I8));
+					entity.insert(entity.end(), count, count + sizeof count);
+					return emit(2, reinterpret_cast<const uint8_t*>(value.data()), value.size());
+				}
+
+				bool binary(json::binary_t&)
+				{
+					return fail("binary values have no JSON text form");
+				}
+
+				bool start_object(size_t)
+				{
+					std::string name;
+					if (frames.empty())
+					{
+						name = topArray ? std::to_string(roots) : std::string();
+					}
+					else
+					{
+						if (!prepare())
+						{
+							return false;
+						}
+						name = nextName();
+					}
+
+					// the suffix marks a list, such an object wouldn't come back as one
+					if (name.size() >= 2 && name.compare(name.size() - 2, 2, "[]") == 0)
+					{
+						return fail("key \"" + name + "\" of an object ends in [], which marks lists");
+					}
+
+					return push(Kind::OBJECT, std::move(name));
+				}
+
+				bool key(std::string& value)
+				{
+					if (value.size() > INT16_MAX)
+					{
+						return fail("key longer than INT16_MAX bytes");
+					}
+
+					pendingKey = value;
+					return true;
+				}
+
+				bool end_object()
+				{
+					return close();
+				}
+
+				bool start_array(size_t)
+				{
+					if (frames.empty())
+					{
+						if (topArray)
+						{
+							return fail("top level array elements have to be objects");
+						}
+
+						topArray = true;
+						return true;
+					}
+
+					return prepare() && push(Kind::NUMBERS, nextName());
+				}
+
+				bool end_array()
+				{
+					if (frames.empty())
+					{
+						topArray = false;
+						return true;
+					}
+
+					if (frames.back().kind != Kind::NUMBERS)
+					{
+						return close();
+					}
+
+					// no one type holds values past INT64_MAX next to negative
+					// or fractional ones, they stay exact as a list of primitives
+					const Frame& frame = frames.back();
+					if (frame.big && (frame.floats || frame.min < 0))
+					{
+						return toList() && close();
+					}
+					return closeNumbers();
+				}
+
+				bool parse_error(size_t, const std::string&, const nlohmann::detail::exception& e)
+				{
+					return fail(e.what());
+				}
+			private:
+				bool fail(std::string message)
+				{
+					if (error.empty())
+					{
+						error = std::move(message);
+					}
+					return false;
+				}
+
+				std::string nextName()
+				{
+					Frame& parent = frames.back();
+					return parent.kind == Kind::OBJECT ? pendingKey : std::to_string(parent.next++);
+				}
+
+				// a value is about to land in the innermost frame
+				bool prepare()
+				{
+					if (frames.empty())
+					{
+						return fail(topArray ? "top level array elements have to be objects" : "the top level value has to be an object or an array");
+					}
+
+					return frames.back().kind != Kind::NUMBERS || toList();
+				}
+
+				bool push(Kind kind, std::string name)
+				{
+					size_t depth = frames.size();
+					if (levels.size() <= depth)
+					{
+						levels.push_back(std::make_unique<Level>());
+					}
+
+					Level& level = *levels[depth];
+					for (Spill& section : level.sections)
+					{
+						section.reset();
+					}
+					level.values.reset();
+
+					Frame frame;
+					frame.kind = kind;
+					frame.name = std::move(name);
+					frames.push_back(std::move(frame));
+					return true;
+				}
+
+				// where an entity of bytes goes: a section of the innermost frame,
+				// or out for a root object
+				Spill* target(int section, uint64_t bytes)
+				{
+					if (frames.empty())
+					{
+						roots++;
+						written += bytes;
+						return &output;
+					}
+
+					Frame& parent = frames.back();
+					if (++parent.counts[section] > INT16_MAX)
+					{
+						static const char* names[] = { "primitives", "arrays", "strings", "objects" };
+						fail("more than INT16_MAX " + std::string(names[section]) + " in " + (parent.name.empty() ? "the root" : "\"" + parent.name + "\""));
+						return nullptr;
+					}
+
+					parent.sizes[section] += bytes;
+					return &levels[frames.size() - 1]->sections[section];
+				}
+
+				bool put(Spill* to, const void* bytes, size_t length)
+				{
+					return to->write(bytes, length) || fail("write failed");
+				}
+
+				bool header(Wrapper wrapper, const std::string& name)
+				{
+					entity.clear();
+					entity.push_back(static_cast<uint8_t>(wrapper));
+					uint8_t length[sizeof(int16_t)];
+					Core::store<int16_t>(length, (int16_t)name.size());
+					entity.insert(entity.end(), length, length + sizeof length);
+					entity.insert(entity.end(), name.begin(), name.end());
+					return true;
+				}
+
+				// entity holds everything up to the payload, the size trailer follows it
+				bool emit(int section, const uint8_t* payload, size_t length)
+				{
+					uint64_t size = entity.size() + length + sizeof(int32_t);
+					if (size > INT32_MAX)
+					{
+						return fail("entity larger than INT32_MAX bytes");
+					}
+
+					uint8_t trailer[sizeof(int32_t)];
+					Core::store<int32_t>(trailer, (int32_t)size);
+
+					Spill* to = target(section, size);
+					return to && put(to, entity.data(), entity.size()) && put(to, payload, length) && put(to, trailer, sizeof trailer);
+				}
+
+				// a primitive, or an empty array, from the bytes after the name
+				bool scalar(Wrapper wrapper, const uint8_t* bytes, size_t length)
+				{
+					if (!prepare())
+					{
+						return false;
+					}
+
+					header(wrapper, nextName());
+					entity.insert(entity.end(), bytes, bytes + length);
+					if (wrapper == Wrapper::ARRAY)
+					{
+						uint8_t n[sizeof(int32_t)] = {};
+						entity.insert(entity.end(), n, n + sizeof n);
+					}
+					return emit(wrapper == Wrapper::PRIMITIVE ? 0 : 1, nullptr, 0);
+				}
+
+				bool primitive(Spilled kind, const uint8_t* bits)
+				{
+					int64_t value = Core::load<int64_t>(bits);
+					Type type = kind == Spilled::FLOAT ? Type::DOUBLE
+						: kind == Spilled::UNSIGNED ? Type::U64 : integerType(value, value);
+
+					uint8_t bytes[1 + sizeof(int64_t)] = { static_cast<uint8_t>(type) };
+					storeAs(bytes + 1, type, kind, bits);
+					header(Wrapper::PRIMITIVE, nextName());
+					entity.insert(entity.end(), bytes, bytes + 1 + getTypeSize(type));
+					return emit(0, nullptr, 0);
+				}
+
+				bool number(Spilled kind, int64_t value)
+				{
+					uint8_t bits[sizeof value];
+					Core::store<int64_t>(bits, value);
+
+					if (frames.empty() || frames.back().kind != Kind::NUMBERS)
+					{
+						return prepare() && primitive(kind, bits);
+					}
+
+					Frame& frame = frames.back();
+					frame.values++;
+					frame.floats |= kind == Spilled::FLOAT;
+					frame.big |= kind == Spilled::UNSIGNED;
+					if (kind == Spilled::INT)
+					{
+						frame.min = std::min(frame.min, value);
+						frame.max = std::max(frame.max, value);
+					}
+
+					uint8_t record[spillSize] = { static_cast<uint8_t>(kind) };
+					std::memcpy(record + 1, bits, sizeof bits);
+					return put(&levels[frames.size() - 1]->values, record, sizeof record);
+				}
+
+				// something other than a number showed up in an array: it becomes
+				// an object, the numbers so far its first primitives
+				bool toList()
+				{
+					Frame& frame = frames.back();
+					frame.kind = Kind::LIST;
+					frame.name += "[]";
+
+					// primitive() appends to sections, never to values
+					Spill& values = levels[frames.size() - 1]->values;
+					return forEachValue(values, frame.values, [&](const uint8_t* records, size_t n)
+					{
+						for (size_t i = 0; i < n; i++)
+						{
+							const uint8_t* record = records + i * spillSize;
+							if (!primitive(static_cast<Spilled>(record[0]), record + 1))
+							{
+								return false;
+							}
+						}
+						return true;
+					});
+				}
+
+				// hands the spilled numbers over in chunks
+				template<typename Visit>
+				bool forEachValue(Spill& values, int64_t count, Visit visit)
+				{
+					if (const std::vector<uint8_t>* memory = values.inMemory())
+					{
+						return visit(memory->data(), (size_t)count);
+					}
+
+					std::vector<uint8_t> records(chunk.size());
+					size_t perChunk = records.size() / spillSize;
+					if (!values.rewindFile())
+					{
+						return fail("spill file read failed");
+					}
+
+					for (int64_t first = 0; first < count; first += perChunk)
+					{
+						size_t n = (size_t)std::min<int64_t>(perChunk, count - first);
+						if (!values.read(records.data(), spillSize, n))
+						{
+							return fail("spill file read failed");
+						}
+						if (!visit(records.data(), n))
+						{
+							return false;
+						}
+					}
+					return true;
+				}
+
+				bool copy(Spill& from, uint64_t length, Spill* to)
+				{
+					if (const std::vector<uint8_t>* memory = from.inMemory())
+					{
+						return put(to, memory->data(), (size_t)length);
+					}
+
+					if (!from.rewindFile())
+					{
+						return fail("spill file read failed");
+					}
+
+					while (length > 0)
+					{
+						size_t n = (size_t)std::min<uint64_t>(length, chunk.size());
+						if (!from.read(chunk.data(), 1, n))
+						{
+							return fail("spill file read failed");
+						}
+						if (!put(to, chunk.data(), n))
+						{
+							return false;
+						}
+						length -= n;
+					}
+					return true;
+				}
+
+				// header, the four sections from the spill files and the size
+				bool close()
+				{
+					Frame frame = std::move(frames.back());
+					frames.pop_back();
+					Level& level = *levels[frames.size()];
+
+					header(Wrapper::OBJECT, frame.name);
+					uint64_t size = entity.size() + 4 * sizeof(int16_t) + sizeof(int32_t);
+					for (uint64_t s : frame.sizes)
+					{
+						size += s;
+					}
+					if (size > INT32_MAX)
+					{
+						return fail("object \"" + frame.name + "\" larger than INT32_MAX bytes");
+					}
+
+					Spill* to = target(3, size);
+					if (!to || !put(to, entity.data(), entity.size()))
+					{
+						return false;
+					}
+
+					for (int s = 0; s < 4; s++)
+					{
+						uint8_t count[sizeof(int16_t)];
+						Core::store<int16_t>(count, (int16_t)frame.counts[s]);
+						if (!put(to, count, sizeof count) || !copy(level.sections[s], frame.sizes[s], to))
+						{
+							return false;
+						}
+					}
+
+					uint8_t trailer[sizeof(int32_t)];
+					Core::store<int32_t>(trailer, (int32_t)size);
+					return put(to, trailer, sizeof trailer);
+				}
+
+				bool closeNumbers()
+				{
+					Frame frame = std::move(frames.back());
+					frames.pop_back();
+					Spill& values = levels[frames.size()]->values;
+
+					Type type = frame.floats ? Type::DOUBLE
+						: frame.big ? Type::U64
+						: frame.values == 0 ? Type::I8 : integerType(frame.min, frame.max);
+					uint64_t bytes = (uint64_t)frame.values * getTypeSize(type);
+
+					if (frame.values > INT32_MAX)
+					{
+						return fail("array \"" + frame.name + "\" longer than INT32_MAX elements");
+					}
+
+					header(Wrapper::ARRAY, frame.name);
+					uint8_t count[sizeof(int32_t)];
+					Core::store<int32_t>(count, (int32_t)frame.values);
+					entity.push_back(static_cast<uint8_t>(type));
+					entity.insert(entity.end(), count, count + sizeof count);
+
+					uint64_t size = entity.size() + bytes + sizeof(int32_t);
+					if (size > INT32_MAX)
+					{
+						return fail("array \"" + frame.name + "\" larger than INT32_MAX bytes");
+					}
+
+					Spill* to = target(1, size);
+					if (!to || !put(to, entity.data(), entity.size()))
+					{
+						return false;
+					}
+
+					std::vector<uint8_t>& converted = entity;
+					bool converting = forEachValue(values, frame.values, [&](const uint8_t* records, size_t n)
+					{
+						converted.resize(n * getTypeSize(type));
+						for (size_t i = 0; i < n; i++)
+						{
+							const uint8_t* record = records + i * spillSize;
+							storeAs(converted.data() + i * getTypeSize(type), type, static_cast<Spilled>(record[0]), record + 1);
+						}
+						return put(to, converted.data(), converted.size());
+					});
+
+					uint8_t trailer[sizeof(int32_t)];
+					Core::store<int32_t>(trailer, (int32_t)size);
+					return converting && put(to, trailer, sizeof trailer);
+				}
+			};
+
+
+			// buffered JSON text
+			class Printer
+			{
+			private:
+				struct Context
+				{
+					bool list;
+					bool first;
+				};
+
+				std::FILE* out;
+				std::vector<char> buffer;
+				std::vector<Context> stack;
+				bool failed = false;
+
+				// the array or string being printed
+				bool isString = false;
+				bool isNull = false;
+				bool firstValue = true;
+				int64_t bitsLeft = 0;
+			public:
+				uint64_t written = 0;
+			public:
+				Printer(std::FILE* out)
+					:
+					out(out)
+				{
+					buffer.reserve(64 * 1024);
+				}
+
+				inline bool good() const { return !failed; }
+
+				bool flush()
+				{
+					if (std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size())
+					{
+						failed = true;
+					}
+					written += buffer.size();
+					buffer.clear();
+					return !failed;
+				}
+
+				void put(char c)
+				{
+					if (buffer.size() == buffer.capacity())
+					{
+						flush();
+					}
+					buffer.push_back(c);
+				}
+
+				void put(const char* p, size_t n)
+				{
+					if (buffer.size() + n > buffer.capacity())
+					{
+						flush();
+					}
+					buffer.insert(buffer.end(), p, p + n);
+				}
+
+				void put(const char* text)
+				{
+					put(text, std::strlen(text));
+				}
+
+				// escaped string contents, without the quotes
+				void escape(const uint8_t* p, size_t n)
+				{
+					size_t run = 0;
+					for (size_t i = 0; i < n; i++)
+					{
+						uint8_t c = p[i];
+						if (c >= 0x20 && c != '"' && c != '\\')
+						{
+							continue;
+						}
+
+						put(reinterpret_cast<const char*>(p) + run, i - run);
+						run = i + 1;
+						switch (c)
+						{
+						case '"': put("\\\""); break;
+						case '\\': put("\\\\"); break;
+						case '\n': put("\\n"); break;
+						case '\r': put("\\r"); break;
+						case '\t': put("\\t"); break;
+						case '\b': put("\\b"); break;
+						case '\f': put("\\f"); break;
+						default:
+						{
+							char hex[8];
+							std::snprintf(hex, sizeof hex, "\\u%04x", c);
+							put(hex);
+						}
+						}
+					}
+					put(reinterpret_cast<const char*>(p) + run, n - run);
+				}
+
+				void quoted(std::string_view text)
+				{
+					put('"');
+					escape(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+					put('"');
+				}
+
+				// comma and key in front of a value, name is the entity name
+				void prefix(std::string_view name)
+				{
+					if (stack.empty())
+					{
+						return;
+					}
+
+					Context& context = stack.back();
+					if (!context.first)
+					{
+						put(',');
+					}
+					context.first = false;
+
+					if (!context.list)
+					{
+						quoted(name);
+						put(':');
+					}
+				}
+
+				template<typename T>
+				void integer(T value)
+				{
+					char text[24];
+					std::to_chars_result r = std::to_chars(text, text + sizeof text, value);
+					put(text, r.ptr - text);
+				}
+
+				void real(double value)
+				{
+					if (!std::isfinite(value))
+					{
+						put("null");
+						return;
+					}
+
+					char text[32];
+					std::to_chars_result r = std::to_chars(text, text + sizeof text, value);
+					put(text, r.ptr - text);
+				}
+
+				void value(Type type, const uint8_t* p)
+				{
+					switch (type)
+					{
+					case Type::I8: integer((int8_t)*p); break;
+					case Type::I16: integer(Core::load<int16_t>(p)); break;
+					case Type::I32: integer(Core::load<int32_t>(p)); break;
+					case Type::I64: integer(Core::load<int64_t>(p)); break;
+					case Type::U8: integer(*p); break;
+					case Type::U16: integer(Core::load<uint16_t>(p)); break;
+					case Type::U32: integer(Core::load<uint32_t>(p)); break;
+					case Type::U64: integer(Core::load<uint64_t>(p)); break;
+					case Type::FLOAT: real(Core::load<float>(p)); break;
+					case Type::DOUBLE: real(Core::load<double>(p)); break;
+					case Type::F16:
+					case Type::BF16:
+					{
+						uint16_t half = Core::load<uint16_t>(p);
+						float f;
+						if (type == Type::F16) Core::Kernels::halfToFloat(&half, 1, &f);
+						else Core::Kernels::bfloat16ToFloat(&half, 1, &f);
+						real(f);
+						break;
+					}
+					default: put(*p ? "true" : "false"); break;
+					}
+				}
+
+				void beginObject(std::string_view name)
+				{
+					bool list = name.size() >= 2 && name.substr(name.size() - 2) == "[]";
+					prefix(list ? name.substr(0, name.size() - 2) : name);
+					put(list ? '[' : '{');
+					stack.push_back(Context{ list, true });
+				}
+
+				void endObject()
+				{
+					put(stack.back().list ? ']' : '}');
+					stack.pop_back();
+				}
+
+				void beginArray(std::string_view name, Wrapper wrapper, Type type, int32_t count)
+				{
+					prefix(name);
+					isString = wrapper == Wrapper::STRING;
+					isNull = !isString && type == Type::BIT && count == 0;
+					firstValue = true;
+					bitsLeft = count;
+					put(isString ? "\"" : isNull ? "null" : "[");
+				}
+
+				void chunk(Type type, const uint8_t* p, size_t length)
+				{
+					if (isString)
+					{
+						escape(p, length);
+						return;
+					}
+
+					size_t step = type == Type::BIT ? 1 : getTypeSize(type);
+					for (size_t i = 0; i < length; i += step)
+					{
+						if (type != Type::BIT)
+						{
+							put(firstValue ? "" : ",");
+							firstValue = false;
+							value(type, p + i);
+							continue;
+						}
+
+						for (int bit = 0; bit < 8 && bitsLeft > 0; bit++, bitsLeft--)
+						{
+							put(firstValue ? "" : ",");
+							firstValue = false;
+							put((p[i] >> bit) & 1 ? "true" : "false");
+						}
+					}
+				}
+
+				void endArray()
+				{
+					put(isString ? "\"" : isNull ? "" : "]");
+				}
+			};
+
+
+			// the FILE* adapter of the parser pays a getc per character, this
+			// hands it fread blocks instead
+			struct Blocks
+			{
+				std::FILE* in;
+				std::vector<char> block = std::vector<char>(64 * 1024);
+				size_t position = 0;
+				size_t length = 0;
+				uint64_t total = 0;
+
+				bool refill()
+				{
+					position = 0;
+					length = std::fread(block.data(), 1, block.size(), in);
+					total += length;
+					return length > 0;
+				}
+			};
+
+			// input iterator over Blocks, compares equal to the end one,
+			// holding nullptr, once the file is exhausted
+			struct BlockIterator
+			{
+				using iterator_category = std::input_iterator_tag;
+				using value_type = char;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const char*;
+				using reference = const char&;
+
+				Blocks* blocks;
+
+				inline const char& operator*() const { return blocks->block[blocks->position]; }
+				inline BlockIterator& operator++() { blocks->position++; return *this; }
+
+				inline bool exhausted() const { return !blocks || (blocks->position == blocks->length && !blocks->refill()); }
+				inline bool operator==(const BlockIterator& other) const { return exhausted() == other.exhausted(); }
+				inline bool operator!=(const BlockIterator& other) const { return !(*this == other); }
+			};
+
+
+			const char* describe(DecodeStatus status)
+			{
+				switch (status)
+				{
+				case DecodeStatus::TRUNCATED: return "input ends inside an entity";
+				case DecodeStatus::MALFORMED: return "malformed entity";
+				case DecodeStatus::TOO_DEEP: return "objects nested too deep";
+				case DecodeStatus::TOO_LARGE: return "entity too large";
+				default: return "ok";
+				}
+			}
+		}
+
+
+		Result toAbc(std::FILE* in, std::FILE* out)
+		{
+			Result result;
+			Builder builder(out);
+
+			Blocks blocks{ in };
+			bool parsed = json::sax_parse(BlockIterator{ &blocks }, BlockIterator{ nullptr }, &builder);
+			result.ok = parsed && builder.error.empty();
+			result.error = builder.error.empty() && !parsed ? "parse failed" : builder.error;
+			result.bytesOut = builder.written;
+			result.objects = (uint64_t)builder.getRoots();
+
+			result.bytesIn = blocks.total;
+
+			if (std::fflush(out) != 0 && result.ok)
+			{
+				result.ok = false;
+				result.error = "write failed";
+			}
+			return result;
+		}
+
+
+		Result fromAbc(std::FILE* in, std::FILE* out)
+		{
+			Result result;
+			Printer printer(out);
+			ObjectReader reader(fileno(in), 1 << 20, DecodeLimits{ 4096, SIZE_MAX });
+			bool topList = false;
+			ObjectReader::Event event;
+
+			while ((event = reader.next()) != ObjectReader::Event::END)
+			{
+				switch (event)
+				{
+				case ObjectReader::Event::BEGIN_OBJECT:
+					if (reader.getDepth() == 1)
+					{
+						// roots named "" come from a JSON object, the rest from a top level array
+						if (result.objects == 0)
+						{
+							topList = !reader.getName().empty();
+							printer.put(topList ? "[" : "");
+						}
+						else if (!topList)
+						{
+							result.ok = false;
+							result.error = "more than one root object";
+							return result;
+						}
+						else
+						{
+							printer.put(',');
+						}
+
+						result.objects++;
+						printer.beginObject("");
+					}
+					else
+					{
+						printer.beginObject(reader.getName());
+					}
+					break;
+				case ObjectReader::Event::END_OBJECT:
+					printer.endObject();
+					break;
+				case ObjectReader::Event::PRIMITIVE:
+					printer.prefix(reader.getName());
+					printer.value(reader.getType(), reader.getData());
+					break;
+				case ObjectReader::Event::BEGIN_ARRAY:
+					printer.beginArray(reader.getName(), reader.getWrapper(), reader.getType(), reader.getCount());
+					break;
+				case ObjectReader::Event::ARRAY_CHUNK:
+					printer.chunk(reader.getType(), reader.getData(), reader.getLength());
+					break;
+				case ObjectReader::Event::END_ARRAY:
+					printer.endArray();
+					break;
+				default:
+					result.ok = false;
+					result.error = reader.getError() != 0 ? std::string("read failed: ") + std::strerror(reader.getError()) : describe(reader.getStatus());
+					return result;
+				}
+			}
+
+			printer.put(topList ? "]" : "");
+			result.ok = printer.flush() && std::fflush(out) == 0;
+			result.error = result.ok ? "" : "write failed";
+			result.bytesOut = printer.written;
+
+			off_t read = lseek(fileno(in), 0, SEEK_CUR);
+			result.bytesIn = read < 0 ? 0 : (uint64_t)read;
+			return result;
+		}
+	}
+}
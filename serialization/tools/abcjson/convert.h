@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+
+
+// JSON <-> .abc without building either tree. JSON is read through the
+// nlohmann SAX interface, .abc through ObjectReader, so memory depends on
+// the nesting depth and not on the input size.
+//
+// Mapping, the wire format has no lists and no null:
+//	object					Object, the root is named ""
+//	integer					narrowest of I8..I64 that holds it, U64 above INT64_MAX
+//	float					DOUBLE
+//	true/false				BOOL
+//	string					String
+//	null					empty BIT array
+//	array of numbers		Array, typed like the widest element; values
+//							above INT64_MAX next to negative or fractional
+//							ones make it a list of primitives instead
+//	any other array			Object named "<key>[]", elements named by index
+//	top level array			one root Object per element, named by index
+//
+// Object keys and the elements of mixed lists come back grouped by kind
+// (primitives, arrays, strings, objects), the wire order. An object whose
+// key ends in "[]" is an error, it would read back as a list.
+namespace ObjectModel
+{
+	namespace Json
+	{
+		struct Result
+		{
+			bool ok = true;
+			std::string error;
+			uint64_t bytesIn = 0;
+			uint64_t bytesOut = 0;
+			// top level objects written or read
+			uint64_t objects = 0;
+		};
+
+		// out is written front to back and may be a pipe. Section counts
+		// above INT16_MAX and entities above INT32_MAX bytes are errors.
+		Result toAbc(std::FILE* in, std::FILE* out);
+
+		// in is read through its file descriptor
+		Result fromAbc(std::FILE* in, std::FILE* out);
+	}
+}
@@ -0,0 +1,67 @@
+#include "convert.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+
+// abcjson to-abc|to-json [in [out]], - or nothing for stdin/stdout
+int main(int argc, char** argv)
+{
+	bool stats = false;
+	const char* args[3] = {};
+	int n = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--stats") == 0)
+		{
+			stats = true;
+		}
+		else if (n < 3)
+		{
+			args[n++] = argv[i];
+		}
+	}
+
+	bool toAbc = n > 0 && std::strcmp(args[0], "to-abc") == 0;
+	bool toJson = n > 0 && std::strcmp(args[0], "to-json") == 0;
+	if (!toAbc && !toJson)
+	{
+		std::fprintf(stderr, "usage: %s to-abc|to-json [in [out]] [--stats]\n", argv[0]);
+		return 2;
+	}
+
+	auto open = [](const char* path, const char* mode, std::FILE* fallback)
+	{
+		return !path || std::strcmp(path, "-") == 0 ? fallback : std::fopen(path, mode);
+	};
+
+	std::FILE* in = open(args[1], "rb", stdin);
+	std::FILE* out = open(args[2], "wb", stdout);
+	if (!in || !out)
+	{
+		std::fprintf(stderr, "%s: %s\n", !in ? args[1] : args[2], std::strerror(errno));
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ObjectModel::Json::Result result = toAbc ? ObjectModel::Json::toAbc(in, out) : ObjectModel::Json::fromAbc(in, out);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (in != stdin) std::fclose(in);
+	if (out != stdout) std::fclose(out);
+
+	if (!result.ok)
+	{
+		std::fprintf(stderr, "abcjson: %s\n", result.error.c_str());
+		return 1;
+	}
+
+	if (stats)
+	{
+		std::fprintf(stderr, "%llu bytes in, %llu bytes out, %llu objects, %.2f s, %.1f MB/s\n",
+			(unsigned long long)result.bytesIn, (unsigned long long)result.bytesOut,
+			(unsigned long long)result.objects, seconds, seconds > 0 ? result.bytesIn / seconds / 1e6 : 0.0);
+	}
+	return 0;
+}
@@ -0,0 +1,237 @@
+#include "server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// serverload [--seconds n] [--clients n] [--window n] [--size n] [--batch n] [--host a.b.c.d] [--port n]
+// keeps window datagrams in flight from each client and reports replies
+// per second and round trip percentiles; without --port it runs against
+// a Net::Server of its own on a free port, reading batch datagrams per
+// syscall. Every eighth datagram is a
+// primitive, the rest are echoed text stamped with their send time.
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Result
+	{
+		uint64_t replies = 0;
+		uint64_t lost = 0;
+		std::vector<uint32_t> latencies;
+	};
+
+	uint64_t now()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+	}
+
+	void client(const sockaddr_in& to, Clock::time_point until, size_t window, size_t size, Result& result)
+	{
+		int fd = socket(AF_INET, SOCK_DGRAM, 0);
+		struct timeval timeout{ 0, 50 * 1000 };
+		if (fd < 0 || connect(fd, (const sockaddr*)&to, sizeof to) != 0 || setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout) != 0)
+		{
+			std::fprintf(stderr, "client socket: %s\n", std::strerror(errno));
+			return;
+		}
+
+		std::unique_ptr<Primitive> p = Primitive::create("load", (int32_t)7);
+		std::vector<uint8_t> primitive(p->getSize());
+		int16_t it = 0;
+		p->pack(primitive, it);
+
+		// the window goes out and comes back in batches so the clients,
+		// which share the cores with the server, cost as little as they can
+		size_t length = std::max<size_t>(size, 1 + sizeof(uint64_t));
+		std::vector<char> out(window * length, 'x');
+		std::vector<char> in(window * SIZE);
+		std::vector<iovec> iovecs(2 * window);
+		std::vector<mmsghdr> sends(window), receives(window);
+		for (size_t i = 0; i < window; i++)
+		{
+			iovecs[i] = { &in[i * SIZE], SIZE };
+			receives[i].msg_hdr.msg_iov = &iovecs[i];
+			receives[i].msg_hdr.msg_iovlen = 1;
+			sends[i].msg_hdr.msg_iov = &iovecs[window + i];
+			sends[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		size_t outstanding = 0;
+		uint64_t sent = 0;
+		while (Clock::now() < until)
+		{
+			size_t n = window - outstanding;
+			uint64_t stamp = now();
+			for (size_t i = 0; i < n; i++, sent++)
+			{
+				iovec& iov = iovecs[window + i];
+				if (sent % 8 == 7)
+				{
+					iov = { primitive.data(), primitive.size() };
+					continue;
+				}
+				char* text = &out[i * length];
+				text[0] = 'L';
+				std::memcpy(text + 1, &stamp, sizeof stamp);
+				iov = { text, length };
+			}
+			for (size_t i = 0; i < n; )
+			{
+				int m = sendmmsg(fd, sends.data() + i, (unsigned)(n - i), 0);
+				i += m > 0 ? (size_t)m : 1;
+			}
+			outstanding = window;
+
+			int got = recvmmsg(fd, receives.data(), (unsigned)window, MSG_WAITFORONE, nullptr);
+			if (got <= 0)
+			{
+				// whatever is still out counts as lost, the window starts over
+				result.lost += outstanding;
+				outstanding = 0;
+				continue;
+			}
+
+			uint64_t arrived = now();
+			outstanding -= (size_t)got;
+			result.replies += (uint64_t)got;
+			for (int i = 0; i < got; i++)
+			{
+				const char* reply = &in[i * SIZE];
+				if (reply[0] == 'L' && receives[i].msg_len >= 1 + sizeof(uint64_t))
+				{
+					std::memcpy(&stamp, reply + 1, sizeof stamp);
+					result.latencies.push_back((uint32_t)std::min<uint64_t>((arrived - stamp) / 1000, UINT32_MAX));
+				}
+			}
+		}
+		close(fd);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	size_t seconds = 5;
+	size_t clients = 4;
+	size_t window = 32;
+	size_t size = 64;
+	size_t port = 0;
+	size_t batch = 32;
+	std::string host = "127.0.0.1";
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto number = [&](size_t& into)
+		{
+			if (i + 1 >= argc)
+			{
+				return false;
+			}
+			into = std::strtoull(argv[++i], nullptr, 10);
+			return true;
+		};
+
+		bool ok = true;
+		if (std::strcmp(argv[i], "--seconds") == 0) ok = number(seconds);
+		else if (std::strcmp(argv[i], "--clients") == 0) ok = number(clients);
+		else if (std::strcmp(argv[i], "--window") == 0) ok = number(window);
+		else if (std::strcmp(argv[i], "--size") == 0) ok = number(size) && size <= SIZE;
+		else if (std::strcmp(argv[i], "--batch") == 0) ok = number(batch);
+		else if (std::strcmp(argv[i], "--port") == 0) ok = number(port);
+		else if (std::strcmp(argv[i], "--host") == 0 && i + 1 < argc) host = argv[++i];
+		else ok = false;
+
+		if (!ok || clients == 0 || window == 0)
+		{
+			std::fprintf(stderr, "usage: %s [--seconds n] [--clients n] [--window n] [--size n] [--batch n] [--host a.b.c.d] [--port n]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::unique_ptr<Net::Server> server;
+	std::thread loop;
+	if (port == 0)
+	{
+		server = std::make_unique<Net::Server>(0, host);
+		server->setVerbose(false);
+		server->setBatch(batch);
+		if (!server->open())
+		{
+			std::fprintf(stderr, "server: %s\n", std::strerror(errno));
+			return 1;
+		}
+		port = (size_t)server->getPort();
+		loop = std::thread([&]() { server->start(); });
+	}
+
+	sockaddr_in to{};
+	to.sin_family = AF_INET;
+	to.sin_port = htons((uint16_t)port);
+	if (inet_pton(AF_INET, host.c_str(), &to.sin_addr) != 1)
+	{
+		std::fprintf(stderr, "bad host %s\n", host.c_str());
+		return 2;
+	}
+
+	// the server thread's cpu time, what the packets cost it alone
+	auto serverTime = [&]()
+	{
+		clockid_t clock;
+		struct timespec spent{};
+		if (server && pthread_getcpuclockid(loop.native_handle(), &clock) == 0)
+		{
+			clock_gettime(clock, &spent);
+		}
+		return spent.tv_sec * 1e9 + spent.tv_nsec;
+	};
+	double serverStart = serverTime();
+
+	std::vector<Result> results(clients);
+	std::vector<std::thread> threads;
+	Clock::time_point start = Clock::now();
+	Clock::time_point until = start + std::chrono::seconds(seconds);
+	for (size_t i = 0; i < clients; i++)
+	{
+		threads.emplace_back(client, std::cref(to), until, window, size, std::ref(results[i]));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	double serverSpent = serverTime() - serverStart;
+
+	Result total;
+	for (Result& result : results)
+	{
+		total.replies += result.replies;
+		total.lost += result.lost;
+		total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+	}
+	std::sort(total.latencies.begin(), total.latencies.end());
+	auto percentile = [&](double p)
+	{
+		return total.latencies.empty() ? 0u : total.latencies[(size_t)(p * (total.latencies.size() - 1))];
+	};
+
+	std::printf("clients %zu window %zu size %zu batch %zu: %.0f packets/s, p50 %uus, p99 %uus, max %uus, lost %llu\n",
+		clients, window, size, batch, total.replies / elapsed, percentile(0.5), percentile(0.99), percentile(1.0),
+		(unsigned long long)total.lost);
+
+	if (server)
+	{
+		server->stop();
+		loop.join();
+		std::printf("server received %llu, dropped %llu replies, %.0fns cpu per packet\n",
+			(unsigned long long)server->getReceived(), (unsigned long long)server->getDropped(),
+			total.replies ? serverSpent / total.replies : 0.0);
+	}
+	return total.replies > 0 ? 0 : 1;
+}
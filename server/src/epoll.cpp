@@ -0,0 +1,382 @@
+#include "server.h"
+
+// the same server on POSIX: one non blocking socket, edge triggered epoll,
+// and every readable edge drains the socket so bursts don't pile up in the
+// kernel, up to batch datagrams per recvmmsg and their replies in one
+// sendmmsg. Replies that find the socket full wait in a backlog for EPOLLOUT.
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+namespace Net
+{
+	namespace
+	{
+		inline bool wouldBlock(int error)
+		{
+			// ENOBUFS is a full device queue, as good as a full socket
+			return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS;
+		}
+	}
+
+
+	Server::Server(int port, std::string ipaddress)
+		:
+		ipaddress(ipaddress),
+		port(port),
+		info{},
+		infolength(sizeof(info)) {}
+
+
+	bool Server::open()
+	{
+		if (serversocket >= 0)
+		{
+			return true;
+		}
+
+		struct sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		if (inet_pton(AF_INET, ipaddress.c_str(), &address.sin_addr) != 1)
+		{
+			return false;
+		}
+
+		int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		int epoll = epoll_create1(EPOLL_CLOEXEC);
+		int wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		// a bigger receive buffer rides out bursts between two epoll_waits
+		int bytes = 4 * 1024 * 1024;
+		bool ok = fd >= 0 && epoll >= 0 && wake >= 0;
+		ok = ok && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof bytes) == 0;
+		ok = ok && bind(fd, (struct sockaddr*)&address, sizeof address) == 0;
+
+		struct epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = wake;
+		ok = ok && epoll_ctl(epoll, EPOLL_CTL_ADD, wake, &event) == 0;
+		event.events = EPOLLIN | EPOLLET;
+		event.data.fd = fd;
+		ok = ok && epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+
+		if (!ok)
+		{
+			for (int f : { fd, epoll, wake })
+			{
+				if (f >= 0)
+				{
+					close(f);
+				}
+			}
+			return false;
+		}
+
+		serversocket = fd;
+		epollfd = epoll;
+		wakefd = wake;
+		writable = true;
+
+		// every header points at its slot for good, a round only resets
+		// the lengths the kernel wrote
+		slots.assign(batch, Slot());
+		incoming.assign(batch, mmsghdr());
+		outgoing.assign(batch, mmsghdr());
+		iovecs.assign(2 * batch, iovec());
+		for (size_t i = 0; i < batch; i++)
+		{
+			iovecs[i] = { slots[i].bytes, SIZE };
+			incoming[i].msg_hdr.msg_name = &slots[i].from;
+			incoming[i].msg_hdr.msg_iov = &iovecs[i];
+			incoming[i].msg_hdr.msg_iovlen = 1;
+
+			iovecs[batch + i] = { slots[i].bytes, 0 };
+			outgoing[i].msg_hdr.msg_name = &slots[i].from;
+			outgoing[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			outgoing[i].msg_hdr.msg_iov = &iovecs[batch + i];
+			outgoing[i].msg_hdr.msg_iovlen = 1;
+		}
+		if (verbose)
+		{
+			printf("Server started at:%s:%d\n", ipaddress.c_str(), getPort());
+		}
+		return true;
+	}
+
+
+	void Server::init()
+	{
+		if (!open())
+		{
+			printf("bind() failed...%d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+
+	void Server::start()
+	{
+		init();
+
+		struct epoll_event events[8];
+		while (!stopping.load(std::memory_order_acquire))
+		{
+			int n = epoll_wait(epollfd, events, 8, -1);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				printf("epoll_wait() failed...%d\n", errno);
+				return;
+			}
+
+			for (int i = 0; i < n; i++)
+			{
+				if (events[i].data.fd == wakefd)
+				{
+					continue;
+				}
+				if (events[i].events & EPOLLOUT)
+				{
+					flush();
+				}
+				if ((events[i].events & (EPOLLIN | EPOLLERR)) && batch > 1)
+				{
+					drainBatch();
+				}
+				else if (events[i].events & (EPOLLIN | EPOLLERR))
+				{
+					drain();
+				}
+			}
+		}
+	}
+
+
+	void Server::stop()
+	{
+		stopping.store(true, std::memory_order_release);
+		uint64_t one = 1;
+		if (wakefd >= 0 && write(wakefd, &one, sizeof one) < 0)
+		{
+			printf("stop() failed...%d\n", errno);
+		}
+	}
+
+
+	int Server::getPort() const
+	{
+		struct sockaddr_in bound{};
+		socklen_t length = sizeof bound;
+		if (serversocket < 0 || getsockname(serversocket, (struct sockaddr*)&bound, &length) != 0)
+		{
+			return port;
+		}
+		return ntohs(bound.sin_port);
+	}
+
+
+	void Server::drain()
+	{
+		// edge triggered, nothing wakes the loop again for what is left
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			infolength = sizeof(info);
+			recvlength = (int)recvfrom(serversocket, buffer, SIZE, 0, (struct sockaddr*)&info, &infolength);
+			if (recvlength < 0)
+			{
+				// a client's icmp error surfaces here, it isn't ours
+				if (errno == EINTR || errno == ECONNREFUSED)
+				{
+					continue;
+				}
+				if (!wouldBlock(errno))
+				{
+					printf("recv() failed...%d\n", errno);
+				}
+				return;
+			}
+
+			received++;
+			proccess();
+			send();
+
+			// the loop won't see EPOLLOUT before the socket is dry
+			if (!backlog.empty() && (received & 63) == 0)
+			{
+				flush();
+			}
+		}
+	}
+
+
+	void Server::send()
+	{
+		int length = respond();
+
+		// behind the backlog, replies go out in order
+		if (backlog.empty())
+		{
+			if (sendto(serversocket, buffer, length, 0, (struct sockaddr*)&info, infolength) >= 0)
+			{
+				return;
+			}
+			// a datagram that can't go out is lost like any other
+			if (!wouldBlock(errno))
+			{
+				return;
+			}
+		}
+
+		queue(buffer, length, info);
+	}
+
+
+	void Server::drainBatch()
+	{
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			for (size_t i = 0; i < batch; i++)
+			{
+				incoming[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			}
+
+			int n = recvmmsg(serversocket, incoming.data(), (unsigned)batch, 0, nullptr);
+			if (n < 0)
+			{
+				if (errno == EINTR || errno == ECONNREFUSED)
+				{
+					continue;
+				}
+				if (!wouldBlock(errno))
+				{
+					printf("recvmmsg() failed...%d\n", errno);
+				}
+				return;
+			}
+
+			// the whole batch first, each reply lands in its own slot
+			received += (uint64_t)n;
+			for (int i = 0; i < n; i++)
+			{
+				buffer = slots[i].bytes;
+				recvlength = (int)incoming[i].msg_len;
+				info = slots[i].from;
+				proccess();
+				iovecs[batch + i].iov_len = (size_t)respond();
+			}
+			buffer = storage;
+			transmit((size_t)n);
+			if (!backlog.empty())
+			{
+				flush();
+			}
+
+			// a short batch means the socket is dry, the next datagram is a new edge
+			if ((size_t)n < batch)
+			{
+				return;
+			}
+		}
+	}
+
+
+	void Server::transmit(size_t n)
+	{
+		size_t done = 0;
+		while (backlog.empty() && done < n)
+		{
+			int sent = sendmmsg(serversocket, outgoing.data() + done, (unsigned)(n - done), 0);
+			if (sent >= 0)
+			{
+				done += (size_t)sent;
+				continue;
+			}
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (wouldBlock(errno))
+			{
+				break;
+			}
+			// the error belongs to the first datagram, it is lost
+			done++;
+		}
+
+		for (; done < n; done++)
+		{
+			queue(slots[done].bytes, (int)iovecs[batch + done].iov_len, slots[done].from);
+		}
+	}
+
+
+	void Server::queue(const char* bytes, int length, const struct sockaddr_in& to)
+	{
+		if (backlog.size() >= maxBacklog)
+		{
+			dropped++;
+			return;
+		}
+
+		backlog.emplace_back();
+		Reply& reply = backlog.back();
+		reply.to = to;
+		reply.length = length;
+		std::memcpy(reply.bytes, bytes, length);
+		if (writable)
+		{
+			watch(true);
+		}
+	}
+
+
+	void Server::flush()
+	{
+		while (!backlog.empty())
+		{
+			Reply& reply = backlog.front();
+			if (sendto(serversocket, reply.bytes, reply.length, 0, (struct sockaddr*)&reply.to, sizeof reply.to) < 0 && wouldBlock(errno))
+			{
+				return;
+			}
+			backlog.pop_front();
+		}
+
+		if (!writable)
+		{
+			watch(false);
+		}
+	}
+
+
+	void Server::watch(bool out)
+	{
+		struct epoll_event event{};
+		event.events = EPOLLIN | EPOLLET | (out ? (uint32_t)EPOLLOUT : 0u);
+		event.data.fd = serversocket;
+		epoll_ctl(epollfd, EPOLL_CTL_MOD, serversocket, &event);
+		writable = !out;
+	}
+
+
+	Server::~Server()
+	{
+		for (int fd : { serversocket, epollfd, wakefd })
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+		}
+	}
+}
+#endif
@@ -1,10 +1,35 @@
 #include "server.h"
 
+#ifdef _WIN32
 #pragma warning(disable: 4996)
+#endif
 
 
 namespace Net
 {
+	namespace
+	{
+		// a whole primitive, whatever a client sends
+		bool isPrimitive(const char* bytes, int length)
+		{
+			if (length < 3 || bytes[0] != 0x1)
+			{
+				return false;
+			}
+
+			int16_t nameLength = Core::load<int16_t>(reinterpret_cast<const uint8_t*>(bytes) + 1);
+			if (nameLength < 0 || length < 4 + nameLength)
+			{
+				return false;
+			}
+
+			size_t typeSize = getTypeSize(static_cast<Type>(bytes[3 + nameLength]));
+			return typeSize != 0 && (size_t)length >= 4 + nameLength + typeSize + sizeof(int32_t);
+		}
+	}
+
+
+#ifdef _WIN32
 	Server::Server(int port, std::string ipaddress)
 		:
 		wsa{ 0 },
@@ -83,22 +108,48 @@ namespace Net
 	}
 
 
+	void Server::send()
+	{
+		int length = respond();
+		if ((sendto(serversocket, buffer, length, 0, (struct sockaddr*) & info, infolength)) == SOCKET_ERROR)
+		{
+			printf("send() failed...%d\n", WSAGetLastError());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+
+	Server::~Server()
+	{
+		WSACleanup();
+		closesocket(serversocket);
+	}
+#endif
+
+
 	void Server::proccess()
 	{
-		printf("packet from:%s:%d\n", inet_ntoa(info.sin_addr), ntohs(info.sin_port));
-		if (buffer[0] == 0x1)
+		if (verbose)
 		{
-			std::vector<uint8_t> result;
-			for (unsigned i = 0; i < recvlength; i++)
-			{
-				result.push_back(buffer[i]);
-			}
+			printf("packet from:%s:%d\n", inet_ntoa(info.sin_addr), ntohs(info.sin_port));
+		}
 
+		if (isPrimitive(buffer, recvlength))
+		{
+			packet.assign(buffer, buffer + recvlength);
+
+			// the last packet's primitive goes back to the pool here, its
+			// copy in primitives is gone by now so the payload comes along
 			int16_t it = 0;
-			Primitive p = Primitive::unpack(result, it);
+			last = EntityPool::local().unpackPrimitive(packet, it);
+			Primitive& p = *last;
 			primitives.insert(std::make_pair(p.getName(), p));
 			current = p.getName();
 
+			if (!verbose)
+			{
+				return;
+			}
 
 			printf("Primitive:\n");
 			printf("\t |Name:%s\n", p.getName().c_str());
@@ -112,7 +163,7 @@ namespace Net
 
 			printf("\n");
 		}
-		else
+		else if (verbose)
 		{
 			printf("data:");
 			for (unsigned i = 0; i < recvlength; i++)
@@ -126,34 +177,22 @@ namespace Net
 	}
 
 
-	void Server::send()
+	int Server::respond()
 	{
-
+		// anything that isn't a primitive is echoed
 		if (primitives.empty())
 		{
-			if ((sendto(serversocket, buffer, recvlength, 0, (struct sockaddr*) & info, infolength)) == SOCKET_ERROR)
-			{
-				printf("send() failed...%d\n", WSAGetLastError());
-				exit(EXIT_FAILURE);
-			}
+			return recvlength;
 		}
-		else
-		{
-			int16_t it = 0;
-			std::unique_ptr<Primitive> p = modify(current);
-			std::vector<uint8_t> result(p->getSize());
-			p->pack(result, it);
-			std::copy(result.begin(), result.end(), buffer);
 
-			if ((sendto(serversocket, buffer, p->getSize(), 0, (struct sockaddr*) & info, infolength)) == SOCKET_ERROR)
-			{
-				printf("send() failed...%d\n", WSAGetLastError());
-				exit(EXIT_FAILURE);
-			}
-
-			primitives.erase(current);
-		}
+		int16_t it = 0;
+		std::unique_ptr<Primitive> p = modify(current);
+		packet.resize(p->getSize());
+		p->pack(packet, it);
+		std::copy(packet.begin(), packet.end(), buffer);
 
+		primitives.erase(current);
+		return p->getSize();
 	}
 
 
@@ -170,13 +209,4 @@ namespace Net
 		return std::move(p);
 
 	}
-
-
-	Server::~Server()
-	{
-		WSACleanup();
-		closesocket(serversocket);
-	}
-
-
-}
\ No newline at end of file
+}
@@ -4,11 +4,19 @@
 #include <thread>
 #include <unordered_map>
 #include <vector>
-#include <WinSock2.h>
 #include <serialization.h>
 
+#ifdef _WIN32
+#include <WinSock2.h>
 
 #pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <atomic>
+#include <deque>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
 
 #define SIZE 1024
 
@@ -20,16 +28,62 @@ namespace Net
 	class Server
 	{
 	private:
+#ifdef _WIN32
 		WSADATA wsa;
 		SOCKET serversocket;
+#else
+		// replies the socket had no room for, sent on EPOLLOUT
+		struct Reply
+		{
+			struct sockaddr_in to;
+			int length;
+			char bytes[SIZE];
+		};
+
+		// one datagram of a batch, received and replied to in place
+		struct Slot
+		{
+			struct sockaddr_in from;
+			char bytes[SIZE];
+		};
+
+		int serversocket = -1;
+		int epollfd = -1;
+		// written by stop() to wake the loop
+		int wakefd = -1;
+		std::atomic<bool> stopping{ false };
+		std::deque<Reply> backlog;
+		size_t maxBacklog = 4096;
+		// datagrams per recvmmsg/sendmmsg, 1 for recvfrom/sendto
+		size_t batch = 32;
+		std::vector<Slot> slots;
+		std::vector<struct mmsghdr> incoming;
+		std::vector<struct mmsghdr> outgoing;
+		std::vector<struct iovec> iovecs;
+		// false while EPOLLOUT is watched
+		bool writable = true;
+		uint64_t received = 0;
+		uint64_t dropped = 0;
+#endif
 		std::string ipaddress;
 		int port;
-		char buffer[SIZE];
+		// the packet being handled, a batch slot or storage
+		char storage[SIZE];
+		char* buffer = storage;
 		std::string message;
 		struct sockaddr_in info;
+#ifdef _WIN32
 		int infolength;
+#else
+		socklen_t infolength;
+#endif
 		int recvlength;
+		bool verbose = true;
 
+		// the packet's bytes, unpacked and packed in place
+		std::vector<uint8_t> packet;
+		// the last primitive received, from the thread's EntityPool
+		Pooled<Primitive> last;
 		std::unordered_map<std::string, Primitive> primitives;
 		std::string current;
 	public:
@@ -37,12 +91,41 @@ namespace Net
 		~Server();
 	public:
 		void start();
-//		void stop();
+#ifndef _WIN32
+		// binds and sets up the loop, start does it when it wasn't done;
+		// false if the socket can't be bound
+		bool open();
+		// from any thread, start returns once the loop sees it
+		void stop();
+
+		// the bound port, the one picked when 0 was asked for
+		int getPort() const;
+		inline uint64_t getReceived() const { return received; }
+		// replies lost because the send backlog was full
+		inline uint64_t getDropped() const { return dropped; }
+		// datagrams per syscall, set before open
+		inline void setBatch(size_t n) { batch = n > 0 ? n : 1; }
+#endif
+		// prints every packet, off for load
+		inline void setVerbose(bool on) { verbose = on; }
 	private:
 		void init();
 		void receive();
 		void proccess();
 		void send();
+		// the reply to the packet in buffer, in buffer
+		int respond();
 		std::unique_ptr<Primitive> modify(std::string key);
+#ifndef _WIN32
+		// recvfrom until EAGAIN, replying to each packet
+		void drain();
+		// the same a batch at a time, replies go out together
+		void drainBatch();
+		void transmit(size_t n);
+		void queue(const char* bytes, int length, const struct sockaddr_in& to);
+		// the backlog, until the socket is full again
+		void flush();
+		void watch(bool out);
+#endif
 	};
-}
\ No newline at end of file
+}